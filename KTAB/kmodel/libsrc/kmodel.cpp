@@ -26,6 +26,9 @@
 
 #include <time.h>
 #include "kmodel.h"
+#include "kpce.h"
+#include "kprofile.h"
+#include "klog.h"
 
 namespace KBase {
 
@@ -34,11 +37,6 @@ using std::tuple;
 
 using KBase::nameFromEnum;
 
-// --------------------------------------------
-// Global Variables
-
-static std::mutex mtx_spce_log; // control access to log inside Model::scalarPCE
-
 // --------------------------------------------
 string Model::lastExceptionMsg = string();
 
@@ -46,6 +44,12 @@ string Model::getLastError() {
   return lastExceptionMsg;
 }
 
+thread_local const std::atomic<bool> * Model::threadCancelFlag = nullptr;
+
+void Model::setThreadCancelFlag(const std::atomic<bool> * cf) {
+  threadCancelFlag = cf;
+}
+
 // JAH 20160711 added seed 20160730 JAH added sql flags
 // BPW 2016-09-28 removed redundant PRNG input variable
 Model::Model(string desc, uint64_t sd, vector<bool> f, string Name) {
@@ -167,6 +171,10 @@ Model::~Model() {
     KTables.pop_back();
   }
 
+  // the store holds statements on the connection, so it goes first
+  delete store;
+  store = nullptr;
+
   if (nullptr != qtDB && qtDB->isValid()) {
     // Note: It is necessary to free the resources held by query object
     // Else the removeDatabase() method causes segmentation fault
@@ -199,10 +207,43 @@ void Model::run() {
     }
     iter++;
     LOG(INFO) << "Starting Model::run iteration" << iter;
-    auto s1 = s0->step();
+    // the profile is read before and after each turn, so the table shows just this turn
+    const bool prof = Profiler::enabled();
+    const auto p0 = prof ? Profiler::totals() : ProfileTotals();
+    const auto t0 = std::chrono::steady_clock::now();
+    State* s1 = nullptr;
+    {
+      KTAB_PROFILE_PHASE("State::step");
+      s1 = s0->step();
+    }
     addState(s1);
     done = stop(iter, s1);
     s0 = s1;
+    if (prof) {
+      const std::chrono::duration<double> dt = std::chrono::steady_clock::now() - t0;
+      Profiler::report(getFormattedString("turn %u", iter), dt.count(), Profiler::totals() - p0);
+    }
+
+    if ((nullptr != threadCancelFlag) && threadCancelFlag->load()) {
+      throw KException(getFormattedString("Model::run: cancelled after turn %u", iter));
+    }
+
+    const string memLabel = getFormattedString("after turn %u, with %u states", iter, ((unsigned int)(history.size())));
+    if (MemAccount::report()) {
+      MemAccount::logTable(memLabel);
+    }
+    const uint64_t memBudget = MemAccount::budget();
+    if ((0 < memBudget) && (memBudget < MemAccount::liveTotal())) {
+      // first drop what the earlier states can recompute, and stop only if that is not enough
+      for (unsigned int t = 0; t + 1 < history.size(); t++) {
+        history[t]->releaseCaches();
+      }
+      if (memBudget < MemAccount::liveTotal()) {
+        MemAccount::logTable(memLabel);
+        throw KException(getFormattedString("Model::run: over the memory budget of %llu bytes %s",
+                                            (unsigned long long)memBudget, memLabel.c_str()));
+      }
+    }
   }
   return;
 }
@@ -356,130 +397,11 @@ ostream& operator << (ostream& os, const BigRAdjust& rAdj) {
 
 
 double Model::vote(VotingRule vr, double wi, double uij, double uik) {
-  if (wi <= 0.0) { // you can make it really small (10E-10), but never zero or below.
-    throw KException("Model::vote - non-positive voting weight");
-  }
-  double v = 0.0;
-  const double du = uij - uik;
-
-  double rBin = 0; // binary response
-  const double sTol = 1E-8;
-  rBin = du / sTol;
-  rBin = (rBin > +1) ? +1 : rBin;
-  rBin = (rBin < -1) ? -1 : rBin;
-
-  double rProp = du; // proportional response
-  double rCubic = du * du * du; // cubic reponse
-
-  // the following weights determine how much the hybrids deviate from proportional
-  const double rbp = 0.2;
-  // rbp = 0.2 makes LHS slope and RHS slope of equal size (0.8 each), and twice the center jump (0.4)
-
-  const double rpc = 0.5;
-
-  switch (vr) {
-  case VotingRule::Binary:
-    v = wi * rBin;
-    break;
-
-  case VotingRule::PropBin:
-    v = wi * ((1 - rbp)*rProp + rbp*rBin);
-    break;
-
-  case VotingRule::Proportional:
-    v = wi * rProp;
-    break;
-
-  case VotingRule::PropCbc:
-    v = wi * ((1 - rpc)*rProp + rpc*rCubic);
-    break;
-
-  case VotingRule::Cubic:
-    v = wi * rCubic;
-    break;
-
-  case VotingRule::ASymProsp:
-    if (rProp < 0.0) {
-      v = wi * rProp;
-    }
-    if (0.0 < rProp) {
-      v = (2.0 * wi * rProp) / 3.0;
-    }
-    break;
-
-  default:
-    throw KException("Model::vote - Unrecognized VotingRule");
-    break;
-  }
-  return v;
+  return pceVote<double>(vr, wi, uij, uik);
 }
 
 tuple<double, double> Model::vProb(VPModel vpm, const double s1, const double s2) {
-  const double tol = 1E-8;
-  const double minX = 1E-6;
-  double x1 = 0;
-  double x2 = 0;
-  switch (vpm) {
-  case VPModel::Linear:
-    x1 = s1;
-    x2 = s2;
-    break;
-  case VPModel::Square:
-    x1 = KBase::sqr(s1);
-    x2 = KBase::sqr(s2);
-    break;
-  case VPModel::Quartic:
-    x1 = KBase::qrtc(s1);
-    x2 = KBase::qrtc(s2);
-    break;
-  case VPModel::Octic:
-    x1 = KBase::sqr(KBase::qrtc(s1));
-    x2 = KBase::sqr(KBase::qrtc(s2));
-    break;
-  case VPModel::Binary:
-  {
-    // this is setup so that 10% or more advantage either way gives a guaranteed
-    // result. As with binary voting, it is necessary to have interpolation between
-    // to avoid weird round-off effects.
-    const double thresh = 1.10;
-    if (s1 >= thresh*s2) {
-      x1 = 1.0;
-      x2 = minX;
-    }
-    else if (s2 >= thresh*s1) {
-      x1 = minX;
-      x2 = 1.0;
-    }
-    else { // less than the threshold difference
-      double r12 = s1 / (s1 + s2);
-      // We now need a linear rescaling so that
-      // when s1/s2 = t, or r12 = t/(t+1), p12 = 1, and
-      // when s2/s1 = t, or r12 = 1/(1+t), p12 =0.
-      // We can work out (a,b) so that
-      // a*(t/(t+1)) + b = 1, and
-      // a*(1/(1+t)) + b = 0, then
-      // verify that a*(1/(1+1))+b = 1/2.
-      //
-      double p12 = (r12*(thresh + 1.0) - 1.0) / (thresh - 1.0);
-      x1 = p12;
-      x2 = 1 - p12;
-    }
-  }
-    break;
-  }
-  double p1 = x1 / (x1 + x2);
-  double p2 = x2 / (x1 + x2);
-  if (0 > p1) {
-    throw KException("Model::vProb: p1 must be non-negative");
-  }
-  if (0 > p2) {
-    throw KException("Model::vProb: p2 must be non-negative");
-  }
-  if (fabs(p1 + p2 - 1.0) >= tol) {
-    throw KException("Model::vProb: Sum total of all probabilities must be less than 1.0");
-  }
-
-  return tuple<double, double>(p1, p2);
+  return pceVProb<double>(vpm, s1, s2);
 }
 
 // note that while the C_ij can be any arbitrary positive matrix
@@ -515,29 +437,12 @@ KMatrix Model::vProb(VPModel vpm, const KMatrix & c) {
 
 KMatrix Model::coalitions(function<double(unsigned int ak, unsigned int pi, unsigned int pj)> vfn,
                           unsigned int numAct, unsigned int numOpt) {
-  // if several actors occupy the same position, then numAct > numOpt
-  const double minC = 1E-8;
+  const auto cv = pceCoalitions<double>(vfn, numAct, numOpt);
   auto c = KMatrix(numOpt, numOpt);
   for (unsigned int i = 0; i < numOpt; i++) {
-    for (unsigned int j = 0; j < i; j++) {
-      // scan only lower-left
-      double cij = minC;
-      double cji = minC;
-      for (unsigned int k = 0; k < numAct; k++) {
-        double vkij = vfn(k, i, j);
-		
-        if (vkij > 0) {
-          cij = cij + vkij;
-        }
-        if (vkij < 0) {
-          cji = cji - vkij;
-        }
-      }
-      c(i, j) = cij;  // set the lower left coalition
-      c(j, i) = cji;  // set the upper right coalition
-
+    for (unsigned int j = 0; j < numOpt; j++) {
+      c(i, j) = cv[i*numOpt + j];
     }
-	c(i, i) = minC; // set the diagonal coalition
   }
   return c;
 }
@@ -819,6 +724,7 @@ KMatrix Model::condPCE(const KMatrix & pv) {
 // Model::vProb(VotingRule vr, const KMatrix & w, const KMatrix & u)
 KMatrix Model::scalarPCE(unsigned int numAct, unsigned int numOpt, const KMatrix & w, const KMatrix & u,
                          VotingRule vr, VPModel vpm, PCEModel pcem, ReportingLevel rl) {
+  KTAB_PROFILE_PHASE("Model::scalarPCE");
 
   // auto pv = Model::vProb(vr, vpm, w, u);
   // auto p = Model::probCE(pcem, pv);
@@ -832,34 +738,111 @@ KMatrix Model::scalarPCE(unsigned int numAct, unsigned int numOpt, const KMatrix
   const auto p = get<0>(pv2); //column
   const auto pv = get<1>(pv2); // square
 
-  mtx_spce_log.lock();
-  if (ReportingLevel::Low < rl) {
-    LOG(INFO) << "Num actors:" << numAct;
-    LOG(INFO) << "Num options:" << numOpt;
+  // buffered per thread and handed over as one block, rather than logged under a lock
+  if ((ReportingLevel::Low < rl) && KLOG_ON(rl)) {
+    KLOG(rl) << "Num actors: " << numAct;
+    KLOG(rl) << "Num options: " << numOpt;
 
     if ((numAct <= 20) && (numOpt <= 20)) {
-      LOG(INFO) << "Actor strengths:";
-      w.mPrintf(" %6.2f ");
-      LOG(INFO) << "Voting rule:" << vr;
+      KLOG(rl) << "Actor strengths:";
+      KLOG_MATRIX(rl, w, " %6.2f ");
+      KLOG(rl) << "Voting rule: " << vr;
       // printf("         aka %s \n", KBase::vrName(vr).c_str());
-      LOG(INFO) << "Utility to actors of options:";
-      u.mPrintf(" %+8.3f ");
+      KLOG(rl) << "Utility to actors of options:";
+      KLOG_MATRIX(rl, u, " %+8.3f ");
 
-      LOG(INFO) << "Coalition strengths of (i:j):";
-      c.mPrintf(" %8.3f ");
+      KLOG(rl) << "Coalition strengths of (i:j):";
+      KLOG_MATRIX(rl, c, " %8.3f ");
 
-      LOG(INFO) << "Probability Opt_i > Opt_j";
-      pv.mPrintf(" %.4f ");
-      LOG(INFO) << "Probability Opt_i";
-      p.mPrintf(" %.4f ");
+      KLOG(rl) << "Probability Opt_i > Opt_j";
+      KLOG_MATRIX(rl, pv, " %.4f ");
+      KLOG(rl) << "Probability Opt_i";
+      KLOG_MATRIX(rl, p, " %.4f ");
     }
-    LOG(INFO) << "Found stable PCE distribution";
+    KLOG(rl) << "Found stable PCE distribution";
+    KLog::flushThread();
   }
-  mtx_spce_log.unlock();
   return p;
 }
 
 
+tuple<KMatrix, KMatrix> Model::scalarPCEGrad(unsigned int numAct, unsigned int numOpt,
+                                             const KMatrix & w, const KMatrix & u,
+                                             VotingRule vr, VPModel vpm, PCEModel pcem) {
+  if ((1 != w.numR()) || (numAct != w.numC())) {
+    throw KException("Model::scalarPCEGrad: w must be a [1,actor] row-vector");
+  }
+  if ((numAct != u.numR()) || (numOpt != u.numC())) {
+    throw KException("Model::scalarPCEGrad: u must be [actor,option]");
+  }
+
+  // each weight is its own parameter; utilities are constants
+  auto wd = vector<Dual>();
+  for (unsigned int k = 0; k < numAct; k++) {
+    wd.push_back(Dual(w(0, k), numAct, k));
+  }
+  auto vfn = [vr, &wd, &u](unsigned int k, unsigned int i, unsigned int j) {
+    return pceVote<Dual>(vr, wd[k], Dual(u(k, i)), Dual(u(k, j)));
+  };
+  const auto cd = pceCoalitions<Dual>(vfn, numAct, numOpt);
+
+  auto p = KMatrix(numOpt, 1);
+  auto dp = KMatrix(numOpt, numAct);
+
+  if (PCEModel::ConditionalPCM == pcem) {
+    // no iteration, so derivatives go straight through
+    const auto pd = pceCondPCE<Dual>(pceVictProb<Dual>(vpm, cd, numOpt), numOpt);
+    for (unsigned int i = 0; i < numOpt; i++) {
+      p(i, 0) = pd[i].v;
+      for (unsigned int k = 0; k < numAct; k++) {
+        dp(i, k) = pd[i].grad(k);
+      }
+    }
+    return tuple<KMatrix, KMatrix>(p, dp);
+  }
+
+  auto md = vector<Dual>();
+  switch (pcem) {
+  case PCEModel::MarkovIPCM:
+    md = pceMarkovIncentive<Dual>(vpm, cd, numOpt);
+    break;
+  case PCEModel::MarkovUPCM:
+    md = pceMarkovUniform<Dual>(pceVictProb<Dual>(vpm, cd, numOpt), numOpt);
+    break;
+  default:
+    throw KException("Model::scalarPCEGrad: unrecognized PCEModel");
+    break;
+  }
+
+  // The distribution itself comes from the usual iteration.
+  auto c = KMatrix(numOpt, numOpt);
+  for (unsigned int i = 0; i < numOpt; i++) {
+    for (unsigned int j = 0; j < numOpt; j++) {
+      c(i, j) = cd[i*numOpt + j].v;
+    }
+  }
+  p = get<0>(probCE2(pcem, vpm, c));
+
+  // Rather than differentiate the iteration, differentiate its fixed point.
+  // As p = M p and sum(p) = 1, a change dM gives (I - M) dp = dM p with sum(dp) = 0.
+  // Adding p*sum(dp) = 0 to the left makes the system nonsingular when the
+  // stationary distribution is unique: (I - M + p 1') dp = dM p
+  auto a = KMatrix(numOpt, numOpt);
+  auto r = KMatrix(numOpt, numAct);
+  for (unsigned int i = 0; i < numOpt; i++) {
+    for (unsigned int j = 0; j < numOpt; j++) {
+      const Dual & mij = md[i*numOpt + j];
+      a(i, j) = ((i == j) ? 1.0 : 0.0) - mij.v + p(i, 0);
+      for (unsigned int k = 0; k < numAct; k++) {
+        r(i, k) = r(i, k) + mij.grad(k) * p(j, 0);
+      }
+    }
+  }
+  dp = inv(a) * r;
+  return tuple<KMatrix, KMatrix>(p, dp);
+}
+
+
 // -------------------------------------------------
 Actor::Actor(string n, string d) {
   name = n;
@@ -871,6 +854,11 @@ Actor::~Actor() {
   // empty
 }
 
+
+bool Actor::voteFromUtil(VotingRule & /*vr*/, double & /*w*/) const {
+  return false;
+}
+
 // this uses the evenly-weighted "Sum of Utilities" model
 // Note that the pi and pj numbers already include the contribution of k to the hypothetical little
 // i:j conflict with just i,j,k involved
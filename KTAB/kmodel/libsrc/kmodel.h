@@ -43,11 +43,15 @@
 
 #include "kutils.h"
 #include "kmatrix.h"
+#include "kmemory.h"
 #include "prng.h"
+#include "kstore.h"
 #include <QSqlDatabase>
 #include <QSqlQuery>
+#include <atomic>
 #include <map>
 #include <memory>
+#include <mutex>
 
 namespace KBase {
 using std::ostream;
@@ -196,7 +200,7 @@ ostream& operator << (ostream& os, const BigRAdjust& rAdj);
 // There is not much to say about abstract positions, even
 // though the set of possible positions/outcomes is key
 // to defining each particular problem.
-class Position {
+class Position : public MemCounted<MemCategory::Position> {
 public:
   Position();
   virtual ~Position();
@@ -284,6 +288,40 @@ protected:
 };
 
 
+// -------------------------------------------------
+// The LogStore over a QtSql connection: used for Postgres, and for SQLite
+// when the native backend has been turned off.
+class QtSqlStore : public LogStore {
+public:
+  explicit QtSqlStore(QSqlDatabase * qdb);
+  virtual ~QtSqlStore();
+
+  virtual bool exec(const string & sql) override;
+  virtual bool selectInt(const string & sql, int64_t & v) override;
+  virtual bool prepare(const string & sql) override;
+  virtual bool step() override;
+  virtual void beginBatch() override;
+  virtual bool endBatch() override;
+  virtual void begin() override;
+  virtual void commit() override;
+  virtual string lastError() const override;
+  virtual void bindNull(unsigned int pos) override;
+
+protected:
+  virtual void bindInt(unsigned int pos, int64_t v) override;
+  virtual void bindDouble(unsigned int pos, double v) override;
+  virtual void bindText(unsigned int pos, const string & v) override;
+
+private:
+  void bindValue(unsigned int pos, const QVariant & v);
+  QSqlDatabase * qtDB = nullptr;
+  QSqlQuery query;
+  string preparedSQL = "";
+  bool batching = false;
+  vector<QVariant> batchRow = {};
+  vector<QVariantList> batchCols = {};
+};
+
 // -------------------------------------------------
 class Model {
 public:
@@ -300,6 +338,9 @@ public:
   static const unsigned int minNumActor = 3;
   static const unsigned int maxNumActor = 250; //quite generous, as we expect 10-30.
 
+  // the actor limit this model enforces; a subclass that can afford more may raise it
+  virtual unsigned int actorLimit() const { return maxNumActor; }
+
   static const unsigned int maxScenNameLen = 512; // might be auto-generated in sensitivy analysis
   static const unsigned int maxScenDescLen = 512; // see above
   static const unsigned int maxActNameLen = 25; // quite generous, as we expect 1-5
@@ -361,6 +402,12 @@ public:
   static KMatrix scalarPCE(unsigned int numAct, unsigned int numOpt, const KMatrix & w,
                            const KMatrix & u, VotingRule vr, VPModel vpm, PCEModel pcem, ReportingLevel rl);
 
+  // as scalarPCE, but also returns the [option,actor] Jacobian dP[i]/dw[k].
+  // Voting, coalitions and victory probabilities are differentiated in forward mode;
+  // the Markov models then differentiate the stationary distribution directly.
+  static tuple<KMatrix, KMatrix> scalarPCEGrad(unsigned int numAct, unsigned int numOpt, const KMatrix & w,
+                                               const KMatrix & u, VotingRule vr, VPModel vpm, PCEModel pcem);
+
 
   static KMatrix markovIncentivePCE(const KMatrix & coalitions, VPModel vpm);
 
@@ -380,6 +427,12 @@ public:
 
   vector<KTable*> KTables = {}; // JAH added 20160728 this will hold info for all defined tables
   vector<bool> sqlFlags= {};    // JAH added 20160730 this will hold the logging flag for each group of tables
+  // false when no group is logged; then the model never opens a database
+  bool usesDB() const;
+
+  // if true, sqlPosVote stores only Pos_i < Pos_j for antisymmetric voters, and
+  // the PosVoteAll view rebuilds the other half as -Vote(j,i)
+  bool posVoteHalf = defaultPosVoteHalf;
 
   // output an existing actor util table, for the given turn, to SQLite
   void sqlAUtil(unsigned int t);
@@ -388,7 +441,6 @@ public:
   // output an existing PosEquiv table, for the given turn, to SQLite
     void sqlPosProb(unsigned int t);
     void sqlPosVote(unsigned int t);
-    void sqlBargainEntries(unsigned int t, int bargainId, int initiator, int receiver, double val);
     void sqlBargainCoords(unsigned int t, int bargnID,  const KBase::VctrPstn & initPos, const KBase::VctrPstn & rcvrPos);
     //void sqlBargainUtil(unsigned int t, vector<uint64_t> bargnIds,  KBase::KMatrix Util_mat);
 	void sqlBargainUtil(unsigned int t, vector<uint64_t> bargnIds, KBase::KMatrix Util_mat);
@@ -422,20 +474,48 @@ public:
 
   static KTable * createSQL(unsigned int n);
 
-  void initDBDriver(QString connectionName);
+  // Open a new connection, named prefix_<n> with n unique in this process,
+  // so that concurrent models never share one. Throws if the name is taken.
+  void initDBDriver(QString prefix);
   bool connectDB();
   void closeDB();
   static bool loginCredentials(string connString);
+  // Models constructed on the calling thread write to dbName instead of the
+  // configured database, so concurrent runs can each have their own file.
+  // An empty name restores the configured database.
+  static void setThreadDatabaseName(const QString & dbName);
+  // Models run on the calling thread check *cf after every turn, and stop
+  // with a KException once it is set. nullptr, the default, never stops them.
+  static void setThreadCancelFlag(const std::atomic<bool> * cf);
   void beginDBTransaction();
   void commitDBTransaction();
   QSqlQuery getQuery();
+  LogStore * logStore() const { return store; };
+
+  // With the QSQLITE driver, write through sqlite3 directly rather than
+  // through QtSql. On by default; it does not affect Postgres.
+  static void setNativeSQLite(bool ns);
+
+  // The keyed schema stores each per-turn results table as <name>Data,
+  // with an integer ScenarioKey (see ScenarioKeys) instead of the ScenarioId
+  // string, clustered on its natural key (WITHOUT ROWID under SQLite).
+  // A view with the old name and columns sits on top for the readers.
+  // Off by default; it must be chosen before the tables are created.
+  static void setKeyedSchema(bool ks);
+
+  // the posVoteHalf given to models built from now on
+  static void setPosVoteHalf(bool pvh);
+
+  // INSERT statement for one row of a results table, in whichever schema is
+  // in use: the scenario is filled in, then one '?' for each of cols
+  string insertSQL(const string & table, const string & cols) const;
 
   static void configLogger(string logFile);
   static string getLastError();
 
 protected:
   //static string createTableSQL(unsigned int tn);
-  static const int NumTables = 13; //TODO: constant need to be redefined when new table is added
+  static const int NumTables = 14; //TODO: constant need to be redefined when new table is added
   static const int NumSQLLogGrps = 5; // TODO : Add one to this num when new logging group is added
   // note that the function to write to table #k must be kept
   // synchronized with the result of createSQL(k) !
@@ -455,10 +535,24 @@ protected:
   static QString server;
   static int port;
   static QString databaseName;
+  static thread_local QString threadDatabaseName;
+  static thread_local const std::atomic<bool> * threadCancelFlag;
+  static std::atomic<uint64_t> numConnections;
+  static QString activeDatabaseName();
   static QString userName;
   static QString password;
   QSqlDatabase *qtDB = nullptr;
   mutable QSqlQuery query;
+  LogStore * store = nullptr; // every run-log write goes through this
+  static bool nativeSQLite;
+  static bool keyedSchema;
+  static bool defaultPosVoteHalf;
+  int64_t scenKey = 0; // this scenario's row in ScenarioKeys, keyed schema only
+  void openStore();
+  void registerScenarioKey();
+  static KTable * keyedTable(unsigned int n, const string & name, const string & sql,
+    const string & pk, unsigned int grpID);
+  static string createViewSQL(const string & name, const string & select);
   void configSqlite() const;
   void execQuery(std::string& qry);
   bool createDB(const QString& dbName);
@@ -478,7 +572,7 @@ private:
 
 
 // -------------------------------------------------
-class State {
+class State : public MemCounted<MemCategory::State> {
 public:
   explicit State(Model* mod);
   virtual ~State();
@@ -507,6 +601,17 @@ public:
   // it is tricky to make a single function to do this.
   virtual tuple< KMatrix, VUI> pDist(int persp) const = 0;
 
+  // The same as pDist, but each perspective is solved at most once for this state's
+  // utilities and unique positions, which do not change once set.
+  tuple< KMatrix, VUI> cachedPDist(int persp) const;
+
+  // Fill the cache for every estimator h, solving the missing ones in parallel
+  void cacheEstPDists() const;
+
+  // Free whatever can be recomputed on demand, as when over a memory budget.
+  // Here that is the cached pDist results.
+  virtual void releaseCaches();
+
   Model * model = nullptr;
   function <State* ()> step = nullptr; // you have to provide this λ-fn
   vector<Position*> pstns = {};
@@ -538,7 +643,12 @@ protected:
 
   virtual void setOneAUtil(unsigned int perspH, ReportingLevel rl); // TODO: make this non-dummy
 
+  // forget the cached pDist results, as when utilities or unique positions change
+  void clearPDists();
+
 private:
+  mutable std::mutex pDistLock;
+  mutable vector<tuple<KMatrix, VUI>> pDists = {}; // [persp+1], with an empty KMatrix if not yet solved
 };
 
 
@@ -581,6 +691,11 @@ public:
   // in stored utilities.
   virtual double vote(unsigned int est,unsigned int p1, unsigned int p2, const State* st) const = 0;
 
+  // Return true if the vote above is exactly Model::vote(vr, w, u(k,p1), u(k,p2)) on the
+  // stored utilities u = st->aUtil[est], setting vr and w, so that whole tensors of votes
+  // can be computed without a virtual call per vote. The default is false.
+  virtual bool voteFromUtil(VotingRule & vr, double & w) const;
+
   // Bear in mind that some Domain Specific Utility Models, like
   // full-scale computable general equilibrium (CGE) models, may
   // be very expensive to evaluate. Evaluating one policy position yields
@@ -617,6 +732,7 @@ public:
   unsigned int tabID;
   string tabName;
   string tabSQL;
+  string tabViewSQL = ""; // run after tabSQL, if not empty
   unsigned int tabGrpID;
   // be sure you use protection on your privates!
 protected:
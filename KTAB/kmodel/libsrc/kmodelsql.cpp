@@ -25,8 +25,10 @@
 #include <easylogging++.h>
 #include <sstream>
 #include <algorithm>
+#include <exception>
 
 #include "kmodel.h"
+#include "kprofile.h"
 
 #include <QVariant>
 #include <QSqlRecord>
@@ -44,24 +46,165 @@ QString Model::dbDriver;
 QString Model::server;
 int Model::port=5432; // Default port for postgresql
 QString Model::databaseName;
+thread_local QString Model::threadDatabaseName;
+std::atomic<uint64_t> Model::numConnections(0);
 QString Model::userName;
 QString Model::password;
+bool Model::nativeSQLite = true;
+bool Model::keyedSchema = false;
+bool Model::defaultPosVoteHalf = false;
 
-void Model::initDBDriver(QString connectionName) {
-  if (QSqlDatabase::contains(connectionName)) {
-    LOG(INFO) << "A database connection already exists with the name: " << connectionName.toStdString();
+// --------------------------------------------
+QtSqlStore::QtSqlStore(QSqlDatabase * qdb) : LogStore(), qtDB(qdb), query(*qdb) {}
+
+QtSqlStore::~QtSqlStore() {
+  // free the query's resources before the connection goes away
+  query.clear();
+}
+
+bool QtSqlStore::exec(const string & sql) {
+  preparedSQL = "";
+  return query.exec(QString::fromStdString(sql));
+}
+
+bool QtSqlStore::selectInt(const string & sql, int64_t & v) {
+  preparedSQL = "";
+  if (!query.exec(QString::fromStdString(sql)) || !query.next()) {
+    return false;
+  }
+  v = query.value(0).toLongLong();
+  return true;
+}
+
+bool QtSqlStore::prepare(const string & sql) {
+  if (sql == preparedSQL) {
+    return true;
+  }
+  const bool ok = query.prepare(QString::fromStdString(sql));
+  preparedSQL = ok ? sql : "";
+  return ok;
+}
+
+bool QtSqlStore::step() {
+  if (!batching) {
+    return query.exec();
+  }
+  if (batchCols.size() < batchRow.size()) {
+    batchCols.resize(batchRow.size());
+  }
+  for (unsigned int c = 0; c < batchRow.size(); c++) {
+    batchCols[c] << batchRow[c];
+  }
+  return true;
+}
+
+void QtSqlStore::beginBatch() {
+  batching = true;
+  batchRow.clear();
+  batchCols.clear();
+}
+
+bool QtSqlStore::endBatch() {
+  batching = false;
+  if (batchCols.empty()) {
+    return true;
+  }
+  for (unsigned int c = 0; c < batchCols.size(); c++) {
+    query.bindValue(c, batchCols[c]);
+  }
+  batchCols.clear();
+  return query.execBatch();
+}
+
+void QtSqlStore::begin() {
+  qtDB->transaction();
+}
+
+void QtSqlStore::commit() {
+  qtDB->commit();
+}
+
+string QtSqlStore::lastError() const {
+  return query.lastError().text().toStdString();
+}
+
+void QtSqlStore::bindValue(unsigned int pos, const QVariant & v) {
+  if (!batching) {
+    query.bindValue(pos, v);
     return;
   }
+  if (batchRow.size() <= pos) {
+    batchRow.resize(pos + 1);
+  }
+  batchRow[pos] = v;
+}
+
+void QtSqlStore::bindNull(unsigned int pos) {
+  bindValue(pos, QVariant());
+}
+
+void QtSqlStore::bindInt(unsigned int pos, int64_t v) {
+  bindValue(pos, QVariant(static_cast<qlonglong>(v)));
+}
+
+void QtSqlStore::bindDouble(unsigned int pos, double v) {
+  bindValue(pos, QVariant(v));
+}
+
+void QtSqlStore::bindText(unsigned int pos, const string & v) {
+  bindValue(pos, QVariant(QString::fromStdString(v)));
+}
+
+// --------------------------------------------
+void Model::setNativeSQLite(bool ns) {
+  nativeSQLite = ns;
+}
+
+void Model::setKeyedSchema(bool ks) {
+  keyedSchema = ks;
+}
+
+void Model::setPosVoteHalf(bool pvh) {
+  defaultPosVoteHalf = pvh;
+}
+
+void Model::openStore() {
+  delete store;
+  store = nullptr;
+  if (nativeSQLite && (0 == dbDriver.compare("QSQLITE"))) {
+    store = new SQLiteStore(activeDatabaseName().toStdString());
+  }
+  else {
+    store = new QtSqlStore(qtDB);
+  }
+}
+
+void Model::initDBDriver(QString prefix) {
+  const QString connectionName = QString("%1_%2").arg(prefix).arg((qulonglong)numConnections.fetch_add(1));
+  if (QSqlDatabase::contains(connectionName)) {
+    throw KException("Model::initDBDriver: A database connection already exists with the name: "
+                     + connectionName.toStdString());
+  }
   QSqlDatabase qdb = QSqlDatabase::addDatabase(dbDriver, connectionName);
   qtDB = new QSqlDatabase(qdb);
 }
 
 bool Model::connectDB() {
-  return connect(server, port, databaseName, userName, password);
+  return connect(server, port, activeDatabaseName(), userName, password);
+}
+
+void Model::setThreadDatabaseName(const QString & dbName) {
+  threadDatabaseName = dbName;
+}
+
+QString Model::activeDatabaseName() {
+  return threadDatabaseName.isEmpty() ? databaseName : threadDatabaseName;
 }
 
 void Model::closeDB()
 {
+  delete store;
+  store = nullptr;
   if(qtDB != nullptr && qtDB->isValid() && qtDB->isOpen()) {
       query.clear();
       qtDB->close();
@@ -111,28 +254,41 @@ void Model::configSqlite() const {
   // we can shut off some of the journaling stuff intended to protect
   // the DB in case the system crashes in mid-operation.
   // Eliminating these checks can significantly speed operations.
-  query.exec("PRAGMA journal_mode = MEMORY");
-  query.exec("PRAGMA locking_mode = EXCLUSIVE");
-  query.exec("PRAGMA synchronous = OFF");
+  store->exec("PRAGMA journal_mode = MEMORY");
+  store->exec("PRAGMA locking_mode = EXCLUSIVE");
+  store->exec("PRAGMA synchronous = OFF");
 
   // not a performance issue, but necessary for the data layout
-  query.exec("PRAGMA foreign_keys = ON");
+  store->exec("PRAGMA foreign_keys = ON");
 }
 
 void Model::execQuery(std::string& qry) {
-  if (!query.exec(QString::fromStdString(qry))) {
+  if (!store->exec(qry)) {
     LOG(INFO) << "Failed Query: " << qry;
-    LOG(INFO) << query.lastError().text().toStdString();
+    LOG(INFO) << store->lastError();
     throw KException("Model::execQuery:s DB query failed.");
   }
 }
 
+bool Model::usesDB() const {
+  for (bool f : sqlFlags) {
+    if (f) {
+      return true;
+    }
+  }
+  return false;
+}
+
 void Model::beginDBTransaction() {
-  qtDB->transaction();
+  if (nullptr != store) {
+    store->begin();
+  }
 }
 
 void Model::commitDBTransaction() {
-  qtDB->commit();
+  if (nullptr != store) {
+    store->commit();
+  }
 }
 
 QSqlQuery Model::getQuery()
@@ -325,6 +481,7 @@ KTable * Model::createSQL(unsigned int n)
 
   string sql = "";
   string name = "";
+  string pk = ""; // natural key of a per-turn results table, for the keyed schema
   unsigned int grpID = 0;
 
   if (n >= Model::NumTables) {
@@ -344,6 +501,7 @@ KTable * Model::createSQL(unsigned int n)
           "Util       FLOAT       NOT NULL DEFAULT 0.0"\
           ");";
     name = "PosUtil";
+    pk = "Turn_t, Est_h, Act_i, Pos_j";
     grpID = 4;
     break;
 
@@ -359,6 +517,7 @@ KTable * Model::createSQL(unsigned int n)
           "Vote       FLOAT       NOT NULL DEFAULT 0.0"\
           ");";
     name = "PosVote";
+    pk = "Turn_t, Est_h, Voter_k, Pos_i, Pos_j";
     grpID = 1;
     break;
 
@@ -371,6 +530,7 @@ KTable * Model::createSQL(unsigned int n)
           "Prob       FLOAT       NOT NULL DEFAULT 0.0"\
           ");";
     name = "PosProb";
+    pk = "Turn_t, Est_h, Pos_i";
     grpID = 1;
     break;
 
@@ -382,6 +542,7 @@ KTable * Model::createSQL(unsigned int n)
           "Eqv_j      INTEGER     NOT NULL DEFAULT 0 "\
           ");";
     name = "PosEquiv";
+    pk = "Turn_t, Pos_i";
     grpID = 1;
     break;
 
@@ -406,6 +567,7 @@ KTable * Model::createSQL(unsigned int n)
           "Util_Chlg  FLOAT       NOT NULL DEFAULT 0  "\
           ");";
     name = "UtilChlg";
+    pk = "Turn_t, Est_h, Aff_k, Init_i, Rcvr_j";
     grpID = 2;
     break;
 
@@ -421,6 +583,7 @@ KTable * Model::createSQL(unsigned int n)
           "Prob       FLOAT       NOT NULL DEFAULT 0"\
           ");";
     name = "PosVict";
+    pk = "Turn_t, Est_h, Init_i, Rcvr_j";
     grpID = 2;
     break;
 
@@ -441,6 +604,7 @@ KTable * Model::createSQL(unsigned int n)
           "Util_L     FLOAT       NOT NULL DEFAULT 0  "\
           ");";
     name = "TPProbVictLoss";
+    pk = "Turn_t, Est_h, Init_i, ThrdP_k, Rcvr_j";
     grpID = 2;
     break;
 
@@ -473,9 +637,11 @@ KTable * Model::createSQL(unsigned int n)
           "Init_Seld INTEGER NULL ,"\
           "Recd_Prob FLOAT NULL DEFAULT 0, "\
           "Recd_Seld INTEGER NULL, "\
-          "CHECK (Init_Seld in (0,1) AND Recd_Seld in (0,1))"\
+          "CHECK (Init_Seld in (0,1) AND Recd_Seld in (0,1)), "\
+          "PRIMARY KEY (ScenarioId, Turn_t, BargnId, Init_Act_i, Recd_Act_j)"\
           ");";
     name = "Bargn";
+    pk = "Turn_t, BargnId, Init_Act_i, Recd_Act_j";
     grpID = 4;
     break;
   case 9:  //
@@ -489,6 +655,7 @@ KTable * Model::createSQL(unsigned int n)
           "Recd_Coord FLOAT NOT NULL DEFAULT 0.0"\
           ");";
     name = "BargnCoords";
+    pk = "Turn_t, BargnId, Dim_k";
     grpID = 3;
     break;
 
@@ -501,6 +668,7 @@ KTable * Model::createSQL(unsigned int n)
           "Util FLOAT NOT NULL DEFAULT 0.0"\
           ");";
     name = "BargnUtil";
+    pk = "Turn_t, BargnId, Act_i";
     grpID = 3;
     break;
 
@@ -516,6 +684,7 @@ KTable * Model::createSQL(unsigned int n)
           "Vote FLOAT NOT NULL DEFAULT 0.0"\
           ");";
     name = "BargnVote";
+    pk = "Turn_t, BargnId_i, BargnId_j, Act_k";
     grpID = 3;
     break;
 
@@ -539,6 +708,23 @@ KTable * Model::createSQL(unsigned int n)
     name = "ScenarioDesc";
     grpID = 0;
     break;
+
+  case 13: // integer surrogate for ScenarioId, used by the keyed schema
+    if (0 == dbDriver.compare("QPSQL")) {
+      sql = "create table if not exists ScenarioKeys ("  \
+            "ScenarioKey SERIAL PRIMARY KEY, "\
+            "ScenarioId VARCHAR(32) NOT NULL UNIQUE DEFAULT 'None'"\
+            ");";
+    }
+    else {
+      sql = "create table if not exists ScenarioKeys ("  \
+            "ScenarioKey INTEGER PRIMARY KEY, "\
+            "ScenarioId VARCHAR(32) NOT NULL UNIQUE DEFAULT 'None'"\
+            ");";
+    }
+    name = "ScenarioKeys";
+    grpID = 0;
+    break;
   default:
     throw(KException("Model::createSQL unrecognized table number"));
   }
@@ -546,13 +732,112 @@ KTable * Model::createSQL(unsigned int n)
   if (grpID >= NumSQLLogGrps) {
     throw KException("Model::createSQL: group id should be within the allowed range");
   }
+  if (keyedSchema && !pk.empty()) {
+    return keyedTable(n, name, sql, pk, grpID);
+  }
   auto tab = new KTable(n,name,sql,grpID);
   return tab;
 }
 
 
+KTable * Model::keyedTable(unsigned int n, const string & name, const string & sql,
+  const string & pk, unsigned int grpID) {
+  // the definitions in createSQL all look like
+  // "create table if not exists T (ScenarioId ..., col type ..., ...);"
+  const auto open = sql.find('(');
+  const auto close = sql.rfind(')');
+  if ((string::npos == open) || (string::npos == close) || (close < open) || (0 == open)) {
+    throw KException("Model::keyedTable: could not parse the table definition");
+  }
+  const auto nameEnd = sql.find_last_not_of(' ', open - 1) + 1;
+  const auto nameStart = sql.rfind(' ', nameEnd - 1) + 1;
+  const string table = sql.substr(nameStart, nameEnd - nameStart);
+
+  // split the body at the commas which are not inside parentheses
+  vector<string> items = {};
+  string item = "";
+  int depth = 0;
+  for (auto c : sql.substr(open + 1, close - open - 1)) {
+    if ((',' == c) && (0 == depth)) {
+      items.push_back(item);
+      item = "";
+      continue;
+    }
+    depth += ('(' == c) ? 1 : ((')' == c) ? -1 : 0);
+    item += c;
+  }
+  items.push_back(item);
+
+  string cols = "ScenarioKey INTEGER NOT NULL";
+  string select = "SELECT s.ScenarioId";
+  for (auto & it : items) {
+    const auto b = it.find_first_not_of(' ');
+    if (string::npos == b) {
+      continue;
+    }
+    const string col = it.substr(b, it.find(' ', b) - b);
+    if ((col == "ScenarioId") || (col == "PRIMARY")) {
+      continue; // replaced by the key below
+    }
+    cols += ", " + it.substr(b);
+    if (col != "CHECK") {
+      select += ", d." + col;
+    }
+  }
+  cols += ", PRIMARY KEY (ScenarioKey, " + pk + ")";
+
+  string tsql = "create table if not exists " + table + "Data (" + cols + ")";
+  if (0 != dbDriver.compare("QPSQL")) {
+    tsql += " WITHOUT ROWID";
+  }
+  tsql += ";";
+  select += " FROM " + table + "Data d JOIN ScenarioKeys s ON (s.ScenarioKey = d.ScenarioKey)";
+
+  auto tab = new KTable(n, name, tsql, grpID);
+  tab->tabViewSQL = createViewSQL(table, select);
+  return tab;
+}
+
+
+string Model::createViewSQL(const string & name, const string & select) {
+  // SQLite has no CREATE OR REPLACE VIEW, and Postgres no CREATE VIEW IF NOT EXISTS
+  const string create = (0 == dbDriver.compare("QPSQL")) ? "CREATE OR REPLACE VIEW " : "CREATE VIEW IF NOT EXISTS ";
+  return create + name + " AS " + select;
+}
+
+
+string Model::insertSQL(const string & table, const string & cols) const {
+  string vals = "";
+  const auto nc = std::count(cols.begin(), cols.end(), ',') + 1;
+  for (unsigned int c = 0; c < nc; c++) {
+    vals += ", ?";
+  }
+  if (keyedSchema) {
+    return "INSERT INTO " + table + "Data (ScenarioKey, " + cols + ") VALUES ("
+      + std::to_string(scenKey) + vals + ")";
+  }
+  return "INSERT INTO " + table + " (ScenarioId, " + cols + ") VALUES ('" + scenId + "'" + vals + ")";
+}
+
+
+void Model::registerScenarioKey() {
+  if (!keyedSchema) {
+    return;
+  }
+  string sql = "INSERT INTO ScenarioKeys (ScenarioId) VALUES ('" + scenId + "')";
+  execQuery(sql);
+  int64_t k = 0;
+  if (!store->selectInt("SELECT ScenarioKey FROM ScenarioKeys WHERE ScenarioId = '" + scenId + "'", k)) {
+    LOG(INFO) << store->lastError();
+    throw KException("Model::registerScenarioKey: could not read back the scenario key");
+  }
+  scenKey = k;
+}
+
+
 void Model::sqlAUtil(unsigned int t)
 {
+  KTAB_PROFILE_PHASE("Model::sqlAUtil");
   if (t >= history.size()) {
     throw KException("Model::sqlAUtil: Specified turn number is beyond the size of history");
   }
@@ -570,16 +855,15 @@ void Model::sqlAUtil(unsigned int t)
   // mission-critical RDBMS, rather than a 1-off record of this run,
   // doing so might be disasterous in case the system crashed before
   // things were cleaned up.
-  string sql = "INSERT INTO PosUtil (ScenarioId, Turn_t, Est_h, Act_i, Pos_j, Util) VALUES ('"
-    + scenId + "', :turn_t, :est_h, :act_i, :pos_j, :util)";
+  string sql = insertSQL("PosUtil", "Turn_t, Est_h, Act_i, Pos_j, Util");
 
-  query.prepare(QString::fromStdString(sql));
+  store->prepare(sql);
 
   // Prepared statements cache the execution plan for a query after the query optimizer has
   // found the best plan, so there is no big gain with simple insertions.
   // What makes a huge difference is bundling a few hundred into one atomic "transaction".
   // For this case, runtime droped from 62-65 seconds to 0.5-0.6 (vs. 0.30-0.33 with no SQL at all).
-  qtDB->transaction();
+  store->begin();
 
   for (unsigned int h = 0; h < numAct; h++)   // estimator is h
   {
@@ -588,19 +872,19 @@ void Model::sqlAUtil(unsigned int t)
     {
       for (unsigned int j = 0; j < numAct; j++)
       {
-        query.bindValue(":turn_t", t);
-        query.bindValue(":est_h", h);
-        query.bindValue(":act_i", i);
-        query.bindValue(":pos_j", j);
-        query.bindValue(":util", uij(i, j));
-        if (!query.exec()) {
-          LOG(INFO) << query.lastError().text().toStdString();
+        store->bind(0, t);
+        store->bind(1, h);
+        store->bind(2, i);
+        store->bind(3, j);
+        store->bind(4, uij(i, j));
+        if (!store->step()) {
+          LOG(INFO) << store->lastError();
           throw KException("Model::sqlAUtil: DB query failed");
         }
       }
     }
   }
-  qtDB->commit();
+  store->commit();
   return;
 }
 
@@ -608,6 +892,7 @@ void Model::sqlAUtil(unsigned int t)
 // module run
 void Model::sqlPosEquiv(unsigned int t)
 {
+  KTAB_PROFILE_PHASE("Model::sqlPosEquiv");
   if (t >= history.size()) {
     throw KException("Model::sqlPosEquiv: Specified turn number is beyond the size of history");
   }
@@ -616,11 +901,10 @@ void Model::sqlPosEquiv(unsigned int t)
     throw KException("Model::sqlPosEquiv: st is a null pointer.");
   }
 
-  string qsql = string("INSERT INTO PosEquiv (ScenarioId, Turn_t, Pos_i, Eqv_j) VALUES ('")
-    + scenId + "', :turn_t, :pos_i, :eqv_j)";
-  query.prepare(QString::fromStdString(qsql));
+  string qsql = insertSQL("PosEquiv", "Turn_t, Pos_i, Eqv_j");
+  store->prepare(qsql);
 
-  qtDB->transaction();
+  store->begin();
 
   // Start inserting record
   for (unsigned int i = 0; i < numAct; i++)
@@ -634,49 +918,20 @@ void Model::sqlPosEquiv(unsigned int t)
         je = j;
       }
     }
-    query.bindValue(":turn_t", t);
-    query.bindValue(":pos_i", i);
-    query.bindValue(":eqv_j", je);
-    if (!query.exec()) {
-      LOG(INFO) << query.lastError().text().toStdString();
+    store->bind(0, t);
+    store->bind(1, i);
+    store->bind(2, je);
+    if (!store->step()) {
+      LOG(INFO) << store->lastError();
       throw KException("Model::sqlPosEquiv: DB query failed");
     }
   }
   // end databse transaction
-  qtDB->commit();
+  store->commit();
 
   return;
 }
 
-void Model::sqlBargainEntries(unsigned int t, int bargainId, int initiator, int receiver, double val)
-{
-  // prepare the sql statement to insert
-  string sql = string("INSERT INTO Bargn (ScenarioId, Turn_t, BargnID, Init_Act_i, Recd_Act_j, Value) VALUES ('")
-    + scenId + "', :turn_t, :bargnid, :init_i, :recd_j, :value)";
-  query.prepare(QString::fromStdString(sql));
-
-  // start for the transaction
-  //qtDB->transaction();
-
-  // Turn_t
-  query.bindValue(":turn_t", t);
-  //BargnID
-  query.bindValue(":bargnid", bargainId);
-  //Init_Act_i
-  query.bindValue(":init_i", initiator);
-  //Recd_Act_j
-  query.bindValue(":recd_j", receiver);
-  //Value
-  query.bindValue(":value", val);
-  if (!query.exec()) {
-    LOG(INFO) << query.lastError().text().toStdString();
-    throw KException("Model::sqlBargainEntries: DB query failed");
-  }
-  //qtDB->commit();
-}
-
-
-
 void Model::sqlBargainCoords(unsigned int t, int bargnID, const KBase::VctrPstn & initPos, const KBase::VctrPstn & rcvrPos)
 {
   int nDim = initPos.numR();
@@ -685,35 +940,34 @@ void Model::sqlBargainCoords(unsigned int t, int bargnID, const KBase::VctrPstn
   }
 
   // prepare the sql statement to insert
-  string sql = string("INSERT INTO BargnCoords (ScenarioId, Turn_t, BargnID, Dim_k, Init_Coord, Recd_Coord) VALUES ('")
-    + scenId + "', :turn_t, :bargnid, :dim_k, :init_coord, :recd_coord)";
-  query.prepare(QString::fromStdString(sql));
+  string sql = insertSQL("BargnCoords", "Turn_t, BargnID, Dim_k, Init_Coord, Recd_Coord");
+  store->prepare(sql);
 
   // start for the transaction
-  //qtDB->transaction();
+  //store->begin();
 
   for (int k = 0; k < nDim; k++)
   {
 
     // Turn_t
-    query.bindValue(":turn_t", t);
+    store->bind(0, t);
     //Baragainer
-    query.bindValue(":bargnid", bargnID);
+    store->bind(1, bargnID);
     //Dim_K
-    query.bindValue(":dim_k", k);
+    store->bind(2, k);
 
     //Init_Coord
-    query.bindValue(":init_coord", initPos(k, 0) * 100.0);
+    store->bind(3, initPos(k, 0) * 100.0);
     //Recd_Coord
 
-    query.bindValue(":recd_coord", rcvrPos(k, 0) * 100.0);
-    if (!query.exec()) {
-      LOG(INFO) << query.lastError().text().toStdString();
+    store->bind(4, rcvrPos(k, 0) * 100.0);
+    if (!store->step()) {
+      LOG(INFO) << store->lastError();
       throw KException("Model::sqlBargainCoords: DB query failed");
     }
   }
 
-  //qtDB->commit();
+  //store->commit();
 }
 
 
@@ -725,35 +979,34 @@ void Model::sqlBargainUtil(unsigned int t, vector<uint64_t> bargnIds,  KBase::KM
 
 
   // prepare the sql statement to insert
-  string sql = string("INSERT INTO BargnUtil  (ScenarioId, Turn_t,BargnId, Act_i, Util) VALUES ('")
-    + scenId + "', :turn_t, :bgnId, :act_i, :util)";
+  string sql = insertSQL("BargnUtil", "Turn_t, BargnId, Act_i, Util");
 
-  query.prepare(QString::fromStdString(sql));
+  store->prepare(sql);
   // start for the transaction
-  //qtDB->transaction();
+  //store->begin();
   uint64_t Bargn_i = 0;
   for (unsigned int i = 0; i < Util_mat_row; i++)
   {
     for (unsigned int j = 0; j < Util_mat_col; j++)
     {
       // Turn_t
-      query.bindValue(":turn_t", t);
+      store->bind(0, t);
       //Bargn_i
       Bargn_i = bargnIds[j];
-      query.bindValue(":bgnId", (qulonglong)Bargn_i);
+      store->bind(1, Bargn_i);
       //Act_i
-      query.bindValue(":act_i", i);
+      store->bind(2, i);
       //Util
-      query.bindValue(":util", Util_mat(i, j));
+      store->bind(3, Util_mat(i, j));
       // finish
-      if (!query.exec()) {
-        LOG(INFO) << query.lastError().text().toStdString();
+      if (!store->step()) {
+        LOG(INFO) << store->lastError();
         throw KException("Model::sqlBargainUtil: DB query failed");
       }
     }
   }
 
-  //qtDB->commit();
+  //store->commit();
 }
 
 // JAH 20160731 added this function in replacement to the separate
@@ -770,24 +1023,24 @@ void Model::LogInfoTables()
   // form the insert cmmands
   // prepare the prepared statement statements
   string sql = "INSERT INTO ActorDescription (ScenarioId,Act_i,Name,\"Desc\") VALUES ('"
-    + scenId + "', :act_i, :name, :desc)";
-  query.prepare(QString::fromStdString(sql));
-  qtDB->transaction();
+    + scenId + "', ?, ?, ?)";
+  store->prepare(sql);
+  store->begin();
   // Actor Description Table
   // For each actor fill the required information
   for (unsigned int i = 0; i < actrs.size(); i++) {
     Actor * act = actrs.at(i);
     // bind the data
-    query.bindValue(":act_i", i);
-    query.bindValue(":name", act->name.c_str());
-    query.bindValue(":desc", act->desc.c_str());
+    store->bind(0, i);
+    store->bind(1, act->name);
+    store->bind(2, act->desc);
     // record
-    if (!query.exec()) {
-      LOG(INFO) << query.lastError().text().toStdString();
+    if (!store->step()) {
+      LOG(INFO) << store->lastError();
       throw KException("Model::LogInfoTables: DB query failed");
     }
   }
-  qtDB->commit();
+  store->commit();
 
   // Scenario Description
   // Turn_t
@@ -815,12 +1068,11 @@ void Model::sqlBargainVote(unsigned int t, vector< tuple<uint64_t, uint64_t>> ba
   int Util_mat_row = Vote_mat.size();
 
   // prepare the sql statement to insert
-  string sql = string("INSERT INTO BargnVote (ScenarioId, Turn_t, BargnId_i, BargnId_j, Act_k, Vote) VALUES ('")
-    + scenId + "', :turn_t, :bargnid_i, :bargnid_j, :act_k, :vote)";
-  query.prepare(QString::fromStdString(sql));
+  string sql = insertSQL("BargnVote", "Turn_t, BargnId_i, BargnId_j, Act_k, Vote");
+  store->prepare(sql);
 
   // start for the transaction
-  //qtDB->transaction();
+  //store->begin();
 
   for (unsigned int i = 0; i <Util_mat_row ; i++)
   {
@@ -829,29 +1081,30 @@ void Model::sqlBargainVote(unsigned int t, vector< tuple<uint64_t, uint64_t>> ba
     uint64_t Bargn_j = std::get<1>(tijids);
 
     // Turn_t
-    query.bindValue(":turn_t", t);
+    store->bind(0, t);
     //Bargn_i
-    query.bindValue(":bargnid_i", (qulonglong)Bargn_i);
+    store->bind(1, Bargn_i);
     //Bargn_j
-    query.bindValue(":bargnid_j", (qulonglong)Bargn_j);
+    store->bind(2, Bargn_j);
     //Act_i
-    query.bindValue(":act_k", act_k);
+    store->bind(3, act_k);
     //Util
     double voteMat = Vote_mat[i];
-    query.bindValue(":vote", voteMat);
+    store->bind(4, voteMat);
     // finish
-    if (!query.exec()) {
-      LOG(INFO) << query.lastError().text().toStdString();
+    if (!store->step()) {
+      LOG(INFO) << store->lastError();
       throw KException("Model::sqlBargainVote: DB query failed");
     }
   }
-  //qtDB->commit();
+  //store->commit();
 }
 
 // populates record for table PosProb for each step of
 // module run
 void Model::sqlPosProb(unsigned int t)
 {
+  KTAB_PROFILE_PHASE("Model::sqlPosProb");
   if (t >= history.size()) {
     throw KException("Model::sqlPosProb: Specified turn number is beyond the size of history");
   }
@@ -861,17 +1114,19 @@ void Model::sqlPosProb(unsigned int t)
     throw KException("Model::sqlPosProb: st is a null pointer.");
   }
   // prepare the sql statement to insert
-  string sql = string("INSERT INTO PosProb (ScenarioId, Turn_t, Est_h,Pos_i, Prob) VALUES ('")
-    + scenId + "', :turn_t, :est_h, :pos_i, :prob)";
-  query.prepare(QString::fromStdString(sql));
+  string sql = insertSQL("PosProb", "Turn_t, Est_h, Pos_i, Prob");
+  store->prepare(sql);
+
+  // solve the estimators' distributions in parallel, unless the state already has them
+  st->cacheEstPDists();
 
   // start for the transaction
-  qtDB->transaction();
+  store->begin();
   // collect the information from each estimator,actor
   for (unsigned int h = 0; h < numAct; h++)   // estimator is h
   {
-    // calculate the probablity with respect to each estimator
-    auto pn = st->pDist(h);
+    // the probablity with respect to each estimator
+    auto pn = st->cachedPDist(h);
     auto pdt = std::get<0>(pn); // note that these are unique positions
     if (fabs(1 - sum(pdt)) >= 1e-4) {
       throw KException("Model::sqlPosProb sum of all positions exceeded the limit value.");
@@ -882,23 +1137,24 @@ void Model::sqlPosProb(unsigned int t)
     {
       // Extract the probabity for each actor
       double prob = st->posProb(i, unq, pdt);
-      query.bindValue(":turn_t", t);
-      query.bindValue(":est_h", h);
-      query.bindValue(":pos_i", i);
-      query.bindValue(":prob", prob);
-      if (!query.exec()) {
-        LOG(INFO) << query.lastError().text().toStdString();
+      store->bind(0, t);
+      store->bind(1, h);
+      store->bind(2, i);
+      store->bind(3, prob);
+      if (!store->step()) {
+        LOG(INFO) << store->lastError();
         throw KException("Model::sqlPosProb: DB query failed");
       }
     }
   }
-  qtDB->commit();
+  store->commit();
   return;
 }
 // populates record for table PosProb for each step of
 // module run
 void Model::sqlPosVote(unsigned int t)
 {
+  KTAB_PROFILE_PHASE("Model::sqlPosVote");
   if (t >= history.size()) {
     throw KException("Model::sqlPosVote: Specified turn number is beyond the size of history");
   }
@@ -909,56 +1165,131 @@ void Model::sqlPosVote(unsigned int t)
   if (nullptr == st) {
     throw KException("Model::sqlPosVote: st is a null pointer.");
   }
-  // prepare the sql statement to insert
-  string sql = string("INSERT INTO PosVote (ScenarioId, Turn_t, Est_h, Voter_k, Pos_i, Pos_j, Vote) VALUES ('")
-    + scenId + "', :turn_t, :est_h, :voter_k, :pos_i, :pos_j, :vote)";
-  query.prepare(QString::fromStdString(sql));
 
-  // start for the transaction
-  qtDB->transaction();
-  auto vr = VotingRule::Proportional;
-  // collect the information from each estimator
+  // Where an actor's vote follows from the stored utilities, whole rows of votes
+  // come straight from aUtil[h]; otherwise we fall back to the virtual vote.
+  // Only ASymProsp is not antisymmetric, v(i,j) != -v(j,i).
+  auto vrs = vector<VotingRule>(numAct, VotingRule::Proportional);
+  auto ws = vector<double>(numAct, 0.0);
+  auto fromU = vector<bool>(numAct, false);
+  auto antiSym = vector<bool>(numAct, false);
+  for (unsigned int k = 0; k < numAct; k++) {
+    VotingRule vr = VotingRule::Proportional;
+    double w = 0.0;
+    fromU[k] = actrs[k]->voteFromUtil(vr, w);
+    vrs[k] = vr;
+    ws[k] = w;
+    antiSym[k] = fromU[k] && (VotingRule::ASymProsp != vr);
+  }
 
-  for (unsigned int k = 0; k < numAct; k++)   // voter is k
-  {
-    auto rd = st->model->actrs[k];
-    for (unsigned int i = 0; i < numAct; i++)
-    {
-      for (unsigned int j = 0; j < numAct; j++)
-      {
-        for (unsigned int h = 0; h < numAct; h++)   // estimator is h
-        {
-          if (((h == i) || (h == j)) && (i!=j))
-          {
-            auto vij = rd->vote(h, i, j, st);
-            query.bindValue(":turn_t", t);
-            query.bindValue(":est_h", h);
-            //voter_k
-            query.bindValue(":voter_k", k);
-            // position i
-            query.bindValue(":pos_i", i);
-            //position j
-            query.bindValue(":pos_j", j);
-            // vote ?
-            query.bindValue(":vote", vij);
-            if (!query.exec()) {
-              LOG(INFO) << query.lastError().text().toStdString();
-              throw KException("Model::sqlPosVote: DB query failed");
-            }
+  // the votes only matter where the estimator is one of the two, h == i or h == j
+  struct VoteRows {
+    vector<unsigned int> k, i, j;
+    vector<double> v;
+    void add(unsigned int vk, unsigned int vi, unsigned int vj, double vv) {
+      k.push_back(vk);
+      i.push_back(vi);
+      j.push_back(vj);
+      v.push_back(vv);
+    }
+  };
+  auto rows = vector<VoteRows>(numAct);
+  auto errs = vector<std::exception_ptr>(numAct, nullptr);
+
+  auto estFn = [this, st, &vrs, &ws, &fromU, &antiSym, &rows, &errs](unsigned int h) {
+    try {
+      auto & rh = rows[h];
+      const KMatrix & uh = st->aUtil[h];
+      for (unsigned int k = 0; k < numAct; k++) {   // voter is k
+        auto rd = actrs[k];
+        const bool half = posVoteHalf && antiSym[k];
+        for (unsigned int x = 0; x < numAct; x++) {
+          if (x == h) {
+            continue;
+          }
+          double vhx = 0.0;
+          double vxh = 0.0;
+          if (fromU[k]) {
+            vhx = Model::vote(vrs[k], ws[k], uh(k, h), uh(k, x));
+            vxh = Model::vote(vrs[k], ws[k], uh(k, x), uh(k, h));
+          }
+          else {
+            vhx = rd->vote(h, h, x, st);
+            vxh = rd->vote(h, x, h, st);
+          }
+          if (!half || (h < x)) {
+            rh.add(k, h, x, vhx);
+          }
+          if (!half || (x < h)) {
+            rh.add(k, x, h, vxh);
           }
         }
       }
     }
+    catch (...) {
+      errs[h] = std::current_exception();
+    }
+  };
+  KBase::groupThreads(estFn, 0, numAct - 1);
+  for (auto & e : errs) {
+    if (nullptr != e) {
+      std::rethrow_exception(e);
+    }
   }
-  qtDB->commit();
+
+  if (posVoteHalf) {
+    // the mirrored row is only made up where it was not stored
+    string view = createViewSQL("PosVoteAll",
+      "SELECT ScenarioId, Turn_t, Est_h, Voter_k, Pos_i, Pos_j, Vote FROM PosVote "
+      "UNION ALL "
+      "SELECT p.ScenarioId, p.Turn_t, p.Est_h, p.Voter_k, p.Pos_j, p.Pos_i, -p.Vote FROM PosVote p "
+      "WHERE (p.Pos_i < p.Pos_j) AND NOT EXISTS (SELECT 1 FROM PosVote q "
+      "WHERE (q.ScenarioId = p.ScenarioId) AND (q.Turn_t = p.Turn_t) AND (q.Est_h = p.Est_h) "
+      "AND (q.Voter_k = p.Voter_k) AND (q.Pos_i = p.Pos_j) AND (q.Pos_j = p.Pos_i))");
+    execQuery(view);
+  }
+
+  // prepare the sql statement to insert
+  string sql = insertSQL("PosVote", "Turn_t, Est_h, Voter_k, Pos_i, Pos_j, Vote");
+  store->prepare(sql);
+
+  // start for the transaction
+  store->begin();
+  for (unsigned int h = 0; h < numAct; h++) {   // estimator is h
+    const auto & rh = rows[h];
+    store->beginBatch();
+    bool ok = true;
+    for (unsigned int r = 0; ok && (r < rh.v.size()); r++) {
+      store->bind(0, t);
+      store->bind(1, h);
+      store->bind(2, rh.k[r]);
+      store->bind(3, rh.i[r]);
+      store->bind(4, rh.j[r]);
+      store->bind(5, rh.v[r]);
+      ok = store->step();
+    }
+    ok = store->endBatch() && ok;
+    if (!ok) {
+      LOG(INFO) << store->lastError();
+      throw KException("Model::sqlPosVote: DB query failed");
+    }
+  }
+  store->commit();
 
   return;
 }
 
 void Model::createTableIndices() {
-    const char * indexUtil = "CREATE INDEX IF NOT EXISTS idx_util ON PosUtil(ScenarioId, Turn_t, Est_h, Act_i, Pos_j)";
-    string qry = string(indexUtil);
-    execQuery(qry);
+    if (nullptr == store) {
+      return;
+    }
+    string qry = "";
+    // the keyed PosUtilData is already clustered on this key
+    if (!keyedSchema) {
+      const char * indexUtil = "CREATE INDEX IF NOT EXISTS idx_util ON PosUtil(ScenarioId, Turn_t, Est_h, Act_i, Pos_j)";
+      qry = string(indexUtil);
+      execQuery(qry);
+    }
 
     const char *indexActor = "CREATE INDEX IF NOT EXISTS idx_actor ON ActorDescription(ScenarioId)";
     qry = string(indexActor);
@@ -966,6 +1297,9 @@ void Model::createTableIndices() {
 }
 
 void Model::dropTableIndices() {
+    if (nullptr == store) {
+      return;
+    }
     const char * indexUtil = "DROP INDEX IF EXISTS idx_util";
     string qry = string(indexUtil);
     execQuery(qry);
@@ -0,0 +1,317 @@
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// --------------------------------------------
+// The voting, coalition and PCE kernels, written once as templates on the
+// scalar type. Model instantiates them with double for ordinary runs;
+// instantiating them with KBase::Dual carries derivatives with respect to
+// the actors' weights through the same arithmetic (see Model::scalarPCEGrad).
+//
+// Square matrices are held row-major in a vector, c[i*numOpt + j].
+// -------------------------------------------------
+#ifndef KBASE_PCE_H
+#define KBASE_PCE_H
+
+#include <cmath>
+#include <functional>
+#include <tuple>
+#include <vector>
+
+#include "kutils.h"
+#include "dual.h"
+#include "kmodel.h"
+
+namespace KBase {
+
+using std::function;
+using std::tuple;
+using std::vector;
+
+// see Model::vote
+template <class T>
+T pceVote(VotingRule vr, const T & wi, const T & uij, const T & uik) {
+  if (dualVal(wi) <= 0.0) { // you can make it really small (10E-10), but never zero or below.
+    throw KException("Model::vote - non-positive voting weight");
+  }
+  T v = 0.0;
+  const T du = uij - uik;
+
+  const double sTol = 1E-8;
+  T rBin = du / sTol; // binary response
+  rBin = (1.0 < dualVal(rBin)) ? T(+1.0) : rBin;
+  rBin = (dualVal(rBin) < -1.0) ? T(-1.0) : rBin;
+
+  const T rProp = du; // proportional response
+  const T rCubic = du * du * du; // cubic reponse
+
+  // the following weights determine how much the hybrids deviate from proportional
+  const double rbp = 0.2;
+  // rbp = 0.2 makes LHS slope and RHS slope of equal size (0.8 each), and twice the center jump (0.4)
+
+  const double rpc = 0.5;
+
+  switch (vr) {
+  case VotingRule::Binary:
+    v = wi * rBin;
+    break;
+
+  case VotingRule::PropBin:
+    v = wi * ((1 - rbp)*rProp + rbp*rBin);
+    break;
+
+  case VotingRule::Proportional:
+    v = wi * rProp;
+    break;
+
+  case VotingRule::PropCbc:
+    v = wi * ((1 - rpc)*rProp + rpc*rCubic);
+    break;
+
+  case VotingRule::Cubic:
+    v = wi * rCubic;
+    break;
+
+  case VotingRule::ASymProsp:
+    if (dualVal(rProp) < 0.0) {
+      v = wi * rProp;
+    }
+    if (0.0 < dualVal(rProp)) {
+      v = (2.0 * wi * rProp) / 3.0;
+    }
+    break;
+
+  default:
+    throw KException("Model::vote - Unrecognized VotingRule");
+    break;
+  }
+  return v;
+}
+
+
+// see Model::vProb(VPModel, double, double)
+template <class T>
+tuple<T, T> pceVProb(VPModel vpm, const T & s1, const T & s2) {
+  const double tol = 1E-8;
+  const double minX = 1E-6;
+  T x1 = 0.0;
+  T x2 = 0.0;
+  switch (vpm) {
+  case VPModel::Linear:
+    x1 = s1;
+    x2 = s2;
+    break;
+  case VPModel::Square:
+    x1 = s1 * s1;
+    x2 = s2 * s2;
+    break;
+  case VPModel::Quartic:
+    x1 = s1 * s1 * s1 * s1;
+    x2 = s2 * s2 * s2 * s2;
+    break;
+  case VPModel::Octic:
+  {
+    const T q1 = s1 * s1 * s1 * s1;
+    const T q2 = s2 * s2 * s2 * s2;
+    x1 = q1 * q1;
+    x2 = q2 * q2;
+  }
+    break;
+  case VPModel::Binary:
+  {
+    // this is setup so that 10% or more advantage either way gives a guaranteed
+    // result. As with binary voting, it is necessary to have interpolation between
+    // to avoid weird round-off effects.
+    const double thresh = 1.10;
+    if (dualVal(s1) >= thresh*dualVal(s2)) {
+      x1 = 1.0;
+      x2 = minX;
+    }
+    else if (dualVal(s2) >= thresh*dualVal(s1)) {
+      x1 = minX;
+      x2 = 1.0;
+    }
+    else { // less than the threshold difference
+      const T r12 = s1 / (s1 + s2);
+      // We now need a linear rescaling so that
+      // when s1/s2 = t, or r12 = t/(t+1), p12 = 1, and
+      // when s2/s1 = t, or r12 = 1/(1+t), p12 =0.
+      // We can work out (a,b) so that
+      // a*(t/(t+1)) + b = 1, and
+      // a*(1/(1+t)) + b = 0, then
+      // verify that a*(1/(1+1))+b = 1/2.
+      //
+      const T p12 = (r12*(thresh + 1.0) - 1.0) / (thresh - 1.0);
+      x1 = p12;
+      x2 = 1.0 - p12;
+    }
+  }
+    break;
+  }
+  const T p1 = x1 / (x1 + x2);
+  const T p2 = x2 / (x1 + x2);
+  if (0 > dualVal(p1)) {
+    throw KException("Model::vProb: p1 must be non-negative");
+  }
+  if (0 > dualVal(p2)) {
+    throw KException("Model::vProb: p2 must be non-negative");
+  }
+  if (std::fabs(dualVal(p1) + dualVal(p2) - 1.0) >= tol) {
+    throw KException("Model::vProb: Sum total of all probabilities must be less than 1.0");
+  }
+
+  return tuple<T, T>(p1, p2);
+}
+
+
+// see Model::coalitions
+template <class T>
+vector<T> pceCoalitions(function<T(unsigned int ak, unsigned int pi, unsigned int pj)> vfn,
+                        unsigned int numAct, unsigned int numOpt) {
+  // if several actors occupy the same position, then numAct > numOpt
+  const double minC = 1E-8;
+  auto c = vector<T>(numOpt * numOpt, T(0.0));
+  for (unsigned int i = 0; i < numOpt; i++) {
+    for (unsigned int j = 0; j < i; j++) {
+      // scan only lower-left
+      T cij = minC;
+      T cji = minC;
+      for (unsigned int k = 0; k < numAct; k++) {
+        const T vkij = vfn(k, i, j);
+        if (0 < dualVal(vkij)) {
+          cij = cij + vkij;
+        }
+        if (dualVal(vkij) < 0) {
+          cji = cji - vkij;
+        }
+      }
+      c[i*numOpt + j] = cij;  // set the lower left coalition
+      c[j*numOpt + i] = cji;  // set the upper right coalition
+    }
+    c[i*numOpt + i] = minC; // set the diagonal coalition
+  }
+  return c;
+}
+
+
+// see Model::vProb(VPModel, const KMatrix &)
+template <class T>
+vector<T> pceVictProb(VPModel vpm, const vector<T> & c, unsigned int numOpt) {
+  auto p = vector<T>(numOpt * numOpt, T(0.0));
+  for (unsigned int i = 0; i < numOpt; i++) {
+    for (unsigned int j = 0; j < i; j++) {
+      const T & cij = c[i*numOpt + j];
+      const T & cji = c[j*numOpt + i];
+      if ((0 > dualVal(cij)) || (0 > dualVal(cji))) {
+        throw KException("Model::vProb: coalitions must be non-negative");
+      }
+      if ((0 >= dualVal(cij)) && (0 >= dualVal(cji))) {
+        throw KException("Model::vProb: Either one of cij or cji must be positive");
+      }
+      auto ppr = pceVProb<T>(vpm, cij, cji);
+      p[i*numOpt + j] = std::get<0>(ppr);
+      p[j*numOpt + i] = std::get<1>(ppr);
+    }
+    p[i*numOpt + i] = 0.5;
+  }
+  return p;
+}
+
+
+// see Model::condPCE. Returns the column of option probabilities.
+template <class T>
+vector<T> pceCondPCE(const vector<T> & pv, unsigned int numOpt) {
+  auto p = vector<T>(numOpt, T(0.0));
+  T probOne = 0.0; // probability that one option, any option, beats all alternatives
+  for (unsigned int i = 0; i < numOpt; i++) {
+    T pi = 1.0;
+    for (unsigned int j = 0; j < numOpt; j++) {
+      pi = pi * pv[i*numOpt + j];
+    }
+    p[i] = pi; // probability that i beats all alternatives
+    probOne = probOne + pi;
+  }
+  for (unsigned int i = 0; i < numOpt; i++) {
+    p[i] = p[i] / probOne; // conditional probability that i is that one.
+  }
+  return p;
+}
+
+
+// The Markov PCE models iterate p <- (p + M p)/2 to the stationary
+// distribution of a column-stochastic transition matrix M. These return M.
+
+// see Model::markovIncentivePCE
+template <class T>
+vector<T> pceMarkovIncentive(VPModel vpm, const vector<T> & c, unsigned int numOpt) {
+  const double epsSupport = 1E-10;
+  const auto pv = pceVictProb<T>(vpm, c, numOpt);
+
+  // n[ i -> j] and P[ i -> j] in the "Markov Voting with Incentives in KTAB" paper
+  auto chlg = vector<T>(numOpt * numOpt, T(0.0));
+  for (unsigned int j = 0; j < numOpt; j++) {
+    T sum = 0.0;
+    for (unsigned int i = 0; i < numOpt; i++) {
+      T inctv = c[i*numOpt + j] * pv[i*numOpt + j];
+      if (i == j) {
+        inctv = inctv + epsSupport;
+      }
+      chlg[i*numOpt + j] = inctv;
+      sum = sum + inctv;
+    }
+    for (unsigned int i = 0; i < numOpt; i++) {
+      chlg[i*numOpt + j] = chlg[i*numOpt + j] / sum;
+    }
+  }
+
+  // q_i = sum_j pv(i,j) * (p_i * P[j -> i] + p_j * P[i -> j])
+  auto m = vector<T>(numOpt * numOpt, T(0.0));
+  for (unsigned int i = 0; i < numOpt; i++) {
+    for (unsigned int j = 0; j < numOpt; j++) {
+      const T & vij = pv[i*numOpt + j];
+      m[i*numOpt + i] = m[i*numOpt + i] + vij * chlg[j*numOpt + i];
+      m[i*numOpt + j] = m[i*numOpt + j] + vij * chlg[i*numOpt + j];
+    }
+  }
+  return m;
+}
+
+// see Model::markovUniformPCE
+template <class T>
+vector<T> pceMarkovUniform(const vector<T> & pv, unsigned int numOpt) {
+  // q_i = sum_j pv(i,j) * (p_i + p_j) / n
+  auto m = vector<T>(numOpt * numOpt, T(0.0));
+  for (unsigned int i = 0; i < numOpt; i++) {
+    for (unsigned int j = 0; j < numOpt; j++) {
+      const T vij = pv[i*numOpt + j] / ((double)numOpt);
+      m[i*numOpt + i] = m[i*numOpt + i] + vij;
+      m[i*numOpt + j] = m[i*numOpt + j] + vij;
+    }
+  }
+  return m;
+}
+
+} // namespace KBase
+
+// -------------------------------------------------
+#endif
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
@@ -22,6 +22,7 @@
 // --------------------------------------------
 
 #include "kmodel.h"
+#include "kprofile.h"
 
 namespace KBase {
 using std::get;
@@ -55,6 +56,7 @@ void State::clear() {
   // We delete positions because they are part of the state.
   // Actors persist across states, so they are not deleted here.
   aUtil = {}; // vector<KMatrix>();
+  clearPDists();
   for (auto p : pstns) {
     if (nullptr != p) {
       delete p;
@@ -77,6 +79,7 @@ void State::randomizeUtils(double minU, double maxU, double uNoise) {
   auto rng = model->rng;
   unsigned int na = model->numAct;
   aUtil = vector<KMatrix>();
+  clearPDists();
   auto u = KMatrix::uniform(rng, na, na, minU, maxU);
   for (unsigned int i = 0; i < na; i++) {
     auto un = KMatrix::uniform(rng, na, na, -uNoise, +uNoise);
@@ -154,15 +157,16 @@ void State::setUENdx() {
       + std::to_string(Model::minNumActor));
   }
 
-  if (Model::maxNumActor < na) {
+  if (model->actorLimit() < na) {
     throw KException(string("State::setUENdx: Number of actors can not be more than")
-      + std::to_string(Model::maxNumActor));
+      + std::to_string(model->actorLimit()));
   }
 
   auto ns = KBase::uiSeq(0, na - 1);
   auto uePair = KBase::ueIndices<unsigned int>(ns, efn);
 
   uIndices = get<0>(uePair);
+  clearPDists();
   auto nu = ((const unsigned int)(uIndices.size()));
   if (0 >= nu || nu > na) {
     throw KException(string("State::setUENdx: size of uIndices must be in the range of (0,") + std::to_string(na) + "]");
@@ -184,6 +188,8 @@ void State::setAUtil(int perspH, ReportingLevel rl) {
   // we want to make sure that data is calculated at most once.
   // This is necessary because some utilities are very expensive to calculate,
   // it is easiest to be precise all the time.
+  KTAB_PROFILE_PHASE("State::setAUtil");
+  clearPDists();
 
   if (-1 == perspH) { // calculate them all at once
     if (0 != aUtil.size()) {
@@ -214,6 +220,82 @@ void State::setAUtil(int perspH, ReportingLevel rl) {
   return;
 }
 
+tuple< KMatrix, VUI> State::cachedPDist(int persp) const {
+  const int na = model->numAct;
+  if ((persp < -1) || (na <= persp)) {
+    throw KException("State::cachedPDist: unrecognized perspective");
+  }
+  const size_t nd = na + 1;
+  {
+    std::lock_guard<std::mutex> lock(pDistLock);
+    if (pDists.size() == nd) {
+      const auto & pd = pDists[persp + 1];
+      if (0 < get<0>(pd).numR()) {
+        KTAB_PROFILE_COUNT("State::cachedPDist hits", 1);
+        return pd;
+      }
+    }
+  }
+
+  // solve outside the lock, so different perspectives can be solved at once
+  tuple<KMatrix, VUI> pd;
+  {
+    KTAB_PROFILE_PHASE("State::pDist");
+    pd = pDist(persp);
+  }
+
+  std::lock_guard<std::mutex> lock(pDistLock);
+  if (pDists.size() != nd) {
+    pDists.resize(nd);
+  }
+  pDists[persp + 1] = pd;
+  return pd;
+}
+
+void State::cacheEstPDists() const {
+  const unsigned int na = model->numAct;
+  vector<int> missing = {};
+  {
+    std::lock_guard<std::mutex> lock(pDistLock);
+    for (unsigned int h = 0; h < na; h++) {
+      if ((pDists.size() != (na + 1)) || (0 == get<0>(pDists[h + 1]).numR())) {
+        missing.push_back(h);
+      }
+    }
+  }
+  if (0 == missing.size()) {
+    return;
+  }
+
+  // the PCE solves are independent, so do them in parallel
+  auto errs = vector<std::exception_ptr>(missing.size(), nullptr);
+  auto pFn = [this, &missing, &errs](unsigned int m) {
+    try {
+      cachedPDist(missing[m]);
+    }
+    catch (...) {
+      errs[m] = std::current_exception();
+    }
+  };
+  KBase::groupThreads(pFn, 0, missing.size() - 1);
+  for (auto & e : errs) {
+    if (nullptr != e) {
+      std::rethrow_exception(e);
+    }
+  }
+  return;
+}
+
+void State::clearPDists() {
+  std::lock_guard<std::mutex> lock(pDistLock);
+  pDists = {};
+}
+
+void State::releaseCaches() {
+  clearPDists();
+  return;
+}
+
 void State::setOneAUtil(unsigned int perspH, ReportingLevel rl) {
   // TODO: make this non-dummy
   throw KException("State::setOneAUtil: A dummy function");
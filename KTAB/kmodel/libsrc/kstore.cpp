@@ -0,0 +1,165 @@
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// --------------------------------------------
+
+#include "kstore.h"
+#include "kutils.h"
+
+
+namespace KBase {
+
+// --------------------------------------------
+SQLiteStore::SQLiteStore(const string & fileName) : LogStore() {
+  const int flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE;
+  if (SQLITE_OK != sqlite3_open_v2(fileName.c_str(), &db, flags, nullptr)) {
+    string msg = "SQLiteStore::SQLiteStore: could not open " + fileName;
+    if (nullptr != db) {
+      msg = msg + ": " + sqlite3_errmsg(db);
+      sqlite3_close(db);
+      db = nullptr;
+    }
+    throw KException(msg);
+  }
+}
+
+
+SQLiteStore::~SQLiteStore() {
+  if (inTransaction) {
+    commit();
+  }
+  for (auto & kv : stmts) {
+    sqlite3_finalize(kv.second);
+  }
+  stmts.clear();
+  current = nullptr;
+  sqlite3_close(db);
+  db = nullptr;
+}
+
+
+bool SQLiteStore::exec(const string & sql) {
+  char * zErrMsg = nullptr;
+  const int rc = sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &zErrMsg);
+  sqlite3_free(zErrMsg); // sqlite3_errmsg still has it
+  return (SQLITE_OK == rc);
+}
+
+
+bool SQLiteStore::selectInt(const string & sql, int64_t & v) {
+  sqlite3_stmt * stmt = nullptr;
+  if (SQLITE_OK != sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr)) {
+    sqlite3_finalize(stmt);
+    return false;
+  }
+  const bool found = (SQLITE_ROW == sqlite3_step(stmt));
+  if (found) {
+    v = sqlite3_column_int64(stmt, 0);
+  }
+  sqlite3_finalize(stmt);
+  return found;
+}
+
+
+bool SQLiteStore::prepare(const string & sql) {
+  current = nullptr;
+  auto it = stmts.find(sql);
+  if (stmts.end() != it) {
+    sqlite3_reset(it->second);
+    sqlite3_clear_bindings(it->second);
+    current = it->second;
+    return true;
+  }
+
+  sqlite3_stmt * stmt = nullptr;
+  if (SQLITE_OK != sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr)) {
+    sqlite3_finalize(stmt);
+    return false;
+  }
+  stmts[sql] = stmt;
+  current = stmt;
+  return true;
+}
+
+
+bool SQLiteStore::step() {
+  if (nullptr == current) {
+    return false;
+  }
+  const int rc = sqlite3_step(current);
+  // reset keeps the bindings, which are all overwritten by the next row anyway
+  sqlite3_reset(current);
+  return (SQLITE_DONE == rc) || (SQLITE_ROW == rc);
+}
+
+
+void SQLiteStore::begin() {
+  if (!inTransaction) {
+    inTransaction = exec("BEGIN TRANSACTION");
+  }
+}
+
+
+void SQLiteStore::commit() {
+  if (inTransaction) {
+    exec("COMMIT");
+    inTransaction = false;
+  }
+}
+
+
+string SQLiteStore::lastError() const {
+  return string(sqlite3_errmsg(db));
+}
+
+
+void SQLiteStore::bindNull(unsigned int pos) {
+  if (nullptr != current) {
+    sqlite3_bind_null(current, pos + 1);
+  }
+}
+
+
+void SQLiteStore::bindInt(unsigned int pos, int64_t v) {
+  if (nullptr != current) {
+    sqlite3_bind_int64(current, pos + 1, v);
+  }
+}
+
+
+void SQLiteStore::bindDouble(unsigned int pos, double v) {
+  if (nullptr != current) {
+    sqlite3_bind_double(current, pos + 1, v);
+  }
+}
+
+
+void SQLiteStore::bindText(unsigned int pos, const string & v) {
+  if (nullptr != current) {
+    sqlite3_bind_text(current, pos + 1, v.c_str(), static_cast<int>(v.size()), SQLITE_TRANSIENT);
+  }
+}
+
+} // end of namespace
+
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
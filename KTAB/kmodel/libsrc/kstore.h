@@ -0,0 +1,128 @@
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// --------------------------------------------
+// Write path for the run logs. Model output goes through a LogStore, which
+// has one implementation over the QtSql layer (any driver) and one directly
+// over sqlite3. Nothing in this header depends on Qt, so SQLiteStore can be
+// linked into command-line builds that do not otherwise need QtSql.
+//
+// Statements use positional '?' parameters, numbered from zero as in
+// QSqlQuery::bindValue. A statement is identified by its SQL text: calling
+// prepare() again with the same text hands back the compiled statement,
+// so writers can prepare once per call and still reuse the statement.
+// -------------------------------------------------
+#ifndef KTAB_STORE_H
+#define KTAB_STORE_H
+
+#include <sqlite3.h>
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+namespace KBase {
+using std::string;
+
+class LogStore {
+public:
+  LogStore() {};
+  virtual ~LogStore() {};
+
+  // execute one statement that takes no parameters, e.g. DDL or a PRAGMA
+  virtual bool exec(const string & sql) = 0;
+
+  // run a query that takes no parameters and read the first column of its
+  // first row; false if it fails or returns nothing
+  virtual bool selectInt(const string & sql, int64_t & v) = 0;
+
+  // make sql the current statement, with all parameters unbound
+  virtual bool prepare(const string & sql) = 0;
+
+  // execute the current statement with the values bound so far,
+  // then leave it ready to be bound again
+  virtual bool step() = 0;
+
+  // Between beginBatch and endBatch, step() may only queue the row and
+  // the backend is free to ship all of them at once. The default simply
+  // executes each row as it is stepped.
+  virtual void beginBatch() {};
+  virtual bool endBatch() { return true; };
+
+  virtual void begin() = 0;
+  virtual void commit() = 0;
+
+  virtual string lastError() const = 0;
+
+  void bind(unsigned int pos, int v) { bindInt(pos, v); };
+  void bind(unsigned int pos, unsigned int v) { bindInt(pos, v); };
+  void bind(unsigned int pos, int64_t v) { bindInt(pos, v); };
+  void bind(unsigned int pos, uint64_t v) { bindInt(pos, static_cast<int64_t>(v)); };
+  void bind(unsigned int pos, double v) { bindDouble(pos, v); };
+  void bind(unsigned int pos, const string & v) { bindText(pos, v); };
+  virtual void bindNull(unsigned int pos) = 0;
+
+protected:
+  virtual void bindInt(unsigned int pos, int64_t v) = 0;
+  virtual void bindDouble(unsigned int pos, double v) = 0;
+  virtual void bindText(unsigned int pos, const string & v) = 0;
+
+private:
+  LogStore(const LogStore &) = delete;
+  LogStore & operator=(const LogStore &) = delete;
+};
+
+
+// Writes straight through the sqlite3 C API, with no QVariant boxing and
+// no re-parsing of statements that have been seen before.
+class SQLiteStore : public LogStore {
+public:
+  explicit SQLiteStore(const string & fileName);
+  virtual ~SQLiteStore();
+
+  virtual bool exec(const string & sql) override;
+  virtual bool selectInt(const string & sql, int64_t & v) override;
+  virtual bool prepare(const string & sql) override;
+  virtual bool step() override;
+  virtual void begin() override;
+  virtual void commit() override;
+  virtual string lastError() const override;
+  virtual void bindNull(unsigned int pos) override;
+
+protected:
+  virtual void bindInt(unsigned int pos, int64_t v) override;
+  virtual void bindDouble(unsigned int pos, double v) override;
+  virtual void bindText(unsigned int pos, const string & v) override;
+
+private:
+  sqlite3 * db = nullptr;
+  sqlite3_stmt * current = nullptr;
+  std::map<string, sqlite3_stmt*> stmts = {};
+  bool inTransaction = false;
+};
+
+}; // end of namespace
+
+// -------------------------------------------------
+#endif
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
@@ -43,6 +43,16 @@ using KBase::VPModel;
 namespace DemoLeon {
 const double TolIFD = 1E-6;
 
+// taxes closer than this share one entry in the vaShares cache
+const double ShareCacheQuantum = 1E-10;
+// the cache is simply emptied when it grows past this many entries
+const unsigned int ShareCacheMax = 200000;
+
+// fixed, rather than from the core count, so runs are reproducible across machines
+const unsigned int MCThreads = 8;
+// consecutive samples makeFTax may reject before a stream gives up
+const unsigned int MCMaxFails = 1000;
+
 LeonActor::LeonActor(string n, string d, LeonModel* em, unsigned int id) : Actor(n, d) {
   if (nullptr == em) {
     throw KException("LeonActor::LeonActor: em is null pointer");
@@ -397,38 +407,58 @@ LeonState* LeonState::doSUSN(ReportingLevel rl) const {
   if (model->numAct != s2->pstns.size()) {
     throw KException("LeonState::doSUSN: Number of positions should be equal to number of actors");
   }
+  // The searches are independent, so run them concurrently; the results are
+  // reported and checked afterwards, in actor order, on this thread.
+  auto vBests = vector<double>(numA, 0.0);
+  auto pBests = vector<KMatrix>(numA);
+  auto iters = vector<unsigned int>(numA, 0);
+  auto stables = vector<unsigned int>(numA, 0);
+  auto errs = vector<std::exception_ptr>(numA);
+
+  auto searchFn = [this, assessEU, &vBests, &pBests, &iters, &stables, &errs](unsigned int h) {
+    try {
+      KBase::VHCSearch vhc;
+      vhc.eval = [this, h, assessEU](const KMatrix & m1) {
+        auto m2 = eMod->makeFTax(m1); // make it feasible
+        return assessEU(h, m2);
+      };
+      vhc.nghbrs = KBase::VHCSearch::vn2;
+
+      auto aPos = ((VctrPstn*)(pstns[h]));
+      auto rslt = vhc.run(*aPos,                       // p0
+                          1000, 10, 1E-4,              // iterMax, stableMax, sTol
+                          0.01, 0.618, 1.25, 1e-6,     // step0, shrink, stretch, minStep
+                          ReportingLevel::Silent);
+      // note that typical improvements in utility in the first round are on the order of 1E-1 or 1E-2.
+      // Therefore, any improvement of less than 1/100th of that (below sTol = 1E-4) is considered "stable"
+
+      vBests[h] = get<0>(rslt);
+      pBests[h] = get<1>(rslt);
+      iters[h] = get<2>(rslt);
+      stables[h] = get<3>(rslt);
+    }
+    catch (...) {
+      errs[h] = std::current_exception();
+    }
+    return;
+  };
+
+  // each search already evaluates its neighbors on their own threads, so only a few at a time
+  KBase::groupThreads(searchFn, 0, numA - 1, 4);
+
   for (unsigned int h = 0; h < numA; h++) {
-    auto vhc = new KBase::VHCSearch();
-    vhc->eval = [this, h, assessEU](const KMatrix & m1) {
-      auto m2 = eMod->makeFTax(m1); // make it feasible
-      return assessEU(h, m2);
-    };
-    vhc->nghbrs = KBase::VHCSearch::vn2;
+    if (nullptr != errs[h]) {
+      delete s2;
+      std::rethrow_exception(errs[h]);
+    }
 
-    auto aPos = ((VctrPstn*)(pstns[h]));
     // JAH 20160811 changed to display actor names and not just id
     LOG(INFO) <<"Search for best next-position of actor " << eMod->actrs[h]->name;
-    //printf("Search for best next-position of actor %2i starting from ", h);
-    //trans(*aPos).printf(" %+.6f ");
-    auto rslt = vhc->run(*aPos,                       // p0
-                         1000, 10, 1E-4,              // iterMax, stableMax, sTol
-                         0.01, 0.618, 1.25, 1e-6,     // step0, shrink, stretch, minStep
-                         ReportingLevel::Silent);
-    // note that typical improvements in utility in the first round are on the order of 1E-1 or 1E-2.
-    // Therefore, any improvement of less than 1/100th of that (below sTol = 1E-4) is considered "stable"
-
-    double vBest = get<0>(rslt);
-    KMatrix pBest = get<1>(rslt);
-    unsigned int in = get<2>(rslt);
-    unsigned int sn = get<3>(rslt);
-
-    //cout << "pBest :    ";
-    //trans(pBest).printf(" %+.6f ");
 
+    double vBest = vBests[h];
+    KMatrix pBest = pBests[h];
 
-    delete vhc;
-    vhc = nullptr;
-    LOG(INFO) << "Iter:" << in << "Stable:" << sn;
+    LOG(INFO) << "Iter:" << iters[h] << "Stable:" << stables[h];
     LOG(INFO) << KBase::getFormattedString("Best value for %2u: %+.6f", h, vBest);
     LOG(INFO) << "Best point:";
     trans(pBest).mPrintf(" %+.6f ");
@@ -445,11 +475,7 @@ LeonState* LeonState::doSUSN(ReportingLevel rl) const {
 
     const double du = vBest - eu0(h, 0);
     LOG(INFO) << KBase::getFormattedString("EU improvement for %2u of %+.4E", h, du);
-    //printf("  vBest = %+.6f \n", vBest);
-    //printf("  eu0(%i, 0) for %i = %+.6f \n", h, h, eu0(h,0));
-    //cout << endl << flush;
     // Logically, du should always be non-negative, as VHC never returns a worse value than the starting point.
-    //const double eps = 0; // 1E-5 ;
     if (0 > du) {
       throw KException("LeonState::doSUSN: du must be non-negative");
     }
@@ -1115,6 +1141,7 @@ void LeonModel::makeIOModel(const KMatrix & trns, const KMatrix & rev, const KMa
   // estimate the size of the remaining errors from
   // mean(a^(n+1)) compared to mean(S(n)).
 
+  setShareMap();
   return;
 }
 
@@ -1477,7 +1504,26 @@ void LeonModel::prepModel(unsigned int numFac, unsigned int numCon, unsigned int
   LOG(INFO) << "budgetBS:";
   budgetBS.mPrintf(" %.4f ");
 
+  setShareMap();
+  return;
+}
+
+void LeonModel::setShareMap() {
+  // Both IO models are linear in the exports, and aL and bL were inverted once
+  // already, so fold rho and vas in as well: each vaShares is then a single product.
+  const auto rhoAL = rho * aL;
+  shareMap = KMatrix(L + N, N);
+  for (unsigned int j = 0; j < N; j++) {
+    for (unsigned int h = 0; h < L; h++) {
+      shareMap(h, j) = rhoAL(h, j);
+    }
+    for (unsigned int k = 0; k < N; k++) {
+      shareMap(L + k, j) = vas(0, k) * bL(k, j);
+    }
+  }
 
+  std::lock_guard<std::mutex> lock(shareCacheMtx);
+  shareCache.clear();
   return;
 }
 
@@ -1501,57 +1547,66 @@ KMatrix LeonModel::xprtDemand(const KMatrix & tau) const {
   return x1;
 }
 
-KMatrix LeonModel::randomFTax(PRNG* rng) {
-  using KBase::dot;
-  KMatrix ftax = KMatrix(N, 1);
-
-  auto makeRand = [this, rng]() {
-    auto tax = KMatrix(N, 1);
-    for (unsigned int i = 0; i < N; i++) {
-      double ti = rng->uniform(-1, +1);
-      if (ti < 0) {
-        ti = ti*maxSub;
-      }
-      if (0 < ti) {
-        ti = ti*maxTax;
-      }
-      tax(i, 0) = ti;
-    }
-    return tax;
-  };
-
-  auto clip = [this](const KMatrix & tm1) {
-    auto tm2 = tm1;
-    for (unsigned int i = 0; i < tm1.numR(); i++) {
-      for (unsigned int j = 0; j < tm1.numC(); j++) {
-        double t = tm1(i, j);
-        t = (t < -maxSub) ? -maxSub : t;
-        t = (maxTax < t) ? maxTax : t;
-        tm2(i, j) = t;
-      }
+// Walk N hit-and-run steps from zero tax across the base-case revenue-neutral
+// region, then adjust for demand effects. Unlike the old clip-and-retry scheme,
+// every candidate is already inside the limits and revenue neutral to first order,
+// so makeFTax rarely has anything to reject.
+KMatrix LeonModel::randomFTax(PRNG* rng) const {
+  const unsigned int maxTries = 100;
+  for (unsigned int tries = 0; tries < maxTries; tries++) {
+    auto z = KMatrix(N, 1);
+    for (unsigned int k = 0; k < N; k++) {
+      hitAndRun(z, rng, rng->uniform(0.0, 1.0));
     }
-    return tm2;
-  };
-
-  bool retry = true;
-  while (retry) {
-    retry = false;
     try {
-      auto t1 = makeRand();
-      // now tax is a bunch of random numbers, within [-maxSub, +maxTax] limits.
-      // first, adjust to revenue neutrality assuming no demand-effects,
-      // then, clip that back within allowable limits (esp make sure -1 < ti)
-      auto t2 = clip(KBase::makePerp(t1, x0));
-      // of course, that might ruin the revenu-neutrality, so repeat:
-      auto t3 = clip(KBase::makePerp(t2, x0));
-      // finally, adjust that including demand effects:
-      ftax = makeFTax(t3);
+      return makeFTax(z);
     }
     catch (KBase::KException&) {
-      retry = true;
+      // step off and try another point
     }
   }
-  return ftax;
+  throw KException("LeonModel::randomFTax: could not find a feasible tax");
+}
+
+
+KMatrix LeonModel::hitAndRun(KMatrix & z, PRNG* rng, double u) const {
+  const double pi = 3.14159265358979323846;
+  const double tiny = 1E-12;
+  KMatrix d;
+  double dn = 0.0;
+  while (dn <= tiny) {
+    d = KMatrix(N, 1);
+    for (unsigned int i = 0; i < N; i++) { // Box-Muller, so the direction is isotropic
+      double u1 = rng->uniform(0.0, 1.0);
+      double u2 = rng->uniform(0.0, 1.0);
+      u1 = (u1 < 1E-300) ? 1E-300 : u1;
+      d(i, 0) = sqrt(-2.0 * log(u1)) * cos(2.0 * pi * u2);
+    }
+    d = KBase::makePerp(d, x0); // stay on the plane dot(x0, tax) = 0
+    dn = KBase::norm(d);
+  }
+  d = d / dn;
+
+  // the chord is where every component stays within [-maxSub, maxTax]
+  double tLo = -1E300;
+  double tHi = +1E300;
+  for (unsigned int i = 0; i < N; i++) {
+    const double di = d(i, 0);
+    if (fabs(di) <= tiny) {
+      continue;
+    }
+    const double ta = (-maxSub - z(i, 0)) / di;
+    const double tb = (maxTax - z(i, 0)) / di;
+    tLo = std::max(tLo, std::min(ta, tb));
+    tHi = std::min(tHi, std::max(ta, tb));
+  }
+  if (tHi < tLo) { // rounding put z just outside, so do not move
+    return z;
+  }
+
+  const auto z0 = z;
+  z = z0 + (tLo + u * (tHi - tLo)) * d;
+  return z0 + (tLo + (1.0 - u) * (tHi - tLo)) * d;
 }
 
 // this occaisonally fails to terminate, so we throw an exception
@@ -1670,49 +1725,63 @@ KMatrix  LeonModel::vaShares(const KMatrix & tax, bool normalizeSharesP) const {
 
   using KBase::sum;
 
-  auto xt = xprtDemand(tax);
-
-  if(infsDegree(tax) >= TolIFD) { // make sure it is a feasible tax
-    throw KException("LeonModel::infsDegree: It is not a feasible tax");
+  auto key = vector<long long>(N);
+  for (unsigned int i = 0; i < N; i++) {
+    key[i] = std::llround(tax(i, 0) / ShareCacheQuantum);
   }
 
-  auto qA = aL * xt; // N-by-1 column vector
-  auto budgetL = rho * qA;
-
-  auto qB = bL * xt; // N-by-1 column vector
-  auto budgetS = KMatrix(1, N);
-  for (unsigned int j = 0; j < N; j++) {
-    double vs = qB(j, 0) * vas(0, j);
-    budgetS(0, j) = vs;
+  auto shares = KMatrix();
+  {
+    std::lock_guard<std::mutex> lock(shareCacheMtx);
+    auto it = shareCache.find(key);
+    if (shareCache.end() != it) {
+      shares = it->second;
+    }
   }
 
-  // note that the sums of factor and of sector VA's will
-  // NOT be equal, as they are assessed by different models.
-  auto fShares = KMatrix(1, L);
-  auto sShares = KMatrix(1, N);
+  if (0 == shares.numC()) {
+    if(infsDegree(tax) >= TolIFD) { // make sure it is a feasible tax
+      throw KException("LeonModel::infsDegree: It is not a feasible tax");
+    }
+
+    // note that the sums of factor and of sector VA's will
+    // NOT be equal, as they are assessed by different models.
+    auto xt = xprtDemand(tax);
+    shares = trans(shareMap * xt); // [factor | sector]
 
-  for (unsigned int j = 0; j < L; j++) {
-    double s = budgetL(j, 0);
-    if(0 >= s) {
-      throw KException("LeonModel::infsDegree: s must be positive within L");
+    for (unsigned int j = 0; j < L; j++) {
+      if(0 >= shares(0, j)) {
+        throw KException("LeonModel::infsDegree: s must be positive within L");
+      }
     }
-    fShares(0, j) = s;
-  }
-  for (unsigned int j = 0; j < N; j++) {
-    double s = budgetS(0, j);
-    if(0 >= s) {
-      throw KException("LeonModel::infsDegree: s must be positive within N");
+    for (unsigned int j = 0; j < N; j++) {
+      if(0 >= shares(0, L + j)) {
+        throw KException("LeonModel::infsDegree: s must be positive within N");
+      }
     }
-    sShares(0, j) = s;
+
+    std::lock_guard<std::mutex> lock(shareCacheMtx);
+    if (ShareCacheMax <= shareCache.size()) {
+      shareCache.clear();
+    }
+    shareCache[key] = shares;
   }
 
   if (normalizeSharesP) {
+    auto fShares = KMatrix(1, L);
+    auto sShares = KMatrix(1, N);
+    for (unsigned int j = 0; j < L; j++) {
+      fShares(0, j) = shares(0, j);
+    }
+    for (unsigned int j = 0; j < N; j++) {
+      sShares(0, j) = shares(0, L + j);
+    }
     fShares = fShares / sum(fShares);
     sShares = sShares / sum(sShares);
-
+    shares = KBase::joinH(fShares, sShares);
   }
 
-  return KBase::joinH(fShares, sShares); //  [factor | sector]  as promised
+  return shares; //  [factor | sector]  as promised
 }
 
 
@@ -1720,51 +1789,156 @@ KMatrix LeonModel::monteCarloShares(unsigned int nRuns, PRNG* rng) {
   auto rl = KBase::ReportingLevel::Low;
   // each run is a row of unnormalized [factor | sector] shares
   // the first row is the base case of zero taxes (row 0 <--> tax 0)
+  auto runs = KMatrix();
+  auto stats = monteCarloStats(nRuns, rng->uniform(), MCThreads, MCSampling::Plain, &runs);
+
+  if (KBase::ReportingLevel::Low <= rl) {
+    for (unsigned int j = 0; j < L + N; j++) {
+      const auto & sj = stats[j];
+      LOG(INFO) << KBase::getFormattedString(
+                    "MC share %2u: mean %+.4f, sd %.4f, 5%% %+.4f, 50%% %+.4f, 95%% %+.4f", j,
+                    sj.mean(), sqrt(sj.variance()), sj.quantile(0), sj.quantile(1), sj.quantile(2));
+    }
+  }
+  return runs;
+}
+
+
+vector<KBase::OnlineStats> LeonModel::monteCarloStats(unsigned int nRuns, uint64_t seed, unsigned int numThreads,
+    MCSampling smp, KMatrix * runs) const {
   const bool normP = false;
   if((0 > maxSub) || (maxSub >= 1)) {
-    throw KException("LeonModel::monteCarloShares: maxSub is not in range [0,1)");
+    throw KException("LeonModel::monteCarloStats: maxSub is not in range [0,1)");
   }
   if(0 > maxTax) {
-    throw KException("LeonModel::monteCarloShares: maxTax must be non-negative");
+    throw KException("LeonModel::monteCarloStats: maxTax must be non-negative");
   }
+  if (0 == nRuns) {
+    throw KException("LeonModel::monteCarloStats: nRuns must be positive");
+  }
+  if (0 == numThreads) {
+    throw KException("LeonModel::monteCarloStats: numThreads must be positive");
+  }
+  const unsigned int numS = (numThreads < nRuns) ? numThreads : nRuns;
+  const unsigned int nc = L + N;
 
-  auto runs = KMatrix(nRuns, L + N);
-  auto tau = KMatrix(N, 1); // zero taxes
-  auto shr = vaShares(tau, normP);
-  for (unsigned int j = 0; j < L + N; j++) {
-    runs(0, j) = shr(0, j);
+  if (nullptr != runs) {
+    *runs = KMatrix(nRuns, nc);
   }
 
-  for (unsigned int i = 1; i < nRuns; i++) {
-    tau = randomFTax(rng); // this occaisonally takes a long time
-    tau = makeFTax(tau);
-    double ifd = infsDegree(tau);
-    if(ifd >= TolIFD) {
-      throw KException("LeonModel::monteCarloShares: ifd must be less than TolIFD");
-    }
-    shr = vaShares(tau, normP);
+  // the streams are seeded in order from one master stream
+  auto master = PRNG(seed);
+  auto seeds = vector<uint64_t>(numS);
+  for (unsigned int s = 0; s < numS; s++) {
+    seeds[s] = master.uniform();
+  }
 
-    for (unsigned int j = 0; j < L + N; j++) {
-      runs(i, j) = shr(0, j);
-    }
-
-    if (KBase::ReportingLevel::Medium <= rl) {
-      LOG(INFO) <<"MC tax policy %4u:" << i;
-      tau.mPrintf(" %+.4f ");
-      LOG(INFO) <<"MC shares %4u:" << i;
-      shr.mPrintf(" %+.4f ");
-      for (unsigned int j = 0; j < L + N; j++) {
-        if (L <= j) {
-          // as they are in [factor |sector] order,
-          // we have L factors to skip then N sectors to show
-          LOG(INFO) << KBase::getFormattedString("for MC tax policy %4u, actor %2u taxed %+.4f has share %+.4f",
-                 i, j, tau(j - L, 0), shr(0, j));
+  const auto mcStats = KBase::OnlineStats({ 0.05, 0.50, 0.95 });
+  auto parts = vector<vector<KBase::OnlineStats>>(numS, vector<KBase::OnlineStats>(nc, mcStats));
+  auto errs = vector<std::exception_ptr>(numS, nullptr);
+
+  auto streamFn = [this, nRuns, numS, nc, smp, runs, &seeds, &parts, &errs](unsigned int s) {
+    try {
+      auto rng = PRNG(seeds[s]);
+      auto & ss = parts[s];
+      auto record = [runs, nc, &ss](unsigned int r, const KMatrix & shr) {
+        for (unsigned int j = 0; j < nc; j++) {
+          ss[j].add(shr(0, j));
+          if (nullptr != runs) {
+            (*runs)(r, j) = shr(0, j);
+          }
+        }
+      };
+
+      unsigned int r = (unsigned int)((((uint64_t)s) * nRuns) / numS);
+      const unsigned int rEnd = (unsigned int)((((uint64_t)s + 1) * nRuns) / numS);
+      if (0 == r) {
+        record(r, vaShares(KMatrix(N, 1), normP)); // zero taxes
+        r++;
+      }
+
+      auto z = KMatrix(N, 1);
+      for (unsigned int k = 0; k < 10 * N; k++) { // burn-in
+        hitAndRun(z, &rng, rng.uniform(0.0, 1.0));
+      }
+
+      const double shift = rng.uniform(0.0, 1.0);
+      uint32_t sobolNdx = 0;
+      auto nextU = [smp, shift, &rng, &sobolNdx]() {
+        if (MCSampling::Sobol != smp) {
+          return rng.uniform(0.0, 1.0);
+        }
+        // base-2 radical inverse of the index, i.e. the 1D Sobol sequence
+        uint32_t b = ++sobolNdx;
+        b = (b << 16) | (b >> 16);
+        b = ((b & 0x00ff00ffu) << 8) | ((b & 0xff00ff00u) >> 8);
+        b = ((b & 0x0f0f0f0fu) << 4) | ((b & 0xf0f0f0f0u) >> 4);
+        b = ((b & 0x33333333u) << 2) | ((b & 0xccccccccu) >> 2);
+        b = ((b & 0x55555555u) << 1) | ((b & 0xaaaaaaaau) >> 1);
+        double u = b / 4294967296.0 + shift;
+        return (u < 1.0) ? u : u - 1.0;
+      };
+
+      auto pending = KMatrix();
+      bool havePending = false;
+      unsigned int fails = 0;
+      while (r < rEnd) {
+        KMatrix cand;
+        if (havePending) {
+          cand = pending;
+          havePending = false;
+        }
+        else {
+          for (unsigned int k = 1; k < N; k++) { // thin the chain
+            hitAndRun(z, &rng, rng.uniform(0.0, 1.0));
+          }
+          auto alt = hitAndRun(z, &rng, nextU());
+          cand = z;
+          if (MCSampling::Antithetic == smp) {
+            pending = alt;
+            havePending = true;
+          }
+        }
+
+        KMatrix tau;
+        try {
+          tau = makeFTax(cand);
+        }
+        catch (KBase::KException&) {
+          fails++;
+          if (MCMaxFails < fails) {
+            throw KException("LeonModel::monteCarloStats: too many infeasible samples in a row");
+          }
+          continue;
         }
+        fails = 0;
+        if(infsDegree(tau) >= TolIFD) {
+          throw KException("LeonModel::monteCarloStats: ifd must be less than TolIFD");
+        }
+        record(r, vaShares(tau, normP));
+        r++;
       }
     }
+    catch (...) {
+      errs[s] = std::current_exception();
+    }
+  };
+  KBase::groupThreads(streamFn, 0, numS - 1, numS);
+
+  for (auto & e : errs) {
+    if (nullptr != e) {
+      std::rethrow_exception(e);
+    }
   }
 
-  return runs;
+  // merge in stream order, so the result depends only on seed and numThreads
+  auto stats = parts[0];
+  for (unsigned int s = 1; s < numS; s++) {
+    for (unsigned int j = 0; j < nc; j++) {
+      stats[j].merge(parts[s][j]);
+    }
+  }
+  return stats;
 }
 // -------------------------------------------------
 
@@ -27,6 +27,9 @@
 #include <assert.h>
 #include <chrono>
 #include <cstring>
+#include <exception>
+#include <map>
+#include <mutex>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string>
@@ -39,6 +42,7 @@
 #include "gaopt.h"
 #include "hcsearch.h"
 #include "kmodel.h"
+#include "onlinestats.h"
 
 namespace DemoLeon {
 // namespace to which KBase has no access
@@ -67,6 +71,14 @@ class LeonActor;
 // -------------------------------------------------
 
 LeonModel* demoSetup(unsigned int numFctr, unsigned int numCGrp, unsigned int numSect, uint64_t s, PRNG* rng);
+
+// -------------------------------------------------
+// How monteCarloStats places each sample along its hit-and-run chord.
+// Antithetic uses every chord twice, at u and 1-u; Sobol takes u from the
+// one-dimensional Sobol (van der Corput) sequence, randomly shifted per stream.
+enum class MCSampling {
+  Plain, Antithetic, Sobol
+};
 void demoEUEcon(uint64_t s, PRNG* rng);
 void demoMaxEcon(uint64_t s, PRNG* rng);
 // -------------------------------------------------
@@ -206,7 +218,7 @@ public:
   KMatrix xprtDemand(const KBase::KMatrix& tau) const;
 
   // make a revenue-neutral but otherwise random tax vector
-  KMatrix randomFTax(PRNG* rng);
+  KMatrix randomFTax(PRNG* rng) const;
 
   // Given an arbitrary tax/subsidy vector, search for the nearest which is revenue-neutral.
   // It may flip the signs of some components. It may throw KException, so be prepared.
@@ -220,6 +232,14 @@ public:
 
   KMatrix monteCarloShares(unsigned int nRuns, KBase::PRNG* rng);
 
+  // Sample nRuns feasible taxes (the first being zero tax) and accumulate their
+  // unnormalized [factor | sector] shares, one OnlineStats per column, with the 5%, 50% and 95% quantiles. The samples are
+  // split over numThreads independent streams seeded from seed, so the results are
+  // reproducible for a given seed and thread count. If runs is not null, it is
+  // resized to nRuns rows and also receives every sample.
+  vector<KBase::OnlineStats> monteCarloStats(unsigned int nRuns, uint64_t seed, unsigned int numThreads,
+                                             MCSampling smp, KMatrix * runs = nullptr) const;
+
   // considering all the positions as vectors, return the distance between states.
   static double stateDist (const LeonState* s1 , const LeonState* s2 );
 
@@ -264,7 +284,23 @@ protected:
   // vas: row-vector of fractional value-added shares per sector (i.e. rho added over factors)
   KMatrix  vas = KMatrix();
 
+  // shareMap: [rho * aL ; diag(vas) * bL], so the unnormalized [factor | sector]
+  //     shares of an export vector X are trans(shareMap * X)
+  KMatrix  shareMap = KMatrix();
+
 private:
+  // build shareMap once aL, bL, rho and vas are known
+  void setShareMap();
+
+  // One hit-and-run step inside the box [-maxSub, maxTax] intersected with the
+  // base-case revenue-neutral plane dot(x0, tax) = 0, moving z to the point at fraction
+  // u along a random chord through it; returns the point at 1-u on the same chord.
+  KMatrix hitAndRun(KMatrix & z, PRNG* rng, double u) const;
+
+  // unnormalized vaShares rows, keyed on the quantized feasible tax vector.
+  // Every actor, vote and search neighbor shares it, possibly from several threads.
+  mutable std::map<vector<long long>, KMatrix> shareCache = {};
+  mutable std::mutex shareCacheMtx;
 
 };
 
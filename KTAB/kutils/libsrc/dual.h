@@ -0,0 +1,118 @@
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// --------------------------------------------
+// Forward-mode automatic differentiation, for code which is written once
+// as a template on its scalar type and instantiated with either double or Dual.
+// A Dual carries a value and its gradient with respect to a fixed set of
+// parameters. Constants have an empty gradient, so mixing them in costs little.
+// -------------------------------------------------
+#ifndef KBASE_DUAL_H
+#define KBASE_DUAL_H
+
+#include <vector>
+
+namespace KBase {
+
+using std::vector;
+
+class Dual {
+public:
+  Dual() {};
+  Dual(double x) : v(x) {}; // a constant, deliberately implicit
+  Dual(double x, unsigned int n, unsigned int i) : v(x), d(n, 0.0) { // the i-th of n parameters
+    d[i] = 1.0;
+  };
+
+  double v = 0.0;
+  vector<double> d = {}; // gradient, empty if constant
+
+  // a*da + b*db, where an empty vector stands for zero
+  static vector<double> lin(double a, const vector<double> & da, double b, const vector<double> & db) {
+    if (da.empty() && db.empty()) {
+      return vector<double>();
+    }
+    auto r = vector<double>((da.size() > db.size()) ? da.size() : db.size(), 0.0);
+    for (unsigned int i = 0; i < da.size(); i++) {
+      r[i] = a*da[i];
+    }
+    for (unsigned int i = 0; i < db.size(); i++) {
+      r[i] = r[i] + b*db[i];
+    }
+    return r;
+  };
+
+  // i-th component of the gradient
+  double grad(unsigned int i) const {
+    return (i < d.size()) ? d[i] : 0.0;
+  };
+
+  Dual & operator+= (const Dual & y) {
+    d = lin(1.0, d, 1.0, y.d);
+    v = v + y.v;
+    return *this;
+  };
+  Dual & operator-= (const Dual & y) {
+    d = lin(1.0, d, -1.0, y.d);
+    v = v - y.v;
+    return *this;
+  };
+  Dual & operator*= (const Dual & y) {
+    d = lin(y.v, d, v, y.d);
+    v = v * y.v;
+    return *this;
+  };
+  Dual & operator/= (const Dual & y) {
+    d = lin(1.0 / y.v, d, -v / (y.v*y.v), y.d);
+    v = v / y.v;
+    return *this;
+  };
+};
+
+inline Dual operator+ (Dual x, const Dual & y) { return x += y; }
+inline Dual operator- (Dual x, const Dual & y) { return x -= y; }
+inline Dual operator* (Dual x, const Dual & y) { return x *= y; }
+inline Dual operator/ (Dual x, const Dual & y) { return x /= y; }
+inline Dual operator- (const Dual & x) {
+  Dual r;
+  r.v = -x.v;
+  r.d = Dual::lin(-1.0, x.d, 0.0, vector<double>());
+  return r;
+}
+
+// Comparisons look only at values, so that branches in templated code
+// take the same path for Dual as they would for double.
+inline bool operator< (const Dual & x, const Dual & y) { return x.v < y.v; }
+inline bool operator> (const Dual & x, const Dual & y) { return x.v > y.v; }
+inline bool operator<= (const Dual & x, const Dual & y) { return x.v <= y.v; }
+inline bool operator>= (const Dual & x, const Dual & y) { return x.v >= y.v; }
+
+// the value, whatever the scalar type
+inline double dualVal(double x) { return x; }
+inline double dualVal(const Dual & x) { return x.v; }
+
+} // namespace KBase
+
+// -------------------------------------------------
+#endif
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
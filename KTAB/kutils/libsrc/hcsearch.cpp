@@ -35,6 +35,7 @@ using std::get;
 vector<KMatrix> VHCSearch::vn1(const KMatrix & m0, double s) {
   unsigned int n = m0.numR();
   auto nghbrs = vector<KMatrix>();
+  nghbrs.reserve(2 * n);
   double pms[] = { -1, +1 };
   for (unsigned int i = 0; i < n; i++) {
     for (double si : pms) {
@@ -52,6 +53,7 @@ vector<KMatrix> VHCSearch::vn2(const KMatrix & m0, double s) {
     throw KException("VHCSearch::vn2: m0 should have more than one rows");
   }
   auto nghbrs = vector<KMatrix>();
+  nghbrs.reserve(2 * n * (n - 1));
   double pms[] = { -1, +1 };
   for (unsigned int i = 0; i < n; i++) {
     for (unsigned int j = 0; j < i; j++) {
@@ -98,6 +98,10 @@ public:
   function <vector<HCP>(const HCP)> nghbrs = nullptr;
   function <void(const HCP)> show = nullptr;
 
+  // Optional alternative to nghbrs: call the given function on each neighbor
+  // in turn, so they need never all exist at once. Used instead of nghbrs when set.
+  function <void(const HCP &, function <void(const HCP &)>)> forNghbrs = nullptr;
+
 protected:
 
 private:
@@ -108,6 +112,7 @@ GHCSearch<HCP>::GHCSearch() {
   eval = nullptr;
   nghbrs = nullptr;
   show = nullptr;
+  forNghbrs = nullptr;
 }
 
 template<class HCP>
@@ -115,6 +120,7 @@ GHCSearch<HCP>::~GHCSearch() {
   eval = nullptr;
   nghbrs = nullptr;
   show = nullptr;
+  forNghbrs = nullptr;
 }
 
 template<class HCP>
@@ -129,7 +135,7 @@ GHCSearch<HCP>::run(HCP p0, ReportingLevel srl,
   std::mutex ghcEvalMtx;
 
   assert(eval != nullptr);
-  assert(nghbrs != nullptr);
+  assert((nghbrs != nullptr) || (forNghbrs != nullptr));
   unsigned int iter = 0;
   unsigned int sIter = 0;
   double v0 = eval(p0);
@@ -143,8 +149,7 @@ GHCSearch<HCP>::run(HCP p0, ReportingLevel srl,
     double vBest = v0;
     HCP pBest = p0;
 
-    for (HCP pTmp : nghbrs(p0)) {
-
+    auto tryNghbr = [this, &ghcEvalMtx, &vBest, &pBest](const HCP & pTmp) {
       // Notice that 'eval' is not in the critical section, so we could
       // have arbitrarily many 'eval' operations running concurrently,
       // interleaved arbitrarily with test&reset in the critical section.
@@ -158,6 +163,15 @@ GHCSearch<HCP>::run(HCP p0, ReportingLevel srl,
         pBest = pTmp;
       }
       ghcEvalMtx.unlock();
+    };
+
+    if (nullptr != forNghbrs) {
+      forNghbrs(p0, tryNghbr);
+    }
+    else {
+      for (HCP pTmp : nghbrs(p0)) {
+        tryNghbr(pTmp);
+      }
     }
 
     // lock is necessary if multi-threaded, harmless if single-threaded
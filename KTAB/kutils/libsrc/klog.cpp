@@ -0,0 +1,238 @@
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// --------------------------------------------
+
+
+
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include <easylogging++.h>
+
+#include "klog.h"
+
+namespace KBase {
+// --------------------------------------------
+
+namespace {
+
+// A line of text, or a matrix kept unformatted until it is written
+struct LogEntry {
+  string text = "";
+  bool isMatrix = false;
+  KMatrix mat = KMatrix();
+  string fs = "";
+};
+
+using LogBlock = std::vector<LogEntry>;
+
+void writeBlock(const LogBlock & b) {
+  for (const auto & e : b) {
+    if (!e.isMatrix) {
+      LOG(INFO) << e.text;
+      continue;
+    }
+    // the same rows as KMatrix::mPrintf, with msg leading the first
+    string rowVals = e.text;
+    const char * fc = e.fs.c_str();
+    for (unsigned int i = 0; i < e.mat.numR(); i++) {
+      for (unsigned int j = 0; j < e.mat.numC(); j++) {
+        rowVals += getFormattedString(fc, e.mat(i, j));
+      }
+      LOG(INFO) << rowVals;
+      rowVals.clear();
+    }
+  }
+  return;
+}
+
+// Deliberately never deleted, so that threads ending during static
+// destruction can still hand over their buffers.
+struct LogSink {
+  std::mutex lock;
+  std::condition_variable ready;
+  std::condition_variable drained;
+  std::deque<LogBlock> queue = {};
+  std::thread writer;
+  bool async = false;
+  bool busy = false;
+  bool stop = false;
+  bool atExitSet = false;
+};
+
+LogSink & sink() {
+  static LogSink * s = new LogSink();
+  return *s;
+}
+
+void writerLoop() {
+  auto & s = sink();
+  std::unique_lock<std::mutex> lk(s.lock);
+  while (true) {
+    s.ready.wait(lk, [&s]() { return s.stop || !s.queue.empty(); });
+    if (s.queue.empty()) { // so stop is set, and everything has been written
+      break;
+    }
+    LogBlock b = std::move(s.queue.front());
+    s.queue.pop_front();
+    s.busy = true;
+    lk.unlock();
+    writeBlock(b);
+    lk.lock();
+    s.busy = false;
+    if (s.queue.empty()) {
+      s.drained.notify_all();
+    }
+  }
+  s.drained.notify_all();
+  return;
+}
+
+void stopWriter() {
+  auto & s = sink();
+  {
+    std::lock_guard<std::mutex> lk(s.lock);
+    if (!s.async) {
+      return;
+    }
+    s.stop = true;
+  }
+  s.ready.notify_all();
+  s.writer.join();
+  std::lock_guard<std::mutex> lk(s.lock);
+  s.async = false;
+  s.stop = false;
+  return;
+}
+
+void handOver(LogBlock & b) {
+  if (b.empty()) {
+    return;
+  }
+  auto & s = sink();
+  std::unique_lock<std::mutex> lk(s.lock);
+  if (s.async && !s.stop) {
+    s.queue.push_back(std::move(b));
+    lk.unlock();
+    s.ready.notify_one();
+  }
+  else {
+    writeBlock(b); // under the lock, so blocks do not interleave
+  }
+  b.clear();
+  return;
+}
+
+// Hands its lines over when the thread ends
+struct LogBuffer {
+  LogBlock entries = {};
+  ~LogBuffer() { handOver(entries); }
+};
+
+const unsigned int maxBuffered = 512;
+
+LogBlock & myBuffer() {
+  thread_local LogBuffer buf;
+  return buf.entries;
+}
+
+} // end of anonymous namespace
+
+// --------------------------------------------
+
+std::atomic<uint8_t> KLog::lvl(static_cast<uint8_t>(ReportingLevel::High));
+
+void KLog::setLevel(ReportingLevel rl) {
+  lvl.store(static_cast<uint8_t>(rl), std::memory_order_relaxed);
+}
+
+ReportingLevel KLog::level() {
+  return static_cast<ReportingLevel>(lvl.load(std::memory_order_relaxed));
+}
+
+void KLog::setAsync(bool a) {
+  if (!a) {
+    flushThread();
+    stopWriter();
+    return;
+  }
+  auto & s = sink();
+  std::lock_guard<std::mutex> lk(s.lock);
+  if (s.async) {
+    return;
+  }
+  s.async = true;
+  s.stop = false;
+  s.writer = std::thread(writerLoop);
+  // registered after easylogging is set up, so it runs before easylogging is torn down
+  if (!s.atExitSet) {
+    std::atexit(stopWriter);
+    s.atExitSet = true;
+  }
+  return;
+}
+
+void KLog::line(const string & s) {
+  auto & b = myBuffer();
+  LogEntry e;
+  e.text = s;
+  b.push_back(std::move(e));
+  if (maxBuffered <= b.size()) {
+    handOver(b);
+  }
+  return;
+}
+
+void KLog::matrix(const KMatrix & m, const string & fs, const string & msg) {
+  auto & b = myBuffer();
+  LogEntry e;
+  e.text = msg;
+  e.isMatrix = true;
+  e.mat = m;
+  e.fs = fs;
+  b.push_back(std::move(e));
+  if (maxBuffered <= b.size()) {
+    handOver(b);
+  }
+  return;
+}
+
+void KLog::flushThread() {
+  handOver(myBuffer());
+  return;
+}
+
+void KLog::flush() {
+  flushThread();
+  auto & s = sink();
+  std::unique_lock<std::mutex> lk(s.lock);
+  s.drained.wait(lk, [&s]() { return s.queue.empty() && !s.busy; });
+  return;
+}
+
+} // namespace KBase
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
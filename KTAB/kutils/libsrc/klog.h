@@ -0,0 +1,126 @@
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// --------------------------------------------
+//
+// Level-gated logging for hot loops. Writing
+//
+//   KLOG(ReportingLevel::Medium) << "turn " << t << ": actor " << i;
+//   KLOG_MATRIX(ReportingLevel::High, u, " %.5f ", "u_im:");
+//
+// evaluates nothing to the right of the level unless that level is both
+// compiled in (KTAB_LOG_LEVEL, the highest level kept, 0..4) and at or below
+// KLog::level(). Lines go to a per-thread buffer, and the matrix rows are only
+// formatted when the buffer is written out. A thread's buffer is handed to the
+// sink as one block when it fills, on KLog::flushThread(), or when the thread
+// ends, so its lines stay together without a lock. With KLog::setAsync(true) a
+// writer thread passes the blocks to easylogging, so workers never wait on it;
+// KLog::flush() waits for it to catch up. Unlike LOG(INFO), KLogLine puts no
+// spaces between the items streamed into it.
+// --------------------------------------------
+
+#ifndef KBASE_LOG_H
+#define KBASE_LOG_H
+
+#include <atomic>
+#include <sstream>
+#include <string>
+
+#include "kutils.h"
+#include "kmatrix.h"
+
+#ifndef KTAB_LOG_LEVEL
+#define KTAB_LOG_LEVEL 4
+#endif
+
+
+namespace KBase {
+
+using std::string;
+
+// ----------------------------------------------
+
+class KLog {
+public:
+  // the default, High, keeps everything the hot loops used to log unconditionally
+  static void setLevel(ReportingLevel rl);
+  static ReportingLevel level();
+  static bool on(ReportingLevel rl) {
+    return (static_cast<uint8_t>(rl) <= lvl.load(std::memory_order_relaxed));
+  }
+
+  // Switching from asynchronous to synchronous waits for the writer to finish
+  static void setAsync(bool a);
+
+  // add to this thread's buffer
+  static void line(const string & s);
+  static void matrix(const KMatrix & m, const string & fs, const string & msg = string());
+
+  // hand this thread's buffer to the sink, as one block
+  static void flushThread();
+
+  // flushThread, then wait until every block handed over has been written
+  static void flush();
+
+protected:
+
+private:
+  static std::atomic<uint8_t> lvl;
+};
+
+// One line, built by operator<< and handed to the buffer when it goes out of scope
+class KLogLine {
+public:
+  KLogLine() {}
+  ~KLogLine() { KLog::line(os.str()); }
+  KLogLine(const KLogLine &) = delete;
+  KLogLine & operator=(const KLogLine &) = delete;
+
+  template<typename T>
+  KLogLine & operator<<(const T & x) {
+    os << x;
+    return *this;
+  }
+
+private:
+  std::ostringstream os;
+};
+
+} // namespace KBase
+
+#define KLOG_ON(rl) ((static_cast<int>(rl) <= KTAB_LOG_LEVEL) && KBase::KLog::on(rl))
+
+// the empty if-branch keeps a following else from binding to this if
+#define KLOG(rl) \
+  if (!KLOG_ON(rl)) { } else KBase::KLogLine()
+
+#define KLOG_MATRIX(rl, ...) \
+  do { \
+    if (KLOG_ON(rl)) { \
+      KBase::KLog::matrix(__VA_ARGS__); \
+    } \
+  } while (false)
+
+// ----------------------------------------------
+#endif
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
@@ -36,6 +36,7 @@
 #include <vector>
 
 #include "kutils.h"
+#include "kmemory.h"
 
 namespace KBase {
 
@@ -95,6 +96,8 @@ KMatrix firstEigenvector( const KMatrix& A, double tol);
 class KMatrix {
     friend KMatrix  inv(const KMatrix & m);
 public:
+    // the elements count as MemCategory::Matrix
+    using Vals = vector<double, CountedAlloc<double, MemCategory::Matrix>>;
 
     KMatrix();
     KMatrix(unsigned int nr, unsigned int nc, double iv = 0.0);
@@ -137,22 +140,22 @@ public:
 
     // For those rare cases when we do not need explicit indices inside the loop,
     // the standard C++11 iterators are provided to support range-for
-    vector<double>::iterator begin() {
+    Vals::iterator begin() {
         return vals.begin();
     };
-    vector<double>::iterator end() {
+    Vals::iterator end() {
         return vals.end();
     };
-    vector<double>::const_iterator cbegin() {
+    Vals::const_iterator cbegin() {
         return vals.cbegin();
     };
-    vector<double>::const_iterator cend() {
+    Vals::const_iterator cend() {
         return vals.cend();
     };
-    vector<double>::const_iterator begin() const {
+    Vals::const_iterator begin() const {
         return vals.begin();
     };
-    vector<double>::const_iterator end() const {
+    Vals::const_iterator end() const {
         return vals.end();
     };
 
@@ -162,7 +165,7 @@ public:
 protected:
     unsigned int rows = 0;
     unsigned int clms = 0;
-    vector<double> vals = vector<double>();
+    Vals vals = Vals();
 
 private:
     void vFillVec(unsigned int nr, unsigned int nv, double iv);
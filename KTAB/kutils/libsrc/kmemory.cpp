@@ -0,0 +1,128 @@
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// --------------------------------------------
+
+
+
+#include <easylogging++.h>
+
+#include "kmemory.h"
+
+namespace KBase {
+// --------------------------------------------
+
+std::atomic<uint64_t> MemAccount::live[MemAccount::numCats] = {};
+std::atomic<uint64_t> MemAccount::peak[MemAccount::numCats] = {};
+std::atomic<uint64_t> MemAccount::budgetBytes(0);
+std::atomic<bool> MemAccount::reportOn(false);
+
+string memCategoryName(MemCategory c) {
+  string cn = "";
+  switch (c) {
+  case MemCategory::Matrix:
+    cn = "Matrix";
+    break;
+  case MemCategory::Position:
+    cn = "Position";
+    break;
+  case MemCategory::Bargain:
+    cn = "Bargain";
+    break;
+  case MemCategory::State:
+    cn = "State";
+    break;
+  default:
+    throw KException("memCategoryName: unrecognized MemCategory");
+    break;
+  }
+  return cn;
+}
+
+bool MemAccount::compiledIn() {
+#ifdef KTAB_MEMORY
+  return true;
+#else
+  return false;
+#endif
+}
+
+uint64_t MemAccount::liveBytes(MemCategory c) {
+  return live[static_cast<unsigned int>(c)].load(std::memory_order_relaxed);
+}
+
+uint64_t MemAccount::peakBytes(MemCategory c) {
+  return peak[static_cast<unsigned int>(c)].load(std::memory_order_relaxed);
+}
+
+uint64_t MemAccount::liveTotal() {
+  uint64_t t = 0;
+  for (unsigned int k = 0; k < numCats; k++) {
+    t += live[k].load(std::memory_order_relaxed);
+  }
+  return t;
+}
+
+void MemAccount::resetPeaks() {
+  for (unsigned int k = 0; k < numCats; k++) {
+    peak[k].store(live[k].load(std::memory_order_relaxed), std::memory_order_relaxed);
+  }
+}
+
+void MemAccount::setBudget(uint64_t bytes) {
+  budgetBytes.store(bytes, std::memory_order_relaxed);
+}
+
+uint64_t MemAccount::budget() {
+  return budgetBytes.load(std::memory_order_relaxed);
+}
+
+void MemAccount::setReport(bool r) {
+  reportOn.store(r, std::memory_order_relaxed);
+}
+
+bool MemAccount::report() {
+  return reportOn.load(std::memory_order_relaxed);
+}
+
+void MemAccount::logTable(const string & label) {
+  const double mb = 1024.0 * 1024.0;
+  const uint64_t b = budget();
+  if (0 < b) {
+    LOG(INFO) << getFormattedString("Memory %s: %.2f MB live of a %.2f MB budget",
+                                    label.c_str(), liveTotal() / mb, b / mb);
+  }
+  else {
+    LOG(INFO) << getFormattedString("Memory %s: %.2f MB live", label.c_str(), liveTotal() / mb);
+  }
+  LOG(INFO) << getFormattedString("  %-10s %12s %12s", "category", "live MB", "peak MB");
+  for (unsigned int k = 0; k < numCats; k++) {
+    const auto c = static_cast<MemCategory>(k);
+    LOG(INFO) << getFormattedString("  %-10s %12.3f %12.3f", memCategoryName(c).c_str(),
+                                    liveBytes(c) / mb, peakBytes(c) / mb);
+  }
+  return;
+}
+
+} // namespace KBase
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
@@ -0,0 +1,165 @@
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// --------------------------------------------
+//
+// Allocation accounting by category. KMatrix elements go through CountedAlloc,
+// and Position, State and bargain objects inherit class-level new/delete from
+// MemCounted, so each category keeps a count of its live bytes and their peak.
+// Only heap objects are counted: a position held by value inside a bargain
+// counts as part of the bargain, though its elements count as Matrix.
+//
+// Counting is compiled in only when KTAB_MEMORY is defined (the
+// ENABLE_MEMORY_ACCOUNTING CMake option), which must then be the same for
+// every library and program, so that what one allocates another can free.
+// Without it every count reads zero and nothing costs anything.
+// The counts are process-wide: models run at once are summed together.
+// --------------------------------------------
+
+#ifndef KBASE_MEMORY_H
+#define KBASE_MEMORY_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <string>
+
+#include "kutils.h"
+
+
+namespace KBase {
+
+using std::string;
+
+// ----------------------------------------------
+
+enum class MemCategory : uint8_t { Matrix = 0, Position, Bargain, State, NumCategories };
+
+string memCategoryName(MemCategory c);
+
+class MemAccount {
+public:
+  static bool compiledIn();
+
+  static void add(MemCategory c, size_t bytes) {
+#ifdef KTAB_MEMORY
+    const unsigned int k = static_cast<unsigned int>(c);
+    const uint64_t now = live[k].fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    uint64_t pk = peak[k].load(std::memory_order_relaxed);
+    while ((pk < now) && !peak[k].compare_exchange_weak(pk, now, std::memory_order_relaxed)) {
+      // pk was reloaded, so try again
+    }
+#endif
+    return;
+  }
+
+  static void sub(MemCategory c, size_t bytes) {
+#ifdef KTAB_MEMORY
+    live[static_cast<unsigned int>(c)].fetch_sub(bytes, std::memory_order_relaxed);
+#endif
+    return;
+  }
+
+  static uint64_t liveBytes(MemCategory c);
+  static uint64_t peakBytes(MemCategory c);
+  static uint64_t liveTotal();
+
+  // restart each peak at its current live count
+  static void resetPeaks();
+
+  // 0 means no budget
+  static void setBudget(uint64_t bytes);
+  static uint64_t budget();
+
+  // whether Model::run logs a memory table after every turn
+  static void setReport(bool r);
+  static bool report();
+
+  // Log one row per category, headed by label
+  static void logTable(const string & label);
+
+private:
+  static const unsigned int numCats = static_cast<unsigned int>(MemCategory::NumCategories);
+  static std::atomic<uint64_t> live[numCats];
+  static std::atomic<uint64_t> peak[numCats];
+  static std::atomic<uint64_t> budgetBytes;
+  static std::atomic<bool> reportOn;
+};
+
+// An allocator which counts what it holds under category C
+template <typename T, MemCategory C>
+class CountedAlloc {
+public:
+  using value_type = T;
+
+  template <typename U>
+  struct rebind {
+    using other = CountedAlloc<U, C>;
+  };
+
+  CountedAlloc() noexcept {}
+  template <typename U>
+  CountedAlloc(const CountedAlloc<U, C> &) noexcept {}
+
+  T* allocate(size_t n) {
+    T* p = std::allocator<T>().allocate(n);
+    MemAccount::add(C, n * sizeof(T));
+    return p;
+  }
+  void deallocate(T* p, size_t n) noexcept {
+    MemAccount::sub(C, n * sizeof(T));
+    std::allocator<T>().deallocate(p, n);
+  }
+
+  // friends, so that they do not hide other operators declared outside KBase
+  friend bool operator==(const CountedAlloc &, const CountedAlloc &) {
+    return true;
+  }
+  friend bool operator!=(const CountedAlloc &, const CountedAlloc &) {
+    return false;
+  }
+};
+
+// A base class whose heap instances, including those of its sub-classes, count under C.
+// The sized delete gets the size of the most-derived class only through a virtual destructor.
+template <MemCategory C>
+class MemCounted {
+public:
+  static void* operator new(size_t n) {
+    void* p = ::operator new(n);
+    MemAccount::add(C, n);
+    return p;
+  }
+  static void operator delete(void* p, size_t n) {
+    MemAccount::sub(C, n);
+    ::operator delete(p);
+  }
+};
+
+} // namespace KBase
+
+// ----------------------------------------------
+#endif
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
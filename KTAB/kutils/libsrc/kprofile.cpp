@@ -0,0 +1,243 @@
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// --------------------------------------------
+
+
+
+#include <fstream>
+#include <mutex>
+
+#include <easylogging++.h>
+
+#include "kprofile.h"
+
+namespace KBase {
+// --------------------------------------------
+
+namespace {
+
+struct ProfileSlab {
+  std::atomic<uint64_t> calls[Profiler::maxIDs];
+  std::atomic<uint64_t> nanos[Profiler::maxIDs];
+  ProfileSlab() {
+    for (unsigned int i = 0; i < Profiler::maxIDs; i++) {
+      calls[i].store(0, std::memory_order_relaxed);
+      nanos[i].store(0, std::memory_order_relaxed);
+    }
+  }
+};
+
+// Deliberately never deleted, so that threads ending during static
+// destruction can still fold their slabs into it.
+struct ProfileRegistry {
+  std::mutex lock;
+  vector<string> names = {};
+  vector<bool> timers = {};
+  vector<ProfileSlab*> live = {};
+  ProfileTotals retired = {};
+  string jsonFile = "";
+};
+
+ProfileRegistry & registry() {
+  static ProfileRegistry * reg = new ProfileRegistry();
+  return *reg;
+}
+
+// Owns this thread's slab, and retires it when the thread ends
+struct SlabOwner {
+  ProfileSlab * slab = nullptr;
+  SlabOwner() {
+    slab = new ProfileSlab();
+    auto & reg = registry();
+    std::lock_guard<std::mutex> guard(reg.lock);
+    reg.live.push_back(slab);
+  }
+  ~SlabOwner() {
+    auto & reg = registry();
+    std::lock_guard<std::mutex> guard(reg.lock);
+    for (unsigned int i = 0; i < Profiler::maxIDs; i++) {
+      reg.retired.calls[i] += slab->calls[i].load(std::memory_order_relaxed);
+      reg.retired.nanos[i] += slab->nanos[i].load(std::memory_order_relaxed);
+    }
+    reg.live.erase(std::remove(reg.live.begin(), reg.live.end(), slab), reg.live.end());
+    delete slab;
+    slab = nullptr;
+  }
+};
+
+ProfileSlab & mySlab() {
+  thread_local SlabOwner owner;
+  return *(owner.slab);
+}
+
+string jsonEscape(const string & s) {
+  string r = "";
+  for (char c : s) {
+    if (('"' == c) || ('\\' == c)) {
+      r.push_back('\\');
+    }
+    r.push_back(c);
+  }
+  return r;
+}
+
+} // end of anonymous namespace
+
+// --------------------------------------------
+
+std::atomic<bool> Profiler::on(false);
+
+ProfileTotals ProfileTotals::operator-(const ProfileTotals & b) const {
+  ProfileTotals d = *this;
+  for (unsigned int i = 0; (i < d.calls.size()) && (i < b.calls.size()); i++) {
+    d.calls[i] -= b.calls[i];
+    d.nanos[i] -= b.nanos[i];
+  }
+  return d;
+}
+
+void Profiler::enable(bool b) {
+  on.store(b, std::memory_order_relaxed);
+}
+
+unsigned int Profiler::id(const string & name, bool timer) {
+  auto & reg = registry();
+  std::lock_guard<std::mutex> guard(reg.lock);
+  for (unsigned int i = 0; i < reg.names.size(); i++) {
+    if (name == reg.names[i]) {
+      if (timer != reg.timers[i]) {
+        throw KException("Profiler::id: " + name + " registered as both timer and counter");
+      }
+      return i;
+    }
+  }
+  if (maxIDs <= reg.names.size()) {
+    throw KException("Profiler::id: too many phases and counters");
+  }
+  if (reg.retired.calls.size() < maxIDs) {
+    reg.retired.calls.resize(maxIDs, 0);
+    reg.retired.nanos.resize(maxIDs, 0);
+  }
+  reg.names.push_back(name);
+  reg.timers.push_back(timer);
+  return ((unsigned int)reg.names.size()) - 1;
+}
+
+string Profiler::name(unsigned int i) {
+  auto & reg = registry();
+  std::lock_guard<std::mutex> guard(reg.lock);
+  return (i < reg.names.size()) ? reg.names[i] : "";
+}
+
+bool Profiler::isTimer(unsigned int i) {
+  auto & reg = registry();
+  std::lock_guard<std::mutex> guard(reg.lock);
+  return (i < reg.timers.size()) ? reg.timers[i] : false;
+}
+
+void Profiler::addTime(unsigned int i, uint64_t ns) {
+  auto & s = mySlab();
+  s.calls[i].fetch_add(1, std::memory_order_relaxed);
+  s.nanos[i].fetch_add(ns, std::memory_order_relaxed);
+}
+
+void Profiler::addCount(unsigned int i, uint64_t n) {
+  mySlab().calls[i].fetch_add(n, std::memory_order_relaxed);
+}
+
+ProfileTotals Profiler::totals() {
+  auto & reg = registry();
+  std::lock_guard<std::mutex> guard(reg.lock);
+  const unsigned int n = reg.names.size();
+  ProfileTotals t;
+  t.calls = vector<uint64_t>(n, 0);
+  t.nanos = vector<uint64_t>(n, 0);
+  for (unsigned int i = 0; i < n; i++) {
+    t.calls[i] = reg.retired.calls[i];
+    t.nanos[i] = reg.retired.nanos[i];
+    for (auto s : reg.live) {
+      t.calls[i] += s->calls[i].load(std::memory_order_relaxed);
+      t.nanos[i] += s->nanos[i].load(std::memory_order_relaxed);
+    }
+  }
+  return t;
+}
+
+void Profiler::setJSONFile(const string & fName) {
+  auto & reg = registry();
+  std::lock_guard<std::mutex> guard(reg.lock);
+  reg.jsonFile = fName;
+}
+
+void Profiler::report(const string & label, double wallSecs, const ProfileTotals & d) {
+  vector<string> names = {};
+  vector<bool> timers = {};
+  string jsonFile = "";
+  {
+    auto & reg = registry();
+    std::lock_guard<std::mutex> guard(reg.lock);
+    names = reg.names;
+    timers = reg.timers;
+    jsonFile = reg.jsonFile;
+  }
+
+  LOG(INFO) << getFormattedString("Profile of %s, %.4f sec wall clock", label.c_str(), wallSecs);
+  LOG(INFO) << getFormattedString("  %-36s %10s %10s %10s", "phase", "calls", "sec", "ms/call");
+  string jPhases = "";
+  string jCounts = "";
+  for (unsigned int i = 0; (i < d.calls.size()) && (i < names.size()); i++) {
+    if (0 == d.calls[i]) {
+      continue;
+    }
+    if (timers[i]) {
+      const double secs = d.nanos[i] / 1.0E9;
+      LOG(INFO) << getFormattedString("  %-36s %10llu %10.4f %10.4f", names[i].c_str(),
+                                      (unsigned long long)d.calls[i], secs, (1000.0 * secs) / d.calls[i]);
+      jPhases += getFormattedString("%s{\"name\":\"%s\",\"calls\":%llu,\"secs\":%.6f}",
+                                    (jPhases.empty() ? "" : ","), jsonEscape(names[i]).c_str(),
+                                    (unsigned long long)d.calls[i], secs);
+    }
+  }
+  for (unsigned int i = 0; (i < d.calls.size()) && (i < names.size()); i++) {
+    if ((0 == d.calls[i]) || timers[i]) {
+      continue;
+    }
+    LOG(INFO) << getFormattedString("  %-36s %10llu", names[i].c_str(), (unsigned long long)d.calls[i]);
+    jCounts += getFormattedString("%s\"%s\":%llu", (jCounts.empty() ? "" : ","),
+                                  jsonEscape(names[i]).c_str(), (unsigned long long)d.calls[i]);
+  }
+
+  if (!jsonFile.empty()) {
+    std::ofstream out(jsonFile, std::ios::app);
+    if (!out) {
+      throw KException("Profiler::report: could not open " + jsonFile);
+    }
+    out << getFormattedString("{\"label\":\"%s\",\"wallSecs\":%.6f,\"phases\":[", jsonEscape(label).c_str(), wallSecs)
+        << jPhases << "],\"counters\":{" << jCounts << "}}" << std::endl;
+  }
+  return;
+}
+
+} // namespace KBase
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
@@ -0,0 +1,149 @@
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// --------------------------------------------
+//
+// Phase timers and event counters. A phase is timed by declaring
+//
+//   KTAB_PROFILE_PHASE("SMPState::doBCN");
+//
+// at the top of a scope, and an event counted with
+//
+//   KTAB_PROFILE_COUNT("SMPState::probEduChlg", 1);
+//
+// Both compile to nothing unless KTAB_PROFILE is defined (the ENABLE_PROFILE
+// CMake option), and cost one relaxed load unless Profiler::enable(true) has
+// been called. Each thread adds into its own slab of counters, which is folded
+// into the retired totals when the thread ends, so timing worker threads takes
+// no lock. Phases may nest, so their times need not add up to the turn. The
+// totals are process-wide: models run at once are summed together.
+// --------------------------------------------
+
+#ifndef KBASE_PROFILE_H
+#define KBASE_PROFILE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "kutils.h"
+
+
+namespace KBase {
+
+using std::string;
+using std::vector;
+
+// ----------------------------------------------
+
+// Totals of every phase and counter, indexed by the id from Profiler::id.
+// For a counter, calls is the count and nanos stays zero.
+struct ProfileTotals {
+public:
+  vector<uint64_t> calls = {};
+  vector<uint64_t> nanos = {};
+
+  // the change from an earlier snapshot b
+  ProfileTotals operator-(const ProfileTotals & b) const;
+};
+
+class Profiler {
+public:
+  static void enable(bool on);
+  static bool enabled() { return on.load(std::memory_order_relaxed); }
+
+  // Register a phase or counter by name, once, and return its id.
+  // Registering a name again returns the same id.
+  static unsigned int id(const string & name, bool timer);
+  static string name(unsigned int i);
+  static bool isTimer(unsigned int i);
+
+  // add to this thread's slab
+  static void addTime(unsigned int i, uint64_t ns);
+  static void addCount(unsigned int i, uint64_t n);
+
+  // everything so far, summed over the live threads and those which have ended
+  static ProfileTotals totals();
+
+  // Log d as a table, headed by label and the wall-clock seconds it covers, and
+  // append it as one line of JSON to the file set by setJSONFile, if any.
+  static void report(const string & label, double wallSecs, const ProfileTotals & d);
+  static void setJSONFile(const string & fName);
+
+  static const unsigned int maxIDs = 256;
+
+protected:
+
+private:
+  static std::atomic<bool> on;
+};
+
+// Times its own lifetime into phase pid, if the profiler was on when it started
+class ScopedTimer {
+public:
+  explicit ScopedTimer(unsigned int pid) : phase(pid), active(Profiler::enabled()) {
+    if (active) {
+      t0 = std::chrono::steady_clock::now();
+    }
+  }
+  ~ScopedTimer() {
+    if (active) {
+      const auto dt = std::chrono::steady_clock::now() - t0;
+      Profiler::addTime(phase, std::chrono::duration_cast<std::chrono::nanoseconds>(dt).count());
+    }
+  }
+  ScopedTimer(const ScopedTimer &) = delete;
+  ScopedTimer & operator=(const ScopedTimer &) = delete;
+
+private:
+  unsigned int phase = 0;
+  bool active = false;
+  std::chrono::steady_clock::time_point t0 = {};
+};
+
+} // namespace KBase
+
+#define KTAB_PROFILE_CAT2(a, b) a##b
+#define KTAB_PROFILE_CAT(a, b) KTAB_PROFILE_CAT2(a, b)
+
+#ifdef KTAB_PROFILE
+#define KTAB_PROFILE_PHASE(pname) \
+  static const unsigned int KTAB_PROFILE_CAT(ktabPhaseID_, __LINE__) = KBase::Profiler::id(pname, true); \
+  KBase::ScopedTimer KTAB_PROFILE_CAT(ktabPhaseTimer_, __LINE__)(KTAB_PROFILE_CAT(ktabPhaseID_, __LINE__))
+#define KTAB_PROFILE_COUNT(cname, n) \
+  do { \
+    if (KBase::Profiler::enabled()) { \
+      static const unsigned int ktabCountID = KBase::Profiler::id(cname, false); \
+      KBase::Profiler::addCount(ktabCountID, n); \
+    } \
+  } while (false)
+#else
+#define KTAB_PROFILE_PHASE(pname) do { } while (false)
+#define KTAB_PROFILE_COUNT(cname, n) do { } while (false)
+#endif
+
+// ----------------------------------------------
+#endif
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
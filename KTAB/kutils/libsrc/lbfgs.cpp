@@ -0,0 +1,242 @@
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// --------------------------------------------
+
+
+#include "kutils.h"
+#include "lbfgs.h"
+#include <cmath>
+#include <easylogging++.h>
+
+namespace KBase {
+using std::tuple;
+using std::get;
+// --------------------------------------------
+
+LBFGSearch::LBFGSearch() {
+  eval = nullptr;
+  report = nullptr;
+}
+
+LBFGSearch::~LBFGSearch() {
+  // nothing yet
+}
+
+KMatrix LBFGSearch::project(const KMatrix & p) const {
+  auto q = p;
+  for (unsigned int i = 0; i < q.numR(); i++) {
+    if ((0 < lower.numR()) && (q(i, 0) < lower(i, 0))) {
+      q(i, 0) = lower(i, 0);
+    }
+    if ((0 < upper.numR()) && (q(i, 0) > upper(i, 0))) {
+      q(i, 0) = upper(i, 0);
+    }
+  }
+  return q;
+}
+
+tuple<double, KMatrix, unsigned int>
+LBFGSearch::run(KMatrix p0, unsigned int iMax, double gTol, double fTol, ReportingLevel rl) {
+  if (eval == nullptr) {
+    throw KException("LBFGSearch::run: eval is a null pointer");
+  }
+  if (1 != p0.numC()) {
+    throw KException("LBFGSearch::run: p0 must be a column vector");
+  }
+  const unsigned int n = p0.numR();
+  if (((0 < lower.numR()) && !sameShape(lower, p0)) || ((0 < upper.numR()) && !sameShape(upper, p0))) {
+    throw KException("LBFGSearch::run: bounds must have the same shape as p0");
+  }
+  if ((0 < lower.numR()) && (0 < upper.numR())) {
+    for (unsigned int i = 0; i < n; i++) {
+      if (lower(i, 0) > upper(i, 0)) {
+        throw KException("LBFGSearch::run: lower bound exceeds upper bound");
+      }
+    }
+  }
+  if (0 == memory) {
+    throw KException("LBFGSearch::run: memory must be positive");
+  }
+
+  const double c1 = 1E-4; // sufficient decrease, for the Armijo test
+  const unsigned int lsMax = 40;
+
+  auto atLower = [this](const KMatrix & p, unsigned int i) {
+    return (0 < lower.numR()) && (p(i, 0) <= lower(i, 0));
+  };
+  auto atUpper = [this](const KMatrix & p, unsigned int i) {
+    return (0 < upper.numR()) && (p(i, 0) >= upper(i, 0));
+  };
+
+  auto p = project(p0);
+  auto g = KMatrix(n, 1);
+  double v = eval(p, g);
+
+  auto sHist = vector<KMatrix>();
+  auto yHist = vector<KMatrix>();
+
+  auto showFn = [this](string preface, const KMatrix & pt, double val) {
+    LOG(INFO) << preface << "point:";
+    trans(pt).mPrintf(" %+0.4f ");
+    LOG(INFO) << getFormattedString("%s value: %+.6f", preface.c_str(), val);
+    if (nullptr != report) {
+      report(pt);
+    }
+    return;
+  };
+
+  if (ReportingLevel::Low <= rl) {
+    showFn("Initial", p, v);
+  }
+
+  unsigned int iter = 0;
+  while (iter < iMax) {
+    // Variables pressed against a bound by the gradient stay there this step
+    auto free = vector<bool>(n, true);
+    double pgMax = 0.0;
+    for (unsigned int i = 0; i < n; i++) {
+      if ((atLower(p, i) && (0.0 < g(i, 0))) || (atUpper(p, i) && (g(i, 0) < 0.0))) {
+        free[i] = false;
+      }
+      else {
+        const double gi = fabs(g(i, 0));
+        pgMax = (gi > pgMax) ? gi : pgMax;
+      }
+    }
+    if (pgMax < gTol) {
+      break;
+    }
+    auto mask = [&free, n](const KMatrix & m) {
+      auto r = m;
+      for (unsigned int i = 0; i < n; i++) {
+        if (!free[i]) {
+          r(i, 0) = 0.0;
+        }
+      }
+      return r;
+    };
+
+    // two-loop recursion for -H*g, over the free variables
+    const unsigned int m = sHist.size();
+    auto q = mask(g);
+    auto alpha = vector<double>(m, 0.0);
+    for (unsigned int k = m; 0 < k; k--) {
+      const auto & s = sHist[k - 1];
+      const auto & y = yHist[k - 1];
+      const double sy = dot(mask(s), mask(y));
+      if (0.0 < sy) {
+        alpha[k - 1] = dot(mask(s), q) / sy;
+        q = q - alpha[k - 1] * mask(y);
+      }
+    }
+    if (0 < m) {
+      const auto s = mask(sHist[m - 1]);
+      const auto y = mask(yHist[m - 1]);
+      const double yy = dot(y, y);
+      if (0.0 < yy) {
+        q = (dot(s, y) / yy) * q;
+      }
+    }
+    else {
+      // first step: unit length in the largest component
+      q = q / pgMax;
+    }
+    for (unsigned int k = 0; k < m; k++) {
+      const auto & s = sHist[k];
+      const auto & y = yHist[k];
+      const double sy = dot(mask(s), mask(y));
+      if (0.0 < sy) {
+        const double beta = dot(mask(y), q) / sy;
+        q = q + (alpha[k] - beta) * mask(s);
+      }
+    }
+    auto d = -1.0 * mask(q);
+    double dg = dot(d, g);
+    if (0.0 <= dg) { // not a descent direction, so forget the curvature history
+      sHist.clear();
+      yHist.clear();
+      d = (-1.0 / pgMax) * mask(g);
+      dg = dot(d, g);
+    }
+
+    // backtracking line search along the projected path
+    double t = 1.0;
+    auto p1 = p;
+    auto g1 = KMatrix(n, 1);
+    double v1 = v;
+    bool accepted = false;
+    for (unsigned int ls = 0; ls < lsMax; ls++) {
+      p1 = project(p + t * d);
+      v1 = eval(p1, g1);
+      if (std::isfinite(v1) && (v1 <= v + c1 * dot(g, p1 - p))) {
+        accepted = true;
+        break;
+      }
+      t = t / 2.0;
+    }
+    iter++;
+    if (!accepted) {
+      if (ReportingLevel::Low <= rl) {
+        LOG(INFO) << "LBFGSearch::run: line search failed after " << iter << " iterations";
+      }
+      break;
+    }
+
+    const auto s = p1 - p;
+    const auto y = g1 - g;
+    if (dot(s, y) > 1E-12 * dot(y, y)) { // keep only pairs with positive curvature
+      sHist.push_back(s);
+      yHist.push_back(y);
+      if (sHist.size() > memory) {
+        sHist.erase(sHist.begin());
+        yHist.erase(yHist.begin());
+      }
+    }
+
+    const double dv = v - v1;
+    p = p1;
+    g = g1;
+    v = v1;
+
+    if (ReportingLevel::Medium <= rl) {
+      LOG(INFO) << getFormattedString("After L-BFGS iteration %u, step %.3E", iter, t);
+      showFn("Best current", p, v);
+    }
+
+    if (dv <= fTol * (fabs(v) + fTol)) {
+      break;
+    }
+  }
+
+  tuple<double, KMatrix, unsigned int> rslt { v, p, iter };
+
+  if (ReportingLevel::Low <= rl) {
+    showFn("Final", p, v);
+  }
+  return rslt;
+}
+
+} // namespace KBase
+
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
@@ -0,0 +1,86 @@
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// --------------------------------------------
+
+
+#ifndef KBASE_LBFGS_H
+#define KBASE_LBFGS_H
+
+#include <functional>   // function
+#include <tuple>        // tuple, get, etc.
+#include <vector>
+
+#include "kutils.h"
+#include "kmatrix.h"
+
+
+namespace KBase {
+
+using std::function;
+using std::tuple;
+
+// ----------------------------------------------
+
+// Minimize a smooth scalar function of a column-vector, within simple bounds,
+// by limited-memory BFGS. Unlike VHCSearch, this needs the gradient, but
+// typically converges in dozens of evaluations rather than thousands.
+//
+// Bounds are handled by projection: variables held at a bound by the gradient
+// are frozen for the step, the quasi-Newton direction is taken over the
+// free variables, and the line search projects each trial point back into
+// the box. This is the simple projected variant, not the full L-BFGS-B with
+// its generalized Cauchy point and subspace minimization.
+class LBFGSearch {
+public:
+  explicit LBFGSearch();
+  virtual ~LBFGSearch();
+
+  // minimize eval from p0, which is first moved into the box.
+  // Returns the best value, the best point, and the iteration count.
+  // Stops when the largest component of the projected gradient is below gTol,
+  // or when an iteration reduces the value by less than fTol (relatively).
+  tuple<double, KMatrix, unsigned int>
+  run(KMatrix p0, unsigned int iMax, double gTol, double fTol, ReportingLevel rl);
+
+  // value of the function, with its gradient (same shape as the point) in g
+  function <double(const KMatrix & p, KMatrix & g)> eval = nullptr;
+  function <void(const KMatrix &)> report = nullptr;
+
+  // column vectors, or empty (0x0) for no bound on that side
+  KMatrix lower = KMatrix();
+  KMatrix upper = KMatrix();
+
+  unsigned int memory = 7; // number of (s, y) pairs kept
+
+protected:
+  KMatrix project(const KMatrix & p) const;
+
+private:
+};
+
+} // namespace KBase
+
+// ----------------------------------------------
+#endif
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
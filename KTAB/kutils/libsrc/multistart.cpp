@@ -0,0 +1,152 @@
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// --------------------------------------------
+
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <easylogging++.h>
+
+#include "kutils.h"
+#include "multistart.h"
+
+namespace KBase {
+using std::tuple;
+using std::get;
+// --------------------------------------------
+
+MultiStart::MultiStart() {
+  eval = nullptr;
+  sample = nullptr;
+  search = nullptr;
+}
+
+MultiStart::~MultiStart() {
+  // nothing yet
+}
+
+vector<MSResult> MultiStart::run(unsigned int numStarts, uint64_t seed,
+                                 unsigned int bestK, double dupTol, ReportingLevel rl) {
+  using std::chrono::steady_clock;
+  using std::chrono::duration;
+
+  if (eval == nullptr) {
+    throw KException("MultiStart::run: eval is a null pointer");
+  }
+  if (sample == nullptr) {
+    throw KException("MultiStart::run: sample is a null pointer");
+  }
+  if (search == nullptr) {
+    throw KException("MultiStart::run: search is a null pointer");
+  }
+  if (0 == numStarts) {
+    throw KException("MultiStart::run: numStarts must be positive");
+  }
+
+  // Seeds are drawn up front, in start order, from one master stream
+  auto master = PRNG(seed);
+  auto seeds = vector<uint64_t>();
+  for (unsigned int i = 0; i < numStarts; i++) {
+    seeds.push_back(master.uniform());
+  }
+
+  const auto tStart = steady_clock::now();
+  auto rslts = vector<MSResult>(numStarts);
+  auto errs = vector<std::exception_ptr>(numStarts, nullptr);
+  auto sFn = [this, &seeds, &rslts, &errs](unsigned int i) {
+    try {
+      const auto t0 = steady_clock::now();
+      auto rng = PRNG(seeds[i]);
+      const KMatrix p0 = sample(i, &rng);
+      auto sr = search(p0, &rng);
+      MSResult & r = rslts[i];
+      r.point = get<0>(sr);
+      r.iter = get<1>(sr);
+      r.value = eval(r.point);
+      r.start = i;
+      r.hits = 1;
+      r.seconds = duration<double>(steady_clock::now() - t0).count();
+    }
+    catch (...) {
+      errs[i] = std::current_exception();
+    }
+  };
+  groupThreads(sFn, 0, numStarts - 1, numPar);
+  for (auto & e : errs) {
+    if (nullptr != e) {
+      std::rethrow_exception(e);
+    }
+  }
+  const double wallSecs = duration<double>(steady_clock::now() - tStart).count();
+
+  // best first; ties go to the earlier start
+  std::stable_sort(rslts.begin(), rslts.end(),
+                   [](const MSResult & a, const MSResult & b) {
+    return a.value < b.value;
+  });
+
+  // merge each point into the first better optimum it is close to
+  auto optima = vector<MSResult>();
+  for (const auto & r : rslts) {
+    bool dup = false;
+    for (auto & o : optima) {
+      if (sameShape(o.point, r.point) && (maxAbs(o.point - r.point) <= dupTol)) {
+        o.hits = o.hits + 1;
+        dup = true;
+        break;
+      }
+    }
+    if (!dup) {
+      optima.push_back(r);
+    }
+  }
+  if (optima.size() > bestK) {
+    optima.resize(bestK);
+  }
+
+  if (ReportingLevel::Silent < rl) {
+    double cpuSecs = 0.0;
+    for (const auto & r : rslts) {
+      cpuSecs = cpuSecs + r.seconds;
+    }
+    LOG(INFO) << getFormattedString(
+      "MultiStart: %u starts in %.3f sec (%.3f sec summed over starts)",
+      numStarts, wallSecs, cpuSecs);
+    for (unsigned int k = 0; k < optima.size(); k++) {
+      const auto & o = optima[k];
+      LOG(INFO) << getFormattedString(
+        "  %2u: value %+.6f, reached by %u starts, best from start %u (%u iter, %.3f sec)",
+        k, o.value, o.hits, o.start, o.iter, o.seconds);
+      if (ReportingLevel::Low < rl) {
+        trans(o.point).mPrintf(" %+.4f ");
+      }
+    }
+  }
+  return optima;
+}
+
+} // namespace KBase
+
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
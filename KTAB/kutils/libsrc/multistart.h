@@ -0,0 +1,89 @@
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// --------------------------------------------
+
+
+#ifndef KBASE_MULTISTART_H
+#define KBASE_MULTISTART_H
+
+#include <functional>   // function
+#include <tuple>        // tuple, get, etc.
+#include <vector>
+
+#include "kutils.h"
+#include "kmatrix.h"
+#include "prng.h"
+
+
+namespace KBase {
+
+using std::function;
+using std::tuple;
+
+// ----------------------------------------------
+
+// One converged point from MultiStart, with how it was found.
+struct MSResult {
+  double value = 0.0;
+  KMatrix point = KMatrix();
+  unsigned int start = 0; // index of the best start which reached it
+  unsigned int iter = 0;  // iterations that start took
+  unsigned int hits = 0;  // number of starts which converged here
+  double seconds = 0.0;   // time that start took
+};
+
+// Minimize a non-convex function of a column-vector by running a local
+// search from many starting points concurrently, and keeping the distinct
+// optima. Each start gets its own PRNG, seeded from the master seed and the
+// start index alone, so results do not depend on thread scheduling.
+class MultiStart {
+public:
+  explicit MultiStart();
+  virtual ~MultiStart();
+
+  // Returns up to bestK distinct optima, best first. Two converged points are
+  // the same optimum if no component differs by more than dupTol.
+  vector<MSResult> run(unsigned int numStarts, uint64_t seed,
+                       unsigned int bestK, double dupTol, ReportingLevel rl);
+
+  function <double(const KMatrix &)> eval = nullptr; // minimize this function
+
+  // the starting point for start i
+  function <KMatrix(unsigned int i, PRNG * rng)> sample = nullptr;
+
+  // local search from p0, returning the point reached and the iterations used
+  function <tuple<KMatrix, unsigned int>(const KMatrix & p0, PRNG * rng)> search = nullptr;
+
+  unsigned int numPar = 0; // starts run at once; 0 lets groupThreads decide
+
+protected:
+
+private:
+};
+
+} // namespace KBase
+
+// ----------------------------------------------
+#endif
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
@@ -0,0 +1,245 @@
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// --------------------------------------------
+
+
+#include <algorithm>
+#include <cmath>
+
+#include "onlinestats.h"
+
+namespace KBase {
+// --------------------------------------------
+
+P2Quantile::P2Quantile(double p) {
+  if ((p < 0.0) || (1.0 < p)) {
+    throw KException("P2Quantile::P2Quantile: probability must be in [0,1]");
+  }
+  pq = p;
+  dn[0] = 0.0;
+  dn[1] = p / 2.0;
+  dn[2] = p;
+  dn[3] = (1.0 + p) / 2.0;
+  dn[4] = 1.0;
+  for (unsigned int i = 0; i < 5; i++) {
+    np[i] = 4.0 * dn[i];
+  }
+}
+
+P2Quantile::~P2Quantile() {
+  // nothing yet
+}
+
+void P2Quantile::add(double x) {
+  // the first five values are simply kept, in order
+  if (count < 5) {
+    q[count] = x;
+    count = count + 1;
+    if (5 == count) {
+      std::sort(q, q + 5);
+    }
+    return;
+  }
+  count = count + 1;
+
+  // find the cell k holding x, stretching the end markers if need be
+  unsigned int k = 0;
+  if (x < q[0]) {
+    q[0] = x;
+    k = 0;
+  }
+  else if (q[4] <= x) {
+    q[4] = x;
+    k = 3;
+  }
+  else {
+    k = 0;
+    while (q[k + 1] <= x) {
+      k++;
+    }
+  }
+  for (unsigned int i = k + 1; i < 5; i++) {
+    n[i] = n[i] + 1.0;
+  }
+  for (unsigned int i = 0; i < 5; i++) {
+    np[i] = np[i] + dn[i];
+  }
+
+  // move the three middle markers toward their desired positions
+  for (unsigned int i = 1; i < 4; i++) {
+    const double d = np[i] - n[i];
+    if (((1.0 <= d) && (1.0 < n[i + 1] - n[i])) || ((d <= -1.0) && (n[i - 1] - n[i] < -1.0))) {
+      const double s = (0.0 < d) ? 1.0 : -1.0;
+      // piecewise-parabolic prediction, falling back to linear if it breaks the order
+      const double qp = q[i] + (s / (n[i + 1] - n[i - 1])) *
+                        ((n[i] - n[i - 1] + s) * (q[i + 1] - q[i]) / (n[i + 1] - n[i]) +
+                         (n[i + 1] - n[i] - s) * (q[i] - q[i - 1]) / (n[i] - n[i - 1]));
+      if ((q[i - 1] < qp) && (qp < q[i + 1])) {
+        q[i] = qp;
+      }
+      else {
+        const unsigned int j = (0.0 < s) ? i + 1 : i - 1;
+        q[i] = q[i] + s * (q[j] - q[i]) / (n[j] - n[i]);
+      }
+      n[i] = n[i] + s;
+    }
+  }
+  return;
+}
+
+void P2Quantile::merge(const P2Quantile & pq2) {
+  if (pq != pq2.pq) {
+    throw KException("P2Quantile::merge: quantile probabilities differ");
+  }
+  if (pq2.count < 5) { // just replay the few stored values
+    for (unsigned int i = 0; i < pq2.count; i++) {
+      add(pq2.q[i]);
+    }
+    return;
+  }
+  if (count < 5) {
+    P2Quantile c = pq2;
+    for (unsigned int i = 0; i < count; i++) {
+      c.add(q[i]);
+    }
+    *this = c;
+    return;
+  }
+
+  // both are past start-up: weight the marker heights by count,
+  // and rebuild the positions for the combined count
+  const unsigned int nc = count + pq2.count;
+  for (unsigned int i = 1; i < 4; i++) {
+    q[i] = (count * q[i] + pq2.count * pq2.q[i]) / nc;
+    n[i] = n[i] + pq2.n[i] + 1.0;
+  }
+  q[0] = std::min(q[0], pq2.q[0]);
+  q[4] = std::max(q[4], pq2.q[4]);
+  n[0] = 0.0;
+  n[4] = nc - 1.0;
+  for (unsigned int i = 0; i < 5; i++) {
+    np[i] = (nc - 1.0) * dn[i];
+  }
+  count = nc;
+  return;
+}
+
+double P2Quantile::value() const {
+  if (0 == count) {
+    return 0.0;
+  }
+  if (count < 5) {
+    // linear interpolation between the order statistics
+    double v[5];
+    std::copy(q, q + count, v);
+    std::sort(v, v + count);
+    const double r = pq * (count - 1);
+    const unsigned int j = (unsigned int)(r);
+    if (j + 1 >= count) {
+      return v[count - 1];
+    }
+    return v[j] + (r - j) * (v[j + 1] - v[j]);
+  }
+  return q[2];
+}
+
+// --------------------------------------------
+
+OnlineStats::OnlineStats(const vector<double> & probs) {
+  num = 0;
+  avg = 0.0;
+  m2 = 0.0;
+  lo = 0.0;
+  hi = 0.0;
+  qs = vector<P2Quantile>();
+  for (double p : probs) {
+    qs.push_back(P2Quantile(p));
+  }
+}
+
+OnlineStats::~OnlineStats() {
+  // nothing yet
+}
+
+void OnlineStats::add(double x) {
+  num = num + 1;
+  if (1 == num) {
+    lo = x;
+    hi = x;
+  }
+  else {
+    lo = std::min(lo, x);
+    hi = std::max(hi, x);
+  }
+  const double d = x - avg;
+  avg = avg + d / num;
+  m2 = m2 + d * (x - avg);
+  for (auto & qk : qs) {
+    qk.add(x);
+  }
+  return;
+}
+
+void OnlineStats::merge(const OnlineStats & os) {
+  if (qs.size() != os.qs.size()) {
+    throw KException("OnlineStats::merge: quantiles differ");
+  }
+  if (0 == os.num) {
+    return;
+  }
+  if (0 == num) {
+    *this = os;
+    return;
+  }
+  for (unsigned int k = 0; k < qs.size(); k++) {
+    qs[k].merge(os.qs[k]);
+  }
+  const unsigned int nAB = num + os.num;
+  const double d = os.avg - avg;
+  avg = avg + d * os.num / nAB;
+  m2 = m2 + os.m2 + d * d * ((double)num) * ((double)os.num) / nAB;
+  lo = std::min(lo, os.lo);
+  hi = std::max(hi, os.hi);
+  num = nAB;
+  return;
+}
+
+double OnlineStats::variance() const {
+  return (num < 2) ? 0.0 : m2 / (num - 1);
+}
+
+double OnlineStats::stdv() const {
+  return std::sqrt(variance());
+}
+
+double OnlineStats::quantile(unsigned int k) const {
+  if (k >= qs.size()) {
+    throw KException("OnlineStats::quantile: index out of range");
+  }
+  return qs[k].value();
+}
+
+} // namespace KBase
+
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
@@ -0,0 +1,107 @@
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// --------------------------------------------
+
+
+#ifndef KBASE_ONLINESTATS_H
+#define KBASE_ONLINESTATS_H
+
+#include <vector>
+
+#include "kutils.h"
+
+
+namespace KBase {
+
+using std::vector;
+
+// ----------------------------------------------
+
+// Running estimate of one quantile, by the P-square method of Jain and
+// Chlamtac (1985): five markers are kept and adjusted as values arrive,
+// so memory is constant however many values are added. Until there are
+// five values, the exact quantile of those seen is returned.
+class P2Quantile {
+public:
+  explicit P2Quantile(double p);
+  virtual ~P2Quantile();
+
+  void add(double x);
+
+  // Combine with an estimate of the same quantile, made from other values.
+  // The marker heights are averaged, weighted by count, so the result is
+  // an approximation unless one side has seen fewer than five values.
+  void merge(const P2Quantile & pq2);
+  double value() const;
+  double prob() const { return pq; }
+
+protected:
+
+private:
+  double pq = 0.5;
+  unsigned int count = 0;
+  double q[5] = { 0, 0, 0, 0, 0 };  // marker heights
+  double n[5] = { 0, 1, 2, 3, 4 };  // marker positions
+  double np[5] = { 0, 0, 0, 0, 0 }; // desired marker positions
+  double dn[5] = { 0, 0, 0, 0, 0 }; // increments of the desired positions
+};
+
+// Count, mean, variance (by Welford's method), extremes and a few quantiles
+// of a stream of values, none of which are stored. Statistics gathered on
+// different threads can be merged: exactly for all but the quantiles.
+class OnlineStats {
+public:
+  explicit OnlineStats(const vector<double> & probs = { 0.1, 0.5, 0.9 });
+  virtual ~OnlineStats();
+
+  void add(double x);
+  void merge(const OnlineStats & os);
+
+  unsigned int count() const { return num; }
+  double mean() const { return avg; }
+  double variance() const; // sample variance, zero for fewer than two values
+  double stdv() const;
+  double min() const { return lo; }
+  double max() const { return hi; }
+
+  // estimate of the k-th quantile given to the constructor
+  double quantile(unsigned int k) const;
+  unsigned int numQuantiles() const { return qs.size(); }
+
+protected:
+
+private:
+  unsigned int num = 0;
+  double avg = 0.0;
+  double m2 = 0.0; // sum of squared deviations from the mean
+  double lo = 0.0;
+  double hi = 0.0;
+  vector<P2Quantile> qs = {};
+};
+
+} // namespace KBase
+
+// ----------------------------------------------
+#endif
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
@@ -126,7 +126,8 @@ W64 rotr(const W64 x, unsigned int n) {
 }
 
 
-PRNG::PRNG(uint64_t sd) {
+PRNG::PRNG(uint64_t sd, PRNGEngine e) {
+  engine = e;
   setSeed(sd);
 }
 
@@ -142,6 +143,16 @@ uint64_t PRNG::setSeed(uint64_t s) {
     s = dist(mt1);
   }
   mt.seed(s);
+
+  // expand the seed with splitmix64, which never yields an all-zero xoshiro state
+  W64 z = s;
+  for (unsigned int i = 0; i < 4; i++) {
+    z = z + 0x9E3779B97F4A7C15;
+    W64 w = z;
+    w = (w ^ (w >> 30)) * 0xBF58476D1CE4E5B9;
+    w = (w ^ (w >> 27)) * 0x94D049BB133111EB;
+    xs[i] = w ^ (w >> 31);
+  }
   return s;
 }
 
@@ -190,12 +201,61 @@ unsigned int PRNG::probSel(const KMatrix & cv) {
 
 
 uint64_t PRNG::uniform() {
+  if (PRNGEngine::Xoshiro256 == engine) {
+    // rotl is spelled out, as KBase::rotl double-checks itself on every call
+    const W64 r = xs[1] * 5;
+    const W64 rslt = ((r << 7) | (r >> 57)) * 9;
+    const W64 t = xs[1] << 17;
+    xs[2] ^= xs[0];
+    xs[3] ^= xs[1];
+    xs[1] ^= xs[2];
+    xs[0] ^= xs[3];
+    xs[2] ^= t;
+    xs[3] = (xs[3] << 45) | (xs[3] >> 19);
+    return rslt;
+  }
   const uint64_t max = 0xFFFFFFFFFFFFFFFF;
   std::uniform_int_distribution<uint64_t> dist(0, max);
   uint64_t n = dist(mt);
   return qTrans(n);
 }
 
+
+void PRNG::fillUniform(double * x, size_t n, double a, double b) {
+  if ((nullptr == x) && (0 < n)) {
+    throw KException("PRNG::fillUniform: x is a null pointer");
+  }
+  const double maxU = (double)0xFFFFFFFFFFFFFFFF;
+  for (size_t i = 0; i < n; i++) {
+    const double u = ((double)uniform()) / maxU; // as in uniform(a,b)
+    x[i] = a + ((b - a)*u);
+  }
+  return;
+}
+
+
+void PRNG::fillNormal(double * x, size_t n, double mu, double sigma) {
+  if ((nullptr == x) && (0 < n)) {
+    throw KException("PRNG::fillNormal: x is a null pointer");
+  }
+  if (0.0 > sigma) {
+    throw KException("PRNG::fillNormal: sigma must be non-negative");
+  }
+  const double twoPi = 6.283185307179586477;
+  const double d53 = 1.0 / 9007199254740992.0; // 2^-53
+  for (size_t i = 0; i < n; i += 2) {
+    // u1 is in (0,1], so the log is finite
+    const double u1 = ((double)((uniform() >> 11) + 1)) * d53;
+    const double u2 = ((double)(uniform() >> 11)) * d53;
+    const double r = sigma * sqrt(-2.0 * log(u1));
+    x[i] = mu + r * cos(twoPi * u2);
+    if (i + 1 < n) {
+      x[i + 1] = mu + r * sin(twoPi * u2);
+    }
+  }
+  return;
+}
+
 VBool PRNG::bits(unsigned int nb) {
   VBool bv = {};
   bv.resize(nb);
@@ -215,6 +275,92 @@ VBool PRNG::bits(unsigned int nb) {
   return bv;
 }
 
+
+// -------------------------------------------------
+DiscreteSampler::DiscreteSampler(const KMatrix & cv) {
+  const unsigned int n = cv.numR();
+  if (0 >= n) {
+    throw KException("DiscreteSampler::DiscreteSampler: cv matrix has got no records");
+  }
+  if (1 != cv.numC()) {
+    throw KException("DiscreteSampler::DiscreteSampler: cv matrix doesn't have only one column");
+  }
+  const double pTol = 1E-8;
+  if (fabs(KBase::sum(cv) - 1.0) >= pTol) {
+    throw KException("DiscreteSampler::DiscreteSampler: probabilities must sum to 1.0");
+  }
+
+  prob.resize(n);
+  alias.resize(n);
+  auto scaled = std::vector<double>(n);
+  auto small = std::vector<unsigned int>();
+  auto large = std::vector<unsigned int>();
+  for (unsigned int i = 0; i < n; i++) {
+    if (0.0 > cv(i, 0)) {
+      throw KException("DiscreteSampler::DiscreteSampler: probabilities must be non-negative");
+    }
+    scaled[i] = cv(i, 0) * n;
+    alias[i] = i;
+    if (scaled[i] < 1.0) {
+      small.push_back(i);
+    }
+    else {
+      large.push_back(i);
+    }
+  }
+
+  // pair each under-full column with an over-full one, which tops it up
+  while ((0 < small.size()) && (0 < large.size())) {
+    const unsigned int s = small.back();
+    small.pop_back();
+    const unsigned int g = large.back();
+    large.pop_back();
+    prob[s] = scaled[s];
+    alias[s] = g;
+    scaled[g] = (scaled[g] + scaled[s]) - 1.0;
+    if (scaled[g] < 1.0) {
+      small.push_back(g);
+    }
+    else {
+      large.push_back(g);
+    }
+  }
+  // whatever is left is full, up to round-off
+  for (auto g : large) {
+    prob[g] = 1.0;
+  }
+  for (auto s : small) {
+    prob[s] = 1.0;
+  }
+}
+
+
+DiscreteSampler::~DiscreteSampler() { }
+
+
+unsigned int DiscreteSampler::draw(PRNG * rng) const {
+  const unsigned int n = prob.size();
+  // one 64-bit draw supplies both the column (high part) and the coin (fraction)
+  const double x = rng->uniform(0.0, 1.0) * n;
+  unsigned int i = ((unsigned int)x);
+  if (n <= i) { // only when x == n exactly
+    i = n - 1;
+  }
+  const double f = x - i;
+  return (f < prob[i]) ? i : alias[i];
+}
+
+
+void DiscreteSampler::draw(PRNG * rng, unsigned int * ndx, size_t n) const {
+  if ((nullptr == ndx) && (0 < n)) {
+    throw KException("DiscreteSampler::draw: ndx is a null pointer");
+  }
+  for (size_t k = 0; k < n; k++) {
+    ndx[k] = draw(rng);
+  }
+  return;
+}
+
 } // end of namespace
 
 // --------------------------------------------
@@ -27,6 +27,7 @@
 
 #include <cstdint>
 #include <random>
+#include <vector>
 
 #include "kutils.h"
 #include "kmatrix.h"
@@ -64,17 +65,47 @@ W64 qTrans(W64 s);
 W64 rotl(const W64 x, unsigned int n);
 W64 rotr(const W64 x, unsigned int n);
 
+// The generator behind a PRNG. MT19937 (whitened by qTrans) is the default and
+// reproduces all earlier results; xoshiro256** (Blackman and Vigna, 2018) has
+// 32 bytes of state and is several times faster per draw.
+enum class PRNGEngine {
+  MT19937 = 0, Xoshiro256
+};
+
 class PRNG {
 public:
-  explicit PRNG(uint64_t sd = KBase::dSeed);
+  explicit PRNG(uint64_t sd = KBase::dSeed, PRNGEngine e = PRNGEngine::MT19937);
   virtual ~PRNG();
   uint64_t uniform();
   double uniform(double a, double b);
   unsigned int probSel(const KMatrix & cv);
   VBool bits(unsigned int nb);
   uint64_t setSeed(uint64_t sd);
+  PRNGEngine getEngine() const { return engine; }
+
+  // Fill x[0..n-1] in one call. fillUniform gives exactly the values of
+  // n successive calls to uniform(a,b); fillNormal uses Box-Muller pairs.
+  void fillUniform(double * x, size_t n, double a = 0.0, double b = 1.0);
+  void fillNormal(double * x, size_t n, double mu = 0.0, double sigma = 1.0);
 protected:
+  PRNGEngine engine = PRNGEngine::MT19937;
   mt19937_64 mt = mt19937_64();
+  W64 xs[4] = { 0, 0, 0, 0 }; // xoshiro256** state
+};
+
+// Draw repeatedly from one discrete distribution by Vose's alias method:
+// O(n) setup, then O(1) per draw instead of the linear scan of PRNG::probSel.
+class DiscreteSampler {
+public:
+  // cv is a column of non-negative probabilities summing to 1, as for probSel
+  explicit DiscreteSampler(const KMatrix & cv);
+  virtual ~DiscreteSampler();
+  unsigned int draw(PRNG * rng) const;
+  void draw(PRNG * rng, unsigned int * ndx, size_t n) const;
+  unsigned int size() const { return ((unsigned int)prob.size()); }
+protected:
+  std::vector<double> prob = {};
+  std::vector<unsigned int> alias = {};
 };
 
 };
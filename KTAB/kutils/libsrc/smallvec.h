@@ -0,0 +1,185 @@
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// --------------------------------------------
+//
+// A column vector of doubles which keeps up to N elements inline, so that the
+// short positions and differences of per-pair arithmetic never touch the heap;
+// longer ones fall back to a std::vector. It answers numR, numC and (i,j) like
+// a KMatrix column, converts to and from KMatrix, and its operators do the same
+// element-wise operations, in the same order, as the KMatrix ones.
+// Element access is unchecked; the operators check that sizes match.
+// --------------------------------------------
+
+#ifndef KBASE_SMALLVEC_H
+#define KBASE_SMALLVEC_H
+
+#include <vector>
+
+#include "kutils.h"
+#include "kmatrix.h"
+
+
+namespace KBase {
+
+using std::vector;
+
+// ----------------------------------------------
+
+template <unsigned int N>
+class SmallVec {
+public:
+  SmallVec() {}
+
+  explicit SmallVec(unsigned int nr, double iv = 0.0) {
+    resize(nr);
+    double * d = data();
+    for (unsigned int i = 0; i < n; i++) {
+      d[i] = iv;
+    }
+  }
+
+  explicit SmallVec(const KMatrix & m) {
+    if (1 != m.numC()) {
+      throw KException("SmallVec::SmallVec: m must be a column vector");
+    }
+    resize(m.numR());
+    double * d = data();
+    unsigned int i = 0;
+    for (double x : m) {
+      d[i] = x;
+      i++;
+    }
+  }
+
+  unsigned int numR() const { return n; }
+  unsigned int numC() const { return 1; }
+  bool isInline() const { return (n <= N); }
+
+  double operator() (unsigned int i) const { return data()[i]; }
+  double& operator() (unsigned int i) { return data()[i]; }
+  double operator() (unsigned int i, unsigned int) const { return data()[i]; }
+  double& operator() (unsigned int i, unsigned int) { return data()[i]; }
+
+  const double * data() const { return isInline() ? inl : heap.data(); }
+  double * data() { return isInline() ? inl : heap.data(); }
+
+  KMatrix toKMatrix() const {
+    auto m = KMatrix(n, 1);
+    const double * d = data();
+    for (unsigned int i = 0; i < n; i++) {
+      m(i, 0) = d[i];
+    }
+    return m;
+  }
+
+  SmallVec & operator+= (const SmallVec & v) {
+    sameSize(v, "SmallVec::operator+=");
+    double * d = data();
+    const double * e = v.data();
+    for (unsigned int i = 0; i < n; i++) {
+      d[i] = d[i] + e[i];
+    }
+    return *this;
+  }
+
+  SmallVec & operator-= (const SmallVec & v) {
+    sameSize(v, "SmallVec::operator-=");
+    double * d = data();
+    const double * e = v.data();
+    for (unsigned int i = 0; i < n; i++) {
+      d[i] = d[i] - e[i];
+    }
+    return *this;
+  }
+
+  SmallVec & operator*= (double x) {
+    double * d = data();
+    for (unsigned int i = 0; i < n; i++) {
+      d[i] = x*d[i];
+    }
+    return *this;
+  }
+
+  SmallVec & operator/= (double x) {
+    double * d = data();
+    for (unsigned int i = 0; i < n; i++) {
+      d[i] = d[i] / x;
+    }
+    return *this;
+  }
+
+private:
+  void resize(unsigned int nr) {
+    n = nr;
+    if (N < n) {
+      heap.resize(n);
+    }
+  }
+
+  void sameSize(const SmallVec & v, const char * fn) const {
+    if (n != v.n) {
+      throw KException(string(fn) + ": vectors are not of the same size");
+    }
+  }
+
+  unsigned int n = 0;
+  double inl[N];
+  vector<double> heap = {}; // empty unless N < n
+};
+
+template <unsigned int N>
+SmallVec<N> operator+ (SmallVec<N> v1, const SmallVec<N> & v2) {
+  v1 += v2;
+  return v1;
+}
+
+template <unsigned int N>
+SmallVec<N> operator- (SmallVec<N> v1, const SmallVec<N> & v2) {
+  v1 -= v2;
+  return v1;
+}
+
+template <unsigned int N>
+SmallVec<N> operator* (double x, SmallVec<N> v) {
+  v *= x;
+  return v;
+}
+
+template <unsigned int N>
+SmallVec<N> operator* (SmallVec<N> v, double x) {
+  v *= x;
+  return v;
+}
+
+template <unsigned int N>
+SmallVec<N> operator/ (SmallVec<N> v, double x) {
+  v /= x;
+  return v;
+}
+
+} // namespace KBase
+
+// ----------------------------------------------
+#endif
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
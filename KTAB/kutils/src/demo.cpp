@@ -57,6 +57,7 @@ using KBase::nProd;
 
 
 void demoPCA(PRNG* rng);
+void demoSmallVec(PRNG* rng);
 
 // return a tuple of updated weights and updated features (one per row)
 // xMat has one sample per row, one column per dimension
@@ -98,6 +99,132 @@ void demoUIndices() {
     return;
 }
 
+// -------------------------------------------------
+// Statistical checks of the PRNG sampling API, for each engine.
+// Every check throws on failure. The limits sit about 4.3 standard deviations
+// out (roughly 1 in 10^5 for a correct generator), so a failure means a bug.
+void demoPRNG(uint64_t sd) {
+    using KBase::PRNGEngine;
+    using KBase::DiscreteSampler;
+    const unsigned int nDraw = 1000000;
+    const double zLim = 4.265;
+
+    // Wilson-Hilferty approximation to the chi-square quantile at zLim
+    auto chiSqLim = [zLim](unsigned int df) {
+        const double c = 2.0 / (9.0 * df);
+        const double x = 1.0 - c + zLim * sqrt(c);
+        return df * x * x * x;
+    };
+    auto chiSq = [](const vector<unsigned int> & cnt, const vector<double> & p) {
+        double n = 0.0;
+        for (auto c : cnt) {
+            n = n + c;
+        }
+        double x2 = 0.0;
+        for (unsigned int i = 0; i < cnt.size(); i++) {
+            if (0.0 < p[i]) {
+                const double e = n * p[i];
+                x2 = x2 + (cnt[i] - e) * (cnt[i] - e) / e;
+            }
+        }
+        return x2;
+    };
+    auto check = [](bool ok, string msg) {
+        if (!ok) {
+            throw KException("demoPRNG: " + msg);
+        }
+        LOG(INFO) << "  passed:" << msg;
+    };
+
+    auto buff = vector<double>(nDraw);
+    for (auto eng : { PRNGEngine::MT19937, PRNGEngine::Xoshiro256 }) {
+        LOG(INFO) << ((PRNGEngine::MT19937 == eng) ? "Engine MT19937" : "Engine xoshiro256**");
+
+        // reproducible, and the bulk call matches single draws exactly
+        auto r1 = PRNG(sd, eng);
+        auto r2 = PRNG(sd, eng);
+        bool same = true;
+        for (unsigned int i = 0; i < 1000; i++) {
+            same = same && (r1.uniform() == r2.uniform());
+        }
+        check(same, "same seed gives the same stream");
+        r1.fillUniform(buff.data(), 1000, -2.0, 3.0);
+        for (unsigned int i = 0; i < 1000; i++) {
+            same = same && (buff[i] == r2.uniform(-2.0, 3.0));
+        }
+        check(same, "fillUniform equals successive uniform(a,b)");
+
+        // uniform: moments and a 20-bin histogram
+        auto rng = PRNG(sd, eng);
+        rng.fillUniform(buff.data(), nDraw);
+        double m1 = 0.0;
+        double m2 = 0.0;
+        auto bins = vector<unsigned int>(20, 0);
+        for (auto x : buff) {
+            m1 = m1 + x;
+            m2 = m2 + (x - 0.5) * (x - 0.5);
+            unsigned int b = (unsigned int)(20 * x);
+            bins[(b < 20) ? b : 19]++;
+        }
+        m1 = m1 / nDraw;
+        m2 = m2 / nDraw;
+        check(fabs(m1 - 0.5) < zLim * sqrt(1.0 / (12.0 * nDraw)), "uniform mean");
+        check(fabs(m2 - 1.0 / 12.0) < zLim * sqrt((1.0 / 80.0 - 1.0 / 144.0) / nDraw), "uniform variance");
+        check(chiSq(bins, vector<double>(20, 0.05)) < chiSqLim(19), "uniform histogram");
+
+        // normal: moments and the one-sigma mass; also an odd count
+        rng.fillNormal(buff.data(), nDraw, 0.0, 1.0);
+        m1 = 0.0;
+        m2 = 0.0;
+        double in1 = 0.0;
+        for (auto x : buff) {
+            m1 = m1 + x;
+            m2 = m2 + x * x;
+            in1 = (fabs(x) < 1.0) ? in1 + 1.0 : in1;
+        }
+        m1 = m1 / nDraw;
+        m2 = m2 / nDraw - m1 * m1;
+        in1 = in1 / nDraw;
+        const double p1 = 0.682689492137;
+        check(fabs(m1) < zLim / sqrt((double)nDraw), "normal mean");
+        check(fabs(m2 - 1.0) < zLim * sqrt(2.0 / nDraw), "normal variance");
+        check(fabs(in1 - p1) < zLim * sqrt(p1 * (1 - p1) / nDraw), "normal mass within one sigma");
+        double odd[7] = { 0, 0, 0, 0, 0, 0, 0 };
+        rng.fillNormal(odd, 7, 10.0, 0.0);
+        check(10.0 == odd[6], "fillNormal with an odd count");
+
+        // alias sampler, including a zero-probability outcome
+        const vector<double> pv = { 0.30, 0.05, 0.00, 0.20, 0.01, 0.14, 0.10, 0.07, 0.08, 0.05 };
+        auto cv = KMatrix(pv.size(), 1);
+        for (unsigned int i = 0; i < pv.size(); i++) {
+            cv(i, 0) = pv[i];
+        }
+        auto ds = DiscreteSampler(cv);
+        auto ndx = vector<unsigned int>(nDraw);
+        auto sTime = std::chrono::high_resolution_clock::now();
+        ds.draw(&rng, ndx.data(), nDraw);
+        auto aTime = std::chrono::high_resolution_clock::now();
+        auto cnt = vector<unsigned int>(pv.size(), 0);
+        for (auto i : ndx) {
+            cnt[i]++;
+        }
+        check(0 == cnt[2], "alias sampler never draws a zero-probability outcome");
+        check(chiSq(cnt, pv) < chiSqLim(pv.size() - 2), "alias sampler frequencies");
+
+        auto pTime = std::chrono::high_resolution_clock::now();
+        cnt = vector<unsigned int>(pv.size(), 0);
+        for (unsigned int k = 0; k < nDraw; k++) {
+            cnt[rng.probSel(cv)]++;
+        }
+        auto qTime = std::chrono::high_resolution_clock::now();
+        check(chiSq(cnt, pv) < chiSqLim(pv.size() - 2), "probSel frequencies");
+        const double aSec = std::chrono::duration<double>(aTime - sTime).count();
+        const double pSec = std::chrono::duration<double>(qTime - pTime).count();
+        LOG(INFO) << getFormattedString("  %u draws: alias %.3f sec, probSel %.3f sec", nDraw, aSec, pSec);
+    }
+    return;
+}
+
 void show(string str, const KMatrix & m, string fs) {
     LOG(INFO) << str;
     m.mPrintf(fs.c_str());
@@ -412,6 +539,39 @@ void demoMatrix(PRNG* rng) {
 
     demoPCA(rng);
 
+    demoSmallVec(rng);
+
+    return;
+}
+
+// SmallVec keeps up to N elements inline and falls back to the heap beyond that;
+// both layouts must give exactly the KMatrix results
+void demoSmallVec(PRNG* rng) {
+    using SV = KBase::SmallVec<4>;
+    LOG(INFO) << "SmallVec<4> against KMatrix, inline and on the heap";
+    for (unsigned int n : { 1, 4, 5, 9 }) {
+        auto a = KMatrix::uniform(rng, n, 1, -10.0, +10.0);
+        auto b = KMatrix::uniform(rng, n, 1, -10.0, +10.0);
+        const double x = rng->uniform(0.5, 2.0);
+        const auto km = ((a - b) * x + a) / x;
+
+        const auto va = SV(a);
+        auto vc = va; // copies must not share storage
+        vc += SV(b);
+        const auto sv = ((va - SV(b)) * x + va) / x;
+        const auto sm = sv.toKMatrix();
+
+        if ((n <= 4) != sv.isInline()) {
+          throw KException("demoSmallVec: wrong storage for n = " + std::to_string(n));
+        }
+        for (unsigned int i = 0; i < n; i++) {
+            if ((sm(i, 0) != km(i, 0)) || (vc(i) != a(i, 0) + b(i, 0)) || (va(i) != a(i, 0))) {
+              throw KException("demoSmallVec: SmallVec differs from KMatrix for n = " + std::to_string(n));
+            }
+        }
+        LOG(INFO) << getFormattedString("  n = %u, %s storage: matches KMatrix", n,
+                                        (sv.isInline() ? "inline" : "heap"));
+    }
     return;
 }
 
@@ -2162,6 +2322,7 @@ int main(int ac, char **av) {
     unsigned int vimcpN = 0;
     bool threadP = false;
     bool uiP = false;
+    bool prngP = false;
     bool run = true;
 
     // tmp args
@@ -2182,6 +2343,8 @@ int main(int ac, char **av) {
         printf("\n");
         printf("--ui              unique indices \n");
         printf("\n");
+        printf("--prng            statistical tests of the samplers and engines \n");
+        printf("\n");
         printf("--vhc <n>         vector hill-climbing \n");
         printf("                  0: maximizing a simple quadratic \n");
         printf("                  1: Nash bargaining between two agents in 1D \n");
@@ -2235,6 +2398,9 @@ int main(int ac, char **av) {
             else if (strcmp(av[i], "--ui") == 0) {
                 uiP = true;
             }
+            else if (strcmp(av[i], "--prng") == 0) {
+                prngP = true;
+            }
             else if (strcmp(av[i], "--vimcp") == 0) {
                 vimcpP = true;
                 i++;
@@ -2450,6 +2616,18 @@ int main(int ac, char **av) {
         }
     }
 
+    if (prngP) {
+        try {
+          UDemo::demoPRNG(seed);
+        }
+        catch (KException &ke) {
+          LOG(INFO) << ke.msg;
+        }
+        catch (...) {
+          LOG(INFO) << "Unknown exception from UDemo::demoPRNG";
+        }
+    }
+
     delete rng;
     KBase::displayProgramEnd(sTime);
     return 0;
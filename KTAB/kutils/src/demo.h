@@ -27,6 +27,7 @@
 #include "kutils.h"
 #include "prng.h"
 #include "kmatrix.h"
+#include "smallvec.h"
 #include "gaopt.h"
 #include "hcsearch.h"
 #include "vimcp.h"
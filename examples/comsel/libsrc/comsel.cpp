@@ -32,6 +32,7 @@
 #include "smp.h"
 #include "comsel.h"
 #include "hcsearch.h"
+#include "klog.h"
 #include <easylogging++.h>
 
 namespace ComSelLib {
@@ -459,8 +460,8 @@ namespace ComSelLib {
     auto euMat = [rl, numA, numP, this](const KMatrix & uMat) { 
       return expUtilMat(rl, numA, numP, uMat); };
     auto euState = euMat(u);
-    LOG(INFO) << "Actor expected utilities: ";
-    KBase::trans(euState).mPrintf("%6.4f, ");
+    KLOG(ReportingLevel::Low) << "Actor expected utilities: ";
+    KLOG_MATRIX(ReportingLevel::Low, KBase::trans(euState), "%6.4f, ");
 
     if (ReportingLevel::Low < rl) {
       LOG(INFO) << "---------------------------------------";
@@ -51,6 +51,7 @@ using KBase::joinH;
 using KBase::trans;
 using KBase::ReportingLevel;
 using KBase::VHCSearch;
+using KBase::MultiStart;
 
 using KBase::Actor;
 using KBase::Model;
@@ -251,37 +252,51 @@ double waterMinProb(ReportingLevel rl, const KMatrix & p0) {
     return (err + (pRMS * prmsW));
 }
 
-void minProbErr() {
+void minProbErr(unsigned int numStarts, uint64_t seed) {
 
 
     //const unsigned int numA = 4;
-    auto vhc = new VHCSearch();
     auto eRL = ReportingLevel::Low;
     auto rRL = ReportingLevel::Medium;
 
-    vhc->eval = [eRL](const KMatrix & wm) {
-        const double err = waterMinProb(eRL, wm);
-        return 1 - err;
+    auto ms = MultiStart();
+    ms.eval = [](const KMatrix & wm) {
+        return waterMinProb(ReportingLevel::Silent, wm);
     };
 
-    vhc->nghbrs = VHCSearch::vn1;
-    auto p0 = KMatrix(numA, 1); // all zeros
-    LOG(INFO) << "Initial point:";
-    trans(p0).mPrintf(" %+.4f ");
-    auto rslt = vhc->run(p0,
-                         100, 10, 1E-5, // iMax, sMax, sTol
-                         1.0, 0.618, 1.25, 1e-8, // step, shrink, grow, minStep
+    // the first start is the unadjusted weights, as a single search always was
+    ms.sample = [](unsigned int i, PRNG * rng) {
+        if (0 == i) {
+            return KMatrix(numA, 1); // all zeros
+        }
+        return KMatrix::uniform(rng, numA, 1, -1.0, +1.0);
+    };
+
+    ms.search = [](const KMatrix & p0, PRNG *) {
+        VHCSearch vhc;
+        vhc.eval = [](const KMatrix & wm) {
+            const double err = waterMinProb(ReportingLevel::Silent, wm);
+            return 1 - err;
+        };
+        vhc.nghbrs = VHCSearch::vn1;
+        auto rslt = vhc.run(p0,
+                            100, 10, 1E-5, // iMax, sMax, sTol
+                            1.0, 0.618, 1.25, 1e-8, // step, shrink, grow, minStep
+                            ReportingLevel::Silent);
+        return tuple<KMatrix, unsigned int>(get<1>(rslt), get<2>(rslt));
+    };
+
+    LOG(INFO) << "Searching from" << numStarts << "starts";
+    auto optima = ms.run(numStarts, seed,
+                         5, 1E-3, // bestK, dupTol
                          rRL);
-    double vBest = get<0>(rslt);
-    KMatrix pBest = get<1>(rslt);
-    unsigned int in = get<2>(rslt);
-    unsigned int sn = get<3>(rslt);
-    delete vhc;
-    vhc = nullptr;
-    LOG(INFO) << "Iter:" << in << "Stable:" << sn;
+    const double vBest = 1 - optima[0].value;
+    KMatrix pBest = optima[0].point;
+    LOG(INFO) << "Start:" << optima[0].start << "Iter:" << optima[0].iter;
     LOG(INFO) << KBase::getFormattedString("Best value: %+.4f", vBest);
     LOG(INFO) << "Best point:";
     trans(pBest).mPrintf(" %+.4f ");
+    waterMinProb(eRL, pBest);
     return;
 }
 
@@ -367,7 +382,7 @@ RsrcMinLP* RsrcMinLP::makeRMLP(PRNG* rng,
     return rmlp;
 }
 
-void waterMin() {
+void waterMin(unsigned int numStarts, uint64_t seed) {
 
     setUInit(scenQuant);
 
@@ -380,7 +395,7 @@ void waterMin() {
                                         KBase::KMatrix(numA, 1));
 
     LOG(INFO) << "Error-minimizing search ...";
-    DemoWaterMin::minProbErr();
+    DemoWaterMin::minProbErr(numStarts, seed);
     return;
 }
 
@@ -646,6 +661,7 @@ int main(int ac, char **av) {
     bool waterMinP = false;
     bool rmlpP = false;
     uint64_t seed = dSeed;
+    unsigned int numStarts = 1;
     bool run = true;
 
     // tmp args
@@ -660,6 +676,8 @@ int main(int ac, char **av) {
         printf("--seed <n>   set a 64bit seed\n");
         printf("             0 means truly random\n");
         printf("             default: %020llu \n", dSeed);
+        printf("--starts <n> with --waterMin, search from n starting points\n");
+        printf("             default: 1\n");
     };
 
     if (ac > 1) {
@@ -668,6 +686,10 @@ int main(int ac, char **av) {
                 i++;
                 seed = std::stoull(av[i]);
             }
+            else if (strcmp(av[i], "--starts") == 0) {
+                i++;
+                numStarts = std::stoul(av[i]);
+            }
             else if (strcmp(av[i], "--waterMin") == 0) {
                 waterMinP = true;
             }
@@ -696,7 +718,7 @@ int main(int ac, char **av) {
 
     if (waterMinP) {
       try {
-        DemoWaterMin::waterMin();
+        DemoWaterMin::waterMin(numStarts, seed);
       }
       catch (KBase::KException &ke) {
         LOG(INFO) << ke.msg;
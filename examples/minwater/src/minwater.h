@@ -38,6 +38,7 @@
 #include "kmatrix.h"
 #include "gaopt.h"
 #include "hcsearch.h"
+#include "multistart.h"
 #include "kmodel.h"
 
 namespace DemoWaterMin {
@@ -22,6 +22,8 @@
 // --------------------------------------------
 
 #include "pmatrix.h" 
+#include "lbfgs.h"
+#include "multistart.h"
 #include <easylogging++.h>
 
 namespace PMatDemo {
@@ -271,10 +273,12 @@ KMatrix PMatrixModel::utilFromFP(const FittingParameters & fParams, double bigR)
 
 tuple<double, KMatrix, KMatrix> PMatrixModel::minProbError(
     const FittingParameters & fParams,
-    double bigR, double errWeight) {
+    double bigR, double errWeight,
+    unsigned int numStarts, uint64_t seed) {
   using KBase::hSlice;
   using KBase::vSlice;
-  using KBase::VHCSearch;
+  using KBase::LBFGSearch;
+  using KBase::MultiStart;
 
   LOG(INFO) << KBase::getFormattedString(
     "Starting minimization with R = %+.3f and errWeight = %.2f",
@@ -347,42 +351,61 @@ tuple<double, KMatrix, KMatrix> PMatrixModel::minProbError(
   }
 
 
-  auto vhc = new VHCSearch();
   auto eRL = ReportingLevel::Silent;
   auto rRL = ReportingLevel::Low;
 
-  vhc->eval = [eRL, wMat0, uMat,
+  auto costFn = [eRL, wMat0, uMat,
       wAdj1, pSel1, thresh1,
       wAdj2, pSel2, thresh2,
       errWeight]
-      (const KMatrix & p) {
+      (const KMatrix & p, KMatrix * g) {
     auto c12 = probCost(p,
                         wMat0, uMat,
                         wAdj1, pSel1, thresh1,
                         wAdj2, pSel2, thresh2,
-                        errWeight, eRL);
+                        errWeight, eRL, g);
+    return get<0>(c12);
+  };
+
+  // Adjustment factors of exp(5) = 148 either way are far past anything the
+  // adjustment cost would allow, but keep trial steps from overflowing.
+  const double maxAdj = 5.0;
+
+  auto ms = MultiStart();
+  ms.eval = [costFn](const KMatrix & p) {
+    return costFn(p, nullptr);
+  };
+
+  // The first start is no adjustment at all, as a single run always was;
+  // the others are spread over factors between 1/e and e.
+  ms.sample = [numAct](unsigned int i, PRNG * rng) {
+    if (0 == i) {
+      return KMatrix(numAct, 1); // all zeros
+    }
+    return KMatrix::uniform(rng, numAct, 1, -1.0, +1.0);
+  };
 
-    const double eCost = get<0>(c12);
-    // to minimize error cost, maximize 1-eCost.
-    return 100.0*(1.0 - eCost);
+  ms.search = [costFn, numAct, maxAdj](const KMatrix & p0, PRNG *) {
+    auto lbs = LBFGSearch();
+    lbs.eval = [costFn](const KMatrix & p, KMatrix & g) {
+      return costFn(p, &g);
+    };
+    lbs.lower = KMatrix(numAct, 1, -maxAdj);
+    lbs.upper = KMatrix(numAct, 1, +maxAdj);
+    auto rslt = lbs.run(p0,
+                        500, 1E-8, 1E-10, // iMax, gTol, fTol
+                        ReportingLevel::Silent);
+    return tuple<KMatrix, unsigned int>(get<1>(rslt), get<2>(rslt));
   };
 
-  vhc->nghbrs = VHCSearch::vn1; // vn2 takes 10 times as long, w/o improvement
-  auto p0 = KMatrix(numAct, 1); // all zeros
-  LOG(INFO) << "Initial point:";
-  trans(p0).mPrintf(" %+.4f ");
-  auto rslt = vhc->run(p0,
-                       2500, 10, 1E-5, // iMax, sMax, sTol
-                       0.50, 0.618, 1.25, 1e-8, // step, shrink, grow, minStep
+  LOG(INFO) << "Searching from" << numStarts << "starts";
+  auto optima = ms.run(numStarts, seed,
+                       5, 1E-3, // bestK, dupTol
                        rRL);
-  double vBest = get<0>(rslt);
-  KMatrix pBest = get<1>(rslt);
-  unsigned int in = get<2>(rslt);
-  unsigned int sn = get<3>(rslt);
-  delete vhc;
-  vhc = nullptr;
-  LOG(INFO) << "Iter:" << in << "Stable:" << sn;
-  LOG(INFO) << KBase::getFormattedString("Best value: %+.4f", vBest);
+  double vBest = optima[0].value;
+  KMatrix pBest = optima[0].point;
+  LOG(INFO) << "Start:" << optima[0].start << "Iter:" << optima[0].iter;
+  LOG(INFO) << KBase::getFormattedString("Best cost: %.6f", vBest);
   LOG(INFO) << "Best point:";
   trans(pBest).mPrintf(" %+.4f ");
 
@@ -402,7 +425,8 @@ tuple<double, KMatrix, KMatrix> PMatrixModel::probCost(const KMatrix& pnt,
                                                        const KMatrix& wMat, const KMatrix& uMat,
                                                        const KMatrix& wAdj1, const KMatrix& pSel1, double thresh1,
                                                        const KMatrix& wAdj2, const KMatrix& pSel2, double thresh2,
-                                                       double errWeight, ReportingLevel rl) {
+                                                       double errWeight, ReportingLevel rl,
+                                                       KMatrix * gCost) {
   if (1 != wMat.numR()) {
     throw KException("PMatrixModel::probCost: wMat must be a row vector");
   }
@@ -442,6 +466,15 @@ tuple<double, KMatrix, KMatrix> PMatrixModel::probCost(const KMatrix& pnt,
     return (x>0.0 ? x : 0.0);
   };
 
+  // chain rule from d(err)/dw to d(err)/d(pnt): each w(0,i) is proportional to exp(pnt(i))
+  auto dw = [nAct](const KMatrix & dErr, const KMatrix & w) {
+    auto d = KMatrix(nAct, 1);
+    for (unsigned int i = 0; i < nAct; i++) {
+      d(i, 0) = dErr(i, 0) * w(0, i);
+    }
+    return d;
+  };
+
 
   // Note that wMat, wAdj1, and wAdj2 are row-vectors.
   // wAdj1 and wAdj2 are 1 for all actors except those to be adjusted
@@ -460,7 +493,16 @@ tuple<double, KMatrix, KMatrix> PMatrixModel::probCost(const KMatrix& pnt,
       throw KException("PMatrixModel::probCost: w1(0, i) must be non-negative");
     }
   }
-  auto pDist1 = Model::scalarPCE(nAct, nOpt, w1, uMat, vr, vpm, pcem, rl);
+  auto pDist1 = KMatrix();
+  auto dErr1 = KMatrix(nAct, 1); // d(err1)/d(pnt)
+  if (nullptr == gCost) {
+    pDist1 = Model::scalarPCE(nAct, nOpt, w1, uMat, vr, vpm, pcem, rl);
+  }
+  else {
+    auto pg = Model::scalarPCEGrad(nAct, nOpt, w1, uMat, vr, vpm, pcem);
+    pDist1 = get<0>(pg);
+    dErr1 = -1.0 * dw(trans(get<1>(pg)) * pSel1, w1);
+  }
   auto err1 = sPlus(thresh1 - KBase::dot(pDist1, pSel1));
   double serr1 = err1 * err1;
 
@@ -474,7 +516,16 @@ tuple<double, KMatrix, KMatrix> PMatrixModel::probCost(const KMatrix& pnt,
       throw KException("PMatrixModel::probCost: w2(0,i) must be positive");
     }
   }
-  auto pDist2 = Model::scalarPCE(nAct, nOpt, w2, uMat, vr, vpm, pcem, rl);
+  auto pDist2 = KMatrix();
+  auto dErr2 = KMatrix(nAct, 1); // d(err2)/d(pnt)
+  if (nullptr == gCost) {
+    pDist2 = Model::scalarPCE(nAct, nOpt, w2, uMat, vr, vpm, pcem, rl);
+  }
+  else {
+    auto pg = Model::scalarPCEGrad(nAct, nOpt, w2, uMat, vr, vpm, pcem);
+    pDist2 = get<0>(pg);
+    dErr2 = -1.0 * dw(trans(get<1>(pg)) * pSel2, w2);
+  }
   auto err2 = sPlus(thresh2 - KBase::dot(pDist2, pSel2));
   double serr2 = err2 * err2;
   
@@ -484,6 +535,19 @@ tuple<double, KMatrix, KMatrix> PMatrixModel::probCost(const KMatrix& pnt,
   
   const double totalCost = (pCost + ((serr1 + serr2 + serr3)*errWeight)) / (1.0 + errWeight);
 
+  if (nullptr != gCost) {
+    // sPlus has zero slope where it is clipped, so each err's slope
+    // counts only while it is positive
+    const auto dErr3 = (err1 > err2) ? dErr1 : dErr2;
+    *gCost = KMatrix(nAct, 1);
+    for (unsigned int i = 0; i < nAct; i++) {
+      const double f = fVec(i, 0);
+      const double dPCost = 2.0 * (f + (1.0 / f) - 2.0) * (f - (1.0 / f)) / nAct;
+      const double dSErr = 2.0 * (err1*dErr1(i, 0) + err2*dErr2(i, 0) + err3*dErr3(i, 0));
+      (*gCost)(i, 0) = (dPCost + (dSErr*errWeight)) / (1.0 + errWeight);
+    }
+  }
+
   if (ReportingLevel::Silent < rl) {
     LOG(INFO) << "Point:";
     trans(pnt).mPrintf(" %+7.4f ");
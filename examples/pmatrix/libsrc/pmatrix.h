@@ -93,13 +93,12 @@ public:
 
   static KMatrix utilFromFP(const FittingParameters & fParams, double bigR);
 
+  // Fit the weight adjustments by local searches from numStarts starting
+  // points (run concurrently), returning the best as from probCost.
   static tuple<double, KMatrix, KMatrix> minProbError(
       const FittingParameters & fParams,
-      double bigR, double errWeight);
-
-protected:
-  KMatrix wghtVect; // column vector of actor weights
-  KMatrix polUtilMat; // if set, the basic util(actor,option) matrix
+      double bigR, double errWeight,
+      unsigned int numStarts = 1, uint64_t seed = KBase::dSeed);
 
   // This assess and returns the sum of three kinds of costs.
   // The 'pnt' specifies an adjustment vector and incurs
@@ -107,11 +106,17 @@ protected:
   // The adjusted wMat is then separately adjusted for case 1 and case 2,
   // and a cost is incurred to the extend that selected probabilities
   // fall below their respective thresholds.
+  // If gCost is given, it is set to the gradient of the cost with respect to 'pnt'.
   static tuple<double, KMatrix, KMatrix> probCost(const KMatrix& pnt,
                                                   const KMatrix& wMat, const KMatrix& uMat,
                                                   const KMatrix& wAdj1, const KMatrix& pSel1, double thresh1,
                                                   const KMatrix& wAdj2, const KMatrix& pSel2, double thresh2,
-                                                  double errWeight, ReportingLevel rl);
+                                                  double errWeight, ReportingLevel rl,
+                                                  KMatrix * gCost = nullptr);
+
+protected:
+  KMatrix wghtVect; // column vector of actor weights
+  KMatrix polUtilMat; // if set, the basic util(actor,option) matrix
 
 private:
 };
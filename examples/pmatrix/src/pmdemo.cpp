@@ -210,7 +210,7 @@ void runPMM(uint64_t s, bool cpP, const KMatrix& wMat, const KMatrix& uMat, cons
   return;
 }
 
-void fitFile(string fName, uint64_t seed) {
+void fitFile(string fName, uint64_t seed, unsigned int numStarts) {
   const double bigR = +0.5;
   LOG(INFO) << "Fitting file "<<fName;
   auto fParams = pccCSV(fName);
@@ -219,7 +219,7 @@ void fitFile(string fName, uint64_t seed) {
 
   LOG(INFO) << "RA-Util from outcomes: ";
   uMat.mPrintf(" %.4f  ");
-  auto c12 = PMatrixModel::minProbError(fParams, bigR, 1100.0);
+  auto c12 = PMatrixModel::minProbError(fParams, bigR, 1100.0, numStarts, seed);
   // 250 for 2016-08-27 results
 
   // retrieve the weight-matrices which were fitted, so we can
@@ -238,6 +238,87 @@ void fitFile(string fName, uint64_t seed) {
   return;
 }
 
+void demoGradients(uint64_t sd) {
+  if (0 == sd) {
+    throw KException("demoGradients: sd must not be zero");
+  }
+  const double h = 1E-6;
+  auto rng = PRNG(sd);
+  auto check = [](double err, double tol, string msg) {
+    LOG(INFO) << KBase::getFormattedString("  max error %.2E:", err) << msg;
+    if (!(err < tol)) {
+      throw KException("demoGradients: " + msg);
+    }
+  };
+  // largest difference between two matrices, relative to the larger of 1 and |a|
+  auto maxErr = [](const KMatrix & a, const KMatrix & b) {
+    double e = 0.0;
+    for (unsigned int i = 0; i < a.numR(); i++) {
+      for (unsigned int j = 0; j < a.numC(); j++) {
+        const double d = fabs(a(i, j) - b(i, j)) / std::max(1.0, fabs(a(i, j)));
+        e = std::max(e, d);
+      }
+    }
+    return e;
+  };
+
+  const unsigned int numAct = 7;
+  const unsigned int numOpt = 5;
+  auto wMat = KMatrix::uniform(&rng, 1, numAct, 10.0, 100.0);
+  auto uMat = KMatrix::uniform(&rng, numAct, numOpt, 0.0, 1.0);
+  const auto vr = VotingRule::Proportional;
+  const auto vpm = KBase::VPModel::Linear;
+
+  // the uniform Markov model iterates to a tolerance, so its gradient is less exact
+  for (auto pcem : { KBase::PCEModel::ConditionalPCM, KBase::PCEModel::MarkovIPCM, KBase::PCEModel::MarkovUPCM }) {
+    auto pg = Model::scalarPCEGrad(numAct, numOpt, wMat, uMat, vr, vpm, pcem);
+    auto jac = get<1>(pg);
+    auto fd = KMatrix(numOpt, numAct);
+    for (unsigned int k = 0; k < numAct; k++) {
+      auto wP = wMat;
+      auto wM = wMat;
+      wP(0, k) = wP(0, k) + h * wMat(0, k);
+      wM(0, k) = wM(0, k) - h * wMat(0, k);
+      auto pP = Model::scalarPCE(numAct, numOpt, wP, uMat, vr, vpm, pcem, ReportingLevel::Silent);
+      auto pM = Model::scalarPCE(numAct, numOpt, wM, uMat, vr, vpm, pcem, ReportingLevel::Silent);
+      for (unsigned int i = 0; i < numOpt; i++) {
+        fd(i, k) = (pP(i, 0) - pM(i, 0)) / (2.0 * h * wMat(0, k));
+      }
+    }
+    const double tol = (KBase::PCEModel::MarkovUPCM == pcem) ? 1E-4 : 1E-6;
+    check(maxErr(jac, fd), tol, "scalarPCEGrad matches central differences for " + KBase::PCEModelNames[(int)pcem]);
+  }
+
+  // case 1 and case 2 each scale a different actor, and count different options,
+  // with thresholds high enough that both error terms are active
+  auto wAdj1 = KMatrix(1, numAct, 1.0);
+  auto wAdj2 = KMatrix(1, numAct, 1.0);
+  wAdj1(0, 0) = 0.5;
+  wAdj2(0, 1) = 2.0;
+  auto pSel1 = KMatrix(numOpt, 1);
+  auto pSel2 = KMatrix(numOpt, 1);
+  pSel1(0, 0) = 1.0;
+  pSel2(1, 0) = 1.0;
+  pSel2(2, 0) = 1.0;
+  auto pnt = KMatrix::uniform(&rng, numAct, 1, -0.5, +0.5);
+  auto cost = [&](const KMatrix & p, KMatrix * g) {
+    return get<0>(PMatrixModel::probCost(p, wMat, uMat, wAdj1, pSel1, 0.9, wAdj2, pSel2, 0.9,
+                                         100.0, ReportingLevel::Silent, g));
+  };
+  auto grad = KMatrix();
+  cost(pnt, &grad);
+  auto fd = KMatrix(numAct, 1);
+  for (unsigned int k = 0; k < numAct; k++) {
+    auto pP = pnt;
+    auto pM = pnt;
+    pP(k, 0) = pP(k, 0) + h;
+    pM(k, 0) = pM(k, 0) - h;
+    fd(k, 0) = (cost(pP, nullptr) - cost(pM, nullptr)) / (2.0 * h);
+  }
+  check(maxErr(grad, fd), 1E-6, "probCost gradient matches central differences");
+  return;
+}
+
 void genPMM(uint64_t sd) {
   if (0 == sd) {
     throw KException("genPMM: sd must not be zero");
@@ -292,17 +373,23 @@ int main(int ac, char **av) {
   bool run = true;
   bool pmm = false;
   bool fit = false;
+  bool grad = false;
   string fitFileCSV = "";
+  unsigned int numStarts = 1;
 
   auto showHelp = []() {
     printf("\n");
     printf("Usage: specify one or more of these options\n");
     printf("--fit <file>  read CSV file and fit to it \n");
+    printf("--grad        check the exact PCE and fitting-cost gradients \n");
+    printf("              against central differences \n");
     printf("--help        print this message \n");
     printf("--pmm         run random PMatrixModel \n");
     printf("--seed <n>    set a 64bit seed \n");
     printf("              0 means truly random \n");
     printf("              default: %020llu \n", dSeed);
+    printf("--starts <n>  with --fit, search from n starting points \n");
+    printf("              default: 1 \n");
   };
 
   // tmp args
@@ -319,6 +406,13 @@ int main(int ac, char **av) {
         i++;
         fitFileCSV = av[i];
       }
+      else if (strcmp(av[i], "--starts") == 0) {
+        i++;
+        numStarts = std::stoul(av[i]);
+      }
+      else if (strcmp(av[i], "--grad") == 0) {
+        grad = true;
+      }
       else if (strcmp(av[i], "--pmm") == 0) {
         pmm = true;
       }
@@ -384,7 +478,7 @@ int main(int ac, char **av) {
 
   if (fit) {
     try {
-      PMatDemo::fitFile(fitFileCSV, seed);
+      PMatDemo::fitFile(fitFileCSV, seed, numStarts);
     }
     catch (KBase::KException &ke) {
       LOG(INFO) << ke.msg;
@@ -394,6 +488,18 @@ int main(int ac, char **av) {
     }
   }
 
+  if (grad) {
+    try {
+      PMatDemo::demoGradients(seed);
+    }
+    catch (KBase::KException &ke) {
+      LOG(INFO) << ke.msg;
+    }
+    catch (...) {
+      LOG(INFO) << "Unknown exception from PMatDemo::demoGradients";
+    }
+  }
+
 
   delete rng;
   KBase::displayProgramEnd(sTime);
@@ -42,6 +42,9 @@ namespace PMatDemo {
 void runPMM(uint64_t s, bool cpP, const KMatrix& wMat, const KMatrix& uMat, const vector<string> & aNames);
 FittingParameters pccCSV(const string fs);
 
+// compare the exact gradients of scalarPCEGrad and probCost to central differences
+void demoGradients(uint64_t sd);
+
 }
 // end of namespace
 
@@ -24,6 +24,7 @@
 #include "rplib.h"
 #include "hcsearch.h"
 #include "kmodel.h"
+#include "klog.h"
 
 namespace RfrmPri
 {
@@ -47,9 +48,20 @@ using KBase::KException;
 // return vector of neighboring 1- and 2-permutations
 vector <MtchPstn>  nghbrPerms(const MtchPstn & mp0)
 {
-  const unsigned int numI = mp0.match.size();
   auto mpVec = vector <MtchPstn>();
-  mpVec.push_back(MtchPstn(mp0));
+  forNghbrPerms(mp0, [&mpVec](const MtchPstn & mp) {
+    mpVec.push_back(mp);
+  });
+  return mpVec;
+}; // end of nghbrPerms
+
+
+void forNghbrPerms(const MtchPstn & mp0, function<void(const MtchPstn &)> fn)
+{
+  const unsigned int numI = mp0.match.size();
+  // each neighbor is made in place, then put back the way it was
+  auto mp = MtchPstn(mp0);
+  fn(mp);
 
   // one-permutations
   for (unsigned int i = 0; i < numI; i++)
@@ -59,10 +71,11 @@ vector <MtchPstn>  nghbrPerms(const MtchPstn & mp0)
       unsigned int ei = mp0.match[i];
       unsigned int ej = mp0.match[j];
 
-      auto mij = MtchPstn(mp0);
-      mij.match[i] = ej;
-      mij.match[j] = ei;
-      mpVec.push_back(mij);
+      mp.match[i] = ej;
+      mp.match[j] = ei;
+      fn(mp);
+      mp.match[i] = ei;
+      mp.match[j] = ej;
     }
   }
 
@@ -78,26 +91,24 @@ vector <MtchPstn>  nghbrPerms(const MtchPstn & mp0)
         unsigned int ej = mp0.match[j];
         unsigned int ek = mp0.match[k];
 
-        auto mjki = MtchPstn(mp0);
-        mjki.match[i] = ej;
-        mjki.match[j] = ek;
-        mjki.match[k] = ei;
-        mpVec.push_back(mjki);
+        mp.match[i] = ej;
+        mp.match[j] = ek;
+        mp.match[k] = ei;
+        fn(mp);
 
-        auto mkij = MtchPstn(mp0);
-        mkij.match[i] = ek;
-        mkij.match[j] = ei;
-        mkij.match[k] = ej;
-        mpVec.push_back(mkij);
+        mp.match[i] = ek;
+        mp.match[j] = ei;
+        mp.match[k] = ej;
+        fn(mp);
 
+        mp.match[i] = ei;
+        mp.match[j] = ej;
+        mp.match[k] = ek;
       }
     }
   }
-  //unsigned int mvs = mpVec.size() ;
-  //cout << mvs << endl << flush;
-  //cout << flush;
-  return mpVec;
-}; // end of nghbrPerms
+  return;
+}; // end of forNghbrPerms
 // -------------------------------------------------
 // class-method definitions
 
@@ -152,41 +163,51 @@ KMatrix RPState::expUtilMat(KBase::ReportingLevel rl,
     throw KException("KMatrix RPState::expUtilMat: Number of columns in uMat should be equal to num of positions");
   }
 
-  auto assertRange = [](const KMatrix& m, unsigned int i, unsigned int j)
+  auto vkij = [this, uMat](unsigned int k, unsigned int i, unsigned int j)   // vote_k(i:j)
+  {
+    auto ak = (const RPActor*)(rpMod->actrs[k]);
+    auto v_kij = Model::vote(ak->vr, ak->sCap, uMat(k, i), uMat(k, j));
+    return v_kij;
+  };
+
+  // the following uses exactly the values in the given euMat,
+  // which may or may not be square
+  const KMatrix c = Model::coalitions(vkij, uMat.numR(), uMat.numC());
+  return expUtilMat(rl, numA, numP, vpm, uMat, c);
+};
+
+
+KMatrix RPState::expUtilMat(KBase::ReportingLevel rl,
+                            unsigned int numA,
+                            unsigned int numP,
+                            KBase::VPModel vpm,
+                            const KMatrix & uMat,
+                            const KMatrix & c) const
+{
+  if (numP != c.numR()) {
+    throw KException("KMatrix RPState::expUtilMat: Number of rows in the coalition matrix should be equal to num of positions");
+  }
+  if ((c.numR() != uMat.numC()) || (c.numC() != uMat.numC())) {
+    throw KException("KMatrix RPState::expUtilMat: coalition matrix must be square, one row per option");
+  }
+  // due to round-off error, we must have a tolerance factor
+  auto assertRange = [](const KMatrix& m, unsigned int i, unsigned int j, const string & name)
   {
-    // due to round-off error, we must have a tolerance factor
     const double tol = 1E-10;
     const double mij = m(i, j);
-    if ((mij + tol < 0.0) || (1.0 + tol < mij))
-    {
+    if ((0.0 > mij + tol) || (mij > 1.0 + tol)) {
       LOG(INFO) << KBase::getFormattedString("%f  %i  %i ", mij, i, j);
-    }
-    if (0.0 > mij + tol) {
-      throw KException("KMatrix RPState::expUtilMat: mij should be slightly above 0.0");
-    }
-    if (mij > 1.0 + tol) {
-      throw KException("KMatrix RPState::expUtilMat: mij should be slightly below 1.0");
+      throw KException("KMatrix RPState::expUtilMat: " + name + " should be within [0,1]");
     }
     return;
   };
 
-  auto uRng = [assertRange, uMat](unsigned int i, unsigned int j)
-  {
-    assertRange(uMat, i, j);
+  auto uRng = [assertRange, &uMat](unsigned int i, unsigned int j) {
+    assertRange(uMat, i, j, "uMat");
     return;
   };
   KMatrix::mapV(uRng, uMat.numR(), uMat.numC());
 
-  auto vkij = [this, uMat](unsigned int k, unsigned int i, unsigned int j)   // vote_k(i:j)
-  {
-    auto ak = (const RPActor*)(rpMod->actrs[k]);
-    auto v_kij = Model::vote(ak->vr, ak->sCap, uMat(k, i), uMat(k, j));
-    return v_kij;
-  };
-
-  // the following uses exactly the values in the given euMat,
-  // which may or may not be square
-  const KMatrix c = Model::coalitions(vkij, uMat.numR(), uMat.numC());
   const auto pv2 = Model::probCE2(rpMod->pcem, vpm, c);
   const auto p = get<0>(pv2); // column
   const auto pv = get<1>(pv2); //square
@@ -198,7 +219,7 @@ KMatrix RPState::expUtilMat(KBase::ReportingLevel rl,
     throw KException("KMatrix RPState::expUtilMat: eu must be a column matrix");
   }
   auto euRng = [assertRange, eu](unsigned int i, unsigned int j) {
-    assertRange(eu, i, j);
+    assertRange(eu, i, j, "eu");
     return;
   };
   KMatrix::mapV(euRng, eu.numR(), eu.numC());
@@ -716,8 +737,6 @@ double RPModel::utilActorPos(unsigned int ai, const VUI &pstn) const {
     throw KException("RPModel::utilActorPos: Size of actrs should be equal to actor's count");
   }
   auto rai = ((const RPActor*)(actrs[ai]));
-  const double pvMin = rai->posValMin;
-  const double pvMax = rai->posValMax;
   if (nullptr == rai) {
     throw KException("RPModel::utilActorPos: rai is null pointer");
   }
@@ -733,14 +752,16 @@ double RPModel::utilActorPos(unsigned int ai, const VUI &pstn) const {
   {
     unsigned int rj = pstn[j];
     double cj = govCost(0, rj);
-    double uij = prob[j] * rai->riVals[rj];
-    if (govBudget < costSoFar + cj)
-    {
-      uij = uij * obFactor;
-    }
-    uip = uip + uij;
+    uip = uip + itemUtil(rai, j, rj, costSoFar + cj);
     costSoFar = costSoFar + cj;
   }
+  return normUtil(rai, uip);
+}
+
+
+double RPModel::normUtil(const RPActor * ra, double uip) const {
+  const double pvMin = ra->posValMin;
+  const double pvMax = ra->posValMax;
   if (pvMin < pvMax)   // normalization is configured
   {
     uip = (uip - pvMin) / (pvMax - pvMin);
@@ -756,6 +777,59 @@ double RPModel::utilActorPos(unsigned int ai, const VUI &pstn) const {
 }
 
 
+RPModel::PermUtil RPModel::permUtil(const VUI & pstn) const {
+  if (0 >= govBudget) {
+    throw KException("RPModel::permUtil: govtBudget must be positive");
+  }
+  const unsigned int n = pstn.size();
+  auto pu = PermUtil();
+  pu.pstn = pstn;
+  pu.cost = vector<double>(n, 0.0);
+  double costSoFar = 0;
+  for (unsigned int j = 0; j < n; j++) {
+    costSoFar = costSoFar + govCost(0, pstn[j]);
+    pu.cost[j] = costSoFar;
+  }
+  pu.terms = vector<vector<double>>(numAct, vector<double>(n, 0.0));
+  pu.raw = vector<double>(numAct, 0.0);
+  for (unsigned int ai = 0; ai < numAct; ai++) {
+    auto rai = ((const RPActor*)(actrs[ai]));
+    double uip = 0.0;
+    for (unsigned int j = 0; j < n; j++) {
+      const double tj = itemUtil(rai, j, pstn[j], pu.cost[j]);
+      pu.terms[ai][j] = tj;
+      uip = uip + tj;
+    }
+    pu.raw[ai] = uip;
+  }
+  return pu;
+}
+
+
+double RPModel::utilActorPos(unsigned int ai, const VUI &pstn, const PermUtil & pu,
+                             unsigned int lo, unsigned int hi) const {
+  if (ai >= numAct) {
+    throw KException("RPModel::utilActorPos: actor index should be less than actor count");
+  }
+  if ((pstn.size() != pu.pstn.size()) || (hi >= pstn.size())) {
+    throw KException("RPModel::utilActorPos: permutation does not match the cached one");
+  }
+  auto rai = ((const RPActor*)(actrs[ai]));
+  const auto & t = pu.terms[ai];
+
+  // Swapping items within [lo, hi] changes the running cost only there,
+  // so only those terms can cross the budget breakpoint.
+  double costSoFar = (0 < lo) ? pu.cost[lo - 1] : 0.0;
+  double uip = pu.raw[ai];
+  for (unsigned int j = lo; j <= hi; j++) {
+    const unsigned int rj = pstn[j];
+    costSoFar = costSoFar + govCost(0, rj);
+    uip = uip - t[j] + itemUtil(rai, j, rj, costSoFar);
+  }
+  return normUtil(rai, uip);
+}
+
+
 void RPModel::showHist() const
 {
   for (unsigned int i = 0; i < history.size(); i++)
@@ -900,8 +974,8 @@ RPState* RPState::doSUSN(ReportingLevel rl) const {
     return expUtilMat(rl, numA, numP, vpm, uMat);
   };
   auto euState = euMat(u);
-  LOG(INFO) << "Actor expected utilities: ";
-  KBase::trans(euState).mPrintf("%6.4f, ");
+  KLOG(ReportingLevel::Low) << "Actor expected utilities: ";
+  KLOG_MATRIX(ReportingLevel::Low, KBase::trans(euState), "%6.4f, ");
 
   if (ReportingLevel::Low < rl)
   {
@@ -931,6 +1005,15 @@ RPState* RPState::doSUSN(ReportingLevel rl) const {
   // Get expected-utility vector, one entry for each actor, in the current state.
   const KMatrix eu0 = euMat(uUnique); // 'u' with duplicates, 'uUnique' without duplicates
 
+  // Coalitions over every actor's current position. A hypothetical move by h
+  // changes only the row and column for h, so each evaluation copies the rest.
+  auto vkij = [this, u](unsigned int k, unsigned int i, unsigned int j)
+  {
+    auto ak = (const RPActor*)(rpMod->actrs[k]);
+    return Model::vote(ak->vr, ak->sCap, u(k, i), u(k, j));
+  };
+  const KMatrix C0 = Model::coalitions(vkij, numA, numA);
+
   RPState* s2 = new RPState(model);
   if (numA != s2->pstns.size()) { // pre-allocated by constructor, all nullptr's
     throw KException("RPState::equivNdx: postions size of s2 must be equal to actor count");
@@ -943,11 +1026,15 @@ RPState* RPState::doSUSN(ReportingLevel rl) const {
   // and stores it in s2.
   // To do that, it defines three functions for evaluation, neighbors, and show:
   // efn, nghbrPerms, and sfn.
-  auto newPosFn = [this, rl, euMat, u, eu0, s2](const unsigned int h)
+  auto newPosFn = [this, rl, vpm, u, eu0, C0, s2](const unsigned int h)
   {
     s2->pstns[h] = nullptr;
     auto ph = ((const MtchPstn *)(pstns[h]));
 
+    // Utility terms of the permutation whose neighbors are being scanned,
+    // so that each neighbor only re-scores the items it moved.
+    auto pu = std::make_shared<RPModel::PermUtil>();
+
     // Evaluate h's estimate of the expected utility, to h, of
     // advocating position mp. To do this, build a hypothetical utility matrix representing
     // h's estimates of the direct utilities to all other actors of h adopting this
@@ -956,7 +1043,7 @@ RPState* RPState::doSUSN(ReportingLevel rl) const {
     // and everyone else's actual position. Finally, compute the expected utility to
     // each actor, given that distribution, and pick out the value for h's expected utility.
     // That is the expected value to h of adopting the position.
-    auto efn = [this, euMat, rl, u, h](const MtchPstn & mph)
+    auto efn = [this, rl, vpm, u, C0, pu, h](const MtchPstn & mph)
     {
       // This correctly handles duplicated/unique options
       // We modify the given euMat so that the h-column
@@ -975,10 +1062,38 @@ RPState* RPState::doSUSN(ReportingLevel rl) const {
         throw KException("RPState::equivNdx: match's size in mph must be same as numItm in rpMod");
       }
       auto uh = uh0;
+      const VUI & perm = mph.match;
+      const unsigned int numI = perm.size();
+      bool cached = (pu->pstn.size() == numI);
+      unsigned int lo = 0;
+      unsigned int hi = 0;
+      if (cached)
+      {
+        // the neighbors differ from the base permutation only in [lo, hi]
+        lo = numI;
+        for (unsigned int l = 0; l < numI; l++)
+        {
+          if (perm[l] != pu->pstn[l])
+          {
+            if (numI == lo)
+            {
+              lo = l;
+            }
+            hi = l;
+          }
+        }
+      }
       for (unsigned int i = 0; i < rpMod->numAct; i++)
       {
-        auto ai = (RPActor*)(rpMod->actrs[i]);
-        double uih = ai->posUtil(&mph);
+        double uih = 0.0;
+        if (!cached)
+        {
+          uih = rpMod->utilActorPos(i, perm);
+        }
+        else
+        {
+          uih = rpMod->utilActorPos(i, perm, *pu, lo, hi);
+        }
         uh(i, h) = uih; // utility to actor i of this hypothetical position by h
       }
 
@@ -1038,6 +1153,41 @@ RPState* RPState::doSUSN(ReportingLevel rl) const {
         hypUtil.mPrintf(" %8.2f ");
       }
 
+      // Reuse the coalitions among unmoved positions, and recompute only
+      // those involving h's hypothetical column.
+      const double minC = 1E-8;
+      auto c = KMatrix(numU, numU);
+      for (unsigned int x = 0; x < numU; x++)
+      {
+        for (unsigned int y = 0; y < x; y++)
+        {
+          if ((h != uNdx[x]) && (h != uNdx[y]))
+          {
+            c(x, y) = C0(uNdx[x], uNdx[y]);
+            c(y, x) = C0(uNdx[y], uNdx[x]);
+            continue;
+          }
+          double cxy = minC;
+          double cyx = minC;
+          for (unsigned int k = 0; k < rpMod->numAct; k++)
+          {
+            auto ak = (const RPActor*)(rpMod->actrs[k]);
+            const double vkxy = Model::vote(ak->vr, ak->sCap, hypUtil(k, x), hypUtil(k, y));
+            if (vkxy > 0)
+            {
+              cxy = cxy + vkxy;
+            }
+            if (vkxy < 0)
+            {
+              cyx = cyx - vkxy;
+            }
+          }
+          c(x, y) = cxy;
+          c(y, x) = cyx;
+        }
+        c(x, x) = minC;
+      }
+
 
       if (ReportingLevel::Low < rl)
       {
@@ -1047,7 +1197,7 @@ RPState* RPState::doSUSN(ReportingLevel rl) const {
         LOG(INFO) << "Hypo-util minus base util:";
         (uh - uh0).mPrintf(" %+.4E ");
       }
-      const KMatrix eu = euMat(hypUtil); // uh or hypUtil
+      const KMatrix eu = expUtilMat(rl, rpMod->numAct, numU, vpm, hypUtil, c); // uh or hypUtil
       // BUG: If we use 'uh' here, it passes the (0 <= delta-EU) test, because
       // both hypothetical and actual are then calculated without dropping duplicates.
       // If we use 'hypUtil' here, it sometimes gets (delta-EU < 0), because
@@ -1073,7 +1223,12 @@ RPState* RPState::doSUSN(ReportingLevel rl) const {
 
     auto ghc = new KBase::GHCSearch<MtchPstn>();
     ghc->eval = efn;
-    ghc->nghbrs = nghbrPerms;
+    ghc->forNghbrs = [this, pu](const MtchPstn & mp0, function<void(const MtchPstn &)> fn)
+    {
+      *pu = rpMod->permUtil(mp0.match);
+      forNghbrPerms(mp0, fn);
+      return;
+    };
     ghc->show = sfn;
 
     auto rslt = ghc->run(*ph, // start from h's current positions
@@ -43,6 +43,7 @@ namespace RfrmPri {
 // namespace to hold everything related to the
 // "priority of reforms" CDMP. Note that KBase has no access.
 
+using std::function;
 using std::string;
 using std::tuple;
 using std::vector;
@@ -75,6 +76,9 @@ const string appVersion = "0.2";
 // return vector of neighboring 1- and 2-permutations
 vector <MtchPstn>  nghbrPerms(const MtchPstn & mp0);
 
+// call fn on each of those neighbors, in the same order, without building the vector
+void forNghbrPerms(const MtchPstn & mp0, function<void(const MtchPstn &)> fn);
+
 // -------------------------------------------------
 // class declarations
 
@@ -135,6 +139,22 @@ public:
 
   double utilActorPos(unsigned int ai, const VUI &pstn) const;
 
+  // The running cost and each actor's per-item terms for one priority list.
+  // A list which differs from it only within positions [lo, hi] can then be
+  // valued in O(hi-lo), rather than by walking the whole list again.
+  struct PermUtil {
+    VUI pstn = {};
+    vector<double> cost = {}; // total cost of items 0 through l
+    vector<vector<double>> terms = {}; // [actor][l]
+    vector<double> raw = {}; // unnormalized utility of pstn to each actor
+  };
+  PermUtil permUtil(const VUI & pstn) const;
+
+  // same as utilActorPos(ai, pstn), given that pstn equals pu.pstn outside [lo, hi].
+  // If lo > hi, the two lists are identical.
+  double utilActorPos(unsigned int ai, const VUI &pstn, const PermUtil & pu,
+                      unsigned int lo, unsigned int hi) const;
+
   unsigned int govBudget = 0;
   KMatrix  govCost = KMatrix();
   double pDecline = 0.850;
@@ -159,6 +179,13 @@ protected:
   void initScen3Top4(unsigned int ns); // unfinished
   void configScen(unsigned int numA, const double aCap[], const KMatrix & utils);
 
+  // value to actor ra of having item rj at place j, when items 0 through j cost costThru
+  double itemUtil(const RPActor * ra, unsigned int j, unsigned int rj, double costThru) const {
+    const double uij = prob[j] * ra->riVals[rj];
+    return (govBudget < costThru) ? uij * obFactor : uij;
+  };
+  double normUtil(const RPActor * ra, double uip) const;
+
 private:
 };
 
@@ -190,6 +217,9 @@ protected:
   // Given the utility matrix, uMat, calculate the expected utility to each actor,
   // as a column-vector. Again, this is from the perspective of whoever developed uMat.
   KMatrix  expUtilMat(KBase::ReportingLevel rl, unsigned int numA, unsigned int numP, KBase::VPModel vpm, const KMatrix & uMat) const;
+  // as above, with the coalition matrix for uMat already in hand
+  KMatrix  expUtilMat(KBase::ReportingLevel rl, unsigned int numA, unsigned int numP, KBase::VPModel vpm,
+                      const KMatrix & uMat, const KMatrix & c) const;
 
   const RPModel * rpMod = nullptr; // saves a lot of type-casting later
 
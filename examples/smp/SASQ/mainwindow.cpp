@@ -36,6 +36,7 @@ MainWindow::MainWindow()
     createConnections();
 
     runSmp = new RunModel;
+    connect(runSmp,SIGNAL(runCompleted(bool)),this,SLOT(modelRunCompleted(bool)));
     updatedDataModel= new QStandardItemModel();
     updatedAccModel = new QStandardItemModel();
 }
@@ -295,6 +296,12 @@ void MainWindow::createActions()
     connect(logMinimumAct, SIGNAL(clicked(bool)), this,SLOT(logMinimumStatus(bool)));
     fileToolBar->addWidget(logMinimumAct);
 
+    QCheckBox * exportSpecsAct = new QCheckBox(" Export Spec Files  ", this);
+    exportSpecsAct->setChecked(false);
+    exportSpecsAct->setToolTip("Also save each specification as an xml file");
+    connect(exportSpecsAct, SIGNAL(clicked(bool)), this,SLOT(exportSpecsStatus(bool)));
+    fileToolBar->addWidget(exportSpecsAct);
+
     seedLineEdit=new QLineEdit(this);
     seedLineEdit->setPlaceholderText("Seed...");
     seedLineEdit->setMaximumWidth(200);
@@ -553,6 +560,11 @@ void MainWindow::logMinimumStatus(bool bl)
     logMin=bl;
 }
 
+void MainWindow::exportSpecsStatus(bool bl)
+{
+    exportSpecs=bl;
+}
+
 void MainWindow::about()
 {
     QMessageBox::about(this, tr("About KTAB SAS"),
@@ -604,9 +616,15 @@ void MainWindow::saveClicked(bool bl)
 
 }
 
+void MainWindow::modelRunCompleted(bool cancelled)
+{
+    statusBar()->showMessage(cancelled ? "Cancelled" : "Completed");
+}
+
 void MainWindow::runSpecModel(bool bl)
 {
     runFileNamesList.clear();
+    specRuns.clear();
     //Generate Seed
     using KBase::dSeed;
     uint64_t seed = dSeed;
@@ -693,8 +711,8 @@ void MainWindow::runSpecModel(bool bl)
     QApplication::processEvents();
     //Run SMP Model
     statusBar()->showMessage("Please wait ! SMP Model Run in progress This will take some time to complete !");
-    runSmp->runSMPModel(runFileNamesList,logMin,seedVal,dbFilePath,logType,logFilePath);
-    statusBar()->showMessage("Completed");
+    // returns at once, the specs run in the background until runCompleted
+    runSmp->runSMPScenarios(baseScenario,specRuns,logMin,seedVal,dbFilePath,logType,logFilePath);
     qDebug()<<"runSmpModelXMLFiles";
     //clear
     dummy=0;
@@ -1140,6 +1158,10 @@ void MainWindow::generateModelforScenZ()
     }
     parameters.append(modelDimNames);
 
+    // scen 0 is the base itself, the other specs are changes to it
+    buildBaseScenario();
+    appendSpecRun(std::vector<SMPLib::ScenarioOverride>());
+
     QStringList fileNameSplit = fileNameM.split(".");
     QString file = fileNameSplit.at(0);
     file.append("_scen_" + QString::number(dummy)+ ".xml");
@@ -1152,8 +1174,11 @@ void MainWindow::generateModelforScenZ()
     }
 
     // emit model and save to xml file
-    emit generateXMLFile(parameters,updatedDataModel,updatedAccModel,file);
-    runFileNamesList.append(file);
+    if(exportSpecs)
+    {
+        emit generateXMLFile(parameters,updatedDataModel,updatedAccModel,file);
+        runFileNamesList.append(file);
+    }
 
 
     delete updatedDataModel;
@@ -1220,6 +1245,8 @@ void MainWindow::updateDataModelRowColumn(QVector<QString> rhsList)
         qDebug()<<actorDataModel->rowCount() << "RC" << updatedDataModel->rowCount();
         qDebug()<<actorDataModel->columnCount() << "CC" << updatedDataModel->columnCount();
 
+        std::vector<SMPLib::ScenarioOverride> overrides;
+
         //updating Data Model with values
         for(int r=0; r<rowIndices.length(); ++r)
         {
@@ -1228,6 +1255,7 @@ void MainWindow::updateDataModelRowColumn(QVector<QString> rhsList)
                 QStandardItem * item = new QStandardItem(rhsList.at(modelCount));
 
                 updatedDataModel->setItem(rowIndices.at(r),columnIndices.at(c),item);
+                appendCellOverride(overrides,rowIndices.at(r),columnIndices.at(c),rhsList.at(modelCount));
             }
         }
 
@@ -1239,6 +1267,13 @@ void MainWindow::updateDataModelRowColumn(QVector<QString> rhsList)
                 QStandardItem * item = new QStandardItem(rhsList.at(modelCount));
 
                 updatedAccModel->setItem(accRowIndices.at(r),accColumnIndices.at(c),item);
+
+                SMPLib::ScenarioOverride acc;
+                acc.field = SMPLib::ScenarioField::Accommodation;
+                acc.i = accRowIndices.at(r);
+                acc.j = accColumnIndices.at(c);
+                acc.value = rhsList.at(modelCount).toDouble();
+                overrides.push_back(acc);
             }
         }
 
@@ -1286,9 +1321,14 @@ void MainWindow::updateDataModelRowColumn(QVector<QString> rhsList)
             updatedAccModel->setHorizontalHeaderItem(i,new QStandardItem(updatedDataModel->item(i)->text()));
             updatedAccModel->setVerticalHeaderItem(i,new QStandardItem(updatedDataModel->item(i)->text()));
         }
+        appendSpecRun(overrides);
+
         // emit model and save to xml file
-        emit generateXMLFile(parameters,updatedDataModel,updatedAccModel,file);
-        runFileNamesList.append(file);
+        if(exportSpecs)
+        {
+            emit generateXMLFile(parameters,updatedDataModel,updatedAccModel,file);
+            runFileNamesList.append(file);
+        }
 
     }
     delete updatedDataModel;
@@ -1360,6 +1400,8 @@ void MainWindow::updateFilterCrossProdRowColumn(QVector<QString> rhsList)
         }
     }
 
+    std::vector<SMPLib::ScenarioOverride> overrides;
+
     for(int modelCount = 0 ; modelCount < rhsList.length(); ++modelCount)
     {
         if(specType.at(modelCount)==1)
@@ -1367,6 +1409,7 @@ void MainWindow::updateFilterCrossProdRowColumn(QVector<QString> rhsList)
             QStandardItem * item = new QStandardItem(QString(rhsList.at(modelCount)));
 
             updatedDataModel->setItem(rowIndices.at(actIn),columnIndices.at(actIn),item);
+            appendCellOverride(overrides,rowIndices.at(actIn),columnIndices.at(actIn),rhsList.at(modelCount));
             ++actIn;
         }
         if(specType.at(modelCount)==2)
@@ -1374,6 +1417,13 @@ void MainWindow::updateFilterCrossProdRowColumn(QVector<QString> rhsList)
             QStandardItem * item = new QStandardItem(QString(rhsList.at(modelCount)));
 
             updatedAccModel->setItem(accRowIndices.at(accIn),accColumnIndices.at(accIn),item);
+
+            SMPLib::ScenarioOverride acc;
+            acc.field = SMPLib::ScenarioField::Accommodation;
+            acc.i = accRowIndices.at(accIn);
+            acc.j = accColumnIndices.at(accIn);
+            acc.value = rhsList.at(modelCount).toDouble();
+            overrides.push_back(acc);
             ++accIn;
         }
         if(specType.at(modelCount)==0)
@@ -1414,14 +1464,112 @@ void MainWindow::updateFilterCrossProdRowColumn(QVector<QString> rhsList)
         updatedAccModel->setVerticalHeaderItem(i,new QStandardItem(updatedDataModel->item(i)->text()));
     }
 
+    appendSpecRun(overrides);
+
     // emit model and save to xml file
-    emit generateXMLFile(parameters,updatedDataModel,updatedAccModel,file);
-    runFileNamesList.append(file);
+    if(exportSpecs)
+    {
+        emit generateXMLFile(parameters,updatedDataModel,updatedAccModel,file);
+        runFileNamesList.append(file);
+    }
 
     statusBar()->showMessage(" Done ...");
 
 }
 
+void MainWindow::buildBaseScenario()
+{
+    const int actors = actorDataModel->rowCount();
+    const int dims = modelDimNames.length();
+
+    baseScenario = SMPLib::SMPScenario();
+    baseScenario.name = actorScenarioList.at(0).toStdString();
+    baseScenario.desc = actorScenarioList.at(1).toStdString();
+    baseScenario.seed = seedVal.toULongLong();
+    baseScenario.cap = KMatrix(actors, 1);
+    baseScenario.pos = KMatrix(actors, dims);
+    baseScenario.sal = KMatrix(actors, dims);
+    baseScenario.accM = KMatrix(actors, actors);
+
+    for(int d = 0; d < dims; ++d)
+    {
+        baseScenario.dimNames.push_back(modelDimNames.at(d).toStdString());
+    }
+
+    // the data model holds positions and saliences on the 0-100 scale of the xml files
+    for(int i = 0; i < actors; ++i)
+    {
+        baseScenario.actorNames.push_back(actorDataModel->item(i,0)->text().toStdString());
+        baseScenario.actorDescs.push_back(actorDataModel->item(i,1)->text().toStdString());
+        baseScenario.cap(i, 0) = actorDataModel->item(i,2)->text().toDouble();
+        for(int d = 0; d < dims; ++d)
+        {
+            baseScenario.pos(i, d) = actorDataModel->item(i,3+(d*2))->text().toDouble() / 100.0;
+            baseScenario.sal(i, d) = actorDataModel->item(i,4+(d*2))->text().toDouble() / 100.0;
+        }
+        for(int j = 0; j < actors; ++j)
+        {
+            baseScenario.accM(i, j) = actorAccModel->item(i,j)->text().toDouble();
+        }
+    }
+}
+
+void MainWindow::appendCellOverride(std::vector<SMPLib::ScenarioOverride> & ovr, int row, int col, QString value)
+{
+    SMPLib::ScenarioOverride o;
+    o.i = row;
+    if(2 == col)
+    {
+        o.field = SMPLib::ScenarioField::Capability;
+        o.value = value.toDouble();
+    }
+    else if(3 <= col)
+    {
+        o.field = ((col-3)%2 == 0) ? SMPLib::ScenarioField::Position : SMPLib::ScenarioField::Salience;
+        o.j = (col-3)/2;
+        o.value = value.toDouble() / 100.0;
+    }
+    else
+    {
+        // names and descriptions are not part of a run
+        return;
+    }
+    ovr.push_back(o);
+}
+
+void MainWindow::appendSpecRun(std::vector<SMPLib::ScenarioOverride> ovr)
+{
+    SpecRun spec;
+    spec.name = QString("Scen_"+QString::number(dummy)+";"+actorScenarioList.at(0));
+    spec.desc = QString("Scen_"+QString::number(dummy)+";"+actorScenarioList.at(1));
+
+    // model parameters changed by earlier specs carry over, so every spec sets all of them
+    std::vector<std::string> names;
+    for(int p = 0; p < modelParams.count(); ++p)
+    {
+        names.push_back(modelParams.at(p).toStdString());
+    }
+    try
+    {
+        std::vector<int> params = SMPLib::SMPModel::modelParametersFromNames(names);
+        for(unsigned int p = 0; p < params.size(); ++p)
+        {
+            SMPLib::ScenarioOverride o;
+            o.field = SMPLib::ScenarioField::ModelParameter;
+            o.i = p;
+            o.value = params.at(p);
+            ovr.push_back(o);
+        }
+    }
+    catch(KBase::KException & ke)
+    {
+        displayMessage("Specifications", QString::fromStdString(ke.msg));
+    }
+
+    spec.overrides = ovr;
+    specRuns.append(spec);
+}
+
 void MainWindow::saveSpecsToFile(int specTypeIndex)
 {
     QString fileName;
@@ -107,8 +107,10 @@ private slots:
     void about();
     void clearSpecifications(bool bl);
     void runSpecModel(bool bl);
+    void modelRunCompleted(bool cancelled);
     void displayMessage(QString cls, QString message);
     void logMinimumStatus(bool bl);
+    void exportSpecsStatus(bool bl);
 
 
     //GUI Initialization
@@ -197,6 +199,11 @@ private :
 
     QStringList runFileNamesList;
 
+    // the scenario the specs change, and the changes of each spec
+    SMPLib::SMPScenario baseScenario;
+    QList<SpecRun> specRuns;
+    bool exportSpecs = false;
+
     QLineEdit * seedLineEdit;
     bool logMin = true;
     QString seedVal;
@@ -239,6 +246,9 @@ private:
     void updateDataModelRowColumn(QVector<QString> rhsList);
     void updateFilterCrossProdRowColumn(QVector<QString> rhsList);
     void saveSpecsToFile(int specTypeIndex);
+    void buildBaseScenario();
+    void appendCellOverride(std::vector<SMPLib::ScenarioOverride> & ovr, int row, int col, QString value);
+    void appendSpecRun(std::vector<SMPLib::ScenarioOverride> ovr);
 
     //    void logSMPDataOptionsAnalysis();
 };
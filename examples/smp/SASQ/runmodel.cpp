@@ -10,96 +10,387 @@ RunModel::RunModel()
 
 RunModel::~RunModel()
 {
+    if(specWatcher != nullptr && specWatcher->isRunning())
+    {
+        specWatcher->cancel();
+        specWatcher->waitForFinished();
+    }
+    delete progressDlg;
 
 }
 
 void RunModel::runSMPModel(QStringList fileNames, bool logStatus, QString seedVal, QString dbFilePath, QString logType, QString logFileLoc)
 {
-    logFileName.clear();
-    logFileLocation = logFileLoc;
+    if(!startRun(dbFilePath,logType,logFileLoc))
+    {
+        return;
+    }
 
-    QString con = configureDbRun(dbFilePath);
+    // JAH 20160730 vector of SQL logging flags for 5 groups of tables:
+    // 0 = Information Tables, 1 = Position Tables, 2 = Challenge Tables,
+    // 3 = Bargain Resolution Tables, 4 = VectorPosition table
+    // JAH 20161010 added group 4 for only VectorPos so it can be logged alone
+    std::vector<bool> sqlFlags = {true,true,true,true,true};
 
-    for( int fileIndex = 0 ; fileIndex < fileNames.length() ; ++ fileIndex)
+    //log minimum
+    if(true==logStatus)
     {
-        logSMPDataOptionsAnalysis(logType,QString("_spec_"+ QString::number(fileIndex)));
-        runModel(con,fileNames.at(fileIndex),logStatus,seedVal);
-        qDebug()<<"runModel" << fileIndex;
-//        fclose(coutbuf);
+        sqlFlags = {true,false,false,false,true};
     }
 
-    QMessageBox::information(0,"Done", "Model run completed");
-    qDebug()<<"here";
-}
+    uint64_t seed = seedVal.toULongLong();
 
+    // returns an empty string on success, else the reason the spec failed
+    std::function<QString(const QString &)> runSpec = [this, sqlFlags, seed](const QString & fileName)
+    {
+        const QString shard = shardForThread();
+        auto sTime = KBase::displayProgramStart(DemoSMP::appName, DemoSMP::appVersion);
+        QString err;
+        try
+        {
+            SMPLib::SMPModel::runModelInstance(sqlFlags, fileName.toStdString(), seed,
+                                               std::vector<int>(), shard.toStdString());
+        }
+        catch(KBase::KException & ke)
+        {
+            err = QString::fromStdString(ke.msg);
+        }
+        catch(std::exception & ex)
+        {
+            err = QString(ex.what());
+        }
+        catch(...)
+        {
+            err = QString("unknown exception");
+        }
+        KBase::displayProgramEnd(sTime);
+        return err.isEmpty() ? err : QFileInfo(fileName).fileName() + ": " + err;
+    };
 
-QString RunModel::configureDbRun(QString dbFilePath)
+    watchRun(QtConcurrent::mapped(fileNames, runSpec), fileNames.length());
+}
+
+void RunModel::runSMPScenarios(const SMPLib::SMPScenario & base, const QList<SpecRun> & specs, bool logStatus,
+                               QString seedVal, QString dbFilePath, QString logType, QString logFileLoc)
 {
-    if(!dbFilePath.isEmpty())
+    if(!startRun(dbFilePath,logType,logFileLoc))
     {
-        QString connectionStr;
-        connectionStr.append("Driver=QSQLITE;");//connectionType
-        connectionStr.append("Database=").append(dbFilePath.remove(".db").trimmed()).append(";");
+        return;
+    }
 
-        qDebug() <<connectionStr;
-        //        dbPath = dbFilePath;
+    std::vector<bool> sqlFlags = {true,true,true,true,true};
+    if(true==logStatus)
+    {
+        sqlFlags = {true,false,false,false,true};
+    }
 
-        //Configure DB
-        SMPLib::SMPModel::loginCredentials(connectionStr.toStdString());
+    SMPLib::SMPScenario scen = base;
+    scen.seed = seedVal.toULongLong();
 
-        return connectionStr;
+    // the base is shared read-only, every spec works on its own copy
+    std::function<QString(const SpecRun &)> runSpec = [this, sqlFlags, scen](const SpecRun & spec)
+    {
+        const QString shard = shardForThread();
+        auto sTime = KBase::displayProgramStart(DemoSMP::appName, DemoSMP::appVersion);
+        QString err;
+        try
+        {
+            SMPLib::SMPScenario specScen = SMPLib::SMPModel::applyOverrides(scen, spec.overrides);
+            specScen.name = spec.name.toStdString();
+            specScen.desc = spec.desc.toStdString();
+            SMPLib::SMPModel::runModelInstance(specScen, sqlFlags, shard.toStdString());
+        }
+        catch(KBase::KException & ke)
+        {
+            err = QString::fromStdString(ke.msg);
+        }
+        catch(std::exception & ex)
+        {
+            err = QString(ex.what());
+        }
+        catch(...)
+        {
+            err = QString("unknown exception");
+        }
+        KBase::displayProgramEnd(sTime);
+        return err.isEmpty() ? err : spec.name + ": " + err;
+    };
+
+    watchRun(QtConcurrent::mapped(specs, runSpec), specs.length());
+}
+
+bool RunModel::startRun(QString dbFilePath, QString logType, QString logFileLoc)
+{
+    if(specWatcher != nullptr && specWatcher->isRunning())
+    {
+        QMessageBox::information(0,"Busy", "A model run is already in progress");
+        return false;
     }
 
-    return "";
+    logFileName.clear();
+    logFileLocation = logFileLoc;
 
+    QString con = configureDbRun(dbFilePath);
+    if(con.isEmpty())
+    {
+        emit runCompleted(false);
+        return false;
+    }
+
+    // the loggers are global, so all the specs of a run share one log
+    logSMPDataOptionsAnalysis(logType,QString("_specs"));
+
+    resultsDBName = dbFilePath;
+    resultsDBName = resultsDBName.remove(".db").trimmed();
+    shardDBs.clear();
+    return true;
 }
 
-void RunModel::runModel(QString conStr, QString fileName, bool logStatus, QString seedVal)
+void RunModel::watchRun(QFuture<QString> specs, int specCount)
 {
+    if(specWatcher == nullptr)
+    {
+        specWatcher = new QFutureWatcher<QString>(this);
+        connect(specWatcher,SIGNAL(finished()),this,SLOT(specRunsFinished()));
+
+        progressDlg = new QProgressDialog("Running specifications ...", "Cancel", 0, 0);
+        progressDlg->setWindowModality(Qt::NonModal);
+        progressDlg->setMinimumDuration(0);
+        connect(specWatcher,SIGNAL(progressRangeChanged(int,int)),progressDlg,SLOT(setRange(int,int)));
+        connect(specWatcher,SIGNAL(progressValueChanged(int)),progressDlg,SLOT(setValue(int)));
+        connect(progressDlg,SIGNAL(canceled()),this,SLOT(cancelRun()));
+    }
 
-    auto sTime = KBase::displayProgramStart(DemoSMP::appName, DemoSMP::appVersion);
+    progressDlg->setRange(0, specCount);
+    progressDlg->setValue(0);
+    progressDlg->show();
 
-    std::vector<int> parameters;
+    specWatcher->setFuture(specs);
+}
 
-    //    parameters={0,0,0,0,0,0,0,0,0}; // need to update
+void RunModel::cancelRun()
+{
+    // specs already running are allowed to finish, the rest are never started
+    if(specWatcher != nullptr && specWatcher->isRunning())
+    {
+        specWatcher->cancel();
+    }
+}
 
-    QString currentScenarioId;
-    QString connectDBString;
-    connectDBString = conStr;
-    //    qDebug()<<connectDBString << "db";
+void RunModel::specRunsFinished()
+{
+    progressDlg->hide();
 
-    if(!connectDBString.isEmpty())
+    const bool cancelled = specWatcher->isCanceled();
+    QStringList failures;
+    for(const QString & err : specWatcher->future().results())
     {
-        // A code snippet from Demosmp.cpp to run the model
+        if(!err.isEmpty())
+        {
+            failures.append(err);
+        }
+    }
+
+    QString mergeErr = mergeShards();
 
+    QString msg = cancelled ? QString("Model run cancelled") : QString("Model run completed");
+    if(!failures.isEmpty())
+    {
+        msg.append(QString("\n%1 specification(s) failed:\n").arg(failures.length()));
+        msg.append(failures.join("\n"));
+    }
+    if(!mergeErr.isEmpty())
+    {
+        msg.append("\nCould not merge the results: ").append(mergeErr);
+    }
 
-        uint64_t seed = seedVal.toULongLong();
+    QMessageBox::information(0,"Done", msg);
+    emit runCompleted(cancelled);
+}
 
-        // JAH 20160730 vector of SQL logging flags for 5 groups of tables:
-        // 0 = Information Tables, 1 = Position Tables, 2 = Challenge Tables,
-        // 3 = Bargain Resolution Tables, 4 = VectorPosition table
-        // JAH 20161010 added group 4 for only VectorPos so it can be logged alone
-        std::vector<bool> sqlFlags = {true,true,true,true,true};
+QString RunModel::shardForThread()
+{
+    QMutexLocker lock(&shardMtx);
+    QThread * th = QThread::currentThread();
+    if(!shardDBs.contains(th))
+    {
+        shardDBs.insert(th, QString("%1_shard%2.db").arg(resultsDBName).arg(shardDBs.size()));
+    }
+    return shardDBs.value(th);
+}
 
-        //log minimum
-        if(true==logStatus)
+QString RunModel::mergeShards()
+{
+    QString err;
+    QStringList indexSQL;
+    QStringList keptShards; // not fully merged, so left on disk with their results
+    const QString connName("sasqMerge");
+    {
+        QSqlDatabase mdb = QSqlDatabase::addDatabase("QSQLITE", connName);
+        mdb.setDatabaseName(resultsDBName + ".db");
+        if(!mdb.open())
         {
-            sqlFlags = {true,false,false,false,true};
+            err = mdb.lastError().text();
+            keptShards = shardDBs.values();
         }
+        else
+        {
+            QSqlQuery qry(mdb);
+            QSqlQuery rows(mdb);
+            for(const QString & shard : shardDBs.values())
+            {
+                if(!QFile::exists(shard))
+                {
+                    continue;
+                }
+                qry.prepare("ATTACH DATABASE :shard AS shard");
+                qry.bindValue(":shard", shard);
+                if(!qry.exec())
+                {
+                    err = qry.lastError().text();
+                    keptShards.append(shard);
+                    continue;
+                }
+
+                // read the schema first, the main DB's schema changes while copying
+                QStringList types, names, sqls;
+                qry.exec("SELECT type, name, sql FROM shard.sqlite_master WHERE sql IS NOT NULL");
+                while(qry.next())
+                {
+                    types.append(qry.value(0).toString());
+                    names.append(qry.value(1).toString());
+                    sqls.append(qry.value(2).toString());
+                }
+                qry.finish();
+
+                // keyed shards number their scenarios from 1 each, so their keys would collide
+                if(names.contains("ScenarioKeys"))
+                {
+                    err = QString("%1 uses the keyed schema, which cannot be merged").arg(shard);
+                    qry.exec("DETACH DATABASE shard");
+                    keptShards.append(shard);
+                    continue;
+                }
+
+                // a shard is merged whole or not at all
+                bool merged = mdb.transaction();
+                QStringList shardIndexSQL;
+                QStringList shardViewSQL;
+                for(int n = 0; merged && (n < types.length()); ++n)
+                {
+                    const QString type = types.at(n);
+                    const QString name = names.at(n);
+                    const QString sql = sqls.at(n);
+
+                    rows.prepare("SELECT count(*) FROM main.sqlite_master WHERE type = :type AND name = :name");
+                    rows.bindValue(":type", type);
+                    rows.bindValue(":name", name);
+                    const bool exists = rows.exec() && rows.next() && (0 < rows.value(0).toInt());
+
+                    if(0 == type.compare("table"))
+                    {
+                        // name the columns, an existing table may order them differently
+                        QStringList cols;
+                        if(rows.exec(QString("PRAGMA shard.table_info(%1)").arg(name)))
+                        {
+                            while(rows.next())
+                            {
+                                cols.append(rows.value(1).toString());
+                            }
+                        }
+                        const QString colList = cols.join(", ");
+                        if(cols.isEmpty())
+                        {
+                            err = QString("could not read the columns of %1 in %2").arg(name).arg(shard);
+                            merged = false;
+                        }
+                        else if((!exists && !rows.exec(sql)) ||
+                                !rows.exec(QString("INSERT INTO main.%1 (%2) SELECT %2 FROM shard.%1").arg(name).arg(colList)))
+                        {
+                            err = rows.lastError().text();
+                            merged = false;
+                        }
+                    }
+                    else if(0 == type.compare("view") && !exists)
+                    {
+                        // views may read tables later in the list
+                        shardViewSQL.append(sql);
+                    }
+                    else if(0 == type.compare("index") && !exists && !indexSQL.contains(sql))
+                    {
+                        // indices are built once all the rows are in
+                        shardIndexSQL.append(sql);
+                    }
+                }
+                for(int n = 0; merged && (n < shardViewSQL.length()); ++n)
+                {
+                    if(!rows.exec(shardViewSQL.at(n)))
+                    {
+                        err = rows.lastError().text();
+                        merged = false;
+                    }
+                }
+                rows.finish();
+                if(merged && !mdb.commit())
+                {
+                    err = mdb.lastError().text();
+                    merged = false;
+                }
+                if(!merged)
+                {
+                    mdb.rollback();
+                }
+
+                qry.exec("DETACH DATABASE shard");
+                if(merged)
+                {
+                    indexSQL.append(shardIndexSQL);
+                    QFile::remove(shard);
+                }
+                else
+                {
+                    keptShards.append(shard);
+                }
+            }
+
+            for(const QString & sql : indexSQL)
+            {
+                qry.exec(sql);
+            }
+            qry.finish();
+            rows.finish();
+            mdb.close();
+        }
+    }
+    QSqlDatabase::removeDatabase(connName);
+    shardDBs.clear();
 
-        // Notice that we NEVER use anything but the default seed.
-        //        printf("Using PRNG seed:  %020llu \n", seed);
-        //        printf("Same seed in hex:   0x%016llX \n", seed);
+    if(!keptShards.isEmpty())
+    {
+        err.append(QString("\nThese shards were not merged, and were kept: %1").arg(keptShards.join(", ")));
+    }
+    return err;
+}
 
+QString RunModel::configureDbRun(QString dbFilePath)
+{
+    if(!dbFilePath.isEmpty())
+    {
+        QString connectionStr;
+        connectionStr.append("Driver=QSQLITE;");//connectionType
+        connectionStr.append("Database=").append(dbFilePath.remove(".db").trimmed()).append(";");
 
-        currentScenarioId =QString::fromStdString(SMPLib::SMPModel::runModel
-                                                  (sqlFlags,
-                                                   fileName.toStdString(),seed,false,parameters));
+        qDebug() <<connectionStr;
+        //        dbPath = dbFilePath;
 
-        KBase::displayProgramEnd(sTime);
+        //Configure DB
+        SMPLib::SMPModel::loginCredentials(connectionStr.toStdString());
 
+        return connectionStr;
     }
 
+    return "";
+
 }
 
 void RunModel::logSMPDataOptionsAnalysis(QString logType, QString specCount)
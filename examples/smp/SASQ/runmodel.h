@@ -34,6 +34,11 @@
 #include <QStringList>
 
 #include <QMessageBox>
+#include <QProgressDialog>
+#include <QtConcurrent>
+#include <QFutureWatcher>
+#include <QMutex>
+#include <QtSql>
 #include <QMenu>
 #include <QtGlobal>
 #include <easylogging++.h>
@@ -102,7 +107,13 @@ using SMPLib::SMPState;
 
 } // end of namespace
 
-
+// One specification: the changes it makes to the base scenario
+struct SpecRun
+{
+    QString name;
+    QString desc;
+    std::vector<SMPLib::ScenarioOverride> overrides;
+};
 
 class RunModel : public QObject
 {
@@ -114,13 +125,38 @@ public:
 
 public slots:
     void runSMPModel(QStringList fileNames, bool logStatus, QString seedVal, QString dbFilePath, QString logType, QString logFileLoc);
+    void cancelRun();
 
+public:
+    // same as runSMPModel, but each spec is applied to a copy of the base
+    // scenario in memory, so no XML files are written or parsed
+    void runSMPScenarios(const SMPLib::SMPScenario & base, const QList<SpecRun> & specs, bool logStatus,
+                         QString seedVal, QString dbFilePath, QString logType, QString logFileLoc);
+
+signals:
+    void runCompleted(bool cancelled);
+
+private slots:
+    void specRunsFinished();
 
 private:
     QString configureDbRun(QString dbFilePath);
-    void runModel(QString conStr, QString fileName,bool logStatus, QString seedVal);
+    bool startRun(QString dbFilePath, QString logType, QString logFileLoc);
+    void watchRun(QFuture<QString> specs, int specCount);
     void logSMPDataOptionsAnalysis(QString logType, QString specCount);
 
+    // Specs run concurrently on the global thread pool, each on its own model
+    // instance. Every worker thread logs to its own shard DB, and the shards
+    // are merged into the results DB once all specs are done.
+    QString shardForThread();
+    QString mergeShards();
+
+    QFutureWatcher<QString> * specWatcher = nullptr;
+    QProgressDialog * progressDlg = nullptr;
+    QMutex shardMtx;
+    QMap<QThread*, QString> shardDBs;
+    QString resultsDBName; // without the .db extension
+
     el::Configurations loggerConf;
     QString logFileName;
     QString logFileLocation;
@@ -42,10 +42,16 @@ Database::Database()
     addDatabase("QSQLITE");
 
     yAxisLen=0;
+
+    cacheWatcher = new QFutureWatcher<ScenarioCache>(this);
+    connect(cacheWatcher,SIGNAL(finished()),this,SLOT(scenarioCacheReady()));
 }
 
 Database::~Database()
 {
+    if(cacheWatcher->isRunning()) {
+        cacheWatcher->waitForFinished();
+    }
     if(qry != nullptr) {
         delete qry;
         qry = nullptr;
@@ -81,9 +87,14 @@ void Database::openDB(QString dbPath, QString dbType, QString connectionString,
 
         if(db->isOpen())
         {
+            clearCache();
+
             // Scenarios list in db
             getScenarioList(run);
 
+            // the remaining turns are loaded in the background
+            prefetchScenario();
+
             getActorsDescriptionDB();
 
             // to update numActors in db
@@ -137,7 +148,11 @@ void Database::openDB(QString dbPath, QString dbType, QString connectionString,
             connectionValues = pwd.split("=");
             pwd  = connectionValues.at(1);
 
-            if(!db->open(uId,pwd))
+            // kept on the connection so the prefetch can open its own
+            db->setUserName(uId);
+            db->setPassword(pwd);
+
+            if(!db->open())
             {
                 emit Message("Database Error", db->lastError().text());
             }
@@ -145,9 +160,14 @@ void Database::openDB(QString dbPath, QString dbType, QString connectionString,
             {
                 qry = new QSqlQuery(*db);
 
+                clearCache();
+
                 // Scenarios list in db
                 getScenarioList(run);
 
+                // the remaining turns are loaded in the background
+                prefetchScenario();
+
                 getActorsDescriptionDB();
 
                 // to update numActors in db
@@ -239,7 +259,12 @@ void Database::checkPostgresDB(QString connectionString, bool imp)
 
 void Database::getScenarioData(int turn, QString scenario,int dim)
 {
-    scenarioM=scenario;
+    if(scenario != scenarioM)
+    {
+        scenarioM=scenario;
+        clearCache();
+        prefetchScenario();
+    }
     //model parameters for current scenario
     getModelParameters();
 
@@ -259,8 +284,9 @@ void Database::getStateCount()
 void Database::getDimensionCount()
 {
     dimensionsList = new QStringList;
-    QString query= QString("select Dim_k, 'Desc' from DimensionDescription where ScenarioId = '%1'").arg(scenarioM);
-    qry->exec(query);
+    qry->prepare("select Dim_k, 'Desc' from DimensionDescription where ScenarioId = :scen");
+    qry->bindValue(":scen", scenarioM);
+    qry->exec();
 
     while(qry->next())
     {
@@ -276,9 +302,9 @@ void Database::getActorsDescriptionDB()
     actorNameList.clear();
     actorDescList.clear();
 
-    QString query= QString("select Name,'DESC' from ActorDescription  where ScenarioId = '%1' ").arg(scenarioM);
-
-    qry->exec(query);
+    qry->prepare("select Name,'DESC' from ActorDescription  where ScenarioId = :scen ");
+    qry->bindValue(":scen", scenarioM);
+    qry->exec();
 
     while(qry->next())
     {
@@ -293,14 +319,24 @@ void Database::getInfluenceDB(int turn)
 {
     actorInfluence.clear();
 
-    QString query= QString(" select SpatialCapability.Cap from SpatialCapability,ActorDescription where "
-                           " ActorDescription.Act_i = SpatialCapability.Act_i "
-                           " and SpatialCapability.ScenarioId='%1' "
-                           " and ActorDescription.ScenarioId='%1'"
-                           " and SpatialCapability.Turn_t='%2' "
-                           ).arg(scenarioM).arg(turn);
+    if(useCache() && turn < cache.numStates)
+    {
+        for(int act = 0; act < cache.numActors; ++act)
+        {
+            actorInfluence.append(QVariant(cache.capability(turn,act)).toString());
+        }
+        emit actorsInflu(actorInfluence);
+        return;
+    }
 
-    qry->exec(query);
+    qry->prepare(" select SpatialCapability.Cap from SpatialCapability,ActorDescription where "
+                 " ActorDescription.Act_i = SpatialCapability.Act_i "
+                 " and ActorDescription.ScenarioId = SpatialCapability.ScenarioId "
+                 " and SpatialCapability.ScenarioId = :scen "
+                 " and SpatialCapability.Turn_t = :turn ");
+    qry->bindValue(":scen", scenarioM);
+    qry->bindValue(":turn", turn);
+    qry->exec();
 
     while(qry->next())
     {
@@ -314,19 +350,30 @@ void Database::getPositionDB(int dim, int turn)
 {
     actorPosition.clear();
 
-    QString query= QString(" select VectorPosition.Pos_Coord from VectorPosition,ActorDescription where"
-                           " ActorDescription.Act_i = VectorPosition.Act_i"
-                           " and VectorPosition.ScenarioId='%2' "
-                           " and ActorDescription.ScenarioId='%2'"
-                           " and VectorPosition.Turn_t='%3'"
-                           " and VectorPosition.dim_k='%1'")
-            .arg(dim).arg(scenarioM).arg(turn);
-
-    qry->exec(query);
-
-    while(qry->next())
+    if(useCache() && turn < cache.numStates && dim < cache.numDims)
     {
-        actorPosition.append(qry->value(0).toString());
+        for(int act = 0; act < cache.numActors; ++act)
+        {
+            actorPosition.append(QVariant(cache.position(turn,act,dim)).toString());
+        }
+    }
+    else
+    {
+        qry->prepare(" select VectorPosition.Pos_Coord from VectorPosition,ActorDescription where"
+                     " ActorDescription.Act_i = VectorPosition.Act_i"
+                     " and ActorDescription.ScenarioId = VectorPosition.ScenarioId"
+                     " and VectorPosition.ScenarioId = :scen "
+                     " and VectorPosition.Turn_t = :turn"
+                     " and VectorPosition.dim_k = :dim");
+        qry->bindValue(":scen", scenarioM);
+        qry->bindValue(":turn", turn);
+        qry->bindValue(":dim", dim);
+        qry->exec();
+
+        while(qry->next())
+        {
+            actorPosition.append(qry->value(0).toString());
+        }
     }
     if(actorPosition.length()>0)
         emit actorsPostn(actorPosition,dim);
@@ -337,15 +384,26 @@ void Database::getSalienceDB(int dim, int turn)
 {
     actorSalience.clear();
 
-    QString query= QString(" select SpatialSalience.Sal from SpatialSalience,ActorDescription where"
-                           " ActorDescription.Act_i = SpatialSalience.Act_i"
-                           " and SpatialSalience.ScenarioId='%2' "
-                           " and ActorDescription.ScenarioId='%2' "
-                           " and SpatialSalience.Turn_t='%3'"
-                           " and SpatialSalience.dim_k='%1'")
-            .arg(dim).arg(scenarioM).arg(turn);
+    if(useCache() && turn < cache.numStates && dim < cache.numDims)
+    {
+        for(int act = 0; act < cache.numActors; ++act)
+        {
+            actorSalience.append(QVariant(cache.salience(turn,act,dim)).toString());
+        }
+        emit actorsSalnce(actorSalience,dim);
+        return;
+    }
 
-    qry->exec(query);
+    qry->prepare(" select SpatialSalience.Sal from SpatialSalience,ActorDescription where"
+                 " ActorDescription.Act_i = SpatialSalience.Act_i"
+                 " and ActorDescription.ScenarioId = SpatialSalience.ScenarioId"
+                 " and SpatialSalience.ScenarioId = :scen "
+                 " and SpatialSalience.Turn_t = :turn"
+                 " and SpatialSalience.dim_k = :dim");
+    qry->bindValue(":scen", scenarioM);
+    qry->bindValue(":turn", turn);
+    qry->bindValue(":dim", dim);
+    qry->exec();
 
     while(qry->next())
     {
@@ -360,9 +418,18 @@ void Database::getAffinityDB()
     actorJ.clear();
     actorAffinity.clear();
 
-    QString query= QString(" select Act_i, Act_j, Affinity from Accommodation where ScenarioId='%1' ").arg(scenarioM);
+    if(useCache())
+    {
+        actorI = cache.affI;
+        actorJ = cache.affJ;
+        actorAffinity = cache.affinity;
+        emit actorsAffinity(actorAffinity,actorI,actorJ);
+        return;
+    }
 
-    qry->exec(query);
+    qry->prepare(" select Act_i, Act_j, Affinity from Accommodation where ScenarioId = :scen ");
+    qry->bindValue(":scen", scenarioM);
+    qry->exec();
 
     while(qry->next())
     {
@@ -383,44 +450,41 @@ void Database::getActorsInRangeFromDB(double lowerRng, double higherRng, int dim
     actorCapabilityList.clear();
     barData=0;
 
-    QString query= QString(" select Act_i from VectorPosition where"
-                           " Pos_Coord >= '%1'  AND Pos_Coord < '%2' AND "
-                           " Dim_k='%3' AND ScenarioId='%4' "
-                           "AND Turn_t='%5'")
-            .arg(lwr).arg(upr).arg(dim).arg(scenarioM).arg(turn);
-
-    qry->exec(query);
-
-    while(qry->next())
-    {
-        actorIdsList.append(qry->value(0).toInt());
-    }
-
-    for(int actInd =0; actInd < actorIdsList.length() ; actInd++)
+    if(useCache() && turn < cache.numStates && dim < cache.numDims)
     {
-        QString query= QString(" select Sal from SpatialSalience where"
-                               " Act_i = '%1' AND ScenarioId='%2' AND Turn_t='%3'"
-                               " AND Dim_k='%4'")
-                .arg(actorIdsList.at(actInd)).arg(scenarioM).arg(turn).arg(dim);
-
-        qry->exec(query);
-
-        while(qry->next())
+        for(int act = 0; act < cache.numActors; ++act)
         {
-            actorSalienceList.append(qry->value(0).toDouble());
+            double p = cache.position(turn,act,dim);
+            if(p >= lwr && p < upr)
+            {
+                actorIdsList.append(act);
+                actorSalienceList.append(cache.salience(turn,act,dim));
+                actorCapabilityList.append(cache.capability(turn,act));
+            }
         }
     }
-    for(int actInd =0; actInd < actorIdsList.length() ; actInd++)
+    else
     {
-        QString query1= QString(" select Cap from SpatialCapability where"
-                                " Act_i = '%1' AND ScenarioId='%2' AND Turn_t='%3'")
-                .arg(actorIdsList.at(actInd)).arg(scenarioM).arg(turn);
-
-        qry->exec(query1);
+        // one joined query instead of one query per actor for salience and capability
+        qry->prepare(" select P.Act_i, S.Sal, C.Cap from VectorPosition as P"
+                     " inner join SpatialSalience as S on S.ScenarioId = P.ScenarioId"
+                     " and S.Turn_t = P.Turn_t and S.Act_i = P.Act_i and S.Dim_k = P.Dim_k"
+                     " inner join SpatialCapability as C on C.ScenarioId = P.ScenarioId"
+                     " and C.Turn_t = P.Turn_t and C.Act_i = P.Act_i"
+                     " where P.Pos_Coord >= :lwr AND P.Pos_Coord < :upr AND"
+                     " P.Dim_k = :dim AND P.ScenarioId = :scen AND P.Turn_t = :turn");
+        qry->bindValue(":lwr", lwr);
+        qry->bindValue(":upr", upr);
+        qry->bindValue(":dim", dim);
+        qry->bindValue(":scen", scenarioM);
+        qry->bindValue(":turn", turn);
+        qry->exec();
 
         while(qry->next())
         {
-            actorCapabilityList.append(qry->value(0).toDouble());
+            actorIdsList.append(qry->value(0).toInt());
+            actorSalienceList.append(qry->value(1).toDouble());
+            actorCapabilityList.append(qry->value(2).toDouble());
         }
     }
 
@@ -450,8 +514,9 @@ void Database::getActorsInRangeFromDB(double lowerRng, double higherRng, int dim
 void Database::getDims()
 {
     dimList = new QStringList;
-    QString query= QString("select 'Desc' from DimensionDescription where ScenarioId = '%1'").arg(scenarioM);
-    qry->exec(query);
+    qry->prepare("select 'Desc' from DimensionDescription where ScenarioId = :scen");
+    qry->bindValue(":scen", scenarioM);
+    qry->exec();
 
     while(qry->next())
     {
@@ -464,19 +529,28 @@ void Database::getUtilChlgAndSQvalues(QVector<int> VHAxisValues)
 {
     if(10==VHAxisValues.length())
     {
-        QString query = QString(" select H.diff as Hori_Coord, V.diff as Vert_Coord from "
-                                "(select Turn_t,Est_h,Aff_k,Init_i,Rcvr_j,Util_Chlg - Util_SQ as diff from UtilChlg "
-                                " where ScenarioId = '%1' and  Turn_t = '%2' and Init_i = '%3' and Rcvr_j = '%4' "
-                                " and aff_k = '%5' and est_h = '%6') as V "
-                                " inner join "
-                                "(select Turn_t,Est_h,Aff_k,Init_i,Rcvr_j,Util_Chlg - Util_SQ as diff from UtilChlg "
-                                " where ScenarioId = '%1' and Turn_t = '%2' and Init_i = '%3' and Rcvr_j ='%4' "
-                                " and aff_k = '%7' and est_h = '%8') as H "
-                                " on (V.Turn_t = H.Turn_t) and (V.Init_i = H.Init_i) and (V.Rcvr_j = H.Rcvr_j)")
-                .arg(scenarioM).arg(VHAxisValues[0]).arg(VHAxisValues[3]).arg(VHAxisValues[4])
-                .arg(VHAxisValues[2]).arg(VHAxisValues[1]).arg(VHAxisValues[7]).arg(VHAxisValues[6]);
-
-        qry->exec(query);
+        qry->prepare(" select H.diff as Hori_Coord, V.diff as Vert_Coord from "
+                     "(select Turn_t,Est_h,Aff_k,Init_i,Rcvr_j,Util_Chlg - Util_SQ as diff from UtilChlg "
+                     " where ScenarioId = :scenV and  Turn_t = :turnV and Init_i = :initV and Rcvr_j = :rcvrV "
+                     " and aff_k = :affV and est_h = :estV) as V "
+                     " inner join "
+                     "(select Turn_t,Est_h,Aff_k,Init_i,Rcvr_j,Util_Chlg - Util_SQ as diff from UtilChlg "
+                     " where ScenarioId = :scenH and Turn_t = :turnH and Init_i = :initH and Rcvr_j = :rcvrH "
+                     " and aff_k = :affH and est_h = :estH) as H "
+                     " on (V.Turn_t = H.Turn_t) and (V.Init_i = H.Init_i) and (V.Rcvr_j = H.Rcvr_j)");
+        qry->bindValue(":scenV", scenarioM);
+        qry->bindValue(":turnV", VHAxisValues[0]);
+        qry->bindValue(":initV", VHAxisValues[3]);
+        qry->bindValue(":rcvrV", VHAxisValues[4]);
+        qry->bindValue(":affV", VHAxisValues[2]);
+        qry->bindValue(":estV", VHAxisValues[1]);
+        qry->bindValue(":scenH", scenarioM);
+        qry->bindValue(":turnH", VHAxisValues[0]);
+        qry->bindValue(":initH", VHAxisValues[3]);
+        qry->bindValue(":rcvrH", VHAxisValues[4]);
+        qry->bindValue(":affH", VHAxisValues[7]);
+        qry->bindValue(":estH", VHAxisValues[6]);
+        qry->exec();
 
         while(qry->next())
         {
@@ -489,6 +563,7 @@ void Database::getUtilChlgAndSQvalues(QVector<int> VHAxisValues)
 
 void Database::releaseDB()
 {
+    clearCache();
     if(db != nullptr) {
         if(db->open()) {
             db->close();
@@ -506,21 +581,21 @@ void Database::getActorMovedDataDB(QString scenario)
     int colIndex =0;
     int rowIndex =0;
 
-    QString query;
-
-    query= QString("select M.Movd_Turn, M.Act_i as Movd_ActorID, M.Dim_k, M.PrevPos, M.CurrPos, M.Diff, "
-                   "M.Mover_BargnID, MI.Name as Initiator, MR.Name as Receiver, B.Init_Act_i, B.Recd_Act_j "
-                   "from (select L0.Act_i, L0.Dim_k, L0.Turn_t as Movd_Turn, L0.Mover_BargnId, L0.Pos_Coord "
-                   "as CurrPos, L1.Pos_Coord as PrevPos, L0.Pos_Coord - L1.Pos_Coord as Diff "
-                   "from (select * from VectorPosition where Turn_t <> 0 and ScenarioID = '%1') "
-                   "as L0 inner join (select * from VectorPosition where ScenarioID = '%1') "
-                   "as L1 on L0.Turn_t = (L1.Turn_t+1) and L0.Act_i = L1.Act_i and L0.Dim_k = L1.Dim_k "
-                   "where L0.Pos_Coord <> L1.Pos_Coord ) as M inner join (select * from Bargn where "
-                   "ScenarioID = '%1') as B on M.Mover_BargnId = B.BargnId inner join "
-                   "ActorDescription as MI on B.Init_Act_i = MI.Act_i and B.ScenarioID = MI.ScenarioID inner join "
-                   "ActorDescription as MR on B.Recd_Act_j = MR.Act_i and B.ScenarioID = MR.ScenarioID  ").arg(scenario);
-
-    qry->exec(query);
+    qry->prepare("select M.Movd_Turn, M.Act_i as Movd_ActorID, M.Dim_k, M.PrevPos, M.CurrPos, M.Diff, "
+                 "M.Mover_BargnID, MI.Name as Initiator, MR.Name as Receiver, B.Init_Act_i, B.Recd_Act_j "
+                 "from (select L0.Act_i, L0.Dim_k, L0.Turn_t as Movd_Turn, L0.Mover_BargnId, L0.Pos_Coord "
+                 "as CurrPos, L1.Pos_Coord as PrevPos, L0.Pos_Coord - L1.Pos_Coord as Diff "
+                 "from (select * from VectorPosition where Turn_t <> 0 and ScenarioID = :scen0) "
+                 "as L0 inner join (select * from VectorPosition where ScenarioID = :scen1) "
+                 "as L1 on L0.Turn_t = (L1.Turn_t+1) and L0.Act_i = L1.Act_i and L0.Dim_k = L1.Dim_k "
+                 "where L0.Pos_Coord <> L1.Pos_Coord ) as M inner join (select * from Bargn where "
+                 "ScenarioID = :scen2) as B on M.Mover_BargnId = B.BargnId inner join "
+                 "ActorDescription as MI on B.Init_Act_i = MI.Act_i and B.ScenarioID = MI.ScenarioID inner join "
+                 "ActorDescription as MR on B.Recd_Act_j = MR.Act_i and B.ScenarioID = MR.ScenarioID  ");
+    qry->bindValue(":scen0", scenario);
+    qry->bindValue(":scen1", scenario);
+    qry->bindValue(":scen2", scenario);
+    qry->exec();
     while(qry->next())
     {
         actorMovedModel->setItem(rowIndex,colIndex,new QStandardItem(qry->value(0).toString().trimmed()));
@@ -548,30 +623,44 @@ QString Database::getConnectionName()
 
 void Database::getVectorPosition(int actor, int dim, int turn, QString scenario)
 {
-    QString query;
-
     int i =0;
     QVector<double> x(numStates+1), y(numStates+1);
 
-    query= QString("select * from VectorPosition where Act_i='%1' and Dim_k='%2' and Turn_t<='%3' and  ScenarioId = '%4' ")
-            .arg(actor).arg(dim).arg(turn).arg(scenario);
+    if(useCache() && scenario == cache.scenario && actor < cache.numActors && dim < cache.numDims)
+    {
+        for(int t = 0; t <= turn && t < cache.numStates; ++t)
+        {
+            x[i]=t;
+            y[i]=cache.position(t,actor,dim);// y scales from 0 to 100
+            ++i;
+        }
+        emit vectorPosition(x,y,cache.actorNames.at(actor),turn);
+        return;
+    }
 
-    qry->exec(query);
-    while(qry->next())
+    qry->prepare("select Turn_t, Pos_Coord from VectorPosition where Act_i = :act and Dim_k = :dim"
+                 " and Turn_t <= :turn and ScenarioId = :scen ");
+    qry->bindValue(":act", actor);
+    qry->bindValue(":dim", dim);
+    qry->bindValue(":turn", turn);
+    qry->bindValue(":scen", scenario);
+    qry->exec();
+    while(qry->next() && i < x.length())
     {
-        x[i]=qry->value(1).toDouble();
-        y[i]=qry->value(4).toDouble();// y scales from 0 to 100
+        x[i]=qry->value(0).toDouble();
+        y[i]=qry->value(1).toDouble();// y scales from 0 to 100
         ++i;
     }
 
     QString actorName;
 
-    QString query2 = QString("select * from ActorDescription where Act_i='%1' and ScenarioId='%2'")
-            .arg(actor).arg(scenario);
-    qry->exec(query2);
+    qry->prepare("select Name from ActorDescription where Act_i = :act and ScenarioId = :scen");
+    qry->bindValue(":act", actor);
+    qry->bindValue(":scen", scenario);
+    qry->exec();
     while(qry->next())
     {
-        actorName = qry->value(2).toString();
+        actorName = qry->value(0).toString();
     }
 
     emit vectorPosition(x,y,actorName,turn);
@@ -590,26 +679,38 @@ void Database::readVectorPositionTable(int turn, QString scenario, int dim)
     getAffinityDB();
 
     sqlmodel = new QStandardItemModel(this);
-    QString query;
-
-    query= QString("select * from VectorPosition where Turn_t='%1' and Dim_k='%2' and ScenarioId='%3'")
-            .arg(turn).arg(dim).arg(scenario);
-
-    qry->exec(query);
 
-    int rowindex =0;
-    while(qry->next())
+    if(useCache() && scenario == cache.scenario && dim < cache.numDims)
     {
-        QString value = qry->value(0).toString();
-        QString value1 = qry->value(1).toString();
+        for(int rowindex = 0; rowindex < cache.numActors; ++rowindex)
+        {
+            sqlmodel->setItem(rowindex,0,new QStandardItem(scenario.trimmed()));
+            sqlmodel->setItem(rowindex,1,new QStandardItem(QString::number(turn)));
+        }
+    }
+    else
+    {
+        qry->prepare("select ScenarioId, Turn_t from VectorPosition where Turn_t = :turn and Dim_k = :dim"
+                     " and ScenarioId = :scen");
+        qry->bindValue(":turn", turn);
+        qry->bindValue(":dim", dim);
+        qry->bindValue(":scen", scenario);
+        qry->exec();
+
+        int rowindex =0;
+        while(qry->next())
+        {
+            QString value = qry->value(0).toString();
+            QString value1 = qry->value(1).toString();
 
-        QStandardItem *item = new QStandardItem(value.trimmed());
-        QStandardItem *item1 = new QStandardItem(value1.trimmed());
+            QStandardItem *item = new QStandardItem(value.trimmed());
+            QStandardItem *item1 = new QStandardItem(value1.trimmed());
 
-        sqlmodel->setItem(rowindex,0,item);
-        sqlmodel->setItem(rowindex,1,item1);
+            sqlmodel->setItem(rowindex,0,item);
+            sqlmodel->setItem(rowindex,1,item1);
 
-        ++rowindex;
+            ++rowindex;
+        }
     }
     // load parsed data to model accordingly
     emit dbModel(sqlmodel);
@@ -632,7 +733,6 @@ void Database::readVectorPositionTableEdit(QString scenario)
 
     emit dbModelEdit(sqlmodelEdit);
 }
-
 void Database::getDatabaseList(bool imp, QString &connectionName)
 {
     postgresDBList = new QStringList;
@@ -680,12 +780,19 @@ void Database::getYaxisMaxLength(double range,int dim)//lower & higher range, di
     emit maxYaxisLen(yAxisLen);
 }
 
+
 void Database::getNumActors()
 {
-    QString query= QString("select Act_i from ActorDescription where ScenarioId='%1'" )
-            .arg(scenarioM);
+    if(useCache())
+    {
+        numActors = cache.numActors - 1;
+        emit actorCount(numActors);
+        return;
+    }
 
-    qry->exec(query);
+    qry->prepare("select Act_i from ActorDescription where ScenarioId = :scen");
+    qry->bindValue(":scen", scenarioM);
+    qry->exec();
 
     while(qry->next())
     {
@@ -696,10 +803,16 @@ void Database::getNumActors()
 
 void Database::getNumStates()
 {
-    QString query= QString("select DISTINCT Turn_t from VectorPosition where ScenarioId='%1'" )
-            .arg(scenarioM);
+    if(useCache())
+    {
+        numStates = cache.numStates - 1;
+        emit statesCount(numStates);
+        return;
+    }
 
-    qry->exec(query);
+    qry->prepare("select DISTINCT Turn_t from VectorPosition where ScenarioId = :scen");
+    qry->bindValue(":scen", scenarioM);
+    qry->exec();
 
     while(qry->next())
     {
@@ -754,9 +867,9 @@ void Database::getModelParameters()
 {
     scenarioModelParam.clear();
 
-    QString query= QString("select * from ScenarioDesc where ScenarioId='%1' ").arg(scenarioM);
-
-    qry->exec(query);
+    qry->prepare("select * from ScenarioDesc where ScenarioId = :scen ");
+    qry->bindValue(":scen", scenarioM);
+    qry->exec();
 
     while(qry->next())
     {
@@ -779,6 +892,189 @@ void Database::getModelParameters()
     else
         Message("Database","there are no/insufficient model parameters");
 }
+
+bool Database::useCache() const
+{
+    return (!cache.isEmpty()) && (cache.scenario == scenarioM);
+}
+
+void Database::clearCache()
+{
+    // a load still in flight is dropped when it finishes
+    ++cacheRequest;
+    cache = ScenarioCache();
+}
+
+void Database::prefetchScenario()
+{
+    if(db == nullptr || !db->isOpen() || scenarioM.isEmpty())
+    {
+        return;
+    }
+    if(useCache() || cacheWatcher->isRunning())
+    {
+        // scenarioCacheReady will start over if the running load is stale
+        return;
+    }
+
+    // QSqlDatabase connections can only be used by the thread that created them,
+    // so the worker opens its own connection with the same parameters
+    const int request = cacheRequest;
+    const QString driver = db->driverName();
+    const QString dbPath = db->databaseName();
+    const QString host = db->hostName();
+    const int port = db->port();
+    const QString user = db->userName();
+    const QString password = db->password();
+    const QString scenario = scenarioM;
+    QFuture<ScenarioCache> future = QtConcurrent::run([=]() {
+        return loadScenarioCache(request, driver, dbPath, host, port, user, password, scenario);
+    });
+    cacheWatcher->setFuture(future);
+}
+
+void Database::scenarioCacheReady()
+{
+    ScenarioCache loaded = cacheWatcher->result();
+    if(loaded.request == cacheRequest && loaded.scenario == scenarioM)
+    {
+        cache = loaded;
+    }
+    else
+    {
+        prefetchScenario();
+    }
+}
+
+ScenarioCache Database::loadScenarioCache(int request, QString driver, QString dbPath, QString host,
+                                          int port, QString user, QString password, QString scenario)
+{
+    ScenarioCache sc;
+    sc.request = request;
+    sc.scenario = scenario;
+
+    const QString connName = QString("cacheDb%1").arg(request);
+    {
+        QSqlDatabase cdb = QSqlDatabase::addDatabase(driver, connName);
+        cdb.setDatabaseName(dbPath);
+        if(!host.isEmpty())
+        {
+            cdb.setHostName(host);
+            cdb.setPort(port);
+        }
+
+        if(cdb.open(user,password))
+        {
+            QSqlQuery q(cdb);
+            q.setForwardOnly(true);
+
+            // sizes first, so every table below fills a dense array in a single pass
+            q.prepare("select max(Act_i) from ActorDescription where ScenarioId = :scen");
+            q.bindValue(":scen", scenario);
+            if(q.exec() && q.next() && !q.value(0).isNull())
+            {
+                sc.numActors = q.value(0).toInt() + 1;
+            }
+            q.prepare("select max(Turn_t), max(Dim_k) from VectorPosition where ScenarioId = :scen");
+            q.bindValue(":scen", scenario);
+            if(q.exec() && q.next() && !q.value(0).isNull())
+            {
+                sc.numStates = q.value(0).toInt() + 1;
+                sc.numDims = q.value(1).toInt() + 1;
+            }
+
+            const int na = sc.numActors;
+            const int nd = sc.numDims;
+            sc.actorNames = QVector<QString>(na);
+            sc.pos = QVector<double>(sc.numStates * na * nd, 0.0);
+            sc.sal = QVector<double>(sc.numStates * na * nd, 0.0);
+            sc.cap = QVector<double>(sc.numStates * na, 0.0);
+
+            auto inRange = [&sc](int t, int i) {
+                return (0 <= t) && (t < sc.numStates) && (0 <= i) && (i < sc.numActors);
+            };
+
+            q.prepare("select Act_i, Name from ActorDescription where ScenarioId = :scen");
+            q.bindValue(":scen", scenario);
+            if(q.exec())
+            {
+                while(q.next())
+                {
+                    int i = q.value(0).toInt();
+                    if(0 <= i && i < na)
+                    {
+                        sc.actorNames[i] = q.value(1).toString();
+                    }
+                }
+            }
+
+            q.prepare("select Turn_t, Act_i, Dim_k, Pos_Coord from VectorPosition where ScenarioId = :scen");
+            q.bindValue(":scen", scenario);
+            if(q.exec())
+            {
+                while(q.next())
+                {
+                    int t = q.value(0).toInt();
+                    int i = q.value(1).toInt();
+                    int k = q.value(2).toInt();
+                    if(inRange(t,i) && 0 <= k && k < nd)
+                    {
+                        sc.pos[(t*na + i)*nd + k] = q.value(3).toDouble();
+                    }
+                }
+            }
+
+            q.prepare("select Turn_t, Act_i, Dim_k, Sal from SpatialSalience where ScenarioId = :scen");
+            q.bindValue(":scen", scenario);
+            if(q.exec())
+            {
+                while(q.next())
+                {
+                    int t = q.value(0).toInt();
+                    int i = q.value(1).toInt();
+                    int k = q.value(2).toInt();
+                    if(inRange(t,i) && 0 <= k && k < nd)
+                    {
+                        sc.sal[(t*na + i)*nd + k] = q.value(3).toDouble();
+                    }
+                }
+            }
+
+            q.prepare("select Turn_t, Act_i, Cap from SpatialCapability where ScenarioId = :scen");
+            q.bindValue(":scen", scenario);
+            if(q.exec())
+            {
+                while(q.next())
+                {
+                    int t = q.value(0).toInt();
+                    int i = q.value(1).toInt();
+                    if(inRange(t,i))
+                    {
+                        sc.cap[t*na + i] = q.value(2).toDouble();
+                    }
+                }
+            }
+
+            q.prepare("select Act_i, Act_j, Affinity from Accommodation where ScenarioId = :scen");
+            q.bindValue(":scen", scenario);
+            if(q.exec())
+            {
+                while(q.next())
+                {
+                    sc.affI.append(q.value(0).toInt());
+                    sc.affJ.append(q.value(1).toInt());
+                    sc.affinity.append(q.value(2).toString());
+                }
+            }
+
+            q.finish();
+            cdb.close();
+        }
+    }
+    QSqlDatabase::removeDatabase(connName);
+
+    return sc;
+}
 // --------------------------------------------
 // Copyright KAPSARC. Open source MIT License.
 // --------------------------------------------
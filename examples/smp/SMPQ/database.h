@@ -31,6 +31,32 @@
 #include <QMessageBox>
 #include <QSqlError>
 #include <QStandardItemModel>
+#include <QtConcurrent>
+#include <QFutureWatcher>
+
+// All turns of one scenario, loaded in a few bulk queries so that the
+// sliders and graphs can be served from memory. Arrays are dense and
+// indexed by turn first, then actor, then dimension.
+struct ScenarioCache
+{
+    int request = 0; // which prefetch produced this, stale results are dropped
+    QString scenario;
+    int numActors = 0; // count, not the largest Act_i
+    int numStates = 0; // count of turns
+    int numDims = 0;
+    QVector<QString> actorNames;
+    QVector<double> pos;  // [(t*numActors + i)*numDims + k]
+    QVector<double> sal;  // [(t*numActors + i)*numDims + k]
+    QVector<double> cap;  // [t*numActors + i]
+    QVector<int> affI;
+    QVector<int> affJ;
+    QVector<QString> affinity;
+
+    bool isEmpty() const { return (0 == numActors) || (0 == numStates) || (0 == numDims); }
+    double position(int t, int i, int k) const { return pos[(t*numActors + i)*numDims + k]; }
+    double salience(int t, int i, int k) const { return sal[(t*numActors + i)*numDims + k]; }
+    double capability(int t, int i) const { return cap[t*numActors + i]; }
+};
 
 class Database : public QObject
 {
@@ -74,6 +100,10 @@ public slots :
     //get MaxYAxis len;
     void getYaxisMaxLength(double range, int dim);
 
+    //Scenario cache
+    void prefetchScenario();
+    void scenarioCacheReady();
+
 signals:
     void Message(QString , QString );
     void vectorPosition(QVector<double> x, QVector<double> y, QString actor,int turn);
@@ -168,6 +198,15 @@ private:
 
     void readVectorPositionTableEdit(QString scenario);
 
+    // whole-scenario cache, filled on a worker thread with its own connection
+    QFutureWatcher<ScenarioCache> * cacheWatcher = nullptr;
+    ScenarioCache cache;
+    int cacheRequest = 0;
+    bool useCache() const;
+    void clearCache();
+    static ScenarioCache loadScenarioCache(int request, QString driver, QString dbPath, QString host,
+                                           int port, QString user, QString password, QString scenario);
+
     //postgres
     void getDatabaseList(bool imp, QString &connectionName);
 
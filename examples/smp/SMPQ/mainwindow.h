@@ -52,6 +52,8 @@
 #endif
 
 #include <QDebug>
+#include <QtConcurrent>
+#include <QFutureWatcher>
 #include <QMessageBox>
 #include <QMenu>
 #include <QtGlobal>
@@ -488,6 +490,12 @@ private :
     QPushButton * plotQuadMap;
     int initiatorTip;
 
+    // the quad map grid is computed off the GUI thread
+    QFutureWatcher<QVector<QPointF>> * quadMapWatcher;
+    QVector<int> quadMapReceivers;
+    QString quadMapException;
+    int quadMapTurn;
+
     bool useHistory;
     bool sankeyOutputHistory;
     QString currentScenarioId;
@@ -498,7 +506,8 @@ private :
     void populateInitiatorsAndReceiversRadioButtonsAndCheckBoxes();
     void populatePerspectiveComboBox();
     void populateQuadMapStateRange(int states);
-    void getUtilChlgHorizontalVerticalAxisData(int turn);
+    // returns false if nothing was launched on the worker thread
+    bool getUtilChlgHorizontalVerticalAxisData(int turn);
     void getUtilChlgHorizontalAxisData(int turn);
     void plotScatterPointsOnGraph(QVector<double> x, QVector<double> y, int actIndex);
     void plotDeltaValues();
@@ -516,6 +525,7 @@ private slots :
 
     void quadMapUtilChlgandSQValues(int turn, double hor, double ver,
                                     int actorID);
+    void quadMapPointsReady();
 
     void xAxisRangeChangedQuad(QCPRange newRange, QCPRange oldRange);
     void yAxisRangeChangedQuad(QCPRange newRange, QCPRange oldRange);
@@ -102,6 +102,9 @@ void MainWindow::initializeQuadMapDock()
     connect(quadMapTurnSlider,SIGNAL(valueChanged(int)),this,SLOT(quadMapTurnSliderChanged(int)));
 
     populatePerspectiveComboBox();
+
+    quadMapWatcher = new QFutureWatcher<QVector<QPointF>>(this);
+    connect(quadMapWatcher,SIGNAL(finished()),this,SLOT(quadMapPointsReady()));
 }
 
 void MainWindow::initializeQuadMapPlot()
@@ -328,13 +331,12 @@ void MainWindow::populateQuadMapStateRange(int states)
     connect(turnSlider,SIGNAL(valueChanged(int)),quadMapTurnSlider,SLOT(setValue(int)));
 }
 
-void MainWindow::getUtilChlgHorizontalVerticalAxisData(int turn)
+bool MainWindow::getUtilChlgHorizontalVerticalAxisData(int turn)
 {
     deltaUtilV.clear();
     deltaUtilH.clear();
+    actorIdIndexH.clear();
 
-    int affK=0;
-    int estH=0;
     int initI=0;
 
     for(int initiatorIndex=0; initiatorIndex < actorsName.length(); ++ initiatorIndex)
@@ -345,153 +347,154 @@ void MainWindow::getUtilChlgHorizontalVerticalAxisData(int turn)
         initiatorTip=initI;
     }
 
+    QVector<int> receivers;
     for(int recdJ =0; recdJ < actorsName.length(); ++recdJ)
     {
         if(true==quadMapReceiversCheckBoxList.at(recdJ)->isChecked()
                 && true == quadMapReceiversCheckBoxList.at(recdJ)->isVisible())
         {
-            if(0==perspectiveComboBox->currentIndex()) // initiators
-            {
-                VHAxisValues.clear();
-                estH=affK=initI;
-                VHAxisValues.append(turn);
-                VHAxisValues.append(estH);
-                VHAxisValues.append(affK);
-                VHAxisValues.append(initI);
-                VHAxisValues.append(recdJ);
-
-                estH=initI;
-                affK=recdJ;
-                VHAxisValues.append(turn);
-                VHAxisValues.append(estH);
-                VHAxisValues.append(affK);
-                VHAxisValues.append(initI);
-                VHAxisValues.append(recdJ);
-            }
-            else if(1==perspectiveComboBox->currentIndex()) // receivers
-            {
-                VHAxisValues.clear();
-                affK=initI;
-                estH=recdJ;
-                VHAxisValues.append(turn);
-                VHAxisValues.append(estH);
-                VHAxisValues.append(affK);
-                VHAxisValues.append(initI);
-                VHAxisValues.append(recdJ);
-
-                estH=affK=recdJ;
-                VHAxisValues.append(turn);
-                VHAxisValues.append(estH);
-                VHAxisValues.append(affK);
-                VHAxisValues.append(initI);
-                VHAxisValues.append(recdJ);
-            }
-            else if(2==perspectiveComboBox->currentIndex()) //objective
-            {
-                VHAxisValues.clear();
-                estH=affK=initI;
-                VHAxisValues.append(turn);
-                VHAxisValues.append(estH);
-                VHAxisValues.append(affK);
-                VHAxisValues.append(initI);
-                VHAxisValues.append(recdJ);
-
-                estH=affK=recdJ;
-                VHAxisValues.append(turn);
-                VHAxisValues.append(estH);
-                VHAxisValues.append(affK);
-                VHAxisValues.append(initI);
-                VHAxisValues.append(recdJ);
-            }
-            else //others
-            {
-                VHAxisValues.clear();
+            receivers.append(recdJ);
+        }
+    }
 
-                affK=initI;
-                estH=vComboBox->currentIndex()-1; // -1, actors index starts from 1 not zero, only here.
+    // est_h and aff_k on the vertical and horizontal axes, for each (init_i, rcvr_j)
+    const int perspective = perspectiveComboBox->currentIndex();
+    const int selH = vComboBox->currentIndex()-1; // -1, actors index starts from 1 not zero, only here.
+    if(3==perspective && selH<0)
+        return false;
 
-                if(estH<0)
-                    return;
+    SMPLib::QuadMapPerspective vPersp;
+    SMPLib::QuadMapPerspective hPersp;
+    std::vector<size_t> estimators;
+    if(0==perspective) // initiators
+    {
+        vPersp = [](size_t i, size_t j) { Q_UNUSED(j) return std::make_tuple(i, i); };
+        hPersp = [](size_t i, size_t j) { return std::make_tuple(i, j); };
+        estimators.push_back(initI);
+    }
+    else if(1==perspective) // receivers
+    {
+        vPersp = [](size_t i, size_t j) { return std::make_tuple(j, i); };
+        hPersp = [](size_t i, size_t j) { Q_UNUSED(i) return std::make_tuple(j, j); };
+        for(int j : receivers)
+            estimators.push_back(j);
+    }
+    else if(2==perspective) //objective
+    {
+        vPersp = [](size_t i, size_t j) { Q_UNUSED(j) return std::make_tuple(i, i); };
+        hPersp = [](size_t i, size_t j) { Q_UNUSED(i) return std::make_tuple(j, j); };
+        estimators.push_back(initI);
+        for(int j : receivers)
+            estimators.push_back(j);
+    }
+    else //others
+    {
+        const size_t h = selH;
+        vPersp = [h](size_t i, size_t j) { Q_UNUSED(j) return std::make_tuple(h, i); };
+        hPersp = vPersp;
+        estimators.push_back(h);
+    }
 
-                VHAxisValues.append(turn);
-                VHAxisValues.append(estH);
-                VHAxisValues.append(affK);
-                VHAxisValues.append(initI);
-                VHAxisValues.append(recdJ);
+    // The data for the whole turn is read in bulk here, because the DB connection
+    // belongs to this thread; the grid itself is computed on a worker thread.
+    QString exceptionMsg;
+    SMPLib::QuadMapData qmd;
+    try {
+        if(useHistory)
+        {
+            qmd = SMPModel::getQuadMapData(SMPModel::getSmpModel(), turn);
+        }
+        else
+        {
+            qmd = SMPModel::getQuadMapData(dbObj->getConnectionName(), scenarioBox.toStdString(),
+                                           turn, estimators);
+        }
+    }
+    catch (KException &ke)
+    {
+        exceptionMsg = QString::fromStdString(ke.msg);
+    }
+    catch (std::exception &std_ex)
+    {
+        exceptionMsg = std_ex.what();
+    }
+    catch (...)
+    {
+        exceptionMsg = "SMPLib::SMPModel::getQuadMapData: Unknown Exception Caught while getting QuadMap values";
+    }
 
-                VHAxisValues.append(turn);
-                VHAxisValues.append(estH);
-                VHAxisValues.append(affK);
-                VHAxisValues.append(initI);
-                VHAxisValues.append(recdJ);
-            }
-            //            emit getUtilChlgAndUtilSQfromDB(VHAxisValues);
-            double x,y;
-            QString exceptionMsg;
-            if(useHistory)
-            {
-                try {
-                    y =SMPLib::SMPModel::getQuadMapPoint(VHAxisValues.at(0),VHAxisValues.at(1),VHAxisValues.at(2),
-                                                         VHAxisValues.at(3),VHAxisValues.at(4));
-                    x =SMPLib::SMPModel::getQuadMapPoint(VHAxisValues.at(5),VHAxisValues.at(6),VHAxisValues.at(7),
-                                                         VHAxisValues.at(8),VHAxisValues.at(9));
-                }
-                catch (KException &ke)
-                {
-                    exceptionMsg = QString::fromStdString(ke.msg);
-                    displayMessage("Exception",exceptionMsg);
-                    LOG(INFO) << exceptionMsg.toStdString();
-                }
-                catch (std::exception &std_ex)
-                {
-                    exceptionMsg = std_ex.what();
-                    displayMessage("Exception",exceptionMsg);
-                    LOG(INFO) << exceptionMsg.toStdString();
-                }
-                catch (...)
-                {
-                    exceptionMsg = "SMPLib::SMPModel::getQuadMapPoint: Unknown Exception Caught while getting QuadMap values";
-                    displayMessage("Exception",exceptionMsg);
-                    LOG(INFO) << exceptionMsg.toStdString();
-                }
-            }
-            else
-            {
-                QString connectionName = dbObj->getConnectionName();
-                try {
-                    y =SMPLib::SMPModel::getQuadMapPoint(connectionName,scenarioBox.toStdString(),VHAxisValues.at(0),
-                                                         VHAxisValues.at(1),VHAxisValues.at(2),VHAxisValues.at(3),
-                                                         VHAxisValues.at(4));
-                    x =SMPLib::SMPModel::getQuadMapPoint(connectionName,scenarioBox.toStdString(),VHAxisValues.at(5),
-                                                         VHAxisValues.at(6),VHAxisValues.at(7),VHAxisValues.at(8),
-                                                         VHAxisValues.at(9));      }
-                catch (KException &ke)
-                {
-                    exceptionMsg = QString::fromStdString(ke.msg);
-                    displayMessage("Exception",exceptionMsg);
-                    LOG(INFO) << exceptionMsg.toStdString();
-                }
-                catch (std::exception &std_ex)
-                {
-                    exceptionMsg = std_ex.what();
-                    displayMessage("Exception",exceptionMsg);
-                    LOG(INFO) << exceptionMsg.toStdString();
-                }
-                catch (...)
-                {
-                    exceptionMsg = "SMPLib::SMPModel::getQuadMapPoint: Unknown Exception Caught while getting QuadMap values";
-                    displayMessage("Exception",exceptionMsg);
-                    LOG(INFO) << exceptionMsg.toStdString();
-                }
-            }
+    if(false==exceptionMsg.isEmpty())
+    {
+        displayMessage("Exception",exceptionMsg);
+        LOG(INFO) << exceptionMsg.toStdString();
+        return false;
+    }
 
-            if(true==exceptionMsg.isEmpty())
+    quadMapTurn = turn;
+    quadMapReceivers = receivers;
+    quadMapException.clear();
+
+    QFuture<QVector<QPointF>> future = QtConcurrent::run([this, qmd, vPersp, hPersp, initI, receivers]() {
+        QVector<QPointF> points;
+        try {
+            // only the checked receivers, whose estimators are all that was loaded
+            const KBase::VUI inits = { (unsigned int)initI };
+            KBase::VUI rcvrs;
+            for(int j : receivers)
+                rcvrs.push_back((unsigned int)j);
+            if(rcvrs.empty())
+                return points;
+            auto vGrid = SMPModel::getQuadMap(qmd, vPersp, inits, rcvrs);
+            auto hGrid = SMPModel::getQuadMap(qmd, hPersp, inits, rcvrs);
+            for(int j : receivers)
             {
-                quadMapUtilChlgandSQValues(VHAxisValues.at(0),x,y,VHAxisValues.at(4));
-                exceptionMsg.clear();
+                points.append(QPointF(hGrid(initI, j), vGrid(initI, j)));
             }
         }
+        catch (KException &ke)
+        {
+            quadMapException = QString::fromStdString(ke.msg);
+        }
+        catch (std::exception &std_ex)
+        {
+            quadMapException = std_ex.what();
+        }
+        catch (...)
+        {
+            quadMapException = "SMPLib::SMPModel::getQuadMap: Unknown Exception Caught while getting QuadMap values";
+        }
+        return points;
+    });
+    quadMapWatcher->setFuture(future);
+    return true;
+}
+
+void MainWindow::quadMapPointsReady()
+{
+    if(quadMapException.isEmpty())
+    {
+        QVector<QPointF> points = quadMapWatcher->result();
+        for(int n = 0; n < points.length() && n < quadMapReceivers.length(); ++n)
+        {
+            quadMapUtilChlgandSQValues(quadMapTurn,points.at(n).x(),points.at(n).y(),quadMapReceivers.at(n));
+        }
+    }
+    else
+    {
+        displayMessage("Exception",quadMapException);
+        LOG(INFO) << quadMapException.toStdString();
+        quadMapException.clear();
+    }
+
+    quadMapTitle->setText(QString(" E[ΔU] Quad Map for Actor %1, Turn "
+                                  +QString::number(quadMapTurn)).arg(actorsName.at(initiatorTip)));
+    quadMapCustomGraph->replot();
+    if(false==deltaUtilV.isEmpty())
+    {
+        quadMapAutoScale(autoScale->isChecked());
     }
+    plotQuadMap->setEnabled(true);
+    QApplication::restoreOverrideCursor();
 }
 
 void MainWindow::plotScatterPointsOnGraph(QVector <double> x,QVector <double> y, int actIndex)
@@ -816,24 +819,20 @@ void MainWindow::quadMapPlotPoints(bool status)
     Q_UNUSED(status)
     if(true==quadMapDock->isVisible() && actorsName.length() >0 && lineGraphDimensionComboBox->count()>0)
     {
+        if(quadMapWatcher->isRunning())
+            return;
+
         QApplication::setOverrideCursor(QCursor(QPixmap("://images/hourglass.png"))) ;
         plotQuadMap->setEnabled(false);
         removeAllScatterPoints();
         SMPLib::SMPModel::loginCredentials(connectionString.toStdString());
-        getUtilChlgHorizontalVerticalAxisData(turnSlider->value());
-        quadMapTitle->setText(QString(" E[ΔU] Quad Map for Actor %1, Turn "
-                                      +QString::number(turnSlider->value())).arg(actorsName.at(initiatorTip)));
-        quadMapCustomGraph->replot();
-        if(true==autoScale->isChecked())
-        {
-            quadMapAutoScale(true);
-        }
-        else
+        quadMapTurn = turnSlider->value();
+        // the points are plotted by quadMapPointsReady, once the worker thread is done
+        if(false==getUtilChlgHorizontalVerticalAxisData(turnSlider->value()))
         {
-            quadMapAutoScale(false);
+            plotQuadMap->setEnabled(true);
+            QApplication::restoreOverrideCursor();
         }
-        plotQuadMap->setEnabled(true);
-        QApplication::restoreOverrideCursor();
     }
 }
 
@@ -26,11 +26,40 @@
 // --------------------------------------------
 
 #include "smp.h"
+#include "kprofile.h"
 #include <QSqlQuery>
 #include <QVariant>
 #include <QSqlError>
 #include <QSqlRecord>
 
+namespace {
+// Everything one handle of the C API owns. Nothing is shared between
+// handles, so different handles can be used from different threads at once.
+struct SMPHandle {
+  SMPLib::SMPScenario scen;
+  std::vector<bool> sqlFlags;
+  std::string dbName;
+  SMPLib::SMPModel * md = nullptr;
+  std::string lastError;
+};
+
+SMPHandle * toHandle(void * h) {
+  return static_cast<SMPHandle*>(h);
+}
+
+// the state at turn t of a model that has been run, or nullptr
+const SMPLib::SMPState * handleState(SMPHandle * sh, unsigned int t) {
+  if ((nullptr == sh) || (nullptr == sh->md)) {
+    return nullptr;
+  }
+  if (t >= sh->md->history.size()) {
+    sh->lastError = "Turn is beyond the end of the model's history";
+    return nullptr;
+  }
+  return static_cast<const SMPLib::SMPState*>(sh->md->history[t]);
+}
+}
+
 extern "C" {
   void configLogger(const char *cfgFile) {
     if (nullptr != cfgFile) {
@@ -102,6 +131,179 @@ extern "C" {
     SMPLib::SMPModel::destroyModel();
   }
 
+  // Handle-based interface: no global state, so any number of models can be
+  // created, run and queried, from any number of threads, as long as each
+  // handle is only used by one thread at a time.
+  //
+  // Actor attributes are row-major arrays, one row per actor: cap[numAct],
+  // pos[numAct*numDim] and sal[numAct*numDim], on the [0,100] scale of the
+  // input files, and accM[numAct*numAct] (nullptr for the identity matrix).
+  // modelParams may be nullptr for the defaults. If sqlLogFlags is nullptr,
+  // or all five flags are false, no database is opened at all; otherwise
+  // dbName (nullptr for the configured database) receives the logs.
+  void * smpCreateModel(unsigned int numAct, unsigned int numDim, const double cap[],
+    const double pos[], const double sal[], const double accM[], uint64_t seed,
+    const int modelParams[9], const bool sqlLogFlags[5], const char * dbName) {
+    if ((0 == numAct) || (0 == numDim) || (nullptr == cap) || (nullptr == pos) || (nullptr == sal)) {
+      return nullptr;
+    }
+
+    auto sh = new SMPHandle();
+    SMPLib::SMPScenario & scen = sh->scen;
+    scen.seed = seed;
+    scen.cap = KBase::KMatrix(numAct, 1);
+    scen.pos = KBase::KMatrix(numAct, numDim);
+    scen.sal = KBase::KMatrix(numAct, numDim);
+    scen.accM = KBase::KMatrix(numAct, numAct);
+    for (unsigned int i = 0; i < numAct; ++i) {
+      scen.actorNames.push_back("Actor" + std::to_string(i));
+      scen.actorDescs.push_back("Actor " + std::to_string(i));
+      scen.cap(i, 0) = cap[i];
+      for (unsigned int k = 0; k < numDim; ++k) {
+        scen.pos(i, k) = pos[i*numDim + k] / 100.0;
+        scen.sal(i, k) = sal[i*numDim + k] / 100.0;
+      }
+      for (unsigned int j = 0; j < numAct; ++j) {
+        scen.accM(i, j) = (nullptr == accM) ? ((i == j) ? 1.0 : 0.0) : accM[i*numAct + j];
+      }
+    }
+    for (unsigned int k = 0; k < numDim; ++k) {
+      scen.dimNames.push_back("Dim" + std::to_string(k));
+    }
+    if (nullptr != modelParams) {
+      scen.modelParams = std::vector<int>(modelParams, modelParams + 9);
+    }
+
+    for (unsigned int i = 0; i < 5; ++i) {
+      sh->sqlFlags.push_back((nullptr != sqlLogFlags) && sqlLogFlags[i]);
+    }
+    if (nullptr != dbName) {
+      sh->dbName = std::string(dbName);
+    }
+    return sh;
+  }
+
+  // Runs the model; returns the number of states, or 0 on error (see smpGetError).
+  // The model is built here, so the database connection belongs to the calling thread.
+  uint smpRunModel(void * h) {
+    SMPHandle * sh = toHandle(h);
+    if (nullptr == sh) {
+      return 0;
+    }
+    delete sh->md;
+    sh->md = nullptr;
+    sh->lastError.clear();
+
+    KBase::Model::setThreadDatabaseName(QString::fromStdString(sh->dbName));
+    try {
+      // validates saliences the same way a file would be
+      sh->md = SMPLib::SMPModel::initModel(SMPLib::SMPModel::applyOverrides(sh->scen, {}), sh->sqlFlags);
+      SMPLib::SMPModel::displayModelParams(sh->md);
+      SMPLib::SMPModel::configExec(sh->md);
+      sh->md->closeDB();
+    }
+    catch (KBase::KException &ke) {
+      sh->lastError = ke.msg;
+    }
+    catch (std::exception &std_ex) {
+      sh->lastError = std_ex.what();
+    }
+    catch (...) {
+      sh->lastError = "smpRunModel: Unknown Exception Caught";
+    }
+    KBase::Model::setThreadDatabaseName(QString());
+
+    if (!sh->lastError.empty()) {
+      LOG(INFO) << sh->lastError;
+      delete sh->md;
+      sh->md = nullptr;
+      return 0;
+    }
+    return sh->md->history.size();
+  }
+
+  uint smpGetActorCount(void * h) {
+    SMPHandle * sh = toHandle(h);
+    return (nullptr == sh) ? 0 : sh->scen.actorNames.size();
+  }
+
+  uint smpGetDimensionCount(void * h) {
+    SMPHandle * sh = toHandle(h);
+    return (nullptr == sh) ? 0 : sh->scen.dimNames.size();
+  }
+
+  uint smpGetStateCount(void * h) {
+    SMPHandle * sh = toHandle(h);
+    return ((nullptr == sh) || (nullptr == sh->md)) ? 0 : sh->md->history.size();
+  }
+
+  // Writes numAct*numDim positions of turn t, row-major by actor, on the [0,100] scale.
+  // Returns false if the model has not been run or t is out of range.
+  bool smpGetPositions(void * h, unsigned int t, double positions[]) {
+    SMPHandle * sh = toHandle(h);
+    auto st = handleState(sh, t);
+    if ((nullptr == st) || (nullptr == positions)) {
+      return false;
+    }
+    const unsigned int numAct = sh->md->numAct;
+    const unsigned int numDim = sh->md->numDim;
+    for (unsigned int i = 0; i < numAct; ++i) {
+      auto vp = static_cast<const KBase::VctrPstn*>(st->pstns[i]);
+      for (unsigned int k = 0; k < numDim; ++k) {
+        positions[i*numDim + k] = (*vp)(k, 0) * 100.0;
+      }
+    }
+    return true;
+  }
+
+  // Writes the numAct probabilities of the actors' positions at turn t, as
+  // estimated by actor est; est == -1 uses each actor's own utilities.
+  bool smpGetPositionProbs(void * h, unsigned int t, int est, double probs[]) {
+    SMPHandle * sh = toHandle(h);
+    auto st = handleState(sh, t);
+    if ((nullptr == st) || (nullptr == probs)) {
+      return false;
+    }
+    try {
+      auto pn = st->cachedPDist(est);
+      const KBase::KMatrix & pdt = std::get<0>(pn);
+      const KBase::VUI & unq = std::get<1>(pn);
+      for (unsigned int i = 0; i < sh->md->numAct; ++i) {
+        probs[i] = st->posProb(i, unq, pdt);
+      }
+    }
+    catch (KBase::KException &ke) {
+      sh->lastError = ke.msg;
+      return false;
+    }
+    return true;
+  }
+
+  void smpGetScenarioID(void * h, char * buffer, const unsigned int buffsize) {
+    SMPHandle * sh = toHandle(h);
+    if ((nullptr == sh) || (nullptr == sh->md) || (nullptr == buffer) || (0 == buffsize)) {
+      return;
+    }
+    const std::string scenID = sh->md->getScenarioID();
+    buffer[scenID.copy(buffer, buffsize - 1)] = '\0';
+  }
+
+  void smpGetError(void * h, char * errBuffer, const unsigned int buffsize) {
+    SMPHandle * sh = toHandle(h);
+    if ((nullptr == sh) || (nullptr == errBuffer) || (0 == buffsize)) {
+      return;
+    }
+    errBuffer[sh->lastError.copy(errBuffer, buffsize - 1)] = '\0';
+  }
+
+  void smpDeleteModel(void * h) {
+    SMPHandle * sh = toHandle(h);
+    if (nullptr != sh) {
+      delete sh->md;
+      delete sh;
+    }
+  }
+
   void getVPHistory(float positions[])
   {
     SMPLib::SMPModel * md = SMPLib::SMPModel::getSmpModel();
@@ -157,6 +359,8 @@ using KBase::ReportingLevel;
 
 SMPModel * md0 = nullptr;
 
+double SMPModel::defaultTPTol = 0.0;
+
 // big enough buffer to build all desired SQLite statements
 const unsigned int sqlBuffSize = 250;
 
@@ -211,6 +415,13 @@ double SMPActor::vote(unsigned int est, unsigned int i, unsigned int j, const St
 }
 
 
+bool SMPActor::voteFromUtil(VotingRule & vr, double & w) const {
+    vr = this->vr;
+    w = sCap;
+    return true;
+}
+
+
 double SMPActor::vote(const Position * ap1, const Position * ap2, const SMPState* ast) const {
     double u1 = posUtil(ap1, ast);
     double u2 = posUtil(ap2, ast);
@@ -231,16 +442,12 @@ double SMPActor::posUtil(const Position * ap1, const SMPState* as) const {
     if (0 > ai) {
       throw KException("SMPActor::posUtil: ai must be non-negative");
     }
-    const VctrPstn actorIdeal = as->getIdeal(ai);
-    const VctrPstn* p0 = &actorIdeal;
-    if (nullptr == p0) {
-      throw KException("SMPActor::posUtil: p0 is null pointer");
-    }
+    const VctrPstn* p0 = &(as->getIdeal(ai));
     auto p1 = ((const VctrPstn*)ap1);
     if (nullptr == p1) {
       throw KException("SMPActor::posUtil: p1 is a null pointer");
     }
-    double u1 = SMPModel::bvUtil((*p0) - (*p1), vSal, ri);
+    double u1 = SMPModel::bvUtil(PosVec(*p0) - PosVec(*p1), vSal, ri);
     return u1;
 }
 
@@ -334,9 +541,13 @@ BargainSMP* SMPActor::interpolateBrgn(const SMPActor* ai, const SMPActor* aj,
     if (numD != posJ->numR()) {
       throw KException("SMPActor::interpolateBrgn: Position vectors of I and J don't have same number of rows");
     }
+    // checked before the bargain is allocated, so a bad value cannot leak it
+    if ((InterVecBrgn::S1P1 != ivb) && (InterVecBrgn::S2P2 != ivb) && (InterVecBrgn::S2PMax != ivb)) {
+      throw KException("SMPActor::interpolateBrgn: unrecognized InterVecBrgn value");
+    }
 
-    auto brgnI = VctrPstn(numD, 1);
-    auto brgnJ = VctrPstn(numD, 1);
+    // filled in place, so the only copies are the ones the bargain holds
+    auto brgn = new BargainSMP(ai, aj, *posI, *posJ);
 
     for (unsigned int k = 0; k < numD; k++) {
         double tik = (*posI)(k, 0);
@@ -356,15 +567,11 @@ BargainSMP* SMPActor::interpolateBrgn(const SMPActor* ai, const SMPActor* aj,
         case InterVecBrgn::S2PMax:
             interpBrgnS2PMax(tik, sik, prbI, tjk, sjk, prbJ, bik, bjk);
             break;
-        default:
-            throw KException("SMPActor::interpolateBrgn: unrecognized InterVecBrgn value");
-            break;
         }
-        brgnI(k, 0) = bik;
-        brgnJ(k, 0) = bjk;
+        brgn->posInit(k, 0) = bik;
+        brgn->posRcvr(k, 0) = bjk;
     }
 
-    auto brgn = new BargainSMP(ai, aj, brgnI, brgnJ);
     return brgn;
 }
 
@@ -380,25 +587,26 @@ SMPState::~SMPState() {
     accomodate = KMatrix();
 }
 
-void SMPState::setVDiff(const vector<VctrPstn> & vPos) {
-    auto dfn = [vPos, this](unsigned int i, unsigned int j) {
+void SMPState::packActors() {
+    const unsigned int na = model->numAct;
+    const unsigned int nd = ((const SMPModel*)model)->numDim;
+    posSoA.resize(na * nd);
+    salSoA.resize(na * nd);
+    for (unsigned int i = 0; i < na; i++) {
         auto ai = ((const SMPActor*)(model->actrs[i]));
-        KMatrix si = ai->vSal;
-        auto posJ = ((const VctrPstn*)(pstns[j]));
-        double dij = 0.0;
-        if (0 == vPos.size()) {
-            auto posI = ((const VctrPstn*)(pstns[i]));
-            auto idlI = ideals[i];
-            //dij = SMPModel::bvDiff((*posI) - (*posJ), si);
-            dij = SMPModel::bvDiff(idlI - (*posJ), si);
+        auto pi = ((const VctrPstn*)(pstns[i]));
+        if (nullptr == pi) {
+          throw KException("SMPState::packActors: position is a null pointer");
         }
-        else {
-            auto vpi = vPos[i];
-            dij = SMPModel::bvDiff(vpi - (*posJ), si);
+        for (unsigned int k = 0; k < nd; k++) {
+            posSoA[i*nd + k] = (*pi)(k, 0);
+            salSoA[i*nd + k] = ai->vSal(k, 0);
         }
-        return dij;
-    };
+    }
+    return;
+}
 
+void SMPState::setVDiff(const vector<VctrPstn> & vPos) {
     const unsigned int na = model->numAct;
     if (na != ideals.size()) {
       throw KException("SMPState::setVDiff: Ideals for one or more actors missing");
@@ -410,7 +618,29 @@ void SMPState::setVDiff(const vector<VctrPstn> & vPos) {
     if (na != accomodate.numC()) {
       throw KException("SMPState::setVDiff: Accomodate matrix column count should be equal to number of actors");
     }
-    vDiff = KMatrix::map(dfn, na, na);
+    if ((0 != vPos.size()) && (na != vPos.size())) {
+      throw KException("SMPState::setVDiff: vPos must be empty or have one position per actor");
+    }
+
+    // distances from each actor's ideal (or vPos[i]) to every position
+    packActors();
+    const unsigned int nd = ((const SMPModel*)model)->numDim;
+    const vector<VctrPstn> & from = (0 == vPos.size()) ? ideals : vPos;
+    auto fromSoA = vector<double>(na * nd);
+    for (unsigned int i = 0; i < na; i++) {
+        for (unsigned int k = 0; k < nd; k++) {
+            fromSoA[i*nd + k] = from[i](k, 0);
+        }
+    }
+    auto vd = vector<double>(na * na);
+    SMPModel::bvDiffMatrix(fromSoA.data(), salSoA.data(), posSoA.data(), na, na, nd, vd.data());
+
+    vDiff = KMatrix(na, na);
+    for (unsigned int i = 0; i < na; i++) {
+        for (unsigned int j = 0; j < na; j++) {
+            vDiff(i, j) = vd[i*na + j];
+        }
+    }
     return;
 }
 
@@ -433,6 +663,7 @@ KMatrix SMPState::actrCaps() const {
 
 
 void SMPState::setAllAUtil(ReportingLevel rl) {
+    KTAB_PROFILE_PHASE("SMPState::setAllAUtil");
     const auto vpmCoalition = model->vpm;
     const unsigned int na = model->numAct;
     auto smod = (const SMPModel*)model;
@@ -620,7 +851,7 @@ void  SMPState::setAccomodate(const KMatrix & aMat) {
     if (Model::minNumActor > na) {
       throw KException("SMPState::setAccomodate: Model needs to have a minimum number of actors");
     }
-    if (na > Model::maxNumActor) {
+    if (na > model->actorLimit()) {
       throw KException("SMPState::setAccomodate: Model has got an upper limit to count of actors");
     }
     if (na != aMat.numR()) {
@@ -634,7 +865,7 @@ void  SMPState::setAccomodate(const KMatrix & aMat) {
     return;
 }
 
-VctrPstn SMPState::getIdeal(unsigned int n) const
+const VctrPstn & SMPState::getIdeal(unsigned int n) const
 {
     return ideals[n];
 }
@@ -709,7 +940,7 @@ void SMPState::newIdeals() {
     if (Model::minNumActor > na) {
       throw KException("SMPState::newIdeals: Model needs to have a minimum number of actors");
     }
-    if (na > Model::maxNumActor) {
+    if (na > model->actorLimit()) {
       throw KException("SMPState::newIdeals: Model has got an upper limit to count of actors");
     }
     if (na != accomodate.numC()) {
@@ -804,7 +1035,7 @@ void SMPState::idealsFromPstns(const vector<VctrPstn> &  ps) {
     if (Model::minNumActor > na) {
       throw KException("SMPState::idealsFromPstns: Model needs to have a minimum number of actors");
     }
-    if (na > Model::maxNumActor) {
+    if (na > model->actorLimit()) {
       throw KException("SMPState::idealsFromPstns: Model has got an upper limit to count of actors");
     }
 
@@ -953,6 +1184,22 @@ KMatrix SMPState::getAccomodate() {
 // JAH 20160711 added rng seed
 SMPModel::SMPModel(string desc, uint64_t s, vector<bool> f, string sceName) : Model(desc, s, f, sceName) {
     // note that numDim, posTol, and dimName are initialized in class declaration
+    tpTol = defaultTPTol;
+}
+
+void SMPModel::setThirdPartyTol(double tol) {
+    if (tol < 0.0) {
+      throw KException("SMPModel::setThirdPartyTol: tolerance must not be negative");
+    }
+    defaultTPTol = tol;
+}
+
+unsigned int SMPModel::maxNumActors(double tol) {
+    return (0.0 < tol) ? maxNumActorTP : Model::maxNumActor;
+}
+
+unsigned int SMPModel::actorLimit() const {
+    return maxNumActors(tpTol);
 }
 
 SMPModel::~SMPModel() {
@@ -999,8 +1246,11 @@ double SMPModel::bsUtil(double sd, double R) {
     return u;
 }
 
-double SMPModel::bvDiff(const  KMatrix & vd, const  KMatrix & vs) {
-    if (false == KBase::sameShape(vd, vs)) {
+// Shared by the KMatrix and PosVec versions of bvDiff, so both
+// take their sums in exactly the same order.
+template <class V>
+static double bvDiffSum(const V & vd, const  KMatrix & vs) {
+    if ((vd.numR() != vs.numR()) || (vd.numC() != vs.numC())) {
       throw KException("SMPModel::bvDiff: vd and vs matrices do not have same shape");
     }
     double dsSqr = 0;
@@ -1023,14 +1273,74 @@ double SMPModel::bvDiff(const  KMatrix & vd, const  KMatrix & vs) {
     }
     double sd = sqrt(dsSqr / ssSqr);
     return sd;
+}
+
+double SMPModel::bvDiff(const  KMatrix & vd, const  KMatrix & vs) {
+    return bvDiffSum(vd, vs);
 };
 
+double SMPModel::bvDiff(const  PosVec & vd, const  KMatrix & vs) {
+    return bvDiffSum(vd, vs);
+};
+
+void SMPModel::bvDiffMatrix(const double * a, const double * s, const double * b,
+                            unsigned int na, unsigned int nb, unsigned int nd, double * vd) {
+    const unsigned int blk = 64; // columns of b per block; blk x nd doubles stay in cache
+    auto bT = vector<double>(blk * nd);
+    double dsSqr[blk];
+
+    for (unsigned int j0 = 0; j0 < nb; j0 += blk) {
+        const unsigned int nj = ((nb - j0) < blk) ? (nb - j0) : blk;
+        for (unsigned int j = 0; j < nj; j++) {
+            for (unsigned int k = 0; k < nd; k++) {
+                bT[k*blk + j] = b[(j0 + j)*nd + k];
+            }
+        }
+
+        for (unsigned int i = 0; i < na; i++) {
+            const double * ai = a + i*nd;
+            const double * si = s + i*nd;
+            double ssSqr = 0;
+            for (unsigned int j = 0; j < nj; j++) {
+                dsSqr[j] = 0;
+            }
+            for (unsigned int k = 0; k < nd; k++) {
+                const double sik = si[k];
+                if (0 > sik) {
+                  throw KException("SMPModel::bvDiffMatrix: sij must be non-negative");
+                }
+                ssSqr = ssSqr + (sik*sik);
+                const double aik = ai[k];
+                const double * bk = &bT[k*blk];
+                for (unsigned int j = 0; j < nj; j++) {
+                    const double ds = (aik - bk[j]) * sik;
+                    dsSqr[j] = dsSqr[j] + (ds*ds);
+                }
+            }
+            if (0 >= ssSqr) {
+              throw KException("SMPModel::bvDiffMatrix: ssSqr must be positive");
+            }
+            double * vdi = vd + i*nb + j0;
+            for (unsigned int j = 0; j < nj; j++) {
+                vdi[j] = sqrt(dsSqr[j] / ssSqr);
+            }
+        }
+    }
+    return;
+}
+
 double SMPModel::bvUtil(const  KMatrix & vd, const  KMatrix & vs, double R) {
     const double sd = bvDiff(vd, vs);
     const double u = bsUtil(sd, R);
     return u;
 };
 
+double SMPModel::bvUtil(const  PosVec & vd, const  KMatrix & vs, double R) {
+    const double sd = bvDiff(vd, vs);
+    const double u = bsUtil(sd, R);
+    return u;
+};
+
 void SMPModel::sankeyOutput(string outputFile) const {
     if (numAct != actrs.size()) {
       throw KException("SMPModel::sankeyOutput: actor count is in error");
@@ -1289,6 +1599,7 @@ void SMPModel::sankeyOutput(string outputFile, string dbName, string scenarioId)
 // JAH 20160801 changed to refer to model sqlFlags vector to decide
 // whether or not to populate the table
 void SMPModel::showVPHistory() const {
+    KTAB_PROFILE_PHASE("SMPModel::showVPHistory");
     if (numAct != actrs.size()) {
       throw KException("SMPModel::showVPHistory: actor count in error");
     }
@@ -1319,18 +1630,17 @@ void SMPModel::showVPHistory() const {
     // JAH 20160801 only populate the table if this group is turned on
     if (sqlFlags[grpID])
     {
-        string sql = "INSERT INTO VectorPosition "
-          "(ScenarioId, Turn_t, Act_i, Dim_k, Pos_Coord, Idl_Coord, Mover_BargnId)"
-          "VALUES ('" + scenId + "', :turn_t, :act_i, :dim_k, :pos_coord, :idl_coord, :mover_bgnId)";
+        string sql = insertSQL("VectorPosition",
+          "Turn_t, Act_i, Dim_k, Pos_Coord, Idl_Coord, Mover_BargnId");
 
-        query.prepare(QString::fromStdString(sql));
+        store->prepare(sql);
 
         // Prepared statements cache the execution plan for a query after the query optimizer has
         // found the best plan, so there is no big gain with simple insertions.
         // What makes a huge difference is bundling a few hundred into one atomic "transaction".
         // For this case, runtime droped from 62-65 seconds to 0.5-0.6 (vs. 0.30-0.33 with no SQL at all).
 
-        qtDB->transaction();
+        store->begin();
 
         LOG(INFO) << "History of actor positions over time:";
         string actorPosHistory;
@@ -1354,23 +1664,23 @@ void SMPModel::showVPHistory() const {
                     const double pCoord = (*vpit)(k, 0) * 100.0; // Use the scale of [0,100]
                     // have to print "100.0" sometimes
                     actorPosHistory += KBase::getFormattedString(" %5.1f", pCoord);
-                    query.bindValue(":turn_t", t);
-                    query.bindValue(":act_i", i);
-                    query.bindValue(":dim_k", k);
-                    query.bindValue(":pos_coord", pCoord);
+                    store->bind(0, t);
+                    store->bind(1, i);
+                    store->bind(2, k);
+                    store->bind(3, pCoord);
                     const double iCoord = vidl(k, 0) * 100.0; // Log at the scale of [0,100];
-                    query.bindValue(":idl_coord", iCoord);
+                    store->bind(4, iCoord);
 
                     // This try block is necessary to make sure there is a bargin which caused the move
                     try {
-                      query.bindValue(":mover_bgnId",  (qulonglong)(sst->getPosMoverBargain(i)));
+                      store->bind(5, sst->getPosMoverBargain(i));
                     }
                     catch (const std::out_of_range& oor) { // exception thrown by std::map::at() method
                       // Insert a null value
-                      query.bindValue(":mover_bgnId", QVariant(QVariant::Int));
+                      store->bindNull(5);
                     }
-                    if (!query.exec()) {
-                      LOG(INFO) << query.lastError().text().toStdString();
+                    if (!store->step()) {
+                      LOG(INFO) << store->lastError();
                       throw KException("SMPModel::showVPHistory: Could not write into VectorPosition table");
                     }
                 }
@@ -1379,7 +1689,7 @@ void SMPModel::showVPHistory() const {
             }
         }
 
-        qtDB->commit();
+        store->commit();
     }
 
     // show probabilities over time.
@@ -1391,7 +1701,7 @@ void SMPModel::showVPHistory() const {
         if (numAct != sst->aUtil.size()) { // should be fully initialized
           throw KException("SMPModel::showVPHistory: Each actor must have a utility value");
         }
-        auto pn = sst->pDist(-1);
+        auto pn = sst->cachedPDist(-1);
         auto pdt = std::get<0>(pn); // note that these are unique positions
         auto unq = std::get<1>(pn);
         prbHist.push_back(pdt);
@@ -1470,6 +1780,81 @@ SMPModel * SMPModel::initModel(vector<string> aName, vector<string> aDesc, vecto
     return sm0;
 }
 
+SMPModel * SMPModel::initModel(const SMPScenario & scen, vector<bool> f) {
+    auto sm0 = initModel(scen.actorNames, scen.actorDescs, scen.dimNames, scen.cap, scen.pos, scen.sal,
+                         scen.accM, scen.seed, f, scen.desc, scen.name);
+    if (!scen.modelParams.empty()) {
+        LOG(INFO) << "Setting SMPModel parameters from the scenario ...";
+        updateModelParameters(sm0, scen.modelParams);
+    }
+    return sm0;
+}
+
+SMPScenario SMPModel::applyOverrides(const SMPScenario & base, const vector<ScenarioOverride> & ovr) {
+    SMPScenario scen = base;
+    const unsigned int na = scen.actorNames.size();
+    const unsigned int nd = scen.dimNames.size();
+
+    for (auto o : ovr) {
+        switch (o.field) {
+        case ScenarioField::Capability:
+            if (na <= o.i) {
+              throw KException("SMPModel::applyOverrides: actor index out of range");
+            }
+            if (0.0 >= o.value) {
+              throw KException("SMPModel::applyOverrides: capability must be positive");
+            }
+            scen.cap(o.i, 0) = o.value;
+            break;
+        case ScenarioField::Position:
+        case ScenarioField::Salience:
+            if ((na <= o.i) || (nd <= o.j)) {
+              throw KException("SMPModel::applyOverrides: actor or dimension index out of range");
+            }
+            if (ScenarioField::Position == o.field) {
+                scen.pos(o.i, o.j) = o.value;
+            }
+            else {
+                if ((o.value < 0.0) || (1.0 < o.value)) {
+                  throw KException("SMPModel::applyOverrides: Valid range of salience [0.0, 1.0]");
+                }
+                scen.sal(o.i, o.j) = o.value;
+            }
+            break;
+        case ScenarioField::Accommodation:
+            if ((na <= o.i) || (na <= o.j)) {
+              throw KException("SMPModel::applyOverrides: actor index out of range");
+            }
+            scen.accM(o.i, o.j) = o.value;
+            break;
+        case ScenarioField::ModelParameter:
+            if (scen.modelParams.empty()) {
+                scen.modelParams = getDefaultModelParameters();
+            }
+            if (scen.modelParams.size() <= o.i) {
+              throw KException("SMPModel::applyOverrides: model parameter index out of range");
+            }
+            scen.modelParams[o.i] = ((int)(o.value));
+            break;
+        }
+    }
+
+    // same limit as xmlRead: no more than 100% of attention to all issues
+    for (unsigned int i = 0; i < na; i++) {
+        double totalSal = 0.0;
+        for (unsigned int k = 0; k < nd; k++) {
+            totalSal += scen.sal(i, k);
+        }
+        if (1.0 < totalSal) {
+          string err = KBase::getFormattedString(
+            "SMPModel::applyOverrides: Expected total salience to be less than 100%%. Actual total salience for actor %u:  %f",
+            i, 100.0*totalSal);
+          throw KException(err);
+        }
+    }
+    return scen;
+}
+
 void SMPModel::displayModelParams(SMPModel *md0)
 {
     LOG(INFO) << "Model Paramaters to run the model...";
@@ -1484,98 +1869,77 @@ void SMPModel::displayModelParams(SMPModel *md0)
     LOG(INFO) << "BargnModel:" << md0->brgnMod;
 }
 
-string SMPModel::runModel(vector<bool> sqlFlags,
-                          string inputDataFile, uint64_t seed, bool saveHist, vector<int> modelParams) {
-    if (md0 != nullptr) {
-        delete md0;
-        md0 = nullptr;
-    }
-
+SMPModel * SMPModel::readModel(string inputDataFile, vector<bool> sqlFlags, uint64_t seed) {
     // Supported files for input data: xml, csv
     size_t dotPos = inputDataFile.find_last_of(".");
     if (string::npos == dotPos) { // A file name without extension
-      lastExceptionMsg = "Error: Input file name without extension is invalid.";
-      LOG(INFO) << lastExceptionMsg;
-      return "";
+      throw KException("Error: Input file name without extension is invalid.");
     }
 
     string fileExt = inputDataFile.substr(dotPos+1);
-    string fileName= inputDataFile.substr(0,dotPos);
 
     // convert to all lower case for easy comparison
     std::transform(fileExt.begin(), fileExt.end(), fileExt.begin(), ::tolower);
 
     // Make sure the file extension is either csv or xml only
     if((0 != fileExt.compare("csv")) && (0 != fileExt.compare("xml"))) {
-      lastExceptionMsg = "Error: Only xml or csv files supported.";
-      LOG(INFO) << lastExceptionMsg;
-      return "";
+      throw KException("Error: Only xml or csv files supported.");
     }
 
+    SMPModel * md = nullptr;
     if (fileExt == "xml") {
-      try {
-        md0 = xmlRead(inputDataFile, sqlFlags);
-      }
-      catch (KException &ke) {
-        lastExceptionMsg = ke.msg;
-        //LOG(INFO) << lastExceptionMsg;
-        return "";
-      }
-      catch (std::exception &std_ex) {
-        lastExceptionMsg = std_ex.what();
-        //LOG(INFO) << lastExceptionMsg;
-        return "";
-      }
-      catch (...) {
-        lastExceptionMsg = "SMPModel::runModel: Unknown Exception Caught from xmlRead";
-        //LOG(INFO) << lastExceptionMsg;
-        return "";
-      }
-
-      if (nullptr == md0) {
-        lastExceptionMsg = "Model object couldn't be created in xmlRead";
-        //LOG(INFO) << lastExceptionMsg;
-        return "";
-      }
+        md = xmlRead(inputDataFile, sqlFlags);
+        if (nullptr == md) {
+          throw KException("Model object couldn't be created in xmlRead");
+        }
 
         if (-1 != seed) {
-            md0->setSeed(seed);
+            md->setSeed(seed);
             LOG(INFO) << KBase::getFormattedString(
-              "Using PRNG seed provided by the user: %020llu", md0->getSeed());
+              "Using PRNG seed provided by the user: %020llu", md->getSeed());
         }
         else {
             LOG(INFO) << KBase::getFormattedString(
-              "Using PRNG seed provided by xml file: %020llu", md0->getSeed());
+              "Using PRNG seed provided by xml file: %020llu", md->getSeed());
         }
     }
-    else if (fileExt == "csv") {
-      try {
-        md0 = csvRead(inputDataFile, seed, sqlFlags);
-      }
-      catch (KException &ke) {
-        lastExceptionMsg = ke.msg;
-        //LOG(INFO) << lastExceptionMsg;
-        return "";
-      }
-      catch (std::exception &std_ex) {
-        lastExceptionMsg = std_ex.what();
-        //LOG(INFO) << lastExceptionMsg;
-        return "";
-      }
-      catch (...) {
-        lastExceptionMsg = "SMPModel::runModel: Unknown Exception Caught from csvRead";
-        //LOG(INFO) << lastExceptionMsg;
-        return "";
-      }
+    else {
+        md = csvRead(inputDataFile, seed, sqlFlags);
+        if (nullptr == md) {
+          throw KException("Model object couldn't be created in csvRead");
+        }
+    }
+    return md;
+}
 
-      if (nullptr == md0) {
-        lastExceptionMsg = "Model object couldn't be created in csvRead";
-        LOG(INFO) << lastExceptionMsg;
-        return "";
-      }
-        //md0 = csvRead(inputDataFile, seed, sqlFlags);
+string SMPModel::runModel(vector<bool> sqlFlags,
+                          string inputDataFile, uint64_t seed, bool saveHist, vector<int> modelParams) {
+    if (md0 != nullptr) {
+        delete md0;
+        md0 = nullptr;
     }
 
+    try {
+      md0 = readModel(inputDataFile, sqlFlags, seed);
+    }
+    catch (KException &ke) {
+      lastExceptionMsg = ke.msg;
+      LOG(INFO) << lastExceptionMsg;
+      return "";
+    }
+    catch (std::exception &std_ex) {
+      lastExceptionMsg = std_ex.what();
+      LOG(INFO) << lastExceptionMsg;
+      return "";
+    }
+    catch (...) {
+      lastExceptionMsg = "SMPModel::runModel: Unknown Exception Caught while reading the input file";
+      LOG(INFO) << lastExceptionMsg;
+      return "";
+    }
+
+    string fileName = inputDataFile.substr(0, inputDataFile.find_last_of("."));
+
     if (!modelParams.empty()) {
         SMPModel::updateModelParameters(md0, modelParams);
     }
@@ -1627,6 +1991,48 @@ string SMPModel::runModel(vector<bool> sqlFlags,
     return md0->getScenarioID();
 }
 
+string SMPModel::runModelInstance(vector<bool> sqlFlags, string inputDataFile, uint64_t seed,
+                                  vector<int> modelParams, string dbName) {
+    auto makeModel = [sqlFlags, inputDataFile, seed]() {
+        return readModel(inputDataFile, sqlFlags, seed);
+    };
+    return runInstance(makeModel, modelParams, dbName);
+}
+
+string SMPModel::runModelInstance(const SMPScenario & scen, vector<bool> sqlFlags, string dbName) {
+    auto makeModel = [&scen, sqlFlags]() {
+        return initModel(scen, sqlFlags);
+    };
+    return runInstance(makeModel, {}, dbName);
+}
+
+string SMPModel::runInstance(function<SMPModel*()> makeModel, vector<int> modelParams, string dbName) {
+    // the model connects to its DB while it is being built, so the name has to be in place first
+    Model::setThreadDatabaseName(QString::fromStdString(dbName));
+
+    SMPModel * md = nullptr;
+    string scenID;
+    try {
+      md = makeModel();
+      if (!modelParams.empty()) {
+          SMPModel::updateModelParameters(md, modelParams);
+      }
+      displayModelParams(md);
+      configExec(md);
+      md->releaseDB();
+      scenID = md->getScenarioID();
+    }
+    catch (...) {
+      delete md;
+      Model::setThreadDatabaseName(QString());
+      throw;
+    }
+
+    delete md;
+    Model::setThreadDatabaseName(QString());
+    return scenID;
+}
+
 string SMPModel::csvReadExec(uint64_t seed, string inputCSV, vector<bool> f, vector<int> par) {
     if (md0 != nullptr) {
         delete md0;
@@ -1744,47 +2150,167 @@ vector<int> SMPModel::getDefaultModelParameters()
     return defaultParameters;
 }
 
-double SMPModel::getQuadMapPoint(size_t t, size_t est_h, size_t aff_k, size_t init_i, size_t rcvr_j) {
-    auto smpState = md0->history[t];
-    auto autil = smpState->aUtil;
-    double uii = autil[est_h](init_i, init_i);
-    double uij = autil[est_h](init_i, rcvr_j);
-    double uji = autil[est_h](rcvr_j, init_i);
-    double ujj = autil[est_h](rcvr_j, rcvr_j);
+vector<int> SMPModel::modelParametersFromNames(const vector<string> & names) {
+    using KBase::enumFromName;
+    if (9 != names.size()) {
+      throw KException("SMPModel::modelParametersFromNames: expected exactly nine model parameters");
+    }
+    vector<int> params = {
+      (int)enumFromName<VPModel>(names[0], KBase::VPModelNames),
+      (int)enumFromName<PCEModel>(names[1], KBase::PCEModelNames),
+      (int)enumFromName<StateTransMode>(names[2], KBase::StateTransModeNames),
+      (int)enumFromName<VotingRule>(names[3], KBase::VotingRuleNames),
+      (int)enumFromName<BigRAdjust>(names[4], KBase::BigRAdjustNames),
+      (int)enumFromName<BigRRange>(names[5], KBase::BigRRangeNames),
+      (int)enumFromName<ThirdPartyCommit>(names[6], KBase::ThirdPartyCommitNames),
+      (int)enumFromName<InterVecBrgn>(names[7], InterVecBrgnNames),
+      (int)enumFromName<SMPBargnModel>(names[8], SMPBargnModelNames)
+    };
+    return params;
+}
+
+QuadMapData SMPModel::getQuadMapData(const SMPModel * md, size_t t) {
+    if (nullptr == md) {
+      throw KException("SMPModel::getQuadMapData: model must not be null");
+    }
+    if (t >= md->history.size()) {
+      throw KException("SMPModel::getQuadMapData: turn is not in the model's history");
+    }
+    QuadMapData qmd;
+    qmd.numAct = md->numAct;
+    qmd.vrCltn = md->vrCltn;
+    qmd.tpCommit = md->tpCommit;
+    qmd.util = md->history[t]->aUtil; // one matrix per estimator, already in memory
+    for (unsigned int n = 0; n < md->numAct; n++) {
+        auto an = ((const SMPActor*)(md->actrs[n]));
+        qmd.cap.push_back(an->sCap);
+        qmd.sal.push_back(KBase::sum(an->vSal));
+    }
+    return qmd;
+}
+
+QuadMapData SMPModel::getQuadMapData(const QString &connectionName, const string &scenarioID,
+  size_t turn, const vector<size_t> & estimators) {
+
+    QSqlDatabase qdb = QSqlDatabase::database(connectionName);
+    QSqlQuery qtQry = QSqlQuery(qdb);
+
+    QuadMapData qmd;
+
+    // Get voting rule and third party commit for this scenario
+    qtQry.prepare("SELECT VotingRule, ThirdPartyCommit FROM ScenarioDesc WHERE ScenarioId = :scen_id");
+    qtQry.bindValue(":scen_id", QString::fromStdString(scenarioID));
+    if (qtQry.exec() && qtQry.first()) {
+      qmd.vrCltn = static_cast<VotingRule>(qtQry.value(0).toInt());
+      qmd.tpCommit = static_cast<ThirdPartyCommit>(qtQry.value(1).toInt());
+    }
+
+    // Get count of actors for this scenario
+    qtQry.prepare("SELECT MAX(Act_i) FROM ActorDescription WHERE ScenarioId = :scen_id");
+    qtQry.bindValue(":scen_id", QString::fromStdString(scenarioID));
+    if (qtQry.exec() && qtQry.first()) {
+      qmd.numAct = qtQry.value(0).toUInt() + 1;
+    }
+    const unsigned int na = qmd.numAct;
+
+    // capabilities and total saliences of every actor, one query each
+    qmd.cap = vector<double>(na, 0.0);
+    qtQry.prepare("SELECT Act_i, Cap FROM SpatialCapability WHERE ScenarioId = :scen_id AND Turn_t = :turn_t");
+    qtQry.bindValue(":scen_id", QString::fromStdString(scenarioID));
+    qtQry.bindValue(":turn_t", (uint)turn);
+    if (qtQry.exec()) {
+      while (qtQry.next()) {
+        unsigned int i = qtQry.value(0).toUInt();
+        if (i < na) {
+          qmd.cap[i] = qtQry.value(1).toDouble();
+        }
+      }
+    }
+
+    qmd.sal = vector<double>(na, 0.0);
+    qtQry.prepare("SELECT Act_i, SUM(Sal) FROM SpatialSalience WHERE ScenarioId = :scen_id AND Turn_t = :turn_t "
+      "GROUP BY Act_i");
+    qtQry.bindValue(":scen_id", QString::fromStdString(scenarioID));
+    qtQry.bindValue(":turn_t", (uint)turn);
+    if (qtQry.exec()) {
+      while (qtQry.next()) {
+        unsigned int i = qtQry.value(0).toUInt();
+        if (i < na) {
+          qmd.sal[i] = qtQry.value(1).toDouble();
+        }
+      }
+    }
+
+    // the whole utility matrix of each requested estimator, one query per estimator
+    qmd.util = vector<KMatrix>(na, KMatrix());
+    qtQry.prepare("SELECT Act_i, Pos_j, Util FROM PosUtil WHERE ScenarioId = :scen_id AND Turn_t = :turn_t "
+      "AND Est_h = :est_h");
+    for (auto h : estimators) {
+      if ((h >= na) || (0 < qmd.util[h].numR())) {
+        continue;
+      }
+      auto uh = KMatrix(na, na);
+      qtQry.bindValue(":scen_id", QString::fromStdString(scenarioID));
+      qtQry.bindValue(":turn_t", (uint)turn);
+      qtQry.bindValue(":est_h", (uint)h);
+      if (qtQry.exec()) {
+        while (qtQry.next()) {
+          unsigned int i = qtQry.value(0).toUInt();
+          unsigned int j = qtQry.value(1).toUInt();
+          if ((i < na) && (j < na)) {
+            uh(i, j) = qtQry.value(2).toDouble();
+          }
+        }
+      }
+      qmd.util[h] = uh;
+    }
+
+    qtQry.finish();
+    qtQry.clear();
+
+    return qmd;
+}
+
+double SMPModel::getQuadMapPoint(const QuadMapData & qmd, size_t est_h, size_t aff_k, size_t init_i, size_t rcvr_j) {
+    if ((est_h >= qmd.util.size()) || (0 == qmd.util[est_h].numR())) {
+      throw KException("SMPModel::getQuadMapPoint: utilities of the estimator have not been loaded");
+    }
+    const KMatrix & uh = qmd.util[est_h];
+    double uii = uh(init_i, init_i);
+    double uij = uh(init_i, rcvr_j);
+    double uji = uh(rcvr_j, init_i);
+    double ujj = uh(rcvr_j, rcvr_j);
 
     // h's estimate of utility to k of status-quo positions of i and j
-    const double euSQ = autil[est_h](aff_k, init_i) + autil[est_h](aff_k, rcvr_j);
+    const double euSQ = uh(aff_k, init_i) + uh(aff_k, rcvr_j);
     if ((0.0 > euSQ) || (euSQ > 2.0)) {
       throw KException("SMPModel::getQuadMapPoint: euSQ should be between 0.0 and 2.0");
     }
 
     // h's estimate of utility to k of i defeating j, so j adopts i's position
-    const double uhkij = autil[est_h](aff_k, init_i) + autil[est_h](aff_k, init_i);
+    const double uhkij = uh(aff_k, init_i) + uh(aff_k, init_i);
     if ((0.0 > uhkij) || (uhkij > 2.0)) {
       throw KException("SMPModel::getQuadMapPoint: uhkij should be between 0.0 and 2.0");
     }
 
     // h's estimate of utility to k of j defeating i, so i adopts j's position
-    const double uhkji = autil[est_h](aff_k, rcvr_j) + autil[est_h](aff_k, rcvr_j);
+    const double uhkji = uh(aff_k, rcvr_j) + uh(aff_k, rcvr_j);
     if ((0.0 > uhkji) || (uhkji > 2.0)) {
       throw KException("SMPModel::getQuadMapPoint: uhkji should be between 0.0 and 2.0");
     }
 
-    auto ai = ((const SMPActor*)(md0->actrs[init_i]));
-    double si = KBase::sum(ai->vSal);
+    double si = qmd.sal[init_i];
     if ((0 >= si) || (si > 1)) {
       throw KException("SMPModel::getQuadMapPoint: si should be between 0 and 1");
     }
-    double ci = ai->sCap;
-    auto aj = ((const SMPActor*)(md0->actrs[rcvr_j]));
-    double sj = KBase::sum(aj->vSal);
+    double ci = qmd.cap[init_i];
+    double sj = qmd.sal[rcvr_j];
     if ((0 >= sj) || (sj > 1)) {
       throw KException("SMPModel::getQuadMapPoint: sj should be between 0 and 1");
     }
-    double cj = aj->sCap;
-    const double minCltn = 1E-10;
+    double cj = qmd.cap[rcvr_j];
 
-    auto contribs = calcContribs(md0->vrCltn, si*ci, sj*cj, tuple<double, double, double, double>(uii, uij, uji, ujj));
+    auto contribs = calcContribs(qmd.vrCltn, si*ci, sj*cj, tuple<double, double, double, double>(uii, uij, uji, ujj));
 
     double chij = get<0>(contribs); // strength of complete coalition supporting i over j (initially empty)
     double chji = get<1>(contribs); // strength of complete coalition supporting j over i (initially empty)
@@ -1796,19 +2322,17 @@ double SMPModel::getQuadMapPoint(size_t t, size_t est_h, size_t aff_k, size_t in
     // we assess the overall coalition strengths by adding up the contribution of
     // individual actors (including i and j, above). We assess the contribution of third
     // parties (n) by looking at little coalitions in the hypothetical (in:j) or (i:nj) contests.
-    for (unsigned int n = 0; n < md0->numAct; n++) {
+    for (unsigned int n = 0; n < qmd.numAct; n++) {
         if ((n != init_i) && (n != rcvr_j)) { // already got their influence-contributions
-            auto an = ((const SMPActor*)(md0->actrs[n]));
-
-            double cn = an->sCap;
-            double sn = KBase::sum(an->vSal);
-            double uni = autil[est_h](n, init_i);
-            double unj = autil[est_h](n, rcvr_j);
-            double unn = autil[est_h](n, n);
+            double cn = qmd.cap[n];
+            double sn = qmd.sal[n];
+            double uni = uh(n, init_i);
+            double unj = uh(n, rcvr_j);
+            double unn = uh(n, n);
 
             // notice that each third party starts afresh,
             // considering only contributions of principals and itself
-            double pin = Actor::vProbLittle(md0->vrCltn, sn*cn, uni, unj, contrib_i_ij, contrib_j_ij);
+            double pin = Actor::vProbLittle(qmd.vrCltn, sn*cn, uni, unj, contrib_i_ij, contrib_j_ij);
 
             if (0.0 > pin) {
               throw KException("SMPModel::getQuadMapPoint: pin must be non-negative");
@@ -1817,7 +2341,7 @@ double SMPModel::getQuadMapPoint(size_t t, size_t est_h, size_t aff_k, size_t in
               throw KException("SMPModel::getQuadMapPoint: pin must not be more than 1.0");
             }
             double pjn = 1.0 - pin;
-            auto vt_uv_ul = Actor::thirdPartyVoteSU(sn*cn, md0->vrCltn, md0->tpCommit, pin, pjn, uni, unj, unn);
+            auto vt_uv_ul = Actor::thirdPartyVoteSU(sn*cn, qmd.vrCltn, qmd.tpCommit, pin, pjn, uni, unj, unn);
             const double vnij = get<0>(vt_uv_ul);
             chij = (vnij > 0) ? (chij + vnij) : chij;
             if (0 >= chij) {
@@ -1840,187 +2364,93 @@ double SMPModel::getQuadMapPoint(size_t t, size_t est_h, size_t aff_k, size_t in
     return (euChlg - euSQ);
 }
 
-double SMPModel::getQuadMapPoint(const QString &connectionName, const string &scenarioID,
-  size_t turn, size_t est_h, size_t aff_k, size_t init_i, size_t rcvr_j) {
-
-  QSqlDatabase qdb = QSqlDatabase::database(connectionName);
-  QSqlQuery qtQry = QSqlQuery(qdb);;
-
-    auto getUtilQuery = [scenarioID, turn, est_h](size_t initiator, size_t receiver) {
-        string query = "SELECT Util FROM PosUtil WHERE ScenarioId = \'" + scenarioID
-                + "\' AND Turn_t = " + std::to_string(turn) + " AND Est_h = " + std::to_string(est_h)
-                + " AND Act_i = " + std::to_string(initiator) + " AND Pos_j =  " + std::to_string(receiver);
-        return query;
-    };
-
-    auto getVSalQuery = [scenarioID, turn](size_t actor) {
-        string query = "SELECT SUM(Sal) FROM SpatialSalience WHERE ScenarioId=\'" + scenarioID
-                + "\' AND Turn_t = " + std::to_string(turn) + " AND Act_i = " + std::to_string(actor);
-
-        return query;
-    };
-
-    auto getSCapQuery = [scenarioID, turn](size_t actor) {
-        string query = "SELECT Cap FROM SpatialCapability WHERE ScenarioId=\'" + scenarioID
-                + "\' AND Turn_t = " + std::to_string(turn) + " AND Act_i = " + std::to_string(actor);
-
-        return query;
-    };
-
-    // Get voting rule and third party commit for this scenario
-    string query = "SELECT VotingRule, ThirdPartyCommit FROM ScenarioDesc WHERE ScenarioId=\'" + scenarioID + "\'";
-
-    //voting rule
-    int vr;
-    //third party commit
-    int tpc;
-    if (qtQry.exec(query.c_str())) {
-      if (qtQry.first()) {
-        vr = qtQry.value(0).toInt();
-        tpc = qtQry.value(1).toInt();
+KMatrix SMPModel::getQuadMap(const QuadMapData & qmd, QuadMapPerspective persp, const VUI & inits,
+                             const VUI & rcvrs) {
+    const unsigned int na = qmd.numAct;
+    if (0 == na) { // nothing loaded, and uiSeq(0, na - 1) would wrap around
+      return KMatrix();
+    }
+    VUI rows = inits;
+    if (rows.empty()) {
+      rows = KBase::uiSeq(0, na - 1);
+    }
+    VUI cols = rcvrs;
+    if (cols.empty()) {
+      cols = KBase::uiSeq(0, na - 1);
+    }
+    for (auto j : cols) {
+      if (j >= na) {
+        throw KException("SMPModel::getQuadMap: receiver is out of range");
       }
     }
 
-    VotingRule vrCltn = static_cast<VotingRule>(vr);
-    ThirdPartyCommit tpCommit = static_cast<ThirdPartyCommit>(tpc);
-
-    auto getData = [&qtQry]() {
-      if (qtQry.exec()) {
-        if (qtQry.first()) {
-          return qtQry.value(0);
+    // every off-diagonal cell of the requested rows and columns is independent of the others
+    vector<tuple<unsigned int, unsigned int>> cells = {};
+    for (auto i : rows) {
+      if (i >= na) {
+        throw KException("SMPModel::getQuadMap: initiator is out of range");
+      }
+      for (auto j : cols) {
+        if (i != j) {
+          cells.push_back(tuple<unsigned int, unsigned int>(i, j));
         }
       }
-    };
-
-    auto utilValue = [&qtQry, &getData](size_t initiator, size_t receiver) {
-      qtQry.bindValue(":act_i", (uint)initiator);
-      qtQry.bindValue(":pos_j", (uint)receiver);
-      return getData().toDouble();
-    };
-
-    auto spatialValue = [&qtQry, &getData](size_t initiator) {
-      qtQry.bindValue(":act_i", (uint)initiator);
-      return getData().toDouble();
-    };
-
-    string utilQry = "SELECT Util FROM PosUtil WHERE ScenarioId = \'" + scenarioID
-      + "\' AND Turn_t = " + std::to_string(turn) + " AND Est_h = " + std::to_string(est_h)
-      + " AND Act_i = :act_i AND Pos_j = :pos_j";
-
-    qtQry.prepare(utilQry.c_str());
-
-    double uii = utilValue(init_i, init_i);
-
-    double uij = utilValue(init_i, rcvr_j);
-
-    double uji = utilValue(rcvr_j, init_i);
-
-    double ujj = utilValue(rcvr_j, rcvr_j);
-
-    double uki = utilValue(aff_k, init_i);
-
-    double ukj = utilValue(aff_k, rcvr_j);
-
-    double euSQ = uki + ukj;
-
-    double uhkij = 2 * uki;
-    if ((0.0 > uhkij) || (uhkij > 2.0)) {
-      throw KException("SMPModel::getQuadMapPoint: uhkij should be between 0.0 and 2.0");
-    }
-
-    double uhkji = 2 * ukj;
-    if ((0.0 > uhkji) || (uhkji > 2.0)) {
-      throw KException("SMPModel::getQuadMapPoint: uhkji should be between 0.0 and 2.0");
     }
 
-    string vsalQry = "SELECT SUM(Sal) FROM SpatialSalience WHERE ScenarioId=\'" + scenarioID
-      + "\' AND Turn_t = " + std::to_string(turn) + " AND Act_i = :act_i";
-    qtQry.prepare(vsalQry.c_str());
-
-    double si = spatialValue(init_i);
-    if ((0 >= si) || (si > 1)) {
-      throw KException("SMPModel::getQuadMapPoint: si should be between 0 and 1");
+    auto grid = KMatrix(na, na);
+    if (cells.empty()) {
+      return grid;
     }
 
-    double sj = spatialValue(rcvr_j);
-    if ((0 >= sj) || (sj > 1)) {
-      throw KException("SMPModel::getQuadMapPoint: sj should be between 0 and 1");
+    // Each cell is only O(numAct), so launching one thread per cell would
+    // cost more than it saves. Split the cells into a few contiguous blocks.
+    unsigned int numBlk = std::thread::hardware_concurrency();
+    if (0 == numBlk) {
+      numBlk = 4;
     }
+    const unsigned int numCell = cells.size();
+    numBlk = (numBlk < numCell) ? numBlk : numCell;
 
-    string scapQry = "SELECT Cap FROM SpatialCapability WHERE ScenarioId=\'" + scenarioID
-      + "\' AND Turn_t = " + std::to_string(turn) + " AND Act_i = :act_i";
-    qtQry.prepare(scapQry.c_str());
-
-    double ci = spatialValue(init_i);
-
-    double cj = spatialValue(rcvr_j);
-
-    auto contribs = calcContribs(vrCltn, si*ci, sj*cj, tuple<double, double, double, double>(uii, uij, uji, ujj));
-
-    double chij = get<0>(contribs); // strength of complete coalition supporting i over j (initially empty)
-    double chji = get<1>(contribs); // strength of complete coalition supporting j over i (initially empty)
-
-    // cache those sums
-    double contrib_i_ij = chij;
-    double contrib_j_ij = chji;
-
-    // Get count of actors for this scenario
-    query = "SELECT MAX(Act_i) FROM ActorDescription WHERE ScenarioId=\'" + scenarioID + "\'";
-    qtQry.prepare(query.c_str());
-    size_t numAct = getData().toUInt() + 1;
-
-    // we assess the overall coalition strengths by adding up the contribution of
-    // individual actors (including i and j, above). We assess the contribution of third
-    // parties (n) by looking at little coalitions in the hypothetical (in:j) or (i:nj) contests.
-    //for (size_t n = 0; n < numAct; n++) {
-    for (size_t n = 0; n < numAct; n++) {
-      if ((n != init_i) && (n != rcvr_j)) { // already got their influence-contributions
-
-            qtQry.prepare(vsalQry.c_str());
-            double sn = spatialValue(n);
-
-            qtQry.prepare(scapQry.c_str());
-            double cn = spatialValue(n);
-
-            qtQry.prepare(utilQry.c_str());
-            double uni = utilValue(n, init_i);
-
-            double unj = utilValue(n, rcvr_j);
-
-            double unn = utilValue(n, n);
-
-            // notice that each third party starts afresh,
-            // considering only contributions of principals and itself
-            double pin = Actor::vProbLittle(vrCltn, sn*cn, uni, unj, contrib_i_ij, contrib_j_ij);
-
-            if (0.0 > pin || pin > 1.0) {
-              throw KException("SMPModel::getQuadMapPoint: pin should be between 0 and 1");
-            }
-            double pjn = 1.0 - pin;
-            auto vt_uv_ul = Actor::thirdPartyVoteSU(sn*cn, vrCltn, tpCommit, pin, pjn, uni, unj, unn);
-            const double vnij = get<0>(vt_uv_ul);
-            chij = (vnij > 0) ? (chij + vnij) : chij;
-            if (0 >= chij) {
-              throw KException("SMPModel::getQuadMapPoint: chij must be positive");
-            }
-            chji = (vnij < 0) ? (chji - vnij) : chji;
-            if (0 >= chji) {
-              throw KException("SMPModel::getQuadMapPoint: chij must be positive");
-            }
+    std::mutex errLock;
+    string errMsg = "";
+    auto blkFn = [&qmd, &persp, &cells, &grid, &errLock, &errMsg, numBlk, numCell](unsigned int b) {
+      const unsigned int c1 = (b * numCell) / numBlk;
+      const unsigned int c2 = ((b + 1) * numCell) / numBlk;
+      try {
+        for (unsigned int c = c1; c < c2; c++) {
+          const unsigned int i = get<0>(cells[c]);
+          const unsigned int j = get<1>(cells[c]);
+          auto hk = persp(i, j);
+          // distinct cells, so no lock is needed to write the result
+          grid(i, j) = getQuadMapPoint(qmd, get<0>(hk), get<1>(hk), i, j);
         }
-    }
-
-    qtQry.finish();
-    qtQry.clear();
+      }
+      catch (KException &ke) {
+        std::lock_guard<std::mutex> lock(errLock);
+        errMsg = ke.msg;
+      }
+      catch (std::exception &std_ex) {
+        std::lock_guard<std::mutex> lock(errLock);
+        errMsg = std_ex.what();
+      }
+    };
+    KBase::groupThreads(blkFn, 0, numBlk - 1, numBlk);
 
-    const double phij = chij / (chij + chji); // ProbVict, for i
-    const double phji = chji / (chij + chji);
+    if (!errMsg.empty()) {
+      throw KException(errMsg);
+    }
+    return grid;
+}
 
-    const double euVict = uhkij;  // UtilVict
-    const double euCntst = phij*uhkij + phji*uhkji; // UtilContest,
-    const double euChlg = (1 - sj)*euVict + sj*euCntst; // UtilChlg
+double SMPModel::getQuadMapPoint(size_t t, size_t est_h, size_t aff_k, size_t init_i, size_t rcvr_j) {
+    auto qmd = getQuadMapData(md0, t);
+    return getQuadMapPoint(qmd, est_h, aff_k, init_i, rcvr_j);
+}
 
-    return (euChlg - euSQ);
+double SMPModel::getQuadMapPoint(const QString &connectionName, const string &scenarioID,
+  size_t turn, size_t est_h, size_t aff_k, size_t init_i, size_t rcvr_j) {
+    auto qmd = getQuadMapData(connectionName, scenarioID, turn, vector<size_t>{est_h});
+    return getQuadMapPoint(qmd, est_h, aff_k, init_i, rcvr_j);
 }
 
 tuple<double, double> SMPModel::calcContribs(VotingRule vrCltn, double wi, double wj, tuple<double, double, double, double>(utils)) {
@@ -2087,10 +2517,16 @@ void SMPModel::destroyModel() {
     delete md0;
 }
 
-void SMPModel::randomSMP(unsigned int numA, unsigned int sDim, bool accP, uint64_t s, vector<bool> f) {
+SMPModel * SMPModel::randomModel(unsigned int numA, unsigned int sDim, bool accP, uint64_t s, vector<bool> f) {
     // JAH 20160711 added rng seed 20160730 JAH added sql flags
     SMPModel *md0 = new SMPModel("", s, f);
-    md0->sqlTest();
+    try {
+      md0->sqlTest();
+    }
+    catch (...) {
+      delete md0;
+      throw;
+    }
     if (0 == numA) {
         double lnMin = log(4);
         double lnMax = log(25);
@@ -2108,10 +2544,12 @@ void SMPModel::randomSMP(unsigned int numA, unsigned int sDim, bool accP, uint64
     LOG(INFO) << "Number of SMP dimensions:" << sDim;
 
     if (0 >= sDim) {
-      throw KException("SMPModel::randomSMP: number of smp dimensions must be greater than zero");
+      delete md0;
+      throw KException("SMPModel::randomModel: number of smp dimensions must be greater than zero");
     }
     if (2 >= numA) {
-      throw KException("SMPModel::randomSMP: number of actors must be greater than 2");
+      delete md0;
+      throw KException("SMPModel::randomModel: number of actors must be greater than 2");
     }
 
     for (unsigned int i = 0; i < sDim; i++) {
@@ -2123,7 +2561,8 @@ void SMPModel::randomSMP(unsigned int numA, unsigned int sDim, bool accP, uint64
     }
 
     if (sDim != md0->numDim) {
-      throw KException("SMPModel::randomSMP: smp dimensions should match with that in model's history");
+      delete md0;
+      throw KException("SMPModel::randomModel: smp dimensions should match with that in model's history");
     }
 
     SMPState* st0 = new SMPState(md0);
@@ -2187,6 +2626,14 @@ void SMPModel::randomSMP(unsigned int numA, unsigned int sDim, bool accP, uint64
     st0->setAUtil(-1, ReportingLevel::Silent);
     st0->setNRA(); // TODO: simple setting of NRA
 
+    return md0;
+}
+
+void SMPModel::randomSMP(unsigned int numA, unsigned int sDim, bool accP, uint64_t s, vector<bool> f) {
+    SMPModel *md0 = randomModel(numA, sDim, accP, s, f);
+    numA = md0->numAct;
+    auto st0 = ((SMPState*)(md0->history[0]));
+
     // with SMP actors, we can always read their ideal position.
     // with strategic voting, they might want to advocate positions
     // separate from their ideal, but this simple demo skips that.
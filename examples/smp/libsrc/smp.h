@@ -24,6 +24,7 @@
 #ifndef SMP_LIB_H
 #define SMP_LIB_H
 
+#include <atomic>
 #include <string>
 #include <map>
 
@@ -34,6 +35,7 @@
 #include "kmatrix.h"
 #include "gaopt.h"
 #include "kmodel.h"
+#include "smallvec.h"
 
 namespace SMPLib {
 // namespace to which KBase has no access
@@ -59,6 +61,9 @@ using KBase::VUI;
 using KBase::BigRAdjust;
 using KBase::BigRRange;
 using KBase::KTable; // JAH 20160728
+
+// positions and differences of per-pair arithmetic; inline for up to 8 dimensions
+using PosVec = KBase::SmallVec<8>;
 using eduChlgsI = std::map<unsigned int /*j*/, tuple<double, double> >;
 
 class SMPActor;
@@ -93,7 +98,7 @@ ostream& operator<< (ostream& os, const InterVecBrgn& ivb);
 
 // -------------------------------------------------
 // Plain-Old-Data
-struct BargainSMP {
+struct BargainSMP : public KBase::MemCounted<KBase::MemCategory::Bargain> {
 public:
   BargainSMP(const SMPActor* ai, const SMPActor* ar, const VctrPstn & pi, const VctrPstn & pr);
   ~BargainSMP();
@@ -105,10 +110,65 @@ public:
   VctrPstn posRcvr = VctrPstn();
   uint64_t getID() const;
 protected:
-  static uint64_t highestBargainID;
+  static std::atomic<uint64_t> highestBargainID; // bargains are made on many threads at once
   uint64_t myBargainID = 0;
 };
 
+// -------------------------------------------------
+// Plain-Old-Data
+// Everything needed to compute quad-map points for one turn, read in bulk
+// so that a whole grid can be computed without going back to the DB.
+// util[h] is h's estimate of the actor/position utility matrix; it is
+// left empty for any estimator which was not loaded.
+struct QuadMapData {
+public:
+  unsigned int numAct = 0;
+  VotingRule vrCltn = VotingRule::Proportional;
+  ThirdPartyCommit tpCommit = ThirdPartyCommit::SemiCommit;
+  vector<KMatrix> util = {};
+  vector<double> cap = {};
+  vector<double> sal = {}; // sum of saliences over all dimensions
+};
+
+// Plain-Old-Data
+// A scenario as read from an input file, before any model is built from it.
+// Positions and saliences are on the [0,1] scale which initModel expects.
+// modelParams uses the order of updateModelParameters; empty means defaults.
+struct SMPScenario {
+public:
+  string name = "";
+  string desc = "";
+  uint64_t seed = KBase::dSeed;
+  vector<string> actorNames = {};
+  vector<string> actorDescs = {};
+  vector<string> dimNames = {};
+  KMatrix cap = KMatrix(); // one row per actor
+  KMatrix pos = KMatrix(); // one row per actor, one column per dimension
+  KMatrix sal = KMatrix(); // one row per actor, one column per dimension
+  KMatrix accM = KMatrix();
+  vector<int> modelParams = {};
+};
+
+enum class ScenarioField : unsigned int {
+  Capability, Position, Salience, Accommodation, ModelParameter
+};
+
+// Plain-Old-Data
+// One change to an SMPScenario, in the same units as the scenario.
+// i is the actor (or the model-parameter index), j is the dimension
+// (or, for accommodation, the actor whose position is the reference).
+struct ScenarioOverride {
+public:
+  ScenarioField field = ScenarioField::Capability;
+  unsigned int i = 0;
+  unsigned int j = 0;
+  double value = 0.0;
+};
+
+// For each (init_i, rcvr_j) cell of a quad map, return (est_h, aff_k):
+// whose estimate is used, and which actor's expected utility is plotted.
+using QuadMapPerspective = function<tuple<size_t, size_t>(size_t init_i, size_t rcvr_j)>;
+
 // -------------------------------------------------
 // Trivial, SMP-like actor with fixed attributes
 // the old smp.cpp file, SpatialState::developTwoPosBargain, for a discussion of
@@ -124,6 +184,7 @@ public:
 
   // interfaces to be provided
   double vote(unsigned int est, unsigned int i, unsigned int j, const State*st) const;
+  bool voteFromUtil(VotingRule & vr, double & w) const;
   virtual double vote(const Position * ap1, const Position * ap2, const SMPState* as1) const;
   double posUtil(const Position * ap1, const SMPState* as1) const;
 
@@ -220,7 +281,7 @@ public:
   // initialize the actors' ideals from the given list of VctrPstn.
   // If the list is omitted or empty, it uses their current positions
   void idealsFromPstns(const vector<VctrPstn> &  ps = {});
-  VctrPstn getIdeal(unsigned int n) const;
+  const VctrPstn & getIdeal(unsigned int n) const;
 
   uint64_t getPosMoverBargain(unsigned int actor) const;
 
@@ -231,18 +292,57 @@ protected:
 private:
 
   void calcUtils(unsigned int i, unsigned int bestJ) const;  // i == actor id
-  mutable std::mutex utilDataLock;
-  mutable std::multimap<string, KMatrix> tpvData;
-  mutable std::multimap<string, double>phijData;
-  mutable std::multimap<string, vector<double>> euData;
+
+  // Diagnostics of the challenges assessed in doBCN, held only while a turn is
+  // being recorded. They are flat arrays indexed by actor numbers, so each thread
+  // writes its own cells without locking: a given (h,k,i,j) is assessed by only one
+  // thread, and repeats of (h,i,j) for another k come later on that same thread.
+  // Only k in {i, j, h} is ever assessed, so utilities are stored by which one k is.
+  unsigned int chlgNA = 0;
+  mutable vector<char> phijSet = {};    // [(h*na + i)*na + j]
+  mutable vector<double> phijData = {}; // [(h*na + i)*na + j]
+  mutable vector<double> tpvData = {};  // [(((h*na + i)*na + j)*na + n)*3 + c], c: prob, util_v, util_l
+  mutable vector<char> euSet = {};      // [((h*na + i)*na + j)*3 + kSlot]
+  mutable vector<double> euData = {};   // [(((h*na + i)*na + j)*3 + kSlot)*4 + c], c: SQ, vict, cntst, chlg
+  static unsigned int chlgKSlot(unsigned int h, unsigned int k, unsigned int i, unsigned int j);
+  void initChlgData();
+  void releaseChlgData();
   void recordProbEduChlg() const;
 
+  // Third parties in decreasing order of the bound on their contribution to any
+  // challenge, by estimator, for probEduChlg when the model's tpTol is positive.
+  // They are set by doBCN only for the duration of the turn's challenges.
+  vector<unsigned int> tpOrder = {}; // [h*na + r], the actor of rank r
+  vector<double> tpBound = {};       // [h*na + n], the bound for actor n
+  vector<double> tpSum = {};         // [h], the sum of those bounds
+  void setTPBounds();
+  void releaseTPBounds();
+
+  // what the pruning achieved this turn: the bound on |error| in P[i>j]
+  mutable std::mutex tpStatsLock;
+  mutable uint64_t tpChlgs = 0;    // challenges assessed
+  mutable uint64_t tpSummed = 0;   // third parties summed exactly
+  mutable uint64_t tpTotal = 0;    // third parties there were
+  mutable double tpErrMax = 0.0;
+  mutable double tpErrSum = 0.0;
+
+  // Append the challenge diagnostics to a binary file: turn and na as uint32,
+  // then phijSet, phijData, tpvData, euSet and euData exactly as laid out above.
+  void writeProbEduChlg(const string & fileName) const;
+
   // this sets the values in all the AUtil matrices
   virtual void setAllAUtil(ReportingLevel rl);
 
   virtual void setOneAUtil(unsigned int perspH, ReportingLevel rl);
 
   KMatrix vDiff = KMatrix(); // vDiff(i,j) = difference between idl[i] and pos[j], using actor i's saliences as weights
+
+  // Contiguous na x numDim copies (row i is actor i) of the positions and saliences,
+  // for the dense kernels. pstns stays the owning Position* view; these are
+  // refreshed from it by packActors.
+  vector<double> posSoA = {};
+  vector<double> salSoA = {};
+  void packActors();
   KMatrix rnProb = KMatrix(); // probability of each Unique state, when actors are treated as risk-neutral
 
   // risk-aware probabilities are uProb
@@ -274,6 +374,8 @@ private:
   // return RMS distance between ideals and positions
   double posIdealDist(ReportingLevel rl = ReportingLevel::Silent) const;
 
+  // insert brgnVals into the Bargn table, each row together with the probability
+  // and selection of the bargain in its initiator's and receiver's queues
   void updateBargnTable(const vector<vector<BargainSMP*>> & brgns,
                         map<unsigned int, KBase::KMatrix>  actorBargains,
                         map<unsigned int, unsigned int>  actorMaxBrgNdx) const;
@@ -361,10 +463,32 @@ public:
   static double bsUtil(double sd, double R);
   static double bvDiff(const KMatrix & vd, const  KMatrix & vs);
   static double bvUtil(const KMatrix & vd, const  KMatrix & vs, double R);
+  static double bvDiff(const PosVec & vd, const  KMatrix & vs);
+  static double bvUtil(const PosVec & vd, const  KMatrix & vs, double R);
+
+  // vd[i*nb + j] = bvDiff(a_i - b_j, s_i) for every pair, where a and s are na x nd and
+  // b is nb x nd, all row-major. One blocked sweep, with no allocation per pair: each
+  // block of b is transposed so the innermost loop runs over contiguous j, which the
+  // compiler can vectorize. The sums are taken in the same order as bvDiff.
+  static void bvDiffMatrix(const double * a, const double * s, const double * b,
+                           unsigned int na, unsigned int nb, unsigned int nd, double * vd);
 
   static std::string runModel(std::vector<bool> sqlFlags,
       std::string inputDataFile, uint64_t seed, bool saveHist, std::vector<int> modelParams = std::vector<int>());
 
+  // Same as runModel, but on a private model instance that is deleted afterwards and
+  // logs to dbName (empty for the configured database). It does not touch md0, so
+  // several can run at once, one per thread. Errors are thrown, not stored.
+  static std::string runModelInstance(std::vector<bool> sqlFlags, std::string inputDataFile,
+      uint64_t seed, std::vector<int> modelParams, std::string dbName);
+
+  // read an xml or csv input file into a new model, throwing KException on failure
+  static SMPModel * readModel(std::string inputDataFile, std::vector<bool> sqlFlags, uint64_t seed);
+
+  // Same as the file version, but built straight from a scenario held in memory
+  static std::string runModelInstance(const SMPScenario & scen, std::vector<bool> sqlFlags,
+      std::string dbName);
+
   // this sets up a standard configuration and runs it
   static void configExec(SMPModel * md0);
 
@@ -377,9 +501,31 @@ public:
 
   static void randomSMP(unsigned int numA, unsigned int sDim, bool accP, uint64_t s, vector<bool> f);
 
+  // A random euSMP model, with its initial state, ready for configExec. A zero
+  // numA or sDim is drawn at random, in [4,25] and [1,3] respectively.
+  static SMPModel * randomModel(unsigned int numA, unsigned int sDim, bool accP, uint64_t s, vector<bool> f);
+
+  // Monte-Carlo ensemble: run numReps replicates at once, in this process and without
+  // any database, each with its own seed drawn from the master seed. Replicates are of
+  // the scenario in inputDataFile, or of fresh random euSMP scenarios if it is empty.
+  // Per-turn statistics of positions and probabilities are accumulated as replicates
+  // finish, in replicate order, and written to outFile; if detailFile is not empty,
+  // every replicate's positions and probabilities are written there as well.
+  // Returns the number of replicates which completed.
+  static unsigned int runEnsemble(unsigned int numReps, uint64_t seed, string inputDataFile,
+      bool accP, string outFile, string detailFile, unsigned int numPar = 0);
+
   static SMPModel * csvRead(string fName, uint64_t s, vector<bool> f);
   static SMPModel * xmlRead(string fName,vector<bool> f);
 
+  // parse and check an xml scenario without building a model from it
+  static SMPScenario xmlReadScenario(string fName);
+
+  // copy of base with the overrides applied, checked as strictly as xmlRead would
+  static SMPScenario applyOverrides(const SMPScenario & base, const vector<ScenarioOverride> & ovr);
+
+  static SMPModel * initModel(const SMPScenario & scen, vector<bool> f);
+
   static  SMPModel * initModel(vector<string> aName, vector<string> aDesc, vector<string> dName,
 	  const KMatrix & cap, // one row per actor
 	  const KMatrix & pos, // one row per actor, one column per dimension
@@ -398,6 +544,26 @@ public:
   // output the two files needed to draw Sankey diagram for Database
   static void sankeyOutput(string outputFile, string dbName, std::string scenarioId) ;
 
+  // If not empty, each turn's challenge diagnostics (see SMPState::writeProbEduChlg)
+  // are appended to this binary file, whether or not they are also logged to the DB
+  string chlgDataFile = "";
+
+  // If positive, SMPState::probEduChlg takes third parties in decreasing order of a
+  // bound on their contribution (capability x salience x utility range), and stops
+  // summing once the rest could not move P[i>j] by more than this; the rest is then
+  // split evenly. Zero sums over every third party, exactly.
+  double tpTol = 0.0;
+
+  // the tpTol given to models built from now on
+  static void setThirdPartyTol(double tol);
+
+  // most actors a scenario may have: Model::maxNumActor when every third party is
+  // summed, maxNumActorTP once they are pruned (tol > 0). Each turn still holds
+  // numAct estimates of a numAct x numAct utility matrix, i.e. 8*n^3 bytes.
+  static const unsigned int maxNumActorTP = 2000;
+  static unsigned int maxNumActors(double tol);
+  virtual unsigned int actorLimit() const override;
+
   // number of spatial dimensions in this SMP
   void addDim(string dn);
   unsigned int numDim = 0;
@@ -418,6 +584,10 @@ public:
   //default parameters for SMPQ
   static vector<int> getDefaultModelParameters();
 
+  // Names (as in the XML files) of the nine model parameters, in the order of
+  // updateModelParameters, converted to the int values that it expects
+  static vector<int> modelParametersFromNames(const vector<string> & names);
+
   static void destroyModel();
 
   /**
@@ -433,6 +603,24 @@ public:
   static double getQuadMapPoint(const QString &connectionName, const string &scenarioID,
     size_t turn, size_t est_h, size_t aff_k, size_t init_i, size_t rcvr_j);
 
+  /**
+  * Bulk-load the utilities, capabilities and saliences of one turn, either from
+  * the history of a model or with one query per table (and per estimator) from a db file
+  */
+  static QuadMapData getQuadMapData(const SMPModel * md, size_t turn);
+  static QuadMapData getQuadMapData(const QString &connectionName, const string &scenarioID,
+    size_t turn, const vector<size_t> & estimators);
+
+  static double getQuadMapPoint(const QuadMapData & qmd, size_t est_h, size_t aff_k, size_t init_i, size_t rcvr_j);
+
+  /**
+  * Compute the (init_i, rcvr_j) grid of quad-map points in parallel, with no further I/O.
+  * Only the rows listed in inits and the columns listed in rcvrs are filled (all of them,
+  * if a list is empty), so qmd needs only the estimators those cells use; the rest is zero.
+  */
+  static KMatrix getQuadMap(const QuadMapData & qmd, QuadMapPerspective persp, const VUI & inits = {},
+    const VUI & rcvrs = {});
+
   static uint getIterationCount();
 
   static uint getNumActors();
@@ -452,6 +640,8 @@ protected:
   // synchronized with the result of createTableSQL(k) !
   void sqlTest();
 
+  static double defaultTPTol;
+
   // voting rule for actors when forming coalitions over positions or bargains
   VotingRule vrCltn = VotingRule::Proportional;
 
@@ -473,6 +663,8 @@ protected:
 private:
   void releaseDB();
 
+  // run the model from makeModel, logging to dbName, then delete it
+  static string runInstance(function<SMPModel*()> makeModel, vector<int> modelParams, string dbName);
   
   static tuple<double, double> calcContribs(VotingRule vrCltn, double wi, double wj, tuple<double, double, double, double>(utils));
 
@@ -26,9 +26,12 @@
 // --------------------------------------------
 
 #include "smp.h"
+#include "kprofile.h"
+#include "klog.h"
 #include <QSqlQuery>
 #include <QVariant>
 #include <QSqlError>
+#include <set>
 
 namespace SMPLib {
 using std::function;
@@ -39,6 +42,7 @@ using std::map;
 using KBase::PRNG;
 using KBase::KMatrix;
 using KBase::KException;
+using KBase::KLog;
 using KBase::Actor;
 using KBase::Model;
 using KBase::Position;
@@ -54,7 +58,7 @@ using KBase::ReportingLevel;
 using KBase::nameFromEnum;
 
 // --------------------------------------------
-uint64_t BargainSMP::highestBargainID = 1000;
+std::atomic<uint64_t> BargainSMP::highestBargainID(1000);
 
 // big enough buffer to build all desired SQLite statements
 const unsigned int sqlBuffSize = 250;
@@ -85,7 +89,7 @@ BargainSMP::BargainSMP(const SMPActor* ai, const SMPActor* ar, const VctrPstn &
   actRcvr = ar;
   posInit = pi;
   posRcvr = pr;
-  myBargainID = BargainSMP::highestBargainID++;
+  myBargainID = BargainSMP::highestBargainID.fetch_add(1);
 }
 
 BargainSMP::~BargainSMP() {
@@ -195,6 +199,7 @@ vector<double> SMPState::calcVotes(KMatrix w, KMatrix u, int k) const
 }
 
 SMPState* SMPState::doBCN() {
+  KTAB_PROFILE_PHASE("SMPState::doBCN");
   const unsigned int na = model->numAct;
   brgns.resize(na);
   for (unsigned int i = 0; i < na; i++) {
@@ -205,13 +210,39 @@ SMPState* SMPState::doBCN() {
     this->doBCN(i);
   };
 
+  auto smod = dynamic_cast<SMPModel *>(model);
+  const bool keepChlg = model->sqlFlags[2] || !smod->chlgDataFile.empty();
+  if (keepChlg) {
+    initChlgData();
+  }
+  const bool pruneTP = (0.0 < smod->tpTol);
+  if (pruneTP) {
+    setTPBounds();
+  }
+
   KBase::groupThreads(thrBCN, 0, na - 1);
+  KLog::flush(); // so the workers' blocks precede what follows
+
+  if (pruneTP) {
+    releaseTPBounds();
+    const double pctSummed = (0 < tpTotal) ? (100.0 * tpSummed) / tpTotal : 100.0;
+    const double errMean = (0 < tpChlgs) ? tpErrSum / tpChlgs : 0.0;
+    LOG(INFO) << KBase::getFormattedString(
+      "Turn %u third parties: %llu challenges, %.1f%% summed exactly, |dP| bound max %.2e, mean %.2e",
+      turn, (unsigned long long)tpChlgs, pctSummed, tpErrMax, errMean);
+  }
 
   model->beginDBTransaction();
 
   if (model->sqlFlags[2]) {
     recordProbEduChlg();
   }
+  if (!smod->chlgDataFile.empty()) {
+    writeProbEduChlg(smod->chlgDataFile);
+  }
+  if (keepChlg) {
+    releaseChlgData();
+  }
 
   if (model->sqlFlags[3]) {
     for (auto brgnCoord : brgnCos) {
@@ -224,17 +255,8 @@ SMPState* SMPState::doBCN() {
     }
   }
 
-  if (model->sqlFlags[4]) {
-    for (auto brgnVal : brgnVals) {
-      model->sqlBargainEntries(
-        get<0>(brgnVal), //turn
-        get<1>(brgnVal), //bargnId
-        get<2>(brgnVal), //initiator
-        get<3>(brgnVal), //receiver
-        get<4>(brgnVal)  //value
-      );
-    }
-  }
+  // the Bargn rows (brgnVals) are written by updateBargnTable, once the
+  // selection results are known, so that each row is inserted complete
 
   //model->commitDBTransaction();
 
@@ -252,31 +274,82 @@ SMPState* SMPState::doBCN() {
   };
 
   KBase::groupThreads(thrCalcPosts, 0, na - 1);
+  KLog::flush();
 
   //model->beginDBTransaction();
 
   if (model->sqlFlags[3]) {
+    // Every non-SQ bargain is in both its initiator's and its receiver's queue,
+    // and its utilities and votes do not depend on the queue, so each bargain
+    // (or unordered pair of bargains) is written only the first time it is seen.
+    std::set<tuple<uint64_t, uint64_t>> votedPairs = {};
     for (auto votes : brgnVotes) {
+      if (votes.empty()) {
+        continue;
+      }
+      // every actor's vote in one queue is over the same pairs
+      const auto & pairs = get<1>(votes[0]);
+      auto keep = vector<bool>(pairs.size(), false);
+      auto keptPairs = vector<tuple<uint64_t, uint64_t>>();
+      for (unsigned int n = 0; n < pairs.size(); n++) {
+        const uint64_t b1 = get<0>(pairs[n]);
+        const uint64_t b2 = get<1>(pairs[n]);
+        auto key = tuple<uint64_t, uint64_t>((b1 < b2) ? b1 : b2, (b1 < b2) ? b2 : b1);
+        keep[n] = votedPairs.insert(key).second;
+        if (keep[n]) {
+          keptPairs.push_back(pairs[n]);
+        }
+      }
+      if (keptPairs.empty()) {
+        continue;
+      }
       for (auto vote : votes) {
+        const auto & pv = get<2>(vote);
+        auto keptVotes = vector<double>();
+        for (unsigned int n = 0; n < pv.size(); n++) {
+          if (keep[n]) {
+            keptVotes.push_back(pv[n]);
+          }
+        }
         model->sqlBargainVote(
           get<0>(vote), //turn
-          get<1>(vote), //barginIDsPair_i_j
-          get<2>(vote), //pv_ij
+          keptPairs,    //barginIDsPair_i_j
+          keptVotes,    //pv_ij
           get<3>(vote)  //actor
         );
       }
     }
 
+    std::set<uint64_t> utilBrgns = {};
     for (auto util : brgnUtils) {
+      const auto & ids = get<1>(util);
+      const KMatrix & uMat = get<2>(util);
+      auto keptIds = vector<uint64_t>();
+      auto keptCols = vector<unsigned int>();
+      for (unsigned int m = 0; m < ids.size(); m++) {
+        if (utilBrgns.insert(ids[m]).second) {
+          keptIds.push_back(ids[m]);
+          keptCols.push_back(m);
+        }
+      }
+      if (keptIds.empty()) {
+        continue;
+      }
+      auto keptUtil = KMatrix(uMat.numR(), keptCols.size());
+      for (unsigned int i = 0; i < uMat.numR(); i++) {
+        for (unsigned int c = 0; c < keptCols.size(); c++) {
+          keptUtil(i, c) = uMat(i, keptCols[c]);
+        }
+      }
       model->sqlBargainUtil(
         get<0>(util), //turn
-        get<1>(util), //bargnIds
-        get<2>(util)  //utilities
+        keptIds,      //bargnIds
+        keptUtil      //utilities
       );
     }
   }
 
-  // record data so far
+  // record the bargains, with the results of selection
   if (model->sqlFlags[4]) {
     updateBargnTable(brgns, actorBargains, actorMaxBrgNdx);
   }
@@ -333,6 +406,7 @@ SMPState* SMPState::doBCN() {
 }
 
 void SMPState::doBCN(unsigned int i) {
+    KTAB_PROFILE_PHASE("SMPState::doBCN(i)");
     auto ai = ((const SMPActor*)(model->actrs[i]));
     auto posI = ((const VctrPstn*)pstns[i]);
     auto smod = dynamic_cast<SMPModel *>(model);
@@ -388,7 +462,11 @@ void SMPState::doBCN(unsigned int i) {
       auto aj = ((const SMPActor*)(model->actrs[j]));
       auto posJ = ((const VctrPstn*)pstns[j]);
 
-      std::thread thr(&SMPState::calcUtils, this, i, bestJ);
+      // calcUtils only fills the challenge diagnostics, so skip it when none are kept
+      std::thread thr;
+      if (0 < chlgNA) {
+        thr = std::thread(&SMPState::calcUtils, this, i, bestJ);
+      }
 
       // make the variables local to lexical scope of this block.
       // for testing, calculate and print out a block of data showing each's perspective
@@ -432,77 +510,69 @@ void SMPState::doBCN(unsigned int i) {
       double wj = scj*svj;
 
       // create a new bargain whose positions are the weighted averages
-      auto bpi = VctrPstn((wi*brgnIIJ->posInit + wj*brgnJIJ->posInit) / (wi + wj));
-      auto bpj = VctrPstn((wi*brgnIIJ->posRcvr + wj*brgnJIJ->posRcvr) / (wi + wj));
+      const PosVec bvi = (wi*PosVec(brgnIIJ->posInit) + wj*PosVec(brgnJIJ->posInit)) / (wi + wj);
+      const PosVec bvj = (wi*PosVec(brgnIIJ->posRcvr) + wj*PosVec(brgnJIJ->posRcvr)) / (wi + wj);
+      auto bpi = VctrPstn(bvi.toKMatrix());
+      auto bpj = VctrPstn(bvj.toKMatrix());
       BargainSMP *brgnIJ = new  BargainSMP(brgnIIJ->actInit, brgnIIJ->actRcvr, bpi, bpj);
 
-      mtxLock.lock();
-      LOG(INFO) << KBase::getFormattedString(
+      // buffered per thread, so the block for this actor stays together without a lock
+      KLOG(ReportingLevel::Low) << KBase::getFormattedString(
         "In turn %i actor %u has most advantageous target %u worth %.3f",
         turn, i, j, bestEU);
 
       // Look for counter-intuitive cases
       if (piiJ < 0.5) {
-        LOG(INFO) << "turn" << turn << ","
-            << "i" << i << ","
-            << "j" << j << ","
-            << "bestEU worth" << bestEU << ","
-            << "piiJ " << piiJ;
+        KLOG(ReportingLevel::Low) << KBase::getFormattedString(
+          "turn %i, i %u, j %u, bestEU worth %f, piiJ %f", turn, i, j, bestEU, piiJ);
       }
 
       // I's estimate of the effect on I of I->J
-      LOG(INFO) << KBase::getFormattedString(
+      KLOG(ReportingLevel::Medium) << KBase::getFormattedString(
         "Est by %2u of prob %.4f that [%2u>%2u], with expected gain to %2u of %+.4f",
         i, piiJ, i, j, i, get<2>(chlgI));
 
       // I's estimate of the effect on J of I->J
-      LOG(INFO) << KBase::getFormattedString(
+      KLOG(ReportingLevel::Medium) << KBase::getFormattedString(
           "Est by %2u of prob %.4f that [%2u>%2u], with expected gain to %2u of %+.4f",
           i, get<0>(est_ijij), i, j, j, get<1>(est_ijij));
 
       // J's estimate of the effect on I of I->J
-      LOG(INFO) << KBase::getFormattedString(
+      KLOG(ReportingLevel::Medium) << KBase::getFormattedString(
           "Est by %2u of prob %.4f that [%2u>%2u], with expected gain to %2u of %+.4f",
           j, get<0>(Vjij), i, j, i, get<1>(Vjij));
 
       // J's estimate of the effect on J of I->J
-      LOG(INFO) << KBase::getFormattedString(
+      KLOG(ReportingLevel::Medium) << KBase::getFormattedString(
           "Est by %2u of prob %.4f that [%2u>%2u], with expected gain to %2u of %+.4f",
           j, get<0>(est_jjij), i, j, j, get<1>(est_jjij));
-      LOG(INFO) << "";
-
-      // Bargain positions from i's perspective
-      LOG(INFO) << "Bargain" << showOneBargain(brgnIIJ)
-        << "from" << std::to_string(i) + "'s perspective (brgnIIJ)";
-      //LOG(INFO) << i << "proposes" << i << "adopt:";
-      string proposal = string("   ") + std::to_string(i) + " proposes " + std::to_string(i) + " adopt: ";
-      (KBase::trans(brgnIIJ->posInit) * 100.0).mPrintf(" %.3f ", proposal); // print on the scale of [0,100]
-      //LOG(INFO) << i << "proposes" << j << "adopt:";
-      proposal = string("   ") + std::to_string(i) + " proposes " + std::to_string(j) + " adopt: ";
-      (KBase::trans(brgnIIJ->posRcvr) * 100.0).mPrintf(" %.3f ", proposal); // print on the scale of [0,100]
-      LOG(INFO) << "";
+      KLOG(ReportingLevel::Medium) << "";
+
+      // Bargain positions from i's perspective, on the scale of [0,100]
+      KLOG(ReportingLevel::High) << "Bargain " << showOneBargain(brgnIIJ)
+        << " from " << i << "'s perspective (brgnIIJ)";
+      KLOG_MATRIX(ReportingLevel::High, KBase::trans(brgnIIJ->posInit) * 100.0, " %.3f ",
+                  string("   ") + std::to_string(i) + " proposes " + std::to_string(i) + " adopt: ");
+      KLOG_MATRIX(ReportingLevel::High, KBase::trans(brgnIIJ->posRcvr) * 100.0, " %.3f ",
+                  string("   ") + std::to_string(i) + " proposes " + std::to_string(j) + " adopt: ");
+      KLOG(ReportingLevel::High) << "";
 
       // Bargain positions from j's perspective
-      LOG(INFO) << "Bargain" << showOneBargain(brgnJIJ)
-        << "from" << std::to_string(j) + "'s perspective (brgnIIJ)";
-      //LOG(INFO) << j << "proposes" << i << "adopt:";
-      proposal = string("   ") + std::to_string(j) + " proposes " + std::to_string(i) + " adopt: ";
-      (KBase::trans(brgnJIJ->posInit) * 100.0).mPrintf(" %.3f ", proposal); // print on the scale of [0,100]
-      //LOG(INFO) << j << "proposes" << j << "adopt:";
-      proposal = string("   ") + std::to_string(j) + " proposes " + std::to_string(j) + " adopt: ";
-      (KBase::trans(brgnJIJ->posRcvr) * 100.0).mPrintf(" %.3f ", proposal); // print on the scale of [0,100]
-      LOG(INFO) << "";
+      KLOG(ReportingLevel::High) << "Bargain " << showOneBargain(brgnJIJ)
+        << " from " << j << "'s perspective (brgnIIJ)";
+      KLOG_MATRIX(ReportingLevel::High, KBase::trans(brgnJIJ->posInit) * 100.0, " %.3f ",
+                  string("   ") + std::to_string(j) + " proposes " + std::to_string(i) + " adopt: ");
+      KLOG_MATRIX(ReportingLevel::High, KBase::trans(brgnJIJ->posRcvr) * 100.0, " %.3f ",
+                  string("   ") + std::to_string(j) + " proposes " + std::to_string(j) + " adopt: ");
+      KLOG(ReportingLevel::High) << "";
 
       // Power-weighted compromise
-      LOG(INFO) << "Power-weighted compromise" << showOneBargain(brgnIJ) << "bargain (brgnIJ)";
-      //LOG(INFO) << "  Compromise proposes" << i << "adopt: ";
-      proposal = string("   ") + string("  compromise proposes ") + std::to_string(i) + " adopt: ";
-      (KBase::trans(brgnIJ->posInit) * 100.0).mPrintf(" %.3f ", proposal); // print on the scale of [0,100]
-
-      //LOG(INFO) << "  Compromise proposes" << j << "adopt: ";
-      proposal = string("   ") + string("  compromise proposes ") + std::to_string(j) + " adopt: ";
-      (KBase::trans(brgnIJ->posRcvr) * 100.0).mPrintf(" %.3f ", proposal); // print on the scale of [0,100]
-      LOG(INFO) << "";
+      KLOG(ReportingLevel::High) << "Power-weighted compromise " << showOneBargain(brgnIJ) << " bargain (brgnIJ)";
+      KLOG_MATRIX(ReportingLevel::High, KBase::trans(brgnIJ->posInit) * 100.0, " %.3f ",
+                  string("   ") + string("  compromise proposes ") + std::to_string(i) + " adopt: ");
+      KLOG_MATRIX(ReportingLevel::High, KBase::trans(brgnIJ->posRcvr) * 100.0, " %.3f ",
+                  string("   ") + string("  compromise proposes ") + std::to_string(j) + " adopt: ");
+      KLOG(ReportingLevel::High) << "";
 
 
       // TODO: make one-perspective an option.
@@ -512,8 +582,7 @@ void SMPState::doBCN(unsigned int i) {
       //brgnIJ = tIIJ;
       //brgnIIJ = tIJ;
 
-      LOG(INFO) << "Using" << bMod << "to form proposed bargains";
-      mtxLock.unlock();
+      KLOG(ReportingLevel::Medium) << "Using " << bMod << " to form proposed bargains";
       switch (bMod) {
       case SMPBargnModel::InitOnlyInterpSMPBM:
         // record the only one used into SQLite JAH 20160802 use the flag
@@ -603,14 +672,18 @@ void SMPState::doBCN(unsigned int i) {
         throw KException("SMPState::doBCN(i): unrecognized SMPBargnModel");
       }
 
-      thr.join();
+      if (thr.joinable()) {
+        thr.join();
+      }
     }
     else {
-      LOG(INFO) << "In turn" << turn << "Actor" << i << "has no advantageous targets";
+      KLOG(ReportingLevel::Low) << "In turn " << turn << " Actor " << i << " has no advantageous targets";
     }
+    KLog::flushThread();
 }
 
 void SMPState::updateBestBrgnPositions(int k) {
+  KTAB_PROFILE_PHASE("SMPState::updateBestBrgnPositions");
   auto ndxMaxProb = [](const KMatrix & cv) {
     const double pTol = 1E-8;
     if (fabs(KBase::sum(cv) - 1.0) >= pTol) {
@@ -693,13 +766,13 @@ void SMPState::updateBestBrgnPositions(int k) {
     unsigned int na = smod->numAct;
     unsigned int nb = brgns[k].size();
 
-    mtxLock.lock();
     auto u_im = KMatrix::map(buk, na, nb);
 
-    LOG(INFO) << "u_im:";
-    u_im.mPrintf(" %.5f ");
+    // buffered per thread, so the block for this actor stays together without a lock
+    KLOG(ReportingLevel::High) << "u_im:";
+    KLOG_MATRIX(ReportingLevel::High, u_im, " %.5f ");
 
-    LOG(INFO) << "Doing scalarPCE for the" << nb << "bargains of actor" << k << "...";
+    KLOG(ReportingLevel::Medium) << "Doing scalarPCE for the " << nb << " bargains of actor " << k << " ...";
     auto p = Model::scalarPCE(na, nb, w, u_im, smod->vrCltn, smod->vpm, smod->pcem, ReportingLevel::Medium);
     if (nb != p.numR()) {
       throw KException("SMPState::updateBestBrgnPositions: number of bargains mismatched with scalar PCE row count");
@@ -707,29 +780,33 @@ void SMPState::updateBestBrgnPositions(int k) {
     if (1 != p.numC()) {
       throw KException("SMPState::updateBestBrgnPositions: scalar pce column size is not 1");
     }
-    actorBargains.insert(map<unsigned int, KBase::KMatrix>::value_type(k, p));
 
     unsigned int mMax = nb; // indexing actors by i, bargains by m
-    switch (smod->stm) {
-    case StateTransMode::DeterminsticSTM:
-      mMax = ndxMaxProb(p);
-      break;
-    case StateTransMode::StochasticSTM:
-      mMax = model->rng->probSel(p);
-      break;
-    default:
-      throw KException("SMPState::updateBestBrgnPositions - unrecognized StateTransMode");
-      break;
-    }
-    // 0 <= mMax assured for uint
-    if (mMax >= nb) {
-      throw KException("SMPState::updateBestBrgnPositions: Bargain number with max probability can't be more than bargain count");
+    {
+      // the result maps, and the PRNG of a stochastic choice, are shared by all actors' threads
+      std::lock_guard<std::mutex> lock(mtxLock);
+      actorBargains.insert(map<unsigned int, KBase::KMatrix>::value_type(k, p));
+      switch (smod->stm) {
+      case StateTransMode::DeterminsticSTM:
+        mMax = ndxMaxProb(p);
+        break;
+      case StateTransMode::StochasticSTM:
+        mMax = model->rng->probSel(p);
+        break;
+      default:
+        throw KException("SMPState::updateBestBrgnPositions - unrecognized StateTransMode");
+        break;
+      }
+      // 0 <= mMax assured for uint
+      if (mMax >= nb) {
+        throw KException("SMPState::updateBestBrgnPositions: Bargain number with max probability can't be more than bargain count");
+      }
+      actorMaxBrgNdx.insert(map<unsigned int, unsigned int>::value_type(k, mMax));
     }
-    actorMaxBrgNdx.insert(map<unsigned int, unsigned int>::value_type(k, mMax));
     auto bkm = brgns[k][mMax];
-    LOG(INFO) << "Chosen bargain (" << smod->stm << "):" << bkm->getID()
-      << mMax + 1 << "out of" << nb << "bargains";
-    mtxLock.unlock();
+    KLOG(ReportingLevel::Low) << "Chosen bargain (" << smod->stm << "): " << bkm->getID() << " "
+      << mMax + 1 << " out of " << nb << " bargains";
+    KLog::flushThread();
 
     //populate the Bargain Vote & Util tables
     // JAH added sql flag logging control
@@ -806,6 +883,7 @@ void SMPState::updateBestBrgnPositions(int k) {
 // TODO: offer a choice the different ways of estimating value-of-a-state: even sum or expected value.
 // TODO: we may need to separate euConflict from this at some point
 tuple<double, double> SMPState::probEduChlg(unsigned int h, unsigned int k, unsigned int i, unsigned int j, bool sqlP) const {
+  KTAB_PROFILE_COUNT("SMPState::probEduChlg", 1);
 
   // you could make other choices for these two sub-models
   auto sMod = (const SMPModel*)model;
@@ -919,12 +997,32 @@ tuple<double, double> SMPState::probEduChlg(unsigned int h, unsigned int k, unsi
 
   const unsigned int na = model->numAct;
 
+  // With pruning, third parties are taken heaviest first, and we stop once the
+  // bound on the rest, split either way, could not move P[i>j] by more than tpTol.
+  // Those skipped have zero rows in tpvArray.
+  const bool pruneTP = (0 < tpOrder.size());
+  const double tpTol = sMod->tpTol;
+  double tpRest = 0.0;
+  unsigned int numSummed = 0;
+  if (pruneTP) {
+    tpRest = tpSum[h] - tpBound[h*na + i] - tpBound[h*na + j];
+  }
+
   // we assess the overall coalition strengths by adding up the contribution of
   // individual actors (including i and j, above). We assess the contribution of third
   // parties (n) by looking at little coalitions in the hypothetical (in:j) or (i:nj) contests.
   auto tpvArray = KMatrix(na, 3);
-  for (unsigned int n = 0; n < na; n++) {
+  for (unsigned int r = 0; r < na; r++) {
+    const unsigned int n = pruneTP ? tpOrder[h*na + r] : r;
     if ((n != i) && (n != j)) { // already got their influence-contributions
+      if (pruneTP) {
+        tpRest = std::max(0.0, tpRest);
+        if (tpRest <= 2.0 * tpTol * (chij + chji + tpRest)) {
+          break;
+        }
+        tpRest = tpRest - tpBound[h*na + n];
+        numSummed = numSummed + 1;
+      }
       auto an = ((const SMPActor*)(model->actrs[n]));
 
       double cn = an->sCap;
@@ -963,8 +1061,21 @@ tuple<double, double> SMPState::probEduChlg(unsigned int h, unsigned int k, unsi
     }
   }
 
-  const double phij = chij / (chij + chji); // ProbVict, for i
-  const double phji = chji / (chij + chji);
+  double phij = chij / (chij + chji); // ProbVict, for i
+  double phji = chji / (chij + chji);
+  if (pruneTP) {
+    // the rest could have gone either way, so take the middle of the possible range
+    tpRest = std::max(0.0, tpRest);
+    const double tpErr = tpRest / (2.0 * (chij + chji + tpRest));
+    phij = (chij + tpRest / 2.0) / (chij + chji + tpRest);
+    phji = 1.0 - phij;
+    std::lock_guard<std::mutex> lock(tpStatsLock);
+    tpChlgs = tpChlgs + 1;
+    tpSummed = tpSummed + numSummed;
+    tpTotal = tpTotal + (na - 2);
+    tpErrMax = std::max(tpErrMax, tpErr);
+    tpErrSum = tpErrSum + tpErr;
+  }
 
   const double euVict = uhkij;  // UtilVict
   const double euCntst = phij*uhkij + phji*uhkji; // UtilContest,
@@ -975,43 +1086,119 @@ tuple<double, double> SMPState::probEduChlg(unsigned int h, unsigned int k, unsi
   // JAH 20160802 switched to use the model sql flags vector to control logging
   // I keep sqlP and short-circuit & it because sometimes probEduChlg is called to
   // do some temporary calcs which should not be store - this is controlled with sqlP
-  if (sqlP && model->sqlFlags[2]) {
-    // now that the computation is finished, record everything into SQLite
-    //
-    // record tpvArray into SQLite turn, est (h), init (i), third party (n), receiver (j), and tpvArray[n]
-    // printf ("SMPState::probEduChlg(%2i, %2i, %2i, %i2) = %+6.4f - %+6.4f = %+6.4f\n", h, k, i, j, euCh, euSQ, euChlg);
-
-    string thij = std::to_string(turn)
-      + "," + std::to_string(h)
-      + "," + std::to_string(i)
-      + "," + std::to_string(j);
-
-    // formatting note: %d means an integer, base 10
-    // we will use base 10 by default, and these happen to be unsigned integers, so %i is appropriate
-
-    string thkij = std::to_string(turn)
-      + "," + std::to_string(h)
-      + "," + std::to_string(k)
-      + "," + std::to_string(i)
-      + "," + std::to_string(j);
-
-    std::vector<double> eu;
-    eu.push_back(euSQ);
-    eu.push_back(euVict);
-    eu.push_back(euCntst);
-    eu.push_back(euChlg);
-
-    // Thread safety lock
-    utilDataLock.lock();
-    euData.emplace(thkij,eu);
-    tpvData.emplace(thij, tpvArray);
-    phijData.emplace(thij, phij);
-    utilDataLock.unlock();
+  // (the tensors are allocated, and chlgNA set, only while doBCN needs the record)
+  if (sqlP && (0 < chlgNA)) {
+    // now that the computation is finished, record everything for SQLite:
+    // tpvArray by estimator (h), initiator (i), receiver (j) and third party (n),
+    // and the utilities also by affected actor (k)
+    const size_t hij = (((size_t)h) * na + i) * na + j;
+    phijSet[hij] = 1;
+    phijData[hij] = phij;
+    for (unsigned int n = 0; n < na; n++) {
+      for (unsigned int c = 0; c < 3; c++) {
+        tpvData[(hij * na + n) * 3 + c] = tpvArray(n, c);
+      }
+    }
+
+    const size_t hkij = hij * 3 + chlgKSlot(h, k, i, j);
+    euSet[hkij] = 1;
+    euData[hkij * 4 + 0] = euSQ;
+    euData[hkij * 4 + 1] = euVict;
+    euData[hkij * 4 + 2] = euCntst;
+    euData[hkij * 4 + 3] = euChlg;
   }
   return rslt;
 }
 
 
+unsigned int SMPState::chlgKSlot(unsigned int h, unsigned int k, unsigned int i, unsigned int j) {
+  if (k == i) {
+    return 0;
+  }
+  if (k == j) {
+    return 1;
+  }
+  if (k == h) {
+    return 2;
+  }
+  throw KException("SMPState::chlgKSlot: k must be one of i, j or h");
+}
+
+
+void SMPState::initChlgData() {
+  const size_t na = model->numAct;
+  const size_t nHIJ = na * na * na;
+  chlgNA = na;
+  phijSet = vector<char>(nHIJ, 0);
+  phijData = vector<double>(nHIJ, 0.0);
+  tpvData = vector<double>(nHIJ * na * 3, 0.0);
+  euSet = vector<char>(nHIJ * 3, 0);
+  euData = vector<double>(nHIJ * 3 * 4, 0.0);
+}
+
+
+// The bound for third party n, as estimated by h, is the largest vote which an actor
+// with n's capability and salience could cast over any difference in n's utilities.
+// In Actor::thirdPartyVoteSU, n votes over a probability-weighted difference of
+// its utilities for the positions of i, j and n, so its size is at most the range
+// of row n of aUtil[h], whichever i and j are.
+void SMPState::setTPBounds() {
+  const unsigned int na = model->numAct;
+  const VotingRule vr = ((const SMPModel*)model)->vrCltn;
+  tpOrder = vector<unsigned int>(na * na, 0);
+  tpBound = vector<double>(na * na, 0.0);
+  tpSum = vector<double>(na, 0.0);
+  for (unsigned int h = 0; h < na; h++) {
+    const KMatrix & uh = aUtil[h];
+    for (unsigned int n = 0; n < na; n++) {
+      auto an = ((const SMPActor*)(model->actrs[n]));
+      const double wn = an->sCap * KBase::sum(an->vSal);
+      double uLo = uh(n, 0);
+      double uHi = uh(n, 0);
+      for (unsigned int m = 1; m < na; m++) {
+        uLo = std::min(uLo, uh(n, m));
+        uHi = std::max(uHi, uh(n, m));
+      }
+      double bn = 0.0;
+      if (0.0 < wn) {
+        // every rule is monotonic in the utility difference, though not always symmetric
+        bn = std::max(fabs(Model::vote(vr, wn, uHi - uLo, 0.0)),
+                      fabs(Model::vote(vr, wn, 0.0, uHi - uLo)));
+      }
+      tpBound[h*na + n] = bn;
+      tpSum[h] = tpSum[h] + bn;
+    }
+    auto ord = KBase::uiSeq(0, na - 1);
+    std::stable_sort(ord.begin(), ord.end(), [this, h, na](unsigned int a, unsigned int b) {
+      return tpBound[h*na + a] > tpBound[h*na + b];
+    });
+    std::copy(ord.begin(), ord.end(), tpOrder.begin() + h*na);
+  }
+  tpChlgs = 0;
+  tpSummed = 0;
+  tpTotal = 0;
+  tpErrMax = 0.0;
+  tpErrSum = 0.0;
+}
+
+
+void SMPState::releaseTPBounds() {
+  tpOrder = {};
+  tpBound = {};
+  tpSum = {};
+}
+
+
+void SMPState::releaseChlgData() {
+  chlgNA = 0;
+  phijSet = {};
+  phijData = {};
+  tpvData = {};
+  euSet = {};
+  euData = {};
+}
+
+
 tuple<int, double, double> SMPState::bestChallenge(eduChlgsI &eduI) const {
   int bestJ = -1;
   double pIJ = 0;
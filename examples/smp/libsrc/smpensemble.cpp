@@ -0,0 +1,394 @@
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// --------------------------------------------
+// Monte-Carlo ensembles of SMP runs, summarized turn by turn.
+// --------------------------------------------
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "kmodel.h"
+#include "onlinestats.h"
+#include "smp.h"
+
+
+namespace SMPLib {
+using std::string;
+using std::vector;
+
+using KBase::PRNG;
+using KBase::KException;
+using KBase::OnlineStats;
+using KBase::VctrPstn;
+
+namespace {
+// What one replicate contributes to the ensemble
+struct EnsembleTrace {
+  uint64_t seed = 0;
+  bool ok = false;
+  string error = "";
+  double seconds = 0.0;
+  unsigned int numAct = 0;
+  unsigned int numDim = 0;
+  unsigned int numTurns = 0;
+  vector<string> actorNames = {};
+  vector<string> dimNames = {};
+  vector<double> pos = {};  // [(t*numAct + i)*numDim + k], on the [0,100] scale
+  vector<double> prob = {}; // [t*numAct + i], with each actor's own utilities
+};
+
+EnsembleTrace traceModel(const SMPModel * md) {
+  EnsembleTrace et;
+  et.numAct = md->numAct;
+  et.numDim = md->numDim;
+  et.numTurns = md->history.size();
+  for (auto a : md->actrs) {
+    et.actorNames.push_back(a->name);
+  }
+  et.dimNames = md->dimName;
+  et.pos.resize(et.numTurns * et.numAct * et.numDim);
+  et.prob.resize(et.numTurns * et.numAct);
+  for (unsigned int t = 0; t < et.numTurns; t++) {
+    auto st = md->history[t];
+    for (unsigned int i = 0; i < et.numAct; i++) {
+      auto vp = static_cast<const VctrPstn*>(st->pstns[i]);
+      for (unsigned int k = 0; k < et.numDim; k++) {
+        et.pos[(t*et.numAct + i)*et.numDim + k] = (*vp)(k, 0) * 100.0;
+      }
+    }
+    auto pn = st->cachedPDist(-1);
+    const KMatrix & pdt = std::get<0>(pn);
+    const VUI & unq = std::get<1>(pn);
+    for (unsigned int i = 0; i < et.numAct; i++) {
+      et.prob[t*et.numAct + i] = st->posProb(i, unq, pdt);
+    }
+  }
+  return et;
+}
+
+// root-mean-square distance of the positions at turn t from their centroid
+double posSpread(const EnsembleTrace & et, unsigned int t) {
+  const double * p = &(et.pos[t*et.numAct*et.numDim]);
+  double ss = 0.0;
+  for (unsigned int k = 0; k < et.numDim; k++) {
+    double c = 0.0;
+    for (unsigned int i = 0; i < et.numAct; i++) {
+      c = c + p[i*et.numDim + k];
+    }
+    c = c / et.numAct;
+    for (unsigned int i = 0; i < et.numAct; i++) {
+      const double d = p[i*et.numDim + k] - c;
+      ss = ss + d*d;
+    }
+  }
+  return sqrt(ss / et.numAct);
+}
+
+double maxProb(const EnsembleTrace & et, unsigned int t) {
+  const double * p = &(et.prob[t*et.numAct]);
+  return *std::max_element(p, p + et.numAct);
+}
+
+// Everything kept about the ensemble. By-actor statistics are only kept
+// when every replicate has the same actors and dimensions.
+struct EnsembleStats {
+  bool byActor = false;
+  unsigned int numAct = 0;
+  unsigned int numDim = 0;
+  vector<string> actorNames = {};
+  vector<string> dimNames = {};
+  unsigned int numFailed = 0;
+
+  OnlineStats turns, actors, dims, seconds;
+  vector<OnlineStats> spread = {};  // by turn
+  vector<OnlineStats> mxProb = {};  // by turn
+  vector<OnlineStats> pos = {};     // by turn, actor and dimension
+  vector<OnlineStats> prob = {};    // by turn and actor
+  OnlineStats finalSpread, finalMxProb;
+  vector<OnlineStats> finalPos = {};
+  vector<OnlineStats> finalProb = {};
+
+  void add(const EnsembleTrace & et) {
+    if (!et.ok) {
+      numFailed = numFailed + 1;
+      return;
+    }
+    if (0 == turns.count()) {
+      numAct = et.numAct;
+      numDim = et.numDim;
+      actorNames = et.actorNames;
+      dimNames = et.dimNames;
+      finalPos.resize(numAct * numDim);
+      finalProb.resize(numAct);
+    }
+    else if ((numAct != et.numAct) || (numDim != et.numDim)) {
+      byActor = false;
+    }
+    turns.add(et.numTurns);
+    actors.add(et.numAct);
+    dims.add(et.numDim);
+    seconds.add(et.seconds);
+
+    if (spread.size() < et.numTurns) {
+      spread.resize(et.numTurns);
+      mxProb.resize(et.numTurns);
+      if (byActor) {
+        pos.resize(et.numTurns * numAct * numDim);
+        prob.resize(et.numTurns * numAct);
+      }
+    }
+    const unsigned int tLast = et.numTurns - 1;
+    for (unsigned int t = 0; t < et.numTurns; t++) {
+      spread[t].add(posSpread(et, t));
+      mxProb[t].add(maxProb(et, t));
+    }
+    finalSpread.add(posSpread(et, tLast));
+    finalMxProb.add(maxProb(et, tLast));
+
+    if (byActor) {
+      const unsigned int na = numAct * numDim;
+      for (unsigned int t = 0; t < et.numTurns; t++) {
+        for (unsigned int n = 0; n < na; n++) {
+          pos[t*na + n].add(et.pos[t*na + n]);
+        }
+        for (unsigned int i = 0; i < numAct; i++) {
+          prob[t*numAct + i].add(et.prob[t*numAct + i]);
+        }
+      }
+      for (unsigned int n = 0; n < na; n++) {
+        finalPos[n].add(et.pos[tLast*na + n]);
+      }
+      for (unsigned int i = 0; i < numAct; i++) {
+        finalProb[i].add(et.prob[tLast*numAct + i]);
+      }
+    }
+    return;
+  }
+};
+
+void writeStatsRow(FILE * f, const string & metric, const string & turn,
+                   const string & actor, const string & dim, const OnlineStats & s) {
+  if (0 == s.count()) {
+    return;
+  }
+  fprintf(f, "%s,%s,%s,%s,%u,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f\n",
+          metric.c_str(), turn.c_str(), actor.c_str(), dim.c_str(), s.count(),
+          s.mean(), s.stdv(), s.min(), s.quantile(0), s.quantile(1), s.quantile(2), s.max());
+  return;
+}
+
+void writeEnsembleStats(const EnsembleStats & es, const string & outFile) {
+  FILE * f = fopen(outFile.c_str(), "w");
+  if (nullptr == f) {
+    throw KException("SMPModel::runEnsemble: could not open " + outFile);
+  }
+  fprintf(f, "Metric,Turn,Actor,Dim,N,Mean,StdDev,Min,Q10,Median,Q90,Max\n");
+  writeStatsRow(f, "Turns", "", "", "", es.turns);
+  writeStatsRow(f, "Actors", "", "", "", es.actors);
+  writeStatsRow(f, "Dims", "", "", "", es.dims);
+  writeStatsRow(f, "Seconds", "", "", "", es.seconds);
+
+  auto writeTurn = [f, &es](const string & tName, const OnlineStats & sp, const OnlineStats & mp,
+                            const OnlineStats * ps, const OnlineStats * pr) {
+    writeStatsRow(f, "Spread", tName, "", "", sp);
+    writeStatsRow(f, "MaxProb", tName, "", "", mp);
+    if (es.byActor) {
+      for (unsigned int i = 0; i < es.numAct; i++) {
+        for (unsigned int k = 0; k < es.numDim; k++) {
+          writeStatsRow(f, "Pos", tName, es.actorNames[i], es.dimNames[k], ps[i*es.numDim + k]);
+        }
+        writeStatsRow(f, "Prob", tName, es.actorNames[i], "", pr[i]);
+      }
+    }
+  };
+  for (unsigned int t = 0; t < es.spread.size(); t++) {
+    const OnlineStats * ps = es.byActor ? &(es.pos[t*es.numAct*es.numDim]) : nullptr;
+    const OnlineStats * pr = es.byActor ? &(es.prob[t*es.numAct]) : nullptr;
+    writeTurn(std::to_string(t), es.spread[t], es.mxProb[t], ps, pr);
+  }
+  if (0 < es.turns.count()) {
+    writeTurn("final", es.finalSpread, es.finalMxProb, es.finalPos.data(), es.finalProb.data());
+  }
+  fclose(f);
+  return;
+}
+
+void writeEnsembleTrace(FILE * f, unsigned int r, const EnsembleTrace & et) {
+  if (!et.ok) {
+    return;
+  }
+  for (unsigned int t = 0; t < et.numTurns; t++) {
+    for (unsigned int i = 0; i < et.numAct; i++) {
+      for (unsigned int k = 0; k < et.numDim; k++) {
+        fprintf(f, "%u,%llu,%u,%u,%u,%.4f,%.6f\n", r, (unsigned long long)et.seed, t, i, k,
+                et.pos[(t*et.numAct + i)*et.numDim + k], et.prob[t*et.numAct + i]);
+      }
+    }
+  }
+  return;
+}
+}
+
+unsigned int SMPModel::runEnsemble(unsigned int numReps, uint64_t seed, string inputDataFile,
+                                   bool accP, string outFile, string detailFile, unsigned int numPar) {
+  using std::chrono::steady_clock;
+  using std::chrono::duration;
+
+  if (0 == numReps) {
+    throw KException("SMPModel::runEnsemble: numReps must be positive");
+  }
+
+  // no replicate touches a database
+  const vector<bool> noSQL(Model::NumSQLLogGrps + NumSQLLogGrps, false);
+
+  // An xml scenario is parsed only once; a csv file is re-read by each replicate.
+  const bool randomP = inputDataFile.empty();
+  bool xmlP = false;
+  SMPScenario scen;
+  if (!randomP) {
+    const size_t dotPos = inputDataFile.find_last_of(".");
+    string fileExt = (string::npos == dotPos) ? "" : inputDataFile.substr(dotPos + 1);
+    std::transform(fileExt.begin(), fileExt.end(), fileExt.begin(), ::tolower);
+    xmlP = (0 == fileExt.compare("xml"));
+    if (xmlP) {
+      scen = xmlReadScenario(inputDataFile);
+    }
+  }
+  auto makeModel = [randomP, xmlP, &scen, &inputDataFile, accP, &noSQL](uint64_t s) {
+    if (randomP) {
+      return randomModel(0, 0, accP, s, noSQL);
+    }
+    if (xmlP) {
+      SMPScenario sc = scen;
+      sc.seed = s;
+      return initModel(sc, noSQL);
+    }
+    return readModel(inputDataFile, noSQL, s);
+  };
+
+  // Seeds are drawn up front, in replicate order, from one master stream
+  auto master = PRNG(seed);
+  auto seeds = vector<uint64_t>();
+  for (unsigned int r = 0; r < numReps; r++) {
+    seeds.push_back(master.uniform());
+  }
+
+  FILE * fd = nullptr;
+  if (!detailFile.empty()) {
+    fd = fopen(detailFile.c_str(), "w");
+    if (nullptr == fd) {
+      throw KException("SMPModel::runEnsemble: could not open " + detailFile);
+    }
+    fprintf(fd, "Rep,Seed,Turn,Act_i,Dim_k,Pos_Coord,Prob\n");
+  }
+
+  // Finished replicates wait here until all earlier ones are in, so the
+  // statistics do not depend on which thread finishes first.
+  EnsembleStats es;
+  es.byActor = !randomP;
+  std::mutex foldLock;
+  std::map<unsigned int, EnsembleTrace> pending;
+  unsigned int nextRep = 0;
+  auto fold = [&](unsigned int r, EnsembleTrace && et) {
+    std::lock_guard<std::mutex> lock(foldLock);
+    pending[r] = std::move(et);
+    auto it = pending.find(nextRep);
+    while (pending.end() != it) {
+      const EnsembleTrace & ei = it->second;
+      if (ei.ok) {
+        LOG(INFO) << KBase::getFormattedString(
+          "Ensemble replicate %u: %u actors, %u dims, %u states, %.3f sec",
+          nextRep, ei.numAct, ei.numDim, ei.numTurns, ei.seconds);
+      }
+      else {
+        LOG(INFO) << KBase::getFormattedString("Ensemble replicate %u failed: %s",
+                                               nextRep, ei.error.c_str());
+      }
+      es.add(ei);
+      if (nullptr != fd) {
+        writeEnsembleTrace(fd, nextRep, ei);
+      }
+      pending.erase(it);
+      nextRep = nextRep + 1;
+      it = pending.find(nextRep);
+    }
+  };
+
+  // a failed replicate is reported and counted, but does not stop the others
+  const auto tStart = steady_clock::now();
+  auto rFn = [&seeds, &makeModel, &fold](unsigned int r) {
+    const auto t0 = steady_clock::now();
+    EnsembleTrace et;
+    SMPModel * md = nullptr;
+    try {
+      md = makeModel(seeds[r]);
+      configExec(md);
+      et = traceModel(md);
+      et.ok = true;
+    }
+    catch (KException &ke) {
+      et.error = ke.msg;
+    }
+    catch (std::exception &std_ex) {
+      et.error = std_ex.what();
+    }
+    catch (...) {
+      et.error = "Unknown Exception Caught";
+    }
+    delete md;
+    et.seed = seeds[r];
+    et.seconds = duration<double>(steady_clock::now() - t0).count();
+    fold(r, std::move(et));
+  };
+  KBase::groupThreads(rFn, 0, numReps - 1, numPar);
+  const double wallSecs = duration<double>(steady_clock::now() - tStart).count();
+
+  if (nullptr != fd) {
+    fclose(fd);
+  }
+  writeEnsembleStats(es, outFile);
+
+  const unsigned int numDone = es.turns.count();
+  LOG(INFO) << KBase::getFormattedString(
+    "Ensemble: %u of %u replicates completed in %.3f sec (%.3f sec summed over replicates)",
+    numDone, numReps, wallSecs, es.seconds.mean() * numDone);
+  if (0 < numDone) {
+    LOG(INFO) << KBase::getFormattedString(
+      "Actors %.1f [%.0f, %.0f], dims %.1f [%.0f, %.0f], states %.1f [%.0f, %.0f]",
+      es.actors.mean(), es.actors.min(), es.actors.max(),
+      es.dims.mean(), es.dims.min(), es.dims.max(),
+      es.turns.mean(), es.turns.min(), es.turns.max());
+  }
+  LOG(INFO) << "Ensemble summary written to" << outFile;
+  return numDone;
+}
+
+}; // end of namespace
+
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
@@ -109,7 +109,7 @@ SMPModel * SMPModel::csvRead(string fName, uint64_t s, vector<bool> f) {
     if (numDim < 1) { // lower limit
         throw(KBase::KException("SMPModel:csvRead: Invalid number of dimensions"));
     }
-    if ((numActor < minNumActor) || (maxNumActor < numActor)) { // avoid impossibly low or ridiculously large
+    if ((numActor < minNumActor) || (maxNumActors(defaultTPTol) < numActor)) { // avoid impossibly low or ridiculously large
         throw(KBase::KException("SMPModel::csvRead: Invalid number of actors"));
     }
 
@@ -259,6 +259,16 @@ SMPModel * SMPModel::csvRead(string fName, uint64_t s, vector<bool> f) {
 // end of csvRead
 
 SMPModel * SMPModel::xmlRead(string fName, vector<bool> f) {
+    const SMPScenario scen = xmlReadScenario(fName);
+    // now that it is read and verified, use the data
+    SMPModel * smp = initModel(scen, f);
+    if (nullptr == smp) {
+      throw KException("SMPModel::xmlRead: Model Initialization failed to provide a valid smp object.");
+    }
+    return smp;
+}
+
+SMPScenario SMPModel::xmlReadScenario(string fName) {
     using KBase::enumFromName;
     LOG(INFO) << "Start SMPModel::readXML of" << fName;
 
@@ -308,7 +318,6 @@ SMPModel * SMPModel::xmlRead(string fName, vector<bool> f) {
     XMLDocument d1;
 
     // declare variables out here, so as to be in-scope at 'return'
-    SMPModel* smp = nullptr;  
     vector<string> actorNames = {};
     vector<string> actorDescs = {};
     vector<string> dNames = {};
@@ -564,26 +573,24 @@ SMPModel * SMPModel::xmlRead(string fName, vector<bool> f) {
     posM = posM / 100.0;
     salM = salM / 100.0;
     LOG(INFO) << "End SMPModel::readXML of" << fName;
-    // now that it is read and verified, use the data  
-    smp = initModel(actorNames, actorDescs, dNames, capM, posM, salM, accM, seed, f, sDesc, sName);
-    if (nullptr == smp) {
-      throw KException("SMPModel::xmlRead: Model Initialization failed to provide a valid smp object.");
-    }
 
+    SMPScenario scen;
+    scen.name = sName;
+    scen.desc = sDesc;
+    scen.seed = seed;
+    scen.actorNames = actorNames;
+    scen.actorDescs = actorDescs;
+    scen.dimNames = dNames;
+    scen.cap = capM;
+    scen.pos = posM;
+    scen.sal = salM;
+    scen.accM = accM;
     if (modelHasParams) {
-        LOG(INFO) << "Setting SMPModel parameters from XML scenario ...";
-        smp->vpm = vpmScen;
-        smp->vrCltn = vrScen;
-        smp->pcem = pcemScen;
-        smp->stm = stmScen;
-        smp->bigRRng = bigRRangScen;
-        smp->bigRAdj = bigRAdjScen;
-        smp->tpCommit = tpcScen;
-        smp->ivBrgn = ivbScen;
-        smp->brgnMod = bModScen;
+        // same order as updateModelParameters
+        scen.modelParams = { (int)vpmScen, (int)pcemScen, (int)stmScen, (int)vrScen, (int)bigRAdjScen,
+                             (int)bigRRangScen, (int)tpcScen, (int)ivbScen, (int)bModScen };
     }
-
-    return smp;
+    return scen;
 }
 // end of readXML
 
@@ -0,0 +1,461 @@
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// --------------------------------------------
+// --------------------------------------------
+// Serve SMP scenario jobs over a local Unix domain socket; see smpserver.h.
+// --------------------------------------------
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <sstream>
+
+#ifndef _WIN32
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "smpserver.h"
+
+
+namespace SMPLib {
+using std::shared_ptr;
+using std::string;
+using std::vector;
+
+using KBase::KException;
+using KBase::Model;
+using KBase::PRNG;
+
+SMPServer::SMPServer(string sp, unsigned int nw, string jd) : stopping(false) {
+  if (sp.empty()) {
+    throw KException("SMPServer::SMPServer: socket path must not be empty");
+  }
+  sockPath = sp;
+  numWorkers = (0 < nw) ? nw : std::max(1u, std::thread::hardware_concurrency());
+  jobDir = jd.empty() ? "." : jd;
+}
+
+SMPServer::~SMPServer() {
+  jobs.clear();
+  queue.clear();
+}
+
+void SMPServer::stop() {
+  stopping = true;
+}
+
+#ifdef _WIN32
+
+void SMPServer::serve() {
+  throw KException("SMPServer::serve: Unix domain sockets are not supported on this platform");
+}
+
+#else
+
+namespace {
+const size_t maxInlineBytes = 64 * 1024 * 1024;
+
+bool sendAll(int fd, const string & s) {
+  size_t sent = 0;
+  while (sent < s.size()) {
+    const ssize_t n = send(fd, s.data() + sent, s.size() - sent, MSG_NOSIGNAL);
+    if (0 >= n) {
+      return false;
+    }
+    sent = sent + n;
+  }
+  return true;
+}
+
+// read from fd until buf holds at least n bytes; false if the peer goes away first
+bool recvAtLeast(int fd, string & buf, size_t n) {
+  char chunk[4096];
+  while (buf.size() < n) {
+    const ssize_t r = recv(fd, chunk, sizeof(chunk), 0);
+    if (0 >= r) {
+      return false;
+    }
+    buf.append(chunk, r);
+  }
+  return true;
+}
+
+bool finished(SMPServer::JobState js) {
+  return (SMPServer::JobState::Done == js) || (SMPServer::JobState::Failed == js) ||
+         (SMPServer::JobState::Cancelled == js);
+}
+}
+
+void SMPServer::serve() {
+  sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (sizeof(addr.sun_path) <= sockPath.size()) {
+    throw KException("SMPServer::serve: socket path is too long: " + sockPath);
+  }
+  strncpy(addr.sun_path, sockPath.c_str(), sizeof(addr.sun_path) - 1);
+
+  const int lfd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (0 > lfd) {
+    throw KException("SMPServer::serve: could not create a socket");
+  }
+  unlink(sockPath.c_str()); // left behind by an earlier server, if any
+  // only this user may submit jobs: the socket is created without group or
+  // other access, rather than tightened after bind has already exposed it
+  const mode_t oldMask = umask(S_IRWXG | S_IRWXO);
+  const bool bound = (0 == bind(lfd, (const sockaddr*)&addr, sizeof(addr)));
+  umask(oldMask);
+  if (!bound || (0 != listen(lfd, 64))) {
+    close(lfd);
+    throw KException("SMPServer::serve: could not listen on " + sockPath);
+  }
+
+  auto workers = vector<std::thread>();
+  for (unsigned int w = 0; w < numWorkers; w++) {
+    workers.push_back(std::thread(&SMPServer::worker, this));
+  }
+  LOG(INFO) << KBase::getFormattedString("SMP server listening on %s with %u workers",
+                                         sockPath.c_str(), numWorkers);
+
+  // poll with a timeout, so that stop() is noticed even when nobody connects
+  while (!stopping) {
+    pollfd pfd = { lfd, POLLIN, 0 };
+    if ((0 < poll(&pfd, 1, 200)) && (0 != (pfd.revents & POLLIN))) {
+      const int cfd = accept(lfd, nullptr, nullptr);
+      if (0 <= cfd) {
+        std::lock_guard<std::mutex> lock(clientLock);
+        clientFDs.insert(cfd);
+        std::thread(&SMPServer::client, this, cfd).detach();
+      }
+    }
+  }
+  close(lfd);
+  unlink(sockPath.c_str());
+
+  LOG(INFO) << "SMP server finishing the submitted jobs";
+  {
+    std::lock_guard<std::mutex> lock(jobLock);
+    draining = true;
+  }
+  jobQueued.notify_all();
+  for (auto & w : workers) {
+    w.join();
+  }
+
+  // every WAIT has been answered, so the remaining clients can be dropped
+  {
+    std::unique_lock<std::mutex> lock(clientLock);
+    for (int fd : clientFDs) {
+      shutdown(fd, SHUT_RDWR);
+    }
+    clientsGone.wait(lock, [this] { return clientFDs.empty(); });
+  }
+  LOG(INFO) << "SMP server stopped";
+  return;
+}
+
+void SMPServer::client(int fd) {
+  string pending = "";
+  while (true) {
+    const size_t eol = pending.find('\n');
+    if (string::npos == eol) {
+      if (!recvAtLeast(fd, pending, pending.size() + 1)) {
+        break;
+      }
+      continue;
+    }
+    string line = pending.substr(0, eol);
+    pending.erase(0, eol + 1);
+    if ((!line.empty()) && ('\r' == line.back())) {
+      line.pop_back();
+    }
+    if (line.empty()) {
+      continue;
+    }
+
+    string reply = "";
+    try {
+      reply = handle(line, fd, pending);
+    }
+    catch (KException &ke) {
+      reply = "ERR " + ke.msg;
+    }
+    catch (std::exception &std_ex) {
+      reply = string("ERR ") + std_ex.what();
+    }
+    if (!sendAll(fd, reply + "\n")) {
+      break;
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(clientLock);
+  clientFDs.erase(fd);
+  close(fd);
+  clientsGone.notify_all();
+  return;
+}
+
+string SMPServer::handle(const string & line, int fd, string & pending) {
+  std::istringstream iss(line);
+  string cmd = "";
+  iss >> cmd;
+  auto args = vector<string>();
+  string a = "";
+  while (iss >> a) {
+    args.push_back(a);
+  }
+
+  if ("SUBMIT" == cmd) {
+    return submit(args, fd, pending);
+  }
+  if ("SHUTDOWN" == cmd) {
+    stop();
+    return "OK";
+  }
+
+  std::unique_lock<std::mutex> lock(jobLock);
+  if (("STATUS" == cmd) && args.empty()) {
+    unsigned int n[5] = { 0, 0, 0, 0, 0 };
+    for (const auto & j : jobs) {
+      n[static_cast<unsigned int>(j.second->state)]++;
+    }
+    return KBase::getFormattedString("SERVER workers=%u queued=%u running=%u done=%u failed=%u cancelled=%u",
+                                     numWorkers, n[0], n[1], n[2], n[3], n[4]);
+  }
+  if ((("STATUS" != cmd) && ("WAIT" != cmd) && ("CANCEL" != cmd)) || (1 != args.size())) {
+    return "ERR unrecognized request: " + line;
+  }
+  const uint64_t id = std::stoull(args[0]);
+  auto it = jobs.find(id);
+  if (jobs.end() == it) {
+    return "ERR no such job: " + args[0];
+  }
+  shared_ptr<Job> job = it->second;
+
+  if ("WAIT" == cmd) {
+    jobFinished.wait(lock, [&job] { return finished(job->state); });
+  }
+  else if ("CANCEL" == cmd) {
+    if (JobState::Queued == job->state) {
+      queue.erase(std::find(queue.begin(), queue.end(), job));
+      job->state = JobState::Cancelled;
+      job->error = "cancelled before it started";
+      jobFinished.notify_all();
+    }
+    else if (JobState::Running == job->state) {
+      job->cancel = true;
+    }
+    else {
+      return "ERR job has already finished: " + args[0];
+    }
+    return "OK " + args[0];
+  }
+  return status(*job);
+}
+
+string SMPServer::submit(const vector<string> & args, int fd, string & pending) {
+  auto kv = std::map<string, string>();
+  for (const string & a : args) {
+    const size_t eq = a.find('=');
+    if ((string::npos == eq) || (0 == eq)) {
+      throw KException("SMPServer::submit: expected key=value, not " + a);
+    }
+    kv[a.substr(0, eq)] = a.substr(eq + 1);
+  }
+  for (const auto & p : kv) {
+    const string & k = p.first;
+    if ((k != "csv") && (k != "xml") && (k != "inline") && (k != "bytes") &&
+        (k != "seed") && (k != "logmin") && (k != "db") && (k != "params")) {
+      throw KException("SMPServer::submit: unrecognized key " + k);
+    }
+  }
+  if (1 != kv.count("csv") + kv.count("xml") + kv.count("inline")) {
+    throw KException("SMPServer::submit: give exactly one of csv, xml or inline");
+  }
+
+  // the payload is taken off the connection before anything else can fail,
+  // so a rejected job does not leave its bytes to be read as requests
+  string fmt = "";
+  string payload = "";
+  if (1 == kv.count("inline")) {
+    fmt = kv["inline"];
+    if ((0 == kv.count("bytes")) || (fmt != "csv" && fmt != "xml")) {
+      throw KException("SMPServer::submit: inline needs csv or xml, and bytes");
+    }
+    const size_t nb = std::stoull(kv["bytes"]);
+    if ((0 == nb) || (maxInlineBytes < nb)) {
+      throw KException("SMPServer::submit: inline scenario must be between 1 byte and 64MB");
+    }
+    if (!recvAtLeast(fd, pending, nb)) {
+      throw KException("SMPServer::submit: connection closed before the whole scenario arrived");
+    }
+    payload = pending.substr(0, nb);
+    pending.erase(0, nb);
+  }
+  else {
+    fmt = (1 == kv.count("csv")) ? "csv" : "xml";
+  }
+
+  auto job = std::make_shared<Job>();
+  job->inputFile = (1 == kv.count("inline")) ? "" : kv[fmt];
+
+  // as on the command line: xml files keep their own seed unless one is given
+  job->seed = (fmt == "xml") ? ((uint64_t)-1) : KBase::dSeed;
+  if (1 == kv.count("seed")) {
+    job->seed = std::stoull(kv["seed"]);
+    if (0 == job->seed) {
+      PRNG rng;
+      job->seed = rng.setSeed(0); // 0 == get a random number
+    }
+  }
+
+  job->sqlFlags = {true, true, true, true, true};
+  if ((1 == kv.count("logmin")) && ("0" != kv["logmin"])) {
+    job->sqlFlags = {true, false, false, false, true};
+  }
+
+  if (1 == kv.count("params")) {
+    std::istringstream pss(kv["params"]);
+    string p = "";
+    while (std::getline(pss, p, ',')) {
+      job->modelParams.push_back(std::stoi(p));
+    }
+    if (9 != job->modelParams.size()) {
+      throw KException("SMPServer::submit: params needs exactly 9 values");
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(jobLock);
+  if (stopping || draining) {
+    throw KException("SMPServer::submit: the server is shutting down");
+  }
+  lastJobID++;
+  job->id = lastJobID;
+  const string jobName = jobDir + "/job" + std::to_string(job->id);
+  job->dbName = (1 == kv.count("db")) ? kv["db"] : (jobName + ".db");
+  if (!payload.empty()) {
+    job->inputFile = jobName + "." + fmt;
+    job->inlineInput = true;
+    FILE * f = fopen(job->inputFile.c_str(), "wb");
+    if (nullptr == f) {
+      throw KException("SMPServer::submit: could not write " + job->inputFile);
+    }
+    const size_t nw = fwrite(payload.data(), 1, payload.size(), f);
+    fclose(f);
+    if (payload.size() != nw) {
+      std::remove(job->inputFile.c_str());
+      throw KException("SMPServer::submit: could not write " + job->inputFile);
+    }
+  }
+  jobs[job->id] = job;
+  queue.push_back(job);
+  jobQueued.notify_one();
+  return "OK " + std::to_string(job->id);
+}
+
+#endif
+
+string SMPServer::status(const Job & job) const {
+  const string id = std::to_string(job.id);
+  switch (job.state) {
+  case JobState::Queued:
+    return "JOB " + id + " queued";
+  case JobState::Running:
+    return "JOB " + id + (job.cancel ? " cancelling" : " running");
+  case JobState::Done:
+    return KBase::getFormattedString("JOB %s done secs=%.3f db=%s scenario=%s", id.c_str(),
+                                     job.seconds, job.dbName.c_str(), job.scenarioID.c_str());
+  case JobState::Failed:
+    return "JOB " + id + " failed " + job.error;
+  case JobState::Cancelled:
+    return "JOB " + id + " cancelled " + job.error;
+  }
+  return "JOB " + id;
+}
+
+void SMPServer::worker() {
+  while (true) {
+    shared_ptr<Job> job = nullptr;
+    {
+      std::unique_lock<std::mutex> lock(jobLock);
+      jobQueued.wait(lock, [this] { return (!queue.empty()) || draining; });
+      if (queue.empty()) {
+        return;
+      }
+      job = queue.front();
+      queue.pop_front();
+      job->state = JobState::Running;
+    }
+    runJob(job);
+  }
+}
+
+void SMPServer::runJob(shared_ptr<Job> job) {
+  const auto t0 = std::chrono::steady_clock::now();
+  string scenID = "";
+  string err = "";
+  Model::setThreadCancelFlag(&(job->cancel));
+  try {
+    scenID = SMPModel::runModelInstance(job->sqlFlags, job->inputFile, job->seed,
+                                        job->modelParams, job->dbName);
+  }
+  catch (KException &ke) {
+    err = ke.msg;
+  }
+  catch (std::exception &std_ex) {
+    err = std_ex.what();
+  }
+  catch (...) {
+    err = "SMPServer::runJob: Unknown Exception Caught";
+  }
+  Model::setThreadCancelFlag(nullptr);
+  if (job->inlineInput) {
+    std::remove(job->inputFile.c_str());
+  }
+  const std::chrono::duration<double> dt = std::chrono::steady_clock::now() - t0;
+
+  std::lock_guard<std::mutex> lock(jobLock);
+  job->seconds = dt.count();
+  job->scenarioID = scenID;
+  job->error = err;
+  if (err.empty()) {
+    job->state = JobState::Done;
+  }
+  else {
+    job->state = job->cancel ? JobState::Cancelled : JobState::Failed;
+  }
+  LOG(INFO) << status(*job);
+  jobFinished.notify_all();
+  return;
+}
+
+}; // end of namespace
+
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
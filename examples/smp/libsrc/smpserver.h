@@ -0,0 +1,135 @@
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// --------------------------------------------
+//
+// A long-lived SMP process which takes scenario jobs over a local Unix domain
+// socket, so that many short runs share one start-up. Each job runs on its own
+// model, on one of a fixed number of worker threads.
+//
+// Requests and replies are single lines of text:
+//
+//   SUBMIT csv=<f> | xml=<f> | inline=<csv|xml> bytes=<n>
+//          [seed=<n>] [logmin=1] [db=<name>] [params=<p0,...,p8>]
+//       -> OK <id>    or   ERR <message>
+//     With inline, exactly n bytes of the scenario file follow the line.
+//     Without seed, a csv job uses the default seed and an xml job the one in
+//     its file; seed=0 draws one at random. Without db, the job logs to
+//     <jobdir>/job<id>.db. File names may not contain spaces.
+//   STATUS <id>  -> JOB <id> <queued|running|cancelling>
+//                   JOB <id> done secs=<x> db=<name> scenario=<scenario id>
+//                   JOB <id> <failed|cancelled> <message>
+//   STATUS       -> SERVER workers=<n> queued=<n> running=<n> done=<n> failed=<n> cancelled=<n>
+//   WAIT <id>    -> the STATUS line, once the job has finished
+//   CANCEL <id>  -> OK <id>. A queued job is dropped, a running one stops after its current turn.
+//   SHUTDOWN     -> OK. No more jobs are accepted; those already submitted are finished first.
+// --------------------------------------------
+
+#ifndef SMP_SERVER_H
+#define SMP_SERVER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "smp.h"
+
+
+namespace SMPLib {
+using std::string;
+using std::vector;
+
+class SMPServer {
+public:
+  // numWorkers of zero uses one per hardware thread
+  SMPServer(string sockPath, unsigned int numWorkers, string jobDir);
+  virtual ~SMPServer();
+
+  // Listen on the socket until SHUTDOWN is received or stop() is called,
+  // then finish the submitted jobs and return. Throws KException if the
+  // socket cannot be set up.
+  void serve();
+
+  // Safe to call from another thread, or from a signal handler
+  void stop();
+
+  enum class JobState : unsigned int {
+    Queued, Running, Done, Failed, Cancelled
+  };
+
+protected:
+  struct Job {
+    uint64_t id = 0;
+    string inputFile = "";
+    bool inlineInput = false; // inputFile was written by the server, and is deleted after the run
+    uint64_t seed = 0;
+    vector<bool> sqlFlags = {};
+    vector<int> modelParams = {};
+    string dbName = "";
+    JobState state = JobState::Queued;
+    std::atomic<bool> cancel;
+    double seconds = 0.0;
+    string scenarioID = "";
+    string error = "";
+    Job() : cancel(false) {}
+  };
+
+  // One request line, plus the socket it came on for any inline payload; returns the reply
+  string handle(const string & line, int fd, string & pending);
+  string submit(const vector<string> & args, int fd, string & pending);
+  string status(const Job & job) const; // call with jobLock held
+  void client(int fd);
+  void worker();
+  void runJob(std::shared_ptr<Job> job);
+
+  string sockPath = "";
+  string jobDir = "";
+  unsigned int numWorkers = 0;
+
+  std::atomic<bool> stopping;
+
+  std::mutex jobLock;
+  std::condition_variable jobQueued;
+  std::condition_variable jobFinished;
+  uint64_t lastJobID = 0;
+  std::map<uint64_t, std::shared_ptr<Job>> jobs = {};
+  std::deque<std::shared_ptr<Job>> queue = {};
+  bool draining = false; // workers exit once the queue is empty
+
+  std::mutex clientLock;
+  std::condition_variable clientsGone;
+  std::set<int> clientFDs = {};
+};
+
+}; // end of namespace
+
+// --------------------------------------------
+#endif
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
@@ -26,11 +26,13 @@
 // --------------------------------------------
 
 #include "smp.h"
+#include "kprofile.h"
 #include "sqlite3.h"
 #include <QSqlQuery>
 #include <QVariant>
 #include <QSqlError>
 #include <QCoreApplication>
+#include <fstream>
 
 namespace SMPLib {
 using std::function;
@@ -53,6 +55,7 @@ using KBase::ReportingLevel;
 KTable * SMPModel::createSQL(unsigned int n)  {
   string sql = "";
   string name = "";
+  string pk = ""; // natural key of a per-turn results table, for the keyed schema
   unsigned int grpID = 0;
   // check total number of table exceeds
   if (n >= Model::NumTables + NumTables) {
@@ -75,6 +78,7 @@ KTable * SMPModel::createSQL(unsigned int n)  {
             "Mover_BargnId INTEGER NULL DEFAULT 0" \
       ");";
       name = "VectorPosition";
+      pk = "Turn_t, Act_i, Dim_k";
       grpID = 4;// JAH 20161010 put in group 4 all by itself
       break;
 
@@ -87,6 +91,7 @@ KTable * SMPModel::createSQL(unsigned int n)  {
             "Sal  FLOAT NOT NULL DEFAULT 0.0"\
             ");";
       name = "SpatialSalience";
+      pk = "Turn_t, Act_i, Dim_k";
       grpID = 0;
       break;
 
@@ -98,6 +103,7 @@ KTable * SMPModel::createSQL(unsigned int n)  {
             "Cap  FLOAT NOT NULL DEFAULT 0.0"\
             ");";
       name = "SpatialCapability";
+      pk = "Turn_t, Act_i";
       grpID = 0;
       break;
 
@@ -138,14 +144,31 @@ KTable * SMPModel::createSQL(unsigned int n)  {
   if (grpID >= (Model::NumSQLLogGrps + NumSQLLogGrps)) {
     throw KException("SMPModel::createSQL: grpID not valid");
   }
+  if (keyedSchema && !pk.empty()) {
+    return keyedTable(n, name, sql, pk, grpID);
+  }
   auto tab = new KTable(n,name,sql,grpID);
   return tab;
 }
 
 
 void SMPModel::sqlTest() {
+  if (!usesDB()) {
+    LOG(INFO) << "No SQL logging groups enabled, so no database is used";
+    // the table descriptions are still needed, to look up each table's logging group
+    for (unsigned int i = 0; i < SMPModel::NumTables + Model::NumTables; i++) {
+      auto thistable = SMPModel::createSQL(i);
+      if (nullptr == thistable) {
+        throw KException("SMPModel::sqlTest: Could not create a database table");
+      }
+      KTables.push_back(thistable);
+    }
+    return;
+  }
   QCoreApplication::addLibraryPath("./plugins");
-  initDBDriver(QString("smpDB"));
+  // one connection per model, so that models on different threads do not share it
+  initDBDriver(QString("smpDB_") + QString::fromStdString(scenId));
+  const QString dbName = activeDatabaseName();
 
   if (0 == dbDriver.compare("QPSQL")) {
     if (!connectDB()) {
@@ -158,9 +181,9 @@ void SMPModel::sqlTest() {
       query = QSqlQuery(*qtDB);
 
       // Check if the database exists
-      if (!isDB(databaseName)) {
+      if (!isDB(dbName)) {
         // if doesn't exist create one
-        if (createDB(databaseName)) {
+        if (createDB(dbName)) {
           // close the connection to the postgres db
           qtDB->close();
           // connect to the newly created database
@@ -179,7 +202,7 @@ void SMPModel::sqlTest() {
         }
       }
       else {
-        LOG(INFO) << "Database " << databaseName.toStdString()
+        LOG(INFO) << "Database " << dbName.toStdString()
           << " exists but not able to connect to it.";
         throw KException("Error: SMPModel::sqlTest: Could not connect with the database");
       }
@@ -189,16 +212,24 @@ void SMPModel::sqlTest() {
     }
   }
   else if (0 == dbDriver.compare("QSQLITE")) {
-    qtDB->setDatabaseName(databaseName);
-    qtDB->open();
-    query = QSqlQuery(*qtDB);
-    configSqlite();
+    // the native store opens the file itself; a second, Qt connection
+    // would only fight it for the exclusive lock
+    if (!nativeSQLite) {
+      qtDB->setDatabaseName(dbName);
+      qtDB->open();
+      query = QSqlQuery(*qtDB);
+    }
   }
   else {
       LOG(INFO) << "Invalid DB driver name";
       throw KException("SMPModel::sqlTest: Please specify correct DB driver (QPSQL or QSQLITE)");
   }
 
+  openStore();
+  if (0 == dbDriver.compare("QSQLITE")) {
+    configSqlite();
+  }
+
   // Create & execute SQL statements
   // JAH 20160728 rewritten to complete the vector of KTables before creating the table
   for (unsigned int i = 0; i < SMPModel::NumTables + Model::NumTables; i++) {
@@ -210,7 +241,11 @@ void SMPModel::sqlTest() {
     KTables.push_back(thistable);
     // create the table
     execQuery(thistable->tabSQL);
+    if (!thistable->tabViewSQL.empty()) {
+      execQuery(thistable->tabViewSQL);
+    }
   }
+  registerScenarioKey();
 
   return;
 }
@@ -233,24 +268,22 @@ void SMPModel::LogInfoTables()
   // for efficiency sake, we'll do all tables in a single transaction
   // form insert commands
   string sqlD = string("INSERT INTO DimensionDescription (ScenarioId,Dim_k,\"Desc\") VALUES ('")
-    + scenId + "', :dim_k, :desc)";
+    + scenId + "', ?, ?)";
 
-  string sqlC = string("INSERT INTO SpatialCapability (ScenarioId, Turn_t, Act_i, Cap) VALUES ('")
-    + scenId + "', :turn_t, :act_i, :cap)";
+  string sqlC = insertSQL("SpatialCapability", "Turn_t, Act_i, Cap");
 
-  string sqlS = string("INSERT INTO SpatialSalience (ScenarioId, Turn_t, Act_i, Dim_k,Sal) VALUES ('")
-    + scenId + "', :turn_t, :act_i, :dim_k, :sal)";
+  string sqlS = insertSQL("SpatialSalience", "Turn_t, Act_i, Dim_k, Sal");
 
-  string sqlSc = string("UPDATE ScenarioDesc SET VotingRule = :vr, BigRAdjust = :br, "
-    "BigRRange = :brr, ThirdPartyCommit = :tpc, InterVecBrgn = :ivb, BargnModel = :bm "
+  string sqlSc = string("UPDATE ScenarioDesc SET VotingRule = ?, BigRAdjust = ?, "
+    "BigRRange = ?, ThirdPartyCommit = ?, InterVecBrgn = ?, BargnModel = ? "
     " WHERE ScenarioId = '")
     + scenId + "'";
 
   string sqlAcc = string("INSERT INTO Accommodation (ScenarioId, Act_i, Act_j, Affinity) VALUES ('")
     + scenId
-    + "', :act_i, :act_j, :affinity)";
+    + "', ?, ?, ?)";
 
-  qtDB->transaction();
+  store->begin();
 
   // Retrieve accommodation matrix
   auto st = dynamic_cast<SMPState *>(history.back());
@@ -260,40 +293,40 @@ void SMPModel::LogInfoTables()
   auto accM = st->getAccomodate();
 
   // Accomodation table to record affinities
-  query.prepare(QString::fromStdString(sqlAcc));
+  store->prepare(sqlAcc);
   if ((accM.numR() != numAct) || (accM.numC() != numAct)) {
     throw KException("SMPModel::LogInfoTables: accM matrix shape is not correct");
   }
   for (unsigned int Act_i = 0; Act_i < numAct; ++Act_i) {
       for (unsigned int Act_j = 0; Act_j < numAct; ++Act_j) {
           //bind the data
-          query.bindValue(":act_i", Act_i);
-          query.bindValue(":act_j", Act_j);
-          query.bindValue(":affinity", accM(Act_i, Act_j));
+          store->bind(0, Act_i);
+          store->bind(1, Act_j);
+          store->bind(2, accM(Act_i, Act_j));
           // record
-          if (!query.exec()) {
-            LOG(INFO) << query.lastError().text().toStdString();
+          if (!store->step()) {
+            LOG(INFO) << store->lastError();
             throw KException("SMPModel::LogInfoTables: Failed to write Accommodation record");
           }
       }
   }
 
   // Dimension Description Table
-  query.prepare(QString::fromStdString(sqlD));
+  store->prepare(sqlD);
   for (unsigned int k = 0; k < dimName.size(); k++)
   {
     // bind the data
-    query.bindValue(":dim_k", k);
-    query.bindValue(":desc", dimName[k].c_str());
+    store->bind(0, k);
+    store->bind(1, dimName[k]);
     // record
-    if (!query.exec()) {
-      LOG(INFO) << query.lastError().text().toStdString();
+    if (!store->step()) {
+      LOG(INFO) << store->lastError();
       throw KException("SMPModel::LogInfoTables: Failed to write DimensionDescription record");
     }
   }
 
   // Spatial Capability
-  query.prepare(QString::fromStdString(sqlC));
+  store->prepare(sqlC);
   // for each turn extract the information
   for (unsigned int t = 0; t < history.size(); t++) {
     auto st = history[t];
@@ -302,19 +335,19 @@ void SMPModel::LogInfoTables()
     auto caps = cp->actrCaps();
     for (unsigned int i = 0; i < numAct; i++) {
       // bind data
-      query.bindValue(":turn_t", t);
-      query.bindValue(":act_i", i);
-      query.bindValue(":cap", caps(0, i));
+      store->bind(0, t);
+      store->bind(1, i);
+      store->bind(2, caps(0, i));
       // record
-      if (!query.exec()) {
-        LOG(INFO) << query.lastError().text().toStdString();
+      if (!store->step()) {
+        LOG(INFO) << store->lastError();
         throw KException("SMPModel::LogInfoTables: Failed to write SpatialCapability record");
       }
     }
   }
 
   // Spatial Salience
-  query.prepare(QString::fromStdString(sqlS));
+  store->prepare(sqlS);
   // for each turn extract the information
   for (unsigned int t = 0; t < history.size(); t++) {
     // Get the individual turn
@@ -329,35 +362,35 @@ void SMPModel::LogInfoTables()
         // Get the Salience Value for each actor
         //                double sal = ai->vSal(k, 0);
         //bind the data
-        query.bindValue(":turn_t", t);
-        query.bindValue(":act_i", i);
-        query.bindValue(":dim_k", k);
-        query.bindValue(":sal", ai->vSal(k, 0));
+        store->bind(0, t);
+        store->bind(1, i);
+        store->bind(2, k);
+        store->bind(3, ai->vSal(k, 0));
         // record
-        if (!query.exec()) {
-          LOG(INFO) << query.lastError().text().toStdString();
+        if (!store->step()) {
+          LOG(INFO) << store->lastError();
           throw KException("SMPModel::LogInfoTables: Failed to write SpatialSalience record");
         }
       }
     }
   }
 
-  query.prepare(QString::fromStdString(sqlSc));
+  store->prepare(sqlSc);
   //ScenarioDesc table
-  query.bindValue(":vr", static_cast<int>(vrCltn));
-  query.bindValue(":br", static_cast<int>(bigRAdj));
-  query.bindValue(":brr", static_cast<int>(bigRRng));
-  query.bindValue(":tpc", static_cast<int>(tpCommit));
-  query.bindValue(":ivb", static_cast<int>(ivBrgn));
-  query.bindValue(":bm", static_cast<int>(brgnMod));
-
-  if (!query.exec()) {
-    LOG(INFO) << query.lastError().text().toStdString();
+  store->bind(0, static_cast<int>(vrCltn));
+  store->bind(1, static_cast<int>(bigRAdj));
+  store->bind(2, static_cast<int>(bigRRng));
+  store->bind(3, static_cast<int>(tpCommit));
+  store->bind(4, static_cast<int>(ivBrgn));
+  store->bind(5, static_cast<int>(brgnMod));
+
+  if (!store->step()) {
+    LOG(INFO) << store->lastError();
     throw KException("SMPModel::LogInfoTables: Failed to write ScenarioDesc record");   
   }
 
   // finish
-  qtDB->commit();
+  store->commit();
 
   return;
 }
@@ -367,58 +400,25 @@ void SMPModel::LogInfoTables()
 void SMPState::updateBargnTable(const vector<vector<BargainSMP*>> & brgns,
                                 map<unsigned int, KBase::KMatrix>  actorBargains,
                                 map<unsigned int, unsigned int>   actorMaxBrgNdx) const {
+  KTAB_PROFILE_PHASE("SMPState::updateBargnTable");
 
-  string sql = string("UPDATE Bargn SET Init_Prob = :init_prob, Init_Seld = :init_seld, "
-    "Recd_Prob = :recd_prob, Recd_Seld = :recd_seld "
-    "WHERE ('" + model->getScenarioID() + "' = ScenarioId) "
-    "and (:turn_t = Turn_t) and (:bgnId = BargnId) "
-    "and (:init_act_i = Init_Act_i) and (:recd_act_j = Recd_Act_j)");
-
-  QSqlQuery query = model->getQuery();
+  // selection results, keyed like the Bargn primary key (within this scenario and turn)
+  using BargnKey = tuple<uint64_t, int, int>; // bargnId, init_act_i, recd_act_j
+  using BargnSeld = tuple<double, int, double, int>; // init prob, init seld, recd prob, recd seld
+  map<BargnKey, BargnSeld> seld;
 
-  query.prepare(QString::fromStdString(sql));
-
-  auto updateBargn = [&query, this](int bargnID,
+  auto updateBargn = [&seld](uint64_t bargnID,
     int initActor, double initProb, int isInitSelected,
     int recvActor, double recvProb, int isRecvSelected) {
-
-    query.bindValue(":init_prob", initProb);
-
-    query.bindValue(":init_seld", isInitSelected);
-
-    // For SQ cases, there would be no receiver
-    if (initActor != recvActor) {
-      query.bindValue(":recd_prob", recvProb);
-
-      query.bindValue(":recd_seld", isRecvSelected);
-    }
-    else {
-      // Pass NULL values for SQ cases
-      query.bindValue(":recd_prob", QVariant::Double);
-
-      query.bindValue(":recd_seld", QVariant::Int);
-    }
-
-    query.bindValue(":turn_t", turn);
-
-    query.bindValue(":bgnId", bargnID);
-
-    query.bindValue(":init_act_i", initActor);
-
-    query.bindValue(":recd_act_j", recvActor);
-
-    if (!query.exec()) {
-      LOG(INFO) << query.lastError().text().toStdString();
-      throw KException("SMPState::updateBargnTable: DB query failed");
-    }
-
+    seld[BargnKey(bargnID, initActor, recvActor)] =
+      BargnSeld(initProb, isInitSelected, recvProb, isRecvSelected);
     return;
   };
 
   // start for the transaction
   //model->beginDBTransaction();
 
-  // Update the bargain table for the bargain values for init actor and recd actor
+  // Find the bargain values for init actor and recd actor
   // along with the info whether a bargain got selected or not in the respective actor's queue
   for (unsigned int i = 0; i < brgns.size(); i++) {
     auto ai = ((const SMPActor*)(model->actrs[i]));
@@ -489,140 +489,160 @@ void SMPState::updateBargnTable(const vector<vector<BargainSMP*>> & brgns,
     }
   }
 
-  //model->commitDBTransaction();
+  // now insert each bargain in one pass, complete with its selection results
+  string sql = model->insertSQL("Bargn", "Turn_t, BargnId, Init_Act_i, Recd_Act_j, Value, "
+    "Init_Prob, Init_Seld, Recd_Prob, Recd_Seld");
+
+  KBase::LogStore * store = model->logStore();
+  store->prepare(sql);
+
+  for (const auto & bv : brgnVals) {
+    const uint64_t bargnID = get<1>(bv);
+    const int initActor = get<2>(bv);
+    const int recvActor = get<3>(bv);
+
+    store->bind(0, get<0>(bv));
+    store->bind(1, bargnID);
+    store->bind(2, initActor);
+    store->bind(3, recvActor);
+    store->bind(4, get<4>(bv));
+
+    auto sf = seld.find(BargnKey(bargnID, initActor, recvActor));
+    if (seld.end() == sf) {
+      // not in either queue: keep the column defaults
+      store->bind(5, 0.0);
+      store->bindNull(6);
+      store->bind(7, 0.0);
+      store->bindNull(8);
+    }
+    else {
+      store->bind(5, get<0>(sf->second));
+      store->bind(6, get<1>(sf->second));
+
+      // For SQ cases, there would be no receiver
+      if (initActor != recvActor) {
+        store->bind(7, get<2>(sf->second));
+        store->bind(8, get<3>(sf->second));
+      }
+      else {
+        // Pass NULL values for SQ cases
+        store->bindNull(7);
+        store->bindNull(8);
+      }
+    }
+
+    if (!store->step()) {
+      LOG(INFO) << store->lastError();
+      throw KException("SMPState::updateBargnTable: DB query failed");
+    }
+  }
 
   return;
 }
 
 void SMPState::recordProbEduChlg() const {
-  size_t basePos = -1;
-  size_t digCount = 0;
-  size_t nextCommaPos = string::npos;
-
-  auto nextActor = [&basePos, &nextCommaPos](string &actors) {
-    basePos = nextCommaPos + 1;
-    nextCommaPos = actors.find_first_of(",", basePos);
-    size_t digCount = nextCommaPos - basePos;
-    return actors.substr(basePos, digCount);
-  };
+  KTAB_PROFILE_PHASE("SMPState::recordProbEduChlg");
+  const unsigned int na = chlgNA;
+  const unsigned int t = turn;
 
-  QSqlQuery query = model->getQuery();
+  KBase::LogStore * store = model->logStore();
   string qsql;
-  qsql = string("INSERT INTO TPProbVictLoss "
-    "(ScenarioId, Turn_t, Est_h, Init_i, ThrdP_k, Rcvr_j, Prob, Util_V, Util_L) "
-    "VALUES ("
-    "'") + model->getScenarioID() + "',"
-    " :t, :h, :i, :thrdp_k, :j, :prob, :util_v, :util_l )";
+  qsql = model->insertSQL("TPProbVictLoss",
+    "Turn_t, Est_h, Init_i, ThrdP_k, Rcvr_j, Prob, Util_V, Util_L");
 
-  query.prepare(QString::fromStdString(qsql));
+  store->prepare(qsql);
 
   //model->beginDBTransaction();
-  for (auto &tpv : tpvData) {
-    auto thij = tpv.first;
-    auto tpvArray = tpv.second;
-
-    basePos = -1;
-    digCount = 0;
-    nextCommaPos = string::npos;
-
-    auto t = std::stoi(nextActor(thij));
-    auto h = std::stoi(nextActor(thij));
-    auto i = std::stoi(nextActor(thij));
-    auto j = std::stoi(nextActor(thij));
-
-    query.bindValue(":t", t);
-    query.bindValue(":h", h);
-    query.bindValue(":i", i);
-    query.bindValue(":j", j);
-
-    const unsigned int na = model->numAct;
-
-    for (int tpk = 0; tpk < na; tpk++) {  // third party voter, tpk
-      query.bindValue(":thrdp_k", tpk);
-
-      // bind the data
-      query.bindValue(":prob", tpvArray(tpk, 0));
-      query.bindValue(":util_v", tpvArray(tpk, 1));
-      query.bindValue(":util_l", tpvArray(tpk, 2));
-
-      // actually record it
-      if (!query.exec()) {
-        LOG(INFO) << query.lastError().text().toStdString();
-        throw KException("SMPState::recordProbEduChlg: DB query failed.");
+  for (unsigned int h = 0; h < na; h++) {
+    for (unsigned int i = 0; i < na; i++) {
+      for (unsigned int j = 0; j < na; j++) {
+        const size_t hij = (((size_t)h) * na + i) * na + j;
+        if (0 == phijSet[hij]) {
+          continue;
+        }
+        store->bind(0, t);
+        store->bind(1, h);
+        store->bind(2, i);
+        store->bind(4, j);
+
+        for (unsigned int tpk = 0; tpk < na; tpk++) {  // third party voter, tpk
+          const double * tpv = &tpvData[(hij * na + tpk) * 3];
+          store->bind(3, tpk);
+
+          // bind the data
+          store->bind(5, tpv[0]);
+          store->bind(6, tpv[1]);
+          store->bind(7, tpv[2]);
+
+          // actually record it
+          if (!store->step()) {
+            LOG(INFO) << store->lastError();
+            throw KException("SMPState::recordProbEduChlg: DB query failed.");
+          }
+        }
       }
     }
   }
 
-  qsql = string("INSERT INTO ProbVict "
-    "(ScenarioId, Turn_t, Est_h,Init_i,Rcvr_j,Prob) VALUES ('")
-    + model->getScenarioID() + "', :t, :h, :i, :j, :phij)";
-
-  query.prepare(QString::fromStdString(qsql));
-
-  for (auto &phijVal : phijData) {
-    auto thij = phijVal.first;
-    auto phij = phijVal.second;
-
-    basePos = -1;
-    digCount = 0;
-    nextCommaPos = string::npos;
+  qsql = model->insertSQL("ProbVict", "Turn_t, Est_h, Init_i, Rcvr_j, Prob");
 
-    auto t = std::stoi(nextActor(thij));
-    auto h = std::stoi(nextActor(thij));
-    auto i = std::stoi(nextActor(thij));
-    auto j = std::stoi(nextActor(thij));
+  store->prepare(qsql);
 
-    query.bindValue(":t", t);
-    query.bindValue(":h", h);
-    query.bindValue(":i", i);
-    query.bindValue(":j", j);
-    query.bindValue(":phij", phij);
-
-    // actually record it
-    if (!query.exec()) {
-      LOG(INFO) << query.lastError().text().toStdString();
-      throw KException("SMPState::recordProbEduChlg: DB query failed.");
+  for (unsigned int h = 0; h < na; h++) {
+    for (unsigned int i = 0; i < na; i++) {
+      for (unsigned int j = 0; j < na; j++) {
+        const size_t hij = (((size_t)h) * na + i) * na + j;
+        if (0 == phijSet[hij]) {
+          continue;
+        }
+        store->bind(0, t);
+        store->bind(1, h);
+        store->bind(2, i);
+        store->bind(3, j);
+        store->bind(4, phijData[hij]);
+
+        // actually record it
+        if (!store->step()) {
+          LOG(INFO) << store->lastError();
+          throw KException("SMPState::recordProbEduChlg: DB query failed.");
+        }
+      }
     }
   }
 
-  qsql = string("INSERT INTO UtilChlg "
-    "(ScenarioId, Turn_t, Est_h,Aff_k,Init_i,Rcvr_j,Util_SQ,Util_Vict,Util_Cntst,Util_Chlg) VALUES ('")
-    + model->getScenarioID() + "', :t, :h, :k, :i, :j, :euSQ, :euVict, :euCntst, :euChlg)";
-
-  query.prepare(QString::fromStdString(qsql));
-
-  for (auto &euVal : euData) {
-    auto thkij = euVal.first;
-    basePos = -1;
-    digCount = 0;
-    nextCommaPos = string::npos;
-
-    auto t = std::stoi(nextActor(thkij));
-    auto h = std::stoi(nextActor(thkij));
-    auto k = std::stoi(nextActor(thkij));
-    auto i = std::stoi(nextActor(thkij));
-    auto j = std::stoi(nextActor(thkij));
-
-    auto eu = euVal.second;
-    auto euSQ = eu[0];
-    auto euVict = eu[1];
-    auto euCntst = eu[2];
-    auto euChlg = eu[3];
-
-    query.bindValue(":t", t);
-    query.bindValue(":h", h);
-    query.bindValue(":k", k);
-    query.bindValue(":i", i);
-    query.bindValue(":j", j);
-    query.bindValue(":euSQ", euSQ);
-    query.bindValue(":euVict", euVict);
-    query.bindValue(":euCntst", euCntst);
-    query.bindValue(":euChlg", euChlg);
-
-    // actually record it
-    if (!query.exec()) {
-      LOG(INFO) << query.lastError().text().toStdString();
-      throw KException("SMPState::recordProbEduChlg: DB query failed.");
+  qsql = model->insertSQL("UtilChlg",
+    "Turn_t, Est_h, Aff_k, Init_i, Rcvr_j, Util_SQ, Util_Vict, Util_Cntst, Util_Chlg");
+
+  store->prepare(qsql);
+
+  for (unsigned int h = 0; h < na; h++) {
+    for (unsigned int i = 0; i < na; i++) {
+      for (unsigned int j = 0; j < na; j++) {
+        const size_t hij = (((size_t)h) * na + i) * na + j;
+        const unsigned int ks[3] = { i, j, h }; // the k of each slot, see chlgKSlot
+        for (unsigned int slot = 0; slot < 3; slot++) {
+          const size_t hkij = hij * 3 + slot;
+          if (0 == euSet[hkij]) {
+            continue;
+          }
+          const double * eu = &euData[hkij * 4];
+          store->bind(0, t);
+          store->bind(1, h);
+          store->bind(2, ks[slot]);
+          store->bind(3, i);
+          store->bind(4, j);
+          store->bind(5, eu[0]);
+          store->bind(6, eu[1]);
+          store->bind(7, eu[2]);
+          store->bind(8, eu[3]);
+
+          // actually record it
+          if (!store->step()) {
+            LOG(INFO) << store->lastError();
+            throw KException("SMPState::recordProbEduChlg: DB query failed.");
+          }
+        }
+      }
     }
   }
 
@@ -630,6 +650,25 @@ void SMPState::recordProbEduChlg() const {
   return;
 }
 
+
+void SMPState::writeProbEduChlg(const string & fileName) const {
+  std::ofstream out(fileName, std::ios::binary | std::ios::app);
+  if (!out) {
+    throw KException("SMPState::writeProbEduChlg: could not open " + fileName);
+  }
+  const uint32_t hdr[2] = { (uint32_t)turn, (uint32_t)chlgNA };
+  out.write((const char*)hdr, sizeof(hdr));
+  out.write(phijSet.data(), phijSet.size());
+  out.write((const char*)phijData.data(), phijData.size() * sizeof(double));
+  out.write((const char*)tpvData.data(), tpvData.size() * sizeof(double));
+  out.write(euSet.data(), euSet.size());
+  out.write((const char*)euData.data(), euData.size() * sizeof(double));
+  if (!out) {
+    throw KException("SMPState::writeProbEduChlg: could not write " + fileName);
+  }
+  return;
+}
+
 };
 // end of namespace
 
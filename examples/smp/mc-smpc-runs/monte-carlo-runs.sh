@@ -1,36 +1,25 @@
 # =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 # Copyright KAPSARC. MIT Open Source License.
 # =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
-# see http://zxq9.com/archives/795 for some date formats
 #!/bin/bash
 #
 # usage: monte-carlo-runs.sh <n>
 # -------------------------------------------
 
-START=1
-END=20
+N=${1:-20}
 
-rm -f smpc*_GMT_log.txt  smpc*_GMT.db  test.db
-for i in $(eval echo "{$START..$END}")
-do
-  # Zulu (UTC) time, with nanoseconds
-  timestamp="$(date --utc +%Y-%m-%d_%H-%M-%S-%NZ)"
-  name="smpc-${timestamp}_GMT"
-  echo "${i}: ${name}" 
-  ../smpc --seed 0 --logmin --connstr "Driver=QSQLITE;Database=${name}" --euSMP
-done
+# All replicates run inside one smpc process, on a thread pool and without
+# a database. Per-turn statistics go to smpc_ensemble.csv, and each
+# replicate's positions and probabilities to smpc_ensembleDetail.csv.
+rm -f smpc_ensemble.csv smpc_ensembleDetail.csv
+../smpc --seed 0 --euSMP --ensemble ${N} --ensemble-detail
 
 
 echo "Problem sizes"
-grep "Number of actors" smpc*_GMT_log.txt
-grep "Number of SMP dimensions" smpc*_GMT_log.txt
+grep -E "^(Turns|Actors|Dims)," smpc_ensemble.csv
 
-
-sNum=$(grep "Start time" smpc*_GMT_log.txt | wc -l)
-cNum=$(grep "Elapsed time" smpc*_GMT_log.txt | wc -l)
-
-echo "Number of runs started   ${sNum}"
-echo "Number of runs completed ${cNum}"
+echo "Final-state spread and largest probability"
+grep -E "^(Spread|MaxProb),final," smpc_ensemble.csv
 
 # =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 # Copyright KAPSARC. MIT Open Source License.
@@ -0,0 +1,149 @@
+# =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+# Copyright KAPSARC. MIT Open Source License.
+# =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#
+# usage: python3 server-test.py [path to smpc]
+#
+# Starts "smpc --serve" on a Unix socket in a scratch directory, with one
+# worker so that jobs queue up behind each other, and walks through the
+# requests described in libsrc/smpserver.h: SUBMIT by path and inline,
+# STATUS, WAIT, CANCEL of a queued and of a running job, malformed requests,
+# and SHUTDOWN. Exits non-zero at the first reply that is not as expected.
+# -------------------------------------------
+
+import os
+import shutil
+import socket
+import stat
+import subprocess
+import sys
+import tempfile
+import time
+
+SMPC = sys.argv[1] if len(sys.argv) > 1 else "../smpc"
+DOC = os.path.abspath(os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "doc"))
+
+
+def check(ok, msg, reply=""):
+    if not ok:
+        print("FAILED: %s (got: %s)" % (msg, reply))
+        raise SystemExit(1)
+    print("  passed: %s" % msg)
+
+
+class Client(object):
+    def __init__(self, path):
+        self.sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        self.sock.connect(path)
+        self.rf = self.sock.makefile("rb")
+
+    def req(self, line, payload=b""):
+        self.sock.sendall(line.encode() + b"\n" + payload)
+        return self.rf.readline().decode().strip()
+
+    def close(self):
+        self.rf.close()
+        self.sock.close()
+
+
+def main():
+    work = tempfile.mkdtemp(prefix="smpc-server-")
+    path = os.path.join(work, "smpc.sock")
+    srv = subprocess.Popen([SMPC, "--serve", path, "--workers", "1", "--jobdir", work],
+                           cwd=work, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    try:
+        for _ in range(100):
+            if os.path.exists(path) or srv.poll() is not None:
+                break
+            time.sleep(0.1)
+        check(os.path.exists(path), "server is listening on " + path)
+        check(0 == (stat.S_IMODE(os.stat(path).st_mode) & 0o077), "socket is private to this user")
+        c = Client(path)
+
+        print("Cancelling a running and a queued job")
+        r = c.req("SUBMIT csv=%s/dummyData-a080.csv" % DOC)
+        check(r == "OK 1", "SUBMIT csv= by path", r)
+        for _ in range(300):
+            r = c.req("STATUS 1")
+            if r != "JOB 1 queued":
+                break
+            time.sleep(0.1)
+        check(r == "JOB 1 running", "STATUS of the running job", r)
+        r = c.req("SUBMIT xml=%s/smpExample.xml" % DOC)
+        check(r == "OK 2", "SUBMIT xml= by path", r)
+        r = c.req("STATUS 2")
+        check(r == "JOB 2 queued", "second job waits for the only worker", r)
+        r = c.req("CANCEL 2")
+        check(r == "OK 2", "CANCEL of the queued job", r)
+        r = c.req("STATUS 2")
+        check(r.startswith("JOB 2 cancelled"), "queued job is dropped at once", r)
+        r = c.req("CANCEL 1")
+        check(r == "OK 1", "CANCEL of the running job", r)
+        r = c.req("WAIT 1")
+        check(r.startswith("JOB 1 cancelled"), "running job stops after its current turn", r)
+        r = c.req("CANCEL 1")
+        check(r.startswith("ERR"), "CANCEL of a finished job is refused", r)
+
+        print("Running jobs to completion")
+        r = c.req("SUBMIT csv=%s/dummyData_3Dim.csv seed=7 logmin=1" % DOC)
+        check(r == "OK 3", "SUBMIT with seed and logmin", r)
+        r = c.req("WAIT 3")
+        check(r.startswith("JOB 3 done"), "WAIT for a csv job", r)
+        check(os.path.exists(os.path.join(work, "job3.db")), "job logs to <jobdir>/job<id>.db")
+
+        with open(os.path.join(DOC, "SOE-Policy.csv"), "rb") as f:
+            data = f.read()
+        r = c.req("SUBMIT inline=csv bytes=%d" % len(data), data)
+        check(r == "OK 4", "SUBMIT inline=csv", r)
+        r = c.req("WAIT 4")
+        check(r.startswith("JOB 4 done"), "WAIT for the inline job", r)
+        check(not os.path.exists(os.path.join(work, "job4.csv")), "inline scenario is removed afterwards")
+
+        r = c.req("SUBMIT csv=%s/no-such-file.csv" % work)
+        check(r == "OK 5", "SUBMIT of a missing file is queued", r)
+        r = c.req("WAIT 5")
+        check(r.startswith("JOB 5 failed"), "missing file fails the job, not the server", r)
+
+        print("Malformed requests")
+        for bad in ["BOGUS", "STATUS 99", "WAIT", "CANCEL 1 2",
+                    "SUBMIT", "SUBMIT foo=1", "SUBMIT csv",
+                    "SUBMIT csv=a.csv xml=b.xml", "SUBMIT inline=csv",
+                    "SUBMIT inline=txt bytes=10", "SUBMIT inline=csv bytes=0",
+                    "SUBMIT csv=a.csv params=1,2"]:
+            r = c.req(bad)
+            check(r.startswith("ERR"), "ERR for '%s'" % bad, r)
+        r = c.req("STATUS")
+        check(r == "SERVER workers=1 queued=0 running=0 done=2 failed=1 cancelled=2",
+              "STATUS counts every job once", r)
+
+        print("Shutting down")
+        c2 = Client(path)
+        r = c2.req("SHUTDOWN")
+        check(r == "OK", "SHUTDOWN", r)
+        # the server may already have dropped the connection, which is as good as ERR
+        try:
+            r = c.req("SUBMIT csv=%s/dummyData_3Dim.csv" % DOC)
+        except (IOError, OSError):
+            r = ""
+        check(not r.startswith("OK"), "no jobs are accepted after SHUTDOWN", r)
+        c.close()
+        c2.close()
+        try:
+            rc = srv.wait(timeout=60)
+        except subprocess.TimeoutExpired:
+            rc = None
+        check(rc == 0, "server exits cleanly", str(rc))
+        check(not os.path.exists(path), "socket is removed")
+    finally:
+        if srv.poll() is None:
+            srv.kill()
+        shutil.rmtree(work, ignore_errors=True)
+    print("All server checks passed")
+
+
+if __name__ == "__main__":
+    main()
+
+# =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+# Copyright KAPSARC. MIT Open Source License.
+# =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
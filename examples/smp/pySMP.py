@@ -32,6 +32,11 @@
 # will require restarting python (technically, any SMP will access and use an existing
 # smpDyn.dll process, and the OS will only kill the process when python exits).
 #
+# The SMPInstance class below uses the handle-based functions of the library instead,
+# which keep no global state: any number of instances can be created, run and queried
+# in one python process, positions and probabilities are written straight into
+# caller-provided arrays, and the database can be skipped entirely.
+#
 # See the KTAB documentation and relevant publications for details on the model inputs.
 #
 # --------------------------------------------
@@ -341,6 +346,132 @@ class SMP(object):
 		return self.lastError
 
 
+class SMPInstance(object):
+	'''
+	One model, held by the library through an opaque handle; nothing is shared
+	with other instances, so there is no need to restart python between runs.
+
+	Input Attributes
+	cap - list of numActors capabilities
+	pos - list of numActors lists of numDimensions positions, on the [0,100] scale
+	sal - list of numActors lists of numDimensions saliences, on the [0,100] scale
+	accM - optional numActors x numActors accommodation matrix (default identity)
+	seed - integer; 64-bit unsigned int seed for the random number generator
+	modelParams - optional integer list of 9 model parameters (see SMP)
+	sqlFlags - optional boolean list of 5 flags (see SMP); None skips the database
+	dbName - optional database name; the logger and connection string are global,
+		so set them through an SMP object first if the database is used
+
+	Methods
+	runModel() - run the model, returns the number of states
+	getPositions(turn) - numActors lists of numDimensions positions, on the [0,100] scale
+	getPositionProbs(turn,est=-1) - numActors probabilities, as estimated by actor est
+	getScenarioID() - self-explanatory
+	getLastError() - self-explanatory
+	delModel() - release the model; the instance can't be used afterwards
+	'''
+	_bsize = 32*16		# scenario ID
+	_bsize2 = 256*16	# last error message
+
+	def __init__(self,cap,pos,sal,seed,accM=None,modelParams=None,sqlFlags=None,dbName=None):
+		if sys.platform == 'linux':
+			self._smpLib = c.cdll.LoadLibrary(os.getcwd()+os.sep+'libsmpDyn.so')
+		else:
+			self._smpLib = c.cdll.LoadLibrary(os.getcwd()+os.sep+'smpDyn.dll')
+		lib = self._smpLib
+		# the C function declarations are in the extern "C" block of libsrc/smp.cpp
+		lib.smpCreateModel.restype = c.c_void_p
+		lib.smpCreateModel.argtypes = [c.c_uint,c.c_uint,c.POINTER(c.c_double),c.POINTER(c.c_double),
+			c.POINTER(c.c_double),c.POINTER(c.c_double),c.c_uint64,c.POINTER(c.c_int),
+			c.POINTER(c.c_bool),c.c_char_p]
+		lib.smpRunModel.restype = c.c_uint
+		lib.smpRunModel.argtypes = [c.c_void_p]
+		for fn in ('smpGetActorCount','smpGetDimensionCount','smpGetStateCount'):
+			getattr(lib,fn).restype = c.c_uint
+			getattr(lib,fn).argtypes = [c.c_void_p]
+		lib.smpGetPositions.restype = c.c_bool
+		lib.smpGetPositions.argtypes = [c.c_void_p,c.c_uint,c.POINTER(c.c_double)]
+		lib.smpGetPositionProbs.restype = c.c_bool
+		lib.smpGetPositionProbs.argtypes = [c.c_void_p,c.c_uint,c.c_int,c.POINTER(c.c_double)]
+		lib.smpGetScenarioID.argtypes = [c.c_void_p,c.c_char_p,c.c_uint]
+		lib.smpGetError.argtypes = [c.c_void_p,c.c_char_p,c.c_uint]
+		lib.smpDeleteModel.argtypes = [c.c_void_p]
+
+		self.numActors = len(cap)
+		self.numDimensions = len(pos[0])
+		na, nd = self.numActors, self.numDimensions
+		capC = (c.c_double*na)(*cap)
+		posC = (c.c_double*(na*nd))(*[p for row in pos for p in row])
+		salC = (c.c_double*(na*nd))(*[s for row in sal for s in row])
+		accC = None if accM is None else (c.c_double*(na*na))(*[a for row in accM for a in row])
+		parC = None if modelParams is None else (c.c_int*9)(*modelParams)
+		sqlC = None if sqlFlags is None else (c.c_bool*5)(*sqlFlags)
+		dbC = None if dbName is None else bytes(dbName,encoding="ascii")
+		self._handle = lib.smpCreateModel(na,nd,capC,posC,salC,accC,seed,parC,sqlC,dbC)
+		if not(self._handle):
+			raise ValueError('SMPInstance: invalid model inputs')
+		self.numStates = 0
+
+	def runModel(self):
+		'''
+		Run the model; returns the number of states, 0 on error
+		numStates = runModel()
+		'''
+		self.numStates = self._smpLib.smpRunModel(self._handle)
+		if self.numStates == 0:
+			print('Error occurred: %s'%self.getLastError())
+		return self.numStates
+
+	def getPositions(self,turn,out=None):
+		'''
+		Positions of all actors at a turn; if out is given (e.g. a ctypes array
+		or a contiguous float64 numpy array of numActors*numDimensions), it is
+		filled in place and returned without any copy
+		positions = getPositions(turn)
+		'''
+		n = self.numActors*self.numDimensions
+		buf = out if out is not None else (c.c_double*n)()
+		ptr = buf.ctypes.data_as(c.POINTER(c.c_double)) if hasattr(buf,'ctypes') else buf
+		if not(self._smpLib.smpGetPositions(self._handle,turn,ptr)):
+			print('Error occurred: %s'%self.getLastError())
+			return None
+		if out is not None:
+			return out
+		nd = self.numDimensions
+		return [list(buf[i*nd:(i+1)*nd]) for i in range(self.numActors)]
+
+	def getPositionProbs(self,turn,est=-1,out=None):
+		'''
+		Probabilities of the actors' positions at a turn, as estimated by actor
+		est (-1 uses each actor's own utilities); out works as in getPositions
+		probs = getPositionProbs(turn,est)
+		'''
+		buf = out if out is not None else (c.c_double*self.numActors)()
+		ptr = buf.ctypes.data_as(c.POINTER(c.c_double)) if hasattr(buf,'ctypes') else buf
+		if not(self._smpLib.smpGetPositionProbs(self._handle,turn,est,ptr)):
+			print('Error occurred: %s'%self.getLastError())
+			return None
+		return out if out is not None else list(buf)
+
+	def getScenarioID(self):
+		buf = c.create_string_buffer(self._bsize)
+		self._smpLib.smpGetScenarioID(self._handle,buf,self._bsize)
+		return buf.value.decode('utf-8')
+
+	def getLastError(self):
+		buf = c.create_string_buffer(self._bsize2)
+		self._smpLib.smpGetError(self._handle,buf,self._bsize2)
+		return buf.value.decode('utf-8')
+
+	def delModel(self):
+		if self._handle:
+			self._smpLib.smpDeleteModel(self._handle)
+			self._handle = None
+
+	def __del__(self):
+		self.delModel()
+
+
 ''' Use of the SMP object '''
 if __name__ == "__main__":
 	# full path to the easylogger++ configuration file	
@@ -399,6 +530,18 @@ if __name__ == "__main__":
 		  # print the final position
 		  print('\tFinal Position %0.2f'%posHists[a][d][-1])
 
+	# the same kind of model through the handle-based interface, twice in a row
+	# in the same process, without touching the database
+	cap = [100.0, 80.0, 60.0, 40.0]
+	pos = [[10.0], [40.0], [70.0], [95.0]]
+	sal = [[80.0], [60.0], [90.0], [50.0]]
+	for rep in range(2):
+		inst = SMPInstance(cap,pos,sal,seed+rep,modelParams=modelParams)
+		n = inst.runModel()
+		print('Instance %d: %d states, final positions %s, probabilities %s'%(rep,n,
+			inst.getPositions(n-1),['%0.3f'%p for p in inst.getPositionProbs(n-1)]))
+		inst.delModel()
+
 # ---------------------------------------------
 # Copyright KAPSARC. Open source MIT License.
 # ---------------------------------------------
@@ -27,6 +27,12 @@
 
 #include "smp.h"
 #include "demosmp.h"
+#include "kprofile.h"
+#include "klog.h"
+#include "kmemory.h"
+#include "smpserver.h"
+#include <csignal>
+#include <cstdint>
 #include <functional>
 #include <easylogging++.h>
 
@@ -67,10 +73,19 @@ std::string GenerateDBNameWithTimeStamp()
   return name;
 }
 
+// the server being run, if any, so that SIGINT and SIGTERM can stop it cleanly
+SMPLib::SMPServer * server = nullptr;
+
+void stopServer(int) {
+  if (nullptr != server) {
+    server->stop();
+  }
+}
+
 int main(int ac, char **av) {
   using std::string;
   using KBase::dSeed;
-  uint64_t seed = -1;
+  uint64_t seed = UINT64_MAX; // no --seed given
   bool run = true;
   bool euSmpP = false;
   bool randAccP = false;
@@ -78,6 +93,21 @@ int main(int ac, char **av) {
   bool xmlP = false;
   bool logMin = false;
   bool saveHist = false;
+  bool qtSQLite = false;
+  bool keyedDB = false;
+  bool posVoteHalf = false;
+  unsigned int numReps = 0;
+  bool repDetail = false;
+  double tpTol = 0.0;
+  bool profile = false;
+  string profileJSON = "";
+  unsigned int logLevel = static_cast<unsigned int>(KBase::KLog::level());
+  bool logAsync = false;
+  bool memReport = false;
+  double memBudgetMB = 0.0;
+  string serveSocket = "";
+  unsigned int numWorkers = 0;
+  string jobDir = "";
   string inputCSV = "";
   string inputDBname = "";
   string inputXML = "";
@@ -98,6 +128,32 @@ int main(int ac, char **av) {
     printf("--connstr        a semicolon separated string for database server credentials:\n");
     printf("                 \"Driver=<QPSQL|QSQLITE>;Server=<IP>*;[Port=<port>]*;Database=<DB_name>;\n");
     printf("                 Uid=<user_id>*;Pwd=<password>*\"*for QPSQL only\n");
+    printf("--qtsql          write SQLite logs through QtSql rather than directly via sqlite3\n");
+    printf("--keyeddb        store results in integer-keyed tables, read through views\n");
+    printf("--posvotehalf    store PosVote only for Pos_i < Pos_j where the vote is antisymmetric;\n");
+    printf("                 the PosVoteAll view gives every row\n");
+    printf("--tptol <x>      sum third parties to a challenge only until the rest, bounded by\n");
+    printf("                 capability x salience x utility range, could not move its victory\n");
+    printf("                 probability by more than x; default 0 sums them all. With x > 0\n");
+    printf("                 scenarios of up to %u actors (not %u) are accepted, but each turn\n",
+           SMPLib::SMPModel::maxNumActorTP, Model::maxNumActor);
+    printf("                 still holds n^3 doubles of utilities, 8 GB at 1000 actors\n");
+    printf("--ensemble <n>   run n seeded replicates of the euSMP, csv or xml scenario at once,\n");
+    printf("                 without a database, and write per-turn statistics of positions\n");
+    printf("                 and probabilities to input+'_ensemble.csv' (smpc_ensemble.csv for euSMP)\n");
+    printf("--ensemble-detail  with --ensemble, also write every replicate to input+'_ensembleDetail.csv'\n");
+    printf("--profile        log a table of time spent in each phase of every turn\n");
+    printf("--profilejson <f>  with --profile, also append each turn's table to f as a line of JSON\n");
+    printf("--loglevel <n>   detail logged from the bargaining loops, 0 (none) to 4; default %u\n",
+           static_cast<unsigned int>(KBase::KLog::level()));
+    printf("--logasync       write those logs from a background thread\n");
+    printf("--memreport      log live and peak memory by category after every turn\n");
+    printf("--membudget <mb> when more than mb megabytes are live after a turn, drop cached\n");
+    printf("                 results of earlier turns, then stop the run if still over\n");
+    printf("--serve <s>      instead of running once, take scenario jobs over the Unix domain\n");
+    printf("                 socket s until sent SHUTDOWN; see smpserver.h for the requests\n");
+    printf("--workers <n>    with --serve, run up to n jobs at once; default one per core\n");
+    printf("--jobdir <d>     with --serve, where inline scenarios and default job DBs go; default .\n");
   };
 
   if (ac > 1) {
@@ -151,6 +207,123 @@ int main(int ac, char **av) {
         i++;
         connstr = av[i];
       }
+      else if (strcmp(av[i], "--qtsql") == 0) {
+        qtSQLite = true;
+      }
+      else if (strcmp(av[i], "--keyeddb") == 0) {
+        keyedDB = true;
+      }
+      else if (strcmp(av[i], "--posvotehalf") == 0) {
+        posVoteHalf = true;
+      }
+      else if (strcmp(av[i], "--tptol") == 0) {
+        i++;
+        if (av[i] != NULL)
+        {
+                tpTol = std::stod(av[i]);
+        }
+        else
+        {
+                run = false;
+                break;
+        }
+      }
+      else if (strcmp(av[i], "--ensemble") == 0) {
+        i++;
+        if (av[i] != NULL)
+        {
+                numReps = std::stoul(av[i]);
+        }
+        else
+        {
+                run = false;
+                break;
+        }
+      }
+      else if (strcmp(av[i], "--ensemble-detail") == 0) {
+        repDetail = true;
+      }
+      else if (strcmp(av[i], "--loglevel") == 0) {
+        i++;
+        if ((av[i] != NULL) && (std::stoul(av[i]) <= 4))
+        {
+                logLevel = std::stoul(av[i]);
+        }
+        else
+        {
+                run = false;
+                break;
+        }
+      }
+      else if (strcmp(av[i], "--logasync") == 0) {
+        logAsync = true;
+      }
+      else if (strcmp(av[i], "--memreport") == 0) {
+        memReport = true;
+      }
+      else if (strcmp(av[i], "--membudget") == 0) {
+        i++;
+        if (av[i] != NULL)
+        {
+                memBudgetMB = std::stod(av[i]);
+        }
+        else
+        {
+                run = false;
+                break;
+        }
+      }
+      else if (strcmp(av[i], "--serve") == 0) {
+        i++;
+        if (av[i] != NULL)
+        {
+                serveSocket = av[i];
+        }
+        else
+        {
+                run = false;
+                break;
+        }
+      }
+      else if (strcmp(av[i], "--workers") == 0) {
+        i++;
+        if (av[i] != NULL)
+        {
+                numWorkers = std::stoul(av[i]);
+        }
+        else
+        {
+                run = false;
+                break;
+        }
+      }
+      else if (strcmp(av[i], "--jobdir") == 0) {
+        i++;
+        if (av[i] != NULL)
+        {
+                jobDir = av[i];
+        }
+        else
+        {
+                run = false;
+                break;
+        }
+      }
+      else if (strcmp(av[i], "--profile") == 0) {
+        profile = true;
+      }
+      else if (strcmp(av[i], "--profilejson") == 0) {
+        i++;
+        if (av[i] != NULL)
+        {
+                profileJSON = av[i];
+        }
+        else
+        {
+                run = false;
+                break;
+        }
+      }
       else {
         run = false;
         printf("Unrecognized argument %s\n", av[i]);
@@ -197,7 +370,7 @@ int main(int ac, char **av) {
   // here only if input is not xml, so as to ensure that a manually
   // input seed on the cmdline can override the seed in an xml file,
   // but the dseed coming from no seed input can't override it
-  if ((seed == -1) && (!xmlP)) {
+  if ((seed == UINT64_MAX) && (!xmlP)) {
       seed = KBase::dSeed;
   }
 
@@ -206,6 +379,57 @@ int main(int ac, char **av) {
     LOG(INFO) << KBase::Model::getLastError();
     return -1;
   }
+  KBase::Model::setNativeSQLite(!qtSQLite);
+  KBase::Model::setKeyedSchema(keyedDB);
+  KBase::Model::setPosVoteHalf(posVoteHalf);
+  SMPLib::SMPModel::setThirdPartyTol(tpTol);
+  KBase::Profiler::enable(profile);
+  KBase::Profiler::setJSONFile(profileJSON);
+  KBase::KLog::setLevel(static_cast<KBase::ReportingLevel>(logLevel));
+  KBase::KLog::setAsync(logAsync);
+  if ((memReport || (0.0 < memBudgetMB)) && !KBase::MemAccount::compiledIn()) {
+    LOG(INFO) << "Warning: memory accounting needs a build with ENABLE_MEMORY_ACCOUNTING; --memreport and --membudget are ignored";
+  }
+  KBase::MemAccount::setReport(memReport);
+  KBase::MemAccount::setBudget((uint64_t)(memBudgetMB * 1024.0 * 1024.0));
+
+  // a server replaces the single runs; the set-up above is shared by all its jobs
+  if (!serveSocket.empty()) {
+    SMPLib::SMPServer srv(serveSocket, numWorkers, jobDir);
+    server = &srv;
+    signal(SIGINT, stopServer);
+    signal(SIGTERM, stopServer);
+    try {
+      srv.serve();
+    }
+    catch (KBase::KException &ke) {
+      LOG(INFO) << "Error: " << ke.msg;
+    }
+    server = nullptr;
+    KBase::displayProgramEnd(sTime);
+    return 0;
+  }
+
+  // an ensemble replaces the single runs, and never uses the database
+  if (0 < numReps) {
+    string input = euSmpP ? "" : (csvP ? inputCSV : (xmlP ? inputXML : ""));
+    string outName = input.empty() ? "smpc" : input.substr(0, input.find_last_of("."));
+    if (!euSmpP && input.empty()) {
+      LOG(INFO) << "Error: --ensemble needs one of --euSMP, --csv or --xml";
+    }
+    else {
+      uint64_t eSeed = (seed == UINT64_MAX) ? KBase::dSeed : seed;
+      try {
+        SMPLib::SMPModel::runEnsemble(numReps, eSeed, input, randAccP,
+          outName + "_ensemble.csv", repDetail ? (outName + "_ensembleDetail.csv") : "");
+      }
+      catch (KBase::KException &ke) {
+        LOG(INFO) << "Error: " << ke.msg;
+      }
+    }
+    KBase::displayProgramEnd(sTime);
+    return 0;
+  }
 
   // note that we reset the seed every time, so that in case something
   // goes wrong, we need not scroll back too far to find the